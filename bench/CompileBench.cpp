@@ -0,0 +1,241 @@
+/** \file CompileBench.cpp
+ * Parser, codegen and optimization benchmarks
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/AST_util.h>
+#include <basilisk/Flat.h>
+#include <basilisk/Optimization.h>
+#include <basilisk/Parallel.h>
+#include <basilisk/Interpreter.h>
+
+#include <ProgramGenerator.h>
+#include <Stages.h>
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace ast = basilisk::ast;
+namespace bench = basilisk::bench;
+
+namespace {
+    //! Shape of the program with the provided number of functions, and the expression depth if provided
+    bench::ProgramShape shape_of(const benchmark::State &state) {
+        bench::ProgramShape shape;
+        shape.functions = static_cast<std::size_t>(state.range(0));
+        if (state.range(1) > 0) {
+            shape.depth = static_cast<std::size_t>(state.range(1));
+        }
+        return shape;
+    }
+
+    //! Record a rate counter of the provided number of items per iteration
+    void set_rate(benchmark::State &state, const char *name, std::size_t items) {
+        state.counters[name] = benchmark::Counter(static_cast<double>(state.iterations() * items),
+                benchmark::Counter::kIsRate);
+    }
+}
+
+//! Parsing of a token buffer into a program, including its teardown
+static void BM_Parse(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    auto tokens = bench::lex(source);
+    auto counted = bench::parse(tokens);
+    std::size_t nodes = ast::util::CountVisitor::count(counted).nodes;
+    for (auto _ : state) {
+        auto program = bench::parse(tokens);
+        benchmark::DoNotOptimize(program.definitions.data());
+    }
+    state.counters["nodes"] = benchmark::Counter(static_cast<double>(nodes));
+    set_rate(state, "nodes_per_second", nodes);
+}
+BENCHMARK(BM_Parse)->ArgsProduct({{16, 128, 1024}, {2, 4, 6}})->Unit(benchmark::kMillisecond);
+
+//! Parallel parsing of a token buffer into a program on the number of threads of the third argument
+static void BM_ParseParallel(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    auto tokens = bench::lex(source);
+    auto jobs = static_cast<unsigned>(state.range(2));
+    for (auto _ : state) {
+        auto program = basilisk::parallel::parse(tokens, jobs);
+        benchmark::DoNotOptimize(program.definitions.data());
+    }
+    set_rate(state, "tokens_per_second", tokens.size());
+}
+BENCHMARK(BM_ParseParallel)->ArgsProduct({{128, 1024}, {4}, {1, 2, 4, 8}})->Unit(benchmark::kMillisecond);
+
+//! Lexing and parsing of a source buffer, through a token vector or a token stream, including teardown
+static void BM_LexParse(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    bool stream = state.range(2) != 0;
+    for (auto _ : state) {
+        auto program = stream ? bench::parse_stream(source) : bench::parse(bench::lex(source));
+        benchmark::DoNotOptimize(program.definitions.data());
+    }
+    set_rate(state, "bytes_per_second", source.size());
+}
+BENCHMARK(BM_LexParse)->ArgsProduct({{128, 1024}, {4}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+//! Constant folding of a parsed program
+// Note: folding mutates the program, so each iteration gets a fresh one, timed manually to exclude it
+static void BM_Fold(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    auto tokens = bench::lex(source);
+    std::size_t nodes = 0;
+    std::size_t replaced = 0;
+    for (auto _ : state) {
+        auto program = bench::parse(tokens);
+        nodes = ast::util::CountVisitor::count(program).nodes;
+
+        auto start = std::chrono::steady_clock::now();
+        replaced = ast::util::FoldVisitor::fold(program);
+        auto end = std::chrono::steady_clock::now();
+
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+    }
+    state.counters["nodes"] = benchmark::Counter(static_cast<double>(nodes));
+    state.counters["replaced"] = benchmark::Counter(static_cast<double>(replaced));
+    set_rate(state, "nodes_per_second", nodes);
+}
+BENCHMARK(BM_Fold)->ArgsProduct({{16, 128, 1024}, {4}})->UseManualTime()->Unit(benchmark::kMillisecond);
+
+//! Constant folding of the functions of a parsed program lowered into flat buffers
+// Note: folding mutates the buffers, so each iteration lowers fresh ones, timed manually to exclude it
+static void BM_FoldFlat(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    auto program = bench::parse(bench::lex(source));
+    std::vector<ast::definitions::Function *> functions;
+    for (auto &definition : program.definitions) {
+        if (auto function = dynamic_cast<ast::definitions::Function *>(definition.get())) {
+            functions.push_back(function);
+        }
+    }
+    std::size_t nodes = 0;
+    std::size_t replaced = 0;
+    for (auto _ : state) {
+        std::vector<basilisk::flat::Buffer> buffers;
+        nodes = 0;
+        for (auto function : functions) {
+            buffers.push_back(basilisk::flat::Buffer::lower(*function));
+            nodes += buffers.back().size();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        replaced = 0;
+        for (auto &buffer : buffers) {
+            replaced += buffer.fold();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+    }
+    state.counters["nodes"] = benchmark::Counter(static_cast<double>(nodes));
+    state.counters["replaced"] = benchmark::Counter(static_cast<double>(replaced));
+    set_rate(state, "nodes_per_second", nodes);
+}
+BENCHMARK(BM_FoldFlat)->ArgsProduct({{16, 128, 1024}, {4}})->UseManualTime()->Unit(benchmark::kMillisecond);
+
+//! Code generation of a parsed program
+// Note: codegen mutates the program (renaming `main`), so each iteration gets a fresh one, timed manually to exclude it
+static void BM_Codegen(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    auto tokens = bench::lex(source);
+    std::size_t functions = 0;
+    for (auto _ : state) {
+        auto program = bench::parse(tokens);
+        functions = ast::util::CountVisitor::count(program).functions;
+        llvm::LLVMContext context;
+
+        auto start = std::chrono::steady_clock::now();
+        auto module = bench::generate(program, context);
+        auto end = std::chrono::steady_clock::now();
+
+        benchmark::DoNotOptimize(module.get());
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+    }
+    state.counters["functions"] = benchmark::Counter(static_cast<double>(functions));
+    set_rate(state, "functions_per_second", functions);
+}
+BENCHMARK(BM_Codegen)->ArgsProduct({{16, 128, 1024}, {4}})->UseManualTime()->Unit(benchmark::kMillisecond);
+
+//! Parallel code generation of a parsed program, on the number of threads of the third argument
+// Note: codegen mutates the program (renaming `main`), so each iteration gets a fresh one, timed manually to exclude it
+static void BM_CodegenParallel(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    basilisk::parallel::Settings settings;
+    settings.jobs = static_cast<unsigned>(state.range(2));
+    auto tokens = bench::lex(source);
+    std::size_t functions = 0;
+    for (auto _ : state) {
+        auto program = bench::parse(tokens);
+        functions = ast::util::CountVisitor::count(program).functions;
+        llvm::LLVMContext context;
+        llvm::Module module("bench", context);
+
+        auto start = std::chrono::steady_clock::now();
+        basilisk::parallel::generate(program, module, {}, settings);
+        auto end = std::chrono::steady_clock::now();
+
+        benchmark::DoNotOptimize(&module);
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+    }
+    state.counters["functions"] = benchmark::Counter(static_cast<double>(functions));
+    set_rate(state, "functions_per_second", functions);
+}
+BENCHMARK(BM_CodegenParallel)->ArgsProduct({{128, 1024}, {4}, {1, 2, 4, 8}})->UseManualTime()
+        ->Unit(benchmark::kMillisecond);
+
+//! Optimization pass pipeline of basilisk_c on generated IR, at the optimization level of the third argument
+// Note: the passes mutate the module, so each iteration gets a fresh one, timed manually to exclude it
+static void BM_Optimize(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    auto level = static_cast<basilisk::optimization::Level>(state.range(2));
+    auto tokens = bench::lex(source);
+    std::size_t functions = 0;
+    for (auto _ : state) {
+        auto program = bench::parse(tokens);
+        functions = ast::util::CountVisitor::count(program).functions;
+        llvm::LLVMContext context;
+        auto module = bench::generate(program, context);
+
+        auto start = std::chrono::steady_clock::now();
+        basilisk::optimization::optimize(*module, level);
+        auto end = std::chrono::steady_clock::now();
+
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+    }
+    state.counters["functions"] = benchmark::Counter(static_cast<double>(functions));
+    set_rate(state, "functions_per_second", functions);
+}
+BENCHMARK(BM_Optimize)->ArgsProduct({{16, 128, 1024}, {4}, {1, 2, 3}})->UseManualTime()->Unit(benchmark::kMillisecond);
+
+//! Compilation of source into bytecode, including the initialization of global variables
+static void BM_Interpret(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    basilisk::interpreter::Settings settings;
+    settings.tier_up = 0;
+    for (auto _ : state) {
+        basilisk::interpreter::Interpreter interpreter(bench::parse(bench::lex(source)), settings);
+        benchmark::DoNotOptimize(&interpreter);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+}
+BENCHMARK(BM_Interpret)->ArgsProduct({{16, 128, 1024}, {4}})->Unit(benchmark::kMillisecond);
+
+//! Whole pipeline from source to optimized IR
+static void BM_Pipeline(benchmark::State &state) {
+    std::string source = bench::generate_program(shape_of(state));
+    for (auto _ : state) {
+        auto program = bench::parse(bench::lex(source));
+        llvm::LLVMContext context;
+        auto module = bench::generate(program, context);
+        basilisk::optimization::optimize(*module);
+        benchmark::DoNotOptimize(module.get());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+}
+BENCHMARK(BM_Pipeline)->ArgsProduct({{16, 128, 1024}, {4}})->Unit(benchmark::kMillisecond);
@@ -0,0 +1,62 @@
+/** \file EvaluatorBench.cpp
+ * Evaluator benchmarks
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Evaluator.h>
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace {
+    //! Formula evaluated by the benchmarks
+    const char *formula = "weight = 0.25;\n"
+                          "blend(x, y) {\n"
+                          "    return weight * x * x + (1.0 - weight) * y + 0.5;\n"
+                          "}";
+
+    //! Input columns of the provided number of rows
+    struct Columns {
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> out;
+
+        explicit Columns(std::size_t n) : x(n), y(n), out(n) {
+            for (std::size_t i = 0; i < n; i++) {
+                x[i] = static_cast<double>(i) * 0.5;
+                y[i] = static_cast<double>(n - i);
+            }
+        }
+    };
+}
+
+//! Evaluation of a formula one call per row
+static void BM_EvaluateCalls(benchmark::State &state) {
+    basilisk::evaluator::Evaluator evaluator(formula);
+    auto blend = evaluator.function<double, double>("blend");
+    Columns columns(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < columns.out.size(); i++) {
+            columns.out[i] = blend(columns.x[i], columns.y[i]);
+        }
+        benchmark::DoNotOptimize(columns.out.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * columns.out.size()));
+}
+BENCHMARK(BM_EvaluateCalls)->Range(1 << 10, 1 << 20);
+
+//! Evaluation of a formula through its batch form
+static void BM_EvaluateBatch(benchmark::State &state) {
+    basilisk::evaluator::Evaluator evaluator(formula);
+    auto blend = evaluator.batch("blend");
+    Columns columns(static_cast<std::size_t>(state.range(0)));
+    const double *args[] = {columns.x.data(), columns.y.data()};
+    for (auto _ : state) {
+        blend(args, columns.out.data(), columns.out.size());
+        benchmark::DoNotOptimize(columns.out.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * columns.out.size()));
+}
+BENCHMARK(BM_EvaluateBatch)->Range(1 << 10, 1 << 20);
@@ -0,0 +1,67 @@
+/** \file GenerateProgram.cpp
+ * Executable writing generated benchmark programs, for timing basilisk_c on them
+ *
+ * \author Filip Smola
+ */
+
+#include <ProgramGenerator.h>
+
+#include <iostream>
+#include <string>
+
+//! Print usage into standard output
+void show_usage() {
+    std::cout << "USAGE: basilisk_generate [options]\n\n"
+              << "Write a generated Basilisk program into standard output.\n\n"
+              << "OPTIONS:\n"
+              << "\t--globals N\n\t\tNumber of global variables.\n"
+              << "\t--functions N\n\t\tNumber of functions.\n"
+              << "\t--parameters N\n\t\tNumber of parameters of each function.\n"
+              << "\t--locals N\n\t\tNumber of local variables of each function.\n"
+              << "\t--depth N\n\t\tMaximum expression depth.\n"
+              << "\t--fan-out N\n\t\tMaximum number of distinct functions each function calls.\n"
+              << "\t--seed N\n\t\tSeed of the pseudo-random generator.\n";
+}
+
+int main(int argc, char *argv[]) {
+    basilisk::bench::ProgramShape shape;
+
+    // Go through option - value pairs
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help" || i + 1 >= argc) {
+            show_usage();
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+
+        std::size_t value;
+        try {
+            value = std::stoul(argv[++i]);
+        } catch (std::exception &) {
+            std::cerr << "basilisk_generate: Invalid value for " << arg << '\n';
+            return 1;
+        }
+
+        if (arg == "--globals") {
+            shape.globals = value;
+        } else if (arg == "--functions") {
+            shape.functions = value;
+        } else if (arg == "--parameters") {
+            shape.parameters = value;
+        } else if (arg == "--locals") {
+            shape.locals = value;
+        } else if (arg == "--depth") {
+            shape.depth = value;
+        } else if (arg == "--fan-out") {
+            shape.fan_out = value;
+        } else if (arg == "--seed") {
+            shape.seed = static_cast<std::uint32_t>(value);
+        } else {
+            std::cerr << "basilisk_generate: Unknown option " << arg << '\n';
+            return 1;
+        }
+    }
+
+    std::cout << basilisk::bench::generate_program(shape);
+    return 0;
+}
@@ -0,0 +1,149 @@
+/** \file LexerBench.cpp
+ * Lexer benchmarks
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Lexer.h>
+#include <basilisk/Tokens.h>
+
+#include <ProgramGenerator.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tokens = basilisk::tokens;
+namespace lexer = basilisk::lexer;
+namespace bench = basilisk::bench;
+
+namespace {
+    /** \namespace reference
+     * \brief Copy of the scanner before table-driven classification, kept as the baseline
+     *
+     * Classifies with `<cctype>` and finds special symbols with `std::find`, one character at a time.
+     */
+    namespace reference {
+        constexpr char special_symbols[] = {'(', ')', '{', '}', ',', ';', '=', '+', '-', '*', '/', '%'};
+        constexpr tokens::tags::token_tag special_tags[] = {tokens::tags::lpar, tokens::tags::rpar, tokens::tags::lbrac,
+                                                            tokens::tags::rbrac, tokens::tags::comma,
+                                                            tokens::tags::semicolon, tokens::tags::assign,
+                                                            tokens::tags::plus, tokens::tags::minus, tokens::tags::star,
+                                                            tokens::tags::slash, tokens::tags::percent};
+
+        long which_special(char c) {
+            const char *p = std::find(std::begin(special_symbols), std::end(special_symbols), c);
+            return p == std::end(special_symbols) ? -1 : p - special_symbols;
+        }
+
+        void lex(std::string_view input, std::vector<tokens::Token> &output) {
+            const char *position = input.data();
+            const char *end = input.data() + input.size();
+            auto peek = [&]() { return position < end ? *position : '\0'; };
+            auto since = [&](const char *start) { return std::string_view(start, position - start); };
+
+            for (char next = peek(); next != '\0'; next = peek()) {
+                const char *start = position;
+                if (std::isspace(next) > 0) {
+                    position++;
+                } else if (std::isalpha(next) > 0) {
+                    while (std::isalnum(peek()) > 0 || peek() == '_') {
+                        position++;
+                    }
+                    auto content = since(start);
+                    output.push_back(content == "return" ? tokens::Token{tokens::tags::kw_return, ""}
+                                                         : tokens::Token{tokens::tags::identifier, content});
+                } else if (std::isdigit(next) > 0) {
+                    while (std::isdigit(peek()) > 0) {
+                        position++;
+                    }
+                    position++;
+                    while (std::isdigit(peek()) > 0) {
+                        position++;
+                    }
+                    output.push_back(tokens::Token{tokens::tags::double_literal, since(start)});
+                } else if (which_special(next) >= 0) {
+                    output.push_back(tokens::Token{special_tags[which_special(*position++)], ""});
+                } else {
+                    output.push_back(tokens::Token{tokens::tags::error, ""});
+                    return;
+                }
+            }
+            output.push_back(tokens::Token{tokens::tags::end_of_input, ""});
+        }
+    }
+
+    //! Record throughput counters common to all lexer benchmarks
+    void set_counters(benchmark::State &state, const std::string &source, std::size_t tokens) {
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+        state.counters["tokens"] = benchmark::Counter(static_cast<double>(tokens));
+        state.counters["tokens_per_second"] = benchmark::Counter(
+                static_cast<double>(state.iterations() * tokens), benchmark::Counter::kIsRate);
+    }
+}
+
+//! Baseline: scanner before table-driven classification
+static void BM_LexReference(benchmark::State &state) {
+    std::string source = bench::generate_program_of_size(static_cast<std::size_t>(state.range(0)));
+    std::vector<tokens::Token> output;
+    for (auto _ : state) {
+        output.clear();
+        reference::lex(source, output);
+        benchmark::DoNotOptimize(output.data());
+    }
+    set_counters(state, source, output.size());
+}
+BENCHMARK(BM_LexReference)->RangeMultiplier(8)->Range(1 << 10, 1 << 22);
+
+//! Buffer entry point
+static void BM_LexBuffer(benchmark::State &state) {
+    std::string source = bench::generate_program_of_size(static_cast<std::size_t>(state.range(0)));
+    std::vector<tokens::Token> output;
+    for (auto _ : state) {
+        output.clear();
+        lexer::lex(source, output);
+        benchmark::DoNotOptimize(output.data());
+    }
+    set_counters(state, source, output.size());
+}
+BENCHMARK(BM_LexBuffer)->RangeMultiplier(8)->Range(1 << 10, 1 << 22);
+
+//! Callback entry point, reading the input one character at a time
+static void BM_LexCallback(benchmark::State &state) {
+    std::string source = bench::generate_program_of_size(static_cast<std::size_t>(state.range(0)));
+    std::string buffer;
+    std::vector<tokens::Token> output;
+    for (auto _ : state) {
+        std::size_t position = 0;
+        output.clear();
+        lexer::lex([&]() { return position < source.size() ? source[position++] : '\0'; },
+                   [&]() { return position < source.size() ? source[position] : '\0'; },
+                   [&](const tokens::Token &t) { output.push_back(t); },
+                   buffer);
+        benchmark::DoNotOptimize(output.data());
+    }
+    set_counters(state, source, output.size());
+}
+BENCHMARK(BM_LexCallback)->RangeMultiplier(8)->Range(1 << 10, 1 << 22);
+
+//! Long runs of whitespace and identifier characters, where the vector scanners matter most
+static void BM_LexLongRuns(benchmark::State &state) {
+    std::string source;
+    for (int i = 0; i < 4096; i++) {
+        source += std::string(static_cast<std::size_t>(state.range(0)), ' ');
+        source += "identifier_" + std::string(static_cast<std::size_t>(state.range(0)), 'x');
+        source += " = 1234567890.0987654321;\n";
+    }
+    std::vector<tokens::Token> output;
+    for (auto _ : state) {
+        output.clear();
+        lexer::lex(source, output);
+        benchmark::DoNotOptimize(output.data());
+    }
+    set_counters(state, source, output.size());
+}
+BENCHMARK(BM_LexLongRuns)->Arg(4)->Arg(16)->Arg(64);
@@ -0,0 +1,184 @@
+/** \file ProgramGenerator.cpp
+ * Synthetic program generator implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <ProgramGenerator.h>
+
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace basilisk::bench {
+    namespace {
+        /** \class Generator
+         * \brief State of generating a single program
+         */
+        class Generator {
+            private:
+                //! Shape of the generated program
+                const ProgramShape &shape;
+                //! Pseudo-random generator
+                std::mt19937 random;
+                //! Output stream
+                std::ostringstream out;
+                //! Names of variables in scope
+                std::vector<std::string> variables;
+                //! Names of functions defined so far
+                std::vector<std::string> functions;
+                //! Names of functions the current function may call
+                std::vector<std::string> callees;
+
+                //! Pick a uniformly random number in `[0, bound)`
+                std::size_t pick(std::size_t bound) {
+                    return std::uniform_int_distribution<std::size_t>(0, bound - 1)(random);
+                }
+
+                //! Write a random double literal
+                void literal() {
+                    out << pick(1000) << '.' << pick(100);
+                }
+
+                //! Write a random expression of at most the provided depth
+                void expression(std::size_t depth) {
+                    constexpr char operators[] = {'+', '-', '*', '/', '%'};
+
+                    // Leaves
+                    if (depth == 0) {
+                        if (variables.empty() || pick(3) == 0) {
+                            literal();
+                        } else {
+                            out << variables[pick(variables.size())];
+                        }
+                        return;
+                    }
+
+                    switch (pick(5)) {
+                        case 0:
+                            // Function call
+                            if (!callees.empty()) {
+                                out << callees[pick(callees.size())] << '(';
+                                for (std::size_t i = 0; i < shape.parameters; i++) {
+                                    if (i > 0) {
+                                        out << ", ";
+                                    }
+                                    expression(depth - 1);
+                                }
+                                out << ')';
+                                break;
+                            }
+                            [[fallthrough]];
+                        case 1:
+                            // Parenthesised expression
+                            out << '(';
+                            expression(depth - 1);
+                            out << ')';
+                            break;
+                        case 2:
+                            // Negation
+                            out << '-';
+                            expression(depth - 1);
+                            break;
+                        default:
+                            // Binary operation
+                            expression(depth - 1);
+                            out << ' ' << operators[pick(sizeof(operators))] << ' ';
+                            expression(depth - 1);
+                            break;
+                    }
+                }
+
+            public:
+                //! Construct a generator of the provided shape
+                explicit Generator(const ProgramShape &shape) : shape(shape), random(shape.seed) {}
+
+                //! Generate the program source
+                std::string generate() {
+                    // Global variables
+                    for (std::size_t i = 0; i < shape.globals; i++) {
+                        out << "global_" << i << " = ";
+                        literal();
+                        out << ";\n";
+                    }
+                    out << '\n';
+                    const std::vector<std::string> globals = [&]() {
+                        std::vector<std::string> result;
+                        for (std::size_t i = 0; i < shape.globals; i++) {
+                            result.push_back("global_" + std::to_string(i));
+                        }
+                        return result;
+                    }();
+
+                    // Functions
+                    for (std::size_t f = 0; f < shape.functions; f++) {
+                        std::string name = "function_" + std::to_string(f);
+                        variables = globals;
+
+                        // Pick the functions this one may call
+                        callees.clear();
+                        for (std::size_t i = 0; i < shape.fan_out && !functions.empty(); i++) {
+                            callees.push_back(functions[pick(functions.size())]);
+                        }
+
+                        out << name << '(';
+                        for (std::size_t i = 0; i < shape.parameters; i++) {
+                            std::string parameter = "parameter_" + std::to_string(i);
+                            out << (i > 0 ? ", " : "") << parameter;
+                            variables.push_back(parameter);
+                        }
+                        out << ") {\n";
+
+                        for (std::size_t s = 0; s < shape.locals; s++) {
+                            std::string local = "local_" + std::to_string(s);
+                            out << "    " << local << " = ";
+                            expression(pick(shape.depth + 1));
+                            out << ";\n";
+                            variables.push_back(local);
+                        }
+                        out << "    return ";
+                        expression(shape.depth);
+                        out << ";\n}\n\n";
+
+                        functions.push_back(name);
+                    }
+
+                    // Entry point
+                    variables = globals;
+                    out << "main() {\n    return ";
+                    if (functions.empty()) {
+                        literal();
+                    } else {
+                        out << functions.back() << '(';
+                        for (std::size_t i = 0; i < shape.parameters; i++) {
+                            out << (i > 0 ? ", " : "");
+                            literal();
+                        }
+                        out << ')';
+                    }
+                    out << ";\n}\n";
+
+                    return out.str();
+                }
+        };
+    }
+
+    std::string generate_program(const ProgramShape &shape) {
+        return Generator(shape).generate();
+    }
+
+    std::string generate_program_of_size(std::size_t bytes) {
+        // Measure a single function and scale the count to match
+        ProgramShape shape;
+        shape.functions = 1;
+        std::size_t single = generate_program(shape).size();
+        shape.functions = bytes / single + 1;
+
+        std::string result = generate_program(shape);
+        while (result.size() < bytes) {
+            shape.functions *= 2;
+            result = generate_program(shape);
+        }
+        return result;
+    }
+}
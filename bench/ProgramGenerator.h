@@ -0,0 +1,60 @@
+/** \file ProgramGenerator.h
+ * Synthetic program generator for benchmarks
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_BENCH_PROGRAMGENERATOR_H
+#define BASILISK_BENCH_PROGRAMGENERATOR_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/** \namespace basilisk::bench
+ * \brief Benchmark support code
+ */
+namespace basilisk::bench {
+    /** \struct ProgramShape
+     * \brief Parameters of a generated program
+     */
+    struct ProgramShape {
+        //! Number of global variable definitions
+        std::size_t globals = 8;
+        //! Number of function definitions (excluding `main`)
+        std::size_t functions = 64;
+        //! Number of parameters of each function
+        std::size_t parameters = 3;
+        //! Number of local variable definitions in each function
+        std::size_t locals = 8;
+        //! Maximum depth of each generated expression
+        std::size_t depth = 4;
+        //! Maximum number of distinct functions each function calls
+        std::size_t fan_out = 4;
+        //! Seed of the pseudo-random generator
+        std::uint32_t seed = 42;
+    };
+
+    /**
+     * \brief Generate source of a valid Basilisk program with the provided shape
+     *
+     * The program only refers to variables in scope and only calls functions defined earlier with matching arity, so it
+     *  survives codegen as well as parsing.
+     * Generation is deterministic for a shape.
+     *
+     * \param shape Shape of the program
+     * \return Program source
+     */
+    std::string generate_program(const ProgramShape &shape);
+
+    /**
+     * \brief Generate source of a valid Basilisk program that is roughly the provided size
+     *
+     * Scales the number of functions in the default shape to reach at least the provided size.
+     *
+     * \param bytes Minimum size of the source in bytes
+     * \return Program source
+     */
+    std::string generate_program_of_size(std::size_t bytes);
+}
+
+#endif //BASILISK_BENCH_PROGRAMGENERATOR_H
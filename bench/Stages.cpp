@@ -0,0 +1,57 @@
+/** \file Stages.cpp
+ * Compilation stages for benchmarks implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <Stages.h>
+
+#include <basilisk/Lexer.h>
+#include <basilisk/Parser.h>
+#include <basilisk/Codegen.h>
+
+#include <llvm/IR/IRBuilder.h>
+
+#include <algorithm>
+
+namespace basilisk::bench {
+    std::vector<tokens::Token> lex(const std::string &source) {
+        return lexer::lex(source);
+    }
+
+    ast::Program parse(std::vector<tokens::Token> tokens) {
+        // Reverse the tokens so that the front of the input is at the back of the buffer
+        std::reverse(tokens.begin(), tokens.end());
+
+        parser::get_f_t get = [&tokens]() {
+            if (tokens.empty()) {
+                return tokens::Token{tokens::tags::error, "No more input tokens."};
+            }
+            auto t = tokens.back();
+            tokens.pop_back();
+            return t;
+        };
+        parser::peek_f_t peek = [&tokens](unsigned offset) -> const tokens::Token & {
+            static const tokens::Token too_far{tokens::tags::error, "No token that far from the front of the input queue."};
+            if (offset >= tokens.size()) {
+                return too_far;
+            }
+            return tokens[tokens.size() - 1 - offset];
+        };
+
+        return parser::ProgramParser(get, peek).program();
+    }
+
+    ast::Program parse_stream(const std::string &source) {
+        return parser::parse(source);
+    }
+
+    std::unique_ptr<llvm::Module> generate(ast::Program &program, llvm::LLVMContext &context) {
+        auto module = std::make_unique<llvm::Module>("bench", context);
+        llvm::IRBuilder<> builder(context);
+        codegen::NamedValuesHash variables;
+        codegen::ProgramCodegen program_cg(context, builder, module.get(), variables);
+        program.accept(program_cg);
+        return module;
+    }
+}
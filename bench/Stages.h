@@ -0,0 +1,54 @@
+/** \file Stages.h
+ * Compilation stages for benchmarks
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_BENCH_STAGES_H
+#define BASILISK_BENCH_STAGES_H
+
+#include <basilisk/Tokens.h>
+#include <basilisk/AST.h>
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace basilisk::bench {
+    /**
+     * \brief Lex a source buffer
+     *
+     * \param source Source buffer, which the tokens refer to
+     * \return Tokens
+     */
+    std::vector<tokens::Token> lex(const std::string &source);
+
+    /**
+     * \brief Parse tokens into a program
+     *
+     * \param tokens Tokens in order, ending with the `END` token
+     * \return Program node
+     */
+    ast::Program parse(std::vector<tokens::Token> tokens);
+
+    /**
+     * \brief Parse a source buffer into a program, lexing it as the parser consumes the tokens
+     *
+     * \param source Source buffer
+     * \return Program node
+     */
+    ast::Program parse_stream(const std::string &source);
+
+    /**
+     * \brief Generate LLVM IR of a program into a new module
+     *
+     * \param program Program node
+     * \param context LLVM context to generate in
+     * \return Module containing the generated IR
+     */
+    std::unique_ptr<llvm::Module> generate(ast::Program &program, llvm::LLVMContext &context);
+}
+
+#endif //BASILISK_BENCH_STAGES_H
@@ -9,6 +9,11 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <new>
+#include <cstddef>
+#include <utility>
+
+#include <basilisk/Symbols.h>
 
 /** \namespace basilisk::ast
  * \brief Abstract Syntax Tree definitions
@@ -19,13 +24,125 @@ namespace basilisk::ast {
     // Forward-define visitor base class
     class Visitor;
 
+    /** \class Arena
+     * \brief Bump allocator for AST nodes
+     *
+     * Hands out memory from large blocks by bumping a pointer, and releases all of it at once when destroyed.
+     * Nodes allocated from an arena are still owned through `std::unique_ptr`, but deleting them only runs their
+     *  destructor, so the arena has to outlive them.
+     */
+    class Arena {
+        private:
+            /** \class Allocated
+             * \brief AST node constructed in an arena
+             *
+             * Deleting the node through a pointer to any of its bases destroys it in place, as the virtual destructor
+             *  picks the deallocation function of this class, which leaves the memory to the arena.
+             *
+             * \tparam T Type of the node
+             */
+            template<typename T>
+            class Allocated : public T {
+                public:
+                    using T::T;
+
+                    //! Release nothing, as the memory is released with the arena
+                    static void operator delete(void *) {}
+            };
+
+
+            //! Blocks of memory owned by this arena
+            std::vector<std::unique_ptr<std::byte[]>> blocks;
+            //! Next free byte in the current block
+            std::byte *position = nullptr;
+            //! One past the last byte of the current block
+            std::byte *end = nullptr;
+            //! Size of newly allocated blocks
+            std::size_t block_size;
+            //! Number of bytes handed out
+            std::size_t used = 0;
+            //! Number of bytes reserved in blocks
+            std::size_t reserved = 0;
+        public:
+            //! Default size of arena blocks
+            static constexpr std::size_t default_block_size = 64 * 1024;
+
+            /**
+             * \brief Construct an empty arena
+             *
+             * \param block_size Size of the blocks to allocate from
+             */
+            explicit Arena(std::size_t block_size = default_block_size) : block_size(block_size) {}
+
+            Arena(const Arena &) = delete;
+            Arena &operator=(const Arena &) = delete;
+
+            /**
+             * \brief Allocate memory from the arena
+             *
+             * Allocations larger than a quarter of the block size get a dedicated block.
+             *
+             * \param size Size of the allocation in bytes
+             * \param alignment Alignment of the allocation, must be a power of two
+             * \return Pointer to the allocated memory
+             */
+            void *allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+            /**
+             * \brief Construct an AST node in the arena
+             *
+             * \tparam T Type of the node
+             * \param args Arguments to the node constructor
+             * \return Pointer to the node, whose deletion only runs the destructor
+             */
+            template<typename T, typename... Args>
+            std::unique_ptr<T> make(Args &&... args) {
+                void *memory = allocate(sizeof(Allocated<T>), alignof(Allocated<T>));
+                return std::unique_ptr<T>(new (memory) Allocated<T>(std::forward<Args>(args)...));
+            }
+
+            /**
+             * \brief Take over the blocks of another arena
+             *
+             * Nodes allocated from the other arena remain valid and are now released with this arena.
+             *
+             * \param other Arena to take the blocks of, left empty
+             */
+            void merge(Arena &other);
+
+            //! Number of bytes handed out by this arena
+            std::size_t size() const { return used; }
+            //! Number of bytes reserved by this arena
+            std::size_t capacity() const { return reserved; }
+    };
+
+    /**
+     * \brief Construct an AST node, in an arena if provided
+     *
+     * \tparam T Type of the node
+     * \param arena Arena to allocate from, or `nullptr` to allocate on the heap
+     * \param args Arguments to the node constructor
+     * \return Pointer to the node
+     */
+    template<typename T, typename... Args>
+    std::unique_ptr<T> make_node(Arena *arena, Args &&... args) {
+        if (arena != nullptr) {
+            return arena->make<T>(std::forward<Args>(args)...);
+        } else {
+            return std::make_unique<T>(std::forward<Args>(args)...);
+        }
+    }
+
     /** \class Node
      * \brief Base class for all AST nodes
+     *
+     * Nodes can be allocated either on the heap or in an \ref Arena, and are deleted the same way in both cases.
      */
     class Node {
         protected:
             Node() = default;
         public:
+
             /**
              * \brief Whether this node is equal to another
              *
@@ -45,8 +162,8 @@ namespace basilisk::ast {
             virtual ~Node() = default;
     };
 
-    //! Identifiers are strings
-    typedef std::string Identifier;
+    //! Identifiers are interned symbols
+    typedef symbols::Symbol Identifier;
 
 
     /** \class Expression
@@ -528,6 +645,9 @@ namespace basilisk::ast {
      */
     class Program : public Node {
         public:
+            //! Arena the nodes of this program are allocated from, or `nullptr` if they are on the heap
+            // Note: declared before the definitions so that it is destroyed after them
+            std::unique_ptr<Arena> arena;
             //! Pointers to definitions in this program in order of definition
             std::vector<std::unique_ptr<Definition>> definitions;
 
@@ -537,9 +657,22 @@ namespace basilisk::ast {
              * Construct a Program node from the definitions comprising the program.
              *
              * \param defs Pointers to definitions comprising the program
+             * \param arena Arena the definitions are allocated from, if any
+             */
+            explicit Program(std::vector<std::unique_ptr<Definition>> defs, std::unique_ptr<Arena> arena = nullptr)
+                : arena(std::move(arena)), definitions(std::move(defs)) {}
+
+            Program(Program &&other) = default;
+            /**
+             * \brief Move a program into this one
+             *
+             * Replaces the definitions before the arena, so that the old definitions are destroyed while their arena is
+             *  still alive.
+             *
+             * \param other Program to move
+             * \return This program
              */
-            explicit Program(std::vector<std::unique_ptr<Definition>> defs)
-                : definitions(std::move(defs)) {}
+            Program &operator=(Program &&other) noexcept;
 
             bool equals(Node *other) override;
             void accept(Visitor &visitor) override;
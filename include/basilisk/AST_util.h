@@ -8,10 +8,16 @@
 
 #include <basilisk/AST.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <string>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <optional>
+#include <functional>
 
 /** \namespace basilisk::ast::util
  * \brief AST utility functions
@@ -105,6 +111,396 @@ namespace basilisk::ast::util {
 
             void visit(Node &) override;
     };
+
+    /** \class CountVisitor
+     * \brief Counts the nodes of the AST
+     *
+     * Counts the nodes in the AST under the visited node, in total and by kind.
+     */
+    class CountVisitor : public Visitor {
+        public:
+            /** \struct Counts
+             * \brief Node counts by kind
+             */
+            struct Counts {
+                //! Number of all nodes
+                std::size_t nodes = 0;
+                //! Number of expression nodes
+                std::size_t expressions = 0;
+                //! Number of statement nodes
+                std::size_t statements = 0;
+                //! Number of function definition nodes
+                std::size_t functions = 0;
+                //! Number of variable definition nodes
+                std::size_t variables = 0;
+            };
+        protected:
+            //! Counts so far
+            Counts counts;
+        public:
+            static Counts count(Node &node);
+
+            /**
+             * \brief Get the counts so far
+             *
+             * \return Node counts
+             */
+            const Counts &get() const { return counts; }
+
+            void visit(expressions::Modulo &) override;
+            void visit(expressions::Summation &) override;
+            void visit(expressions::Subtraction &) override;
+            void visit(expressions::Multiplication &) override;
+            void visit(expressions::Division &) override;
+            void visit(expressions::NumericNegation &) override;
+            void visit(expressions::IdentifierExpression &) override;
+            void visit(expressions::Parenthesised &) override;
+            void visit(expressions::FunctionCall &) override;
+            void visit(expressions::LiteralDouble &) override;
+
+            void visit(statements::Assignment &) override;
+            void visit(statements::Discard &) override;
+            void visit(statements::Return &) override;
+
+            void visit(definitions::Function &) override;
+            void visit(definitions::Variable &) override;
+
+            void visit(Program &) override;
+
+            void visit(Node &) override;
+    };
+
+    /** \class PurityVisitor
+     * \brief Determines which functions of a program are free of side effects
+     *
+     * A function is impure when it assigns a global variable, calls `println`, or calls an impure or unknown function.
+     * The other functions are pure, further split by whether their result depends on global variables.
+     * Identifiers resolve as in code generation: to arguments and locals first, then to the global variables defined
+     *  before the function.
+     */
+    class PurityVisitor : public Visitor {
+        public:
+            /** \enum Purity
+             * \brief Side effects of a function, ordered from none to any
+             */
+            enum class Purity {
+                pure,           //!< No side effects, result depends only on the arguments
+                reads_globals,  //!< No side effects, result depends on the arguments and global variables
+                impure          //!< May have side effects
+            };
+            //! Purity of functions by identifier
+            typedef std::unordered_map<Identifier, Purity> result_t;
+        protected:
+            /** \struct Summary
+             * \brief Direct effects of a function, before accounting for its callees
+             */
+            struct Summary {
+                //! Purity of the function body itself
+                Purity purity = Purity::pure;
+                //! Identifiers of the called user functions
+                std::vector<Identifier> callees;
+            };
+
+            //! Global variables defined so far
+            std::unordered_set<Identifier> globals;
+            //! Arguments and locals of the current function
+            std::unordered_set<Identifier> locals;
+            //! Summary of the current function, or `nullptr` outside of functions
+            Summary *current = nullptr;
+            //! Summaries of the functions visited so far
+            std::unordered_map<Identifier, Summary> summaries;
+        public:
+            static result_t analyze(Program &program);
+
+            /**
+             * \brief Compute the purity of the functions visited so far, accounting for their callees
+             *
+             * \return Purity of the functions
+             */
+            result_t get() const;
+
+            /**
+             * \brief Find the functions visited so far that can call themselves, directly or through other functions
+             *
+             * \return Identifiers of the recursive functions
+             */
+            std::unordered_set<Identifier> recursive() const;
+
+            /**
+             * \brief Find the functions visited so far that call other functions
+             *
+             * \return Identifiers of the functions calling other functions
+             */
+            std::unordered_set<Identifier> calling() const;
+
+            /**
+             * \brief Find the functions visited so far that call any of some functions, directly or through other
+             *  functions
+             *
+             * \param callees Identifiers of the called functions
+             * \return Identifiers of the calling functions, together with the called functions themselves
+             */
+            std::unordered_set<Identifier> callers_of(const std::unordered_set<Identifier> &callees) const;
+
+            /**
+             * \brief Find the functions visited so far that always return
+             *
+             * A function always returns when it is not recursive and only calls functions that always return.
+             *
+             * \return Identifiers of the functions that always return
+             */
+            std::unordered_set<Identifier> returning() const;
+
+            void visit(expressions::Modulo &) override;
+            void visit(expressions::Summation &) override;
+            void visit(expressions::Subtraction &) override;
+            void visit(expressions::Multiplication &) override;
+            void visit(expressions::Division &) override;
+            void visit(expressions::NumericNegation &) override;
+            void visit(expressions::IdentifierExpression &) override;
+            void visit(expressions::Parenthesised &) override;
+            void visit(expressions::FunctionCall &) override;
+            void visit(expressions::LiteralDouble &) override;
+
+            void visit(statements::Assignment &) override;
+            void visit(statements::Discard &) override;
+            void visit(statements::Return &) override;
+
+            void visit(definitions::Function &) override;
+            void visit(definitions::Variable &) override;
+
+            void visit(Program &) override;
+
+            void visit(Node &) override;
+    };
+
+    /** \class ReferenceVisitor
+     * \brief Collects the identifiers a subtree refers to
+     */
+    class ReferenceVisitor : public Visitor {
+        public:
+            //! Identifiers of variables read or assigned
+            std::unordered_set<Identifier> variables;
+            //! Identifiers of called functions
+            std::unordered_set<Identifier> functions;
+
+            void visit(expressions::Modulo &) override;
+            void visit(expressions::Summation &) override;
+            void visit(expressions::Subtraction &) override;
+            void visit(expressions::Multiplication &) override;
+            void visit(expressions::Division &) override;
+            void visit(expressions::NumericNegation &) override;
+            void visit(expressions::IdentifierExpression &) override;
+            void visit(expressions::Parenthesised &) override;
+            void visit(expressions::FunctionCall &) override;
+            void visit(expressions::LiteralDouble &) override;
+
+            void visit(statements::Assignment &) override;
+            void visit(statements::Discard &) override;
+            void visit(statements::Return &) override;
+
+            void visit(definitions::Function &) override;
+            void visit(definitions::Variable &) override;
+
+            void visit(Program &) override;
+
+            void visit(Node &) override;
+    };
+
+    /** \class SelfCallVisitor
+     * \brief Counts the calls functions make to themselves, split by whether they are in tail position
+     *
+     * A call is in tail position when it is the whole expression of a return statement, up to parentheses, so that its
+     *  result is returned directly and the call can replace the frame of the caller.
+     * Only functions calling themselves are counted, functions recursive through other functions are not.
+     */
+    class SelfCallVisitor : public Visitor {
+        public:
+            /** \struct Calls
+             * \brief Calls of a function to itself
+             */
+            struct Calls {
+                //! Number of calls in tail position
+                std::size_t tail = 0;
+                //! Number of calls elsewhere
+                std::size_t other = 0;
+            };
+            //! Calls to themselves of functions by identifier
+            typedef std::unordered_map<Identifier, Calls> result_t;
+        protected:
+            //! Identifier of the current function, or `nullptr` outside of functions
+            const Identifier *current = nullptr;
+            //! Call in tail position of the current return statement, or `nullptr` if none
+            const expressions::FunctionCall *tail_call = nullptr;
+            //! Calls of the functions visited so far
+            result_t result;
+        public:
+            /**
+             * \brief Count the calls of the functions of a program to themselves using this visitor
+             *
+             * \param program Program to analyze
+             * \return Calls of the functions calling themselves
+             */
+            static result_t analyze(Program &program);
+
+            //! Calls of the functions visited so far that call themselves
+            const result_t &get() const { return result; }
+
+            void visit(expressions::Modulo &) override;
+            void visit(expressions::Summation &) override;
+            void visit(expressions::Subtraction &) override;
+            void visit(expressions::Multiplication &) override;
+            void visit(expressions::Division &) override;
+            void visit(expressions::NumericNegation &) override;
+            void visit(expressions::IdentifierExpression &) override;
+            void visit(expressions::Parenthesised &) override;
+            void visit(expressions::FunctionCall &) override;
+            void visit(expressions::LiteralDouble &) override;
+
+            void visit(statements::Assignment &) override;
+            void visit(statements::Discard &) override;
+            void visit(statements::Return &) override;
+
+            void visit(definitions::Function &) override;
+            void visit(definitions::Variable &) override;
+
+            void visit(Program &) override;
+
+            void visit(Node &) override;
+    };
+
+    /** \class FoldVisitor
+     * \brief Folds constant expressions and strips redundant nodes before code generation
+     *
+     * Expressions over literals are replaced by literals of their value, computed as in generated code.
+     * Parentheses are stripped when the inner expression can take the place of the parenthesised one, and exact
+     *  identities are simplified (`x * 1.0`, `1.0 * x`, `x / 1.0`, `x - 0.0`, `x + -0.0`, `-0.0 + x` and `- - x`).
+     * Identities that do not hold for all doubles, such as `x * 0.0` or `x + 0.0`, are kept.
+     */
+    class FoldVisitor : public Visitor {
+        private:
+            //! Arena to allocate new nodes from, or `nullptr` to allocate them on the heap
+            Arena *arena;
+            //! Number of nodes replaced so far
+            std::size_t replaced = 0;
+            //! Value of the last visited expression if it is constant
+            std::optional<double> value;
+            //! Subexpression that can replace the last visited expression, or `nullptr` if none
+            Expression *forward = nullptr;
+            //! Release the subexpression that can replace the last visited expression from its parent
+            std::function<std::unique_ptr<Expression>()> release;
+
+            /**
+             * \brief Fold the expression in a slot, replacing it if possible
+             *
+             * \tparam T Type of expressions the slot holds
+             * \param slot Slot holding the expression
+             */
+            template<typename T>
+            void fold(std::unique_ptr<T> &slot);
+
+            /**
+             * \brief Mark a subexpression of the visited expression as its replacement
+             *
+             * \tparam T Type of expressions the subexpression slot holds
+             * \param slot Slot holding the subexpression
+             */
+            template<typename T>
+            void forward_to(std::unique_ptr<T> &slot);
+        public:
+            /**
+             * \brief Construct a folding visitor
+             *
+             * \param arena Arena to allocate new nodes from, or `nullptr` to allocate them on the heap
+             */
+            explicit FoldVisitor(Arena *arena = nullptr) : arena(arena) {}
+
+            /**
+             * \brief Fold the expressions of a program, allocating new nodes from its arena
+             *
+             * \param program Program to fold
+             * \return Number of nodes replaced
+             */
+            static std::size_t fold(Program &program);
+
+            //! Number of nodes replaced so far
+            std::size_t count() const { return replaced; }
+
+            void visit(expressions::Modulo &) override;
+            void visit(expressions::Summation &) override;
+            void visit(expressions::Subtraction &) override;
+            void visit(expressions::Multiplication &) override;
+            void visit(expressions::Division &) override;
+            void visit(expressions::NumericNegation &) override;
+            void visit(expressions::IdentifierExpression &) override;
+            void visit(expressions::Parenthesised &) override;
+            void visit(expressions::FunctionCall &) override;
+            void visit(expressions::LiteralDouble &) override;
+
+            void visit(statements::Assignment &) override;
+            void visit(statements::Discard &) override;
+            void visit(statements::Return &) override;
+
+            void visit(definitions::Function &) override;
+            void visit(definitions::Variable &) override;
+
+            void visit(Program &) override;
+
+            void visit(Node &) override;
+    };
+
+    /** \class HashVisitor
+     * \brief Computes a structural hash of the AST
+     *
+     * Hashes the kind of each node in the AST under the visited node, along with its identifiers and values, so that
+     *  structurally equal subtrees hash the same across runs.
+     * Parentheses are hashed as the expression they contain, as they don't change the generated code.
+     */
+    class HashVisitor : public Visitor {
+        private:
+            //! 64-bit FNV-1a state
+            std::uint64_t state = 14695981039346656037ull;
+
+            //! Mix bytes into the hash
+            void mix(const void *data, std::size_t size);
+            //! Mix an integer into the hash
+            void mix(std::uint64_t value) { mix(&value, sizeof(value)); }
+            //! Mix an identifier into the hash, prefixed by its length
+            void mix(const Identifier &identifier);
+        public:
+            /**
+             * \brief Hash the AST under a node
+             *
+             * \param node Node to hash from
+             * \return Structural hash
+             */
+            static std::uint64_t hash(Node &node);
+
+            //! Hash of the nodes visited so far
+            std::uint64_t get() const { return state; }
+
+            void visit(expressions::Modulo &) override;
+            void visit(expressions::Summation &) override;
+            void visit(expressions::Subtraction &) override;
+            void visit(expressions::Multiplication &) override;
+            void visit(expressions::Division &) override;
+            void visit(expressions::NumericNegation &) override;
+            void visit(expressions::IdentifierExpression &) override;
+            void visit(expressions::Parenthesised &) override;
+            void visit(expressions::FunctionCall &) override;
+            void visit(expressions::LiteralDouble &) override;
+
+            void visit(statements::Assignment &) override;
+            void visit(statements::Discard &) override;
+            void visit(statements::Return &) override;
+
+            void visit(definitions::Function &) override;
+            void visit(definitions::Variable &) override;
+
+            void visit(Program &) override;
+
+            void visit(Node &) override;
+    };
 }
 
 #endif //BASILISK_AST_UTIL_H
@@ -0,0 +1,98 @@
+/** \file Cache.h
+ * On-disk compilation cache
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_CACHE_H
+#define BASILISK_CACHE_H
+
+#include <basilisk/Optimization.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/** \namespace basilisk::cache
+ * \brief On-disk compilation cache
+ *
+ * Cache of compiled code keyed by everything the code depends on, so that compiling the same source again can skip
+ *  the whole pipeline.
+ */
+namespace basilisk::cache {
+    /** \class ObjectCache
+     * \brief Directory of compiled code entries, one file per key
+     *
+     * Entries are written into a temporary file that is then renamed, so concurrent compilers sharing the directory
+     *  never read a partial entry.
+     * Failures to read or write entries are treated as misses, so the cache never fails a compilation.
+     */
+    class ObjectCache {
+        private:
+            //! Directory holding the entries
+            std::string directory;
+            //! Number of lookups that found an entry
+            std::uint64_t hit_count = 0;
+            //! Number of lookups that found no entry
+            std::uint64_t miss_count = 0;
+
+            //! Path of the entry with the provided key
+            std::string path(const std::string &key) const;
+        public:
+            /**
+             * \brief Construct a cache in a directory, creating it if necessary
+             *
+             * \param directory Directory to hold the entries
+             */
+            explicit ObjectCache(std::string directory);
+
+            /**
+             * \brief Compute the key of compiled code
+             *
+             * The key is a SHA-1 digest of the source and the configuration, together with the compiler version.
+             *
+             * \param source Source bytes
+             * \param triple Target triple
+             * \param cpu Target CPU
+             * \param features Target features
+             * \param level Optimization level
+             * \param kind Kind of the entry, distinguishing different outputs of the same source
+             * \return Key as a hexadecimal string
+             */
+            static std::string key(std::string_view source, std::string_view triple, std::string_view cpu,
+                    std::string_view features, optimization::Level level, std::string_view kind);
+
+            /**
+             * \brief Compute the key of an entry that only depends on the compiler and the provided data
+             *
+             * \param data Description of everything the entry depends on
+             * \param kind Kind of the entry, distinguishing different outputs of the same data
+             * \return Key as a hexadecimal string
+             */
+            static std::string key(std::string_view data, std::string_view kind);
+
+            /**
+             * \brief Look up an entry
+             *
+             * \param key Key of the entry
+             * \return Contents of the entry, or none on a miss
+             */
+            std::optional<std::string> get(const std::string &key);
+
+            /**
+             * \brief Store an entry, replacing any previous one with the same key
+             *
+             * \param key Key of the entry
+             * \param data Contents of the entry
+             * \return `true` if the entry was stored, `false` otherwise
+             */
+            bool put(const std::string &key, std::string_view data);
+
+            //! Number of lookups that found an entry
+            std::uint64_t hits() const { return hit_count; }
+            //! Number of lookups that found no entry
+            std::uint64_t misses() const { return miss_count; }
+    };
+}
+
+#endif //BASILISK_CACHE_H
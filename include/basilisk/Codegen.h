@@ -7,6 +7,8 @@
 #define BASILISK_CODEGEN_H
 
 #include <basilisk/AST.h>
+#include <basilisk/AST_util.h>
+#include <basilisk/Flat.h>
 
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/IRBuilder.h>
@@ -14,6 +16,9 @@
 
 #include <memory>
 #include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 /** \namespace basilisk::codegen
@@ -100,65 +105,80 @@ namespace basilisk::codegen {
             void pop() override;
     };
 
-    /** \class ExpressionCodegen
-     * \brief Expression-specific code generation AST visitor
+    /** \class NamedValuesHash
+     * \brief Named values data structure backed by a hash map of binding stacks
      *
-     * AST visitor that generates LLVM IR Value from expression nodes.
+     * Named values data structure backed by a hash map from identifier to the stack of its bindings in the active scopes,
+     *  and an undo log of the identifiers bound in each scope.
+     * Lookup and binding take constant time, and popping a scope takes time linear in the number of its bindings.
      */
-    class ExpressionCodegen : public ast::Visitor {
+     // Note: the top binding of each identifier is from the top-most scope where it is present, which implements shadowing
+    class NamedValuesHash : public NamedValues {
         private:
-            //! LLVM context
-            llvm::LLVMContext &context;
-            //! LLVM instruction generation helper
-            llvm::IRBuilder<> &builder;
-            //! LLVM module
-            llvm::Module *module;
-            //! Pointers to variables
-            NamedValues &variables;
-
-            //! Pointer to the last value built
-            llvm::Value *value = nullptr;
+            //! Type of a binding: depth of the scope it belongs to and the value
+            typedef std::pair<std::size_t, llvm::Value *> binding_t;
+            //! Stacks of bindings of each identifier
+            std::unordered_map<ast::Identifier, std::vector<binding_t>> bindings;
+            //! Undo log of identifiers in order of binding
+            std::vector<ast::Identifier> log;
+            //! Log sizes at the start of each active scope
+            std::vector<std::size_t> marks{0};
         public:
-            /**
-             * \brief Construct an AST visitor to generate LLVM IR from expression nodes into the provided module
-             *
-             * \param context LLVM context
-             * \param builder LLVM IR builder
-             * \param module LLVM module
-             * \param variables Variable scope
-             */
-            ExpressionCodegen(llvm::LLVMContext &context, llvm::IRBuilder<> &builder,
-                    llvm::Module *module, NamedValues &variables)
-                : context(context), builder(builder), module(module), variables(variables) {}
-
-            void visit(ast::Expression &node) override;
-            void visit(ast::expressions::Modulo &node) override;
-
-            void visit(ast::expressions::Expression1 &node) override;
-            void visit(ast::expressions::Summation &node) override;
-            void visit(ast::expressions::Subtraction &node) override;
-
-            void visit(ast::expressions::Expression2 &node) override;
-            void visit(ast::expressions::Multiplication &node) override;
-            void visit(ast::expressions::Division &node) override;
-
-            void visit(ast::expressions::Expression3 &node) override;
-            void visit(ast::expressions::NumericNegation &node) override;
-
-            void visit(ast::expressions::Expression4 &node) override;
-            void visit(ast::expressions::IdentifierExpression &node) override;
-            void visit(ast::expressions::Parenthesised &node) override;
-            void visit(ast::expressions::FunctionCall &node) override;
-            void visit(ast::expressions::LiteralDouble &node) override;
+            void put(ast::Identifier identifier, llvm::Value *value) override;
+            llvm::Value *get(ast::Identifier identifier) override;
+            void push() override;
+            void pop() override;
+    };
 
-            void visit(ast::Node &node) override;
+    /**
+     * \brief Generate LLVM IR value of an expression lowered into a buffer
+     *
+     * The nodes of the expression are generated in order, so each operation only looks up the values of its operands.
+     * Arithmetic instructions are created with the fast-math flags of the builder.
+     *
+     * When contracting, a product used by a sum or difference is fused into it with `llvm.fmuladd`, which the target
+     *  may compute with a single rounding.
+     *
+     * \param buffer Buffer holding the expression
+     * \param expression Index of the expression in the roots of the buffer
+     * \param context LLVM context
+     * \param builder LLVM IR builder
+     * \param module LLVM module
+     * \param variables Variable scope
+     * \param contract Whether to fuse products into the sums and differences using them
+     * \return Pointer to the value of the expression
+     */
+    llvm::Value *generate_expression(const flat::Buffer &buffer, std::size_t expression, llvm::LLVMContext &context,
+            llvm::IRBuilder<> &builder, llvm::Module *module, NamedValues &variables, bool contract = false);
 
-            /**
-             * \brief Get pointer to the last value built
-             *
-             * \return Pointer to the last value built
-             */
-            llvm::Value* get() { return value; }
+    /** \struct Effects
+     * \brief Effects of the functions of a program, that code generation annotates them with
+     */
+    struct Effects {
+        //! Purity of the functions
+        ast::util::PurityVisitor::result_t purity;
+        //! Functions that can call themselves, directly or through other functions
+        std::unordered_set<ast::Identifier> recursive;
+        //! Functions that call other functions
+        std::unordered_set<ast::Identifier> calling;
+        //! Functions that always return
+        std::unordered_set<ast::Identifier> returning;
+        //! Functions that are memoized (see \ref generate_memo)
+        std::unordered_set<ast::Identifier> memoized;
+        //! Functions that write the caches of memoized functions, directly or through the functions they call, so they
+        //!  neither only read memory nor access none although they are pure
+        std::unordered_set<ast::Identifier> writing;
+
+        /**
+         * \brief Analyze the functions of a program
+         *
+         * Pure functions that call other functions and have arguments are memoized when memoizing.
+         *
+         * \param program Program to analyze
+         * \param memoize Whether to memoize functions (see \ref Settings::memoize)
+         * \return Effects of the functions of the program
+         */
+        static Effects analyze(ast::Program &program, bool memoize = false);
     };
 
     /** \class FunctionCodegen
@@ -182,19 +202,52 @@ namespace basilisk::codegen {
 
             //! Pointer to the last function built
             llvm::Function *function = nullptr;
+
+            //! Effects of the functions to annotate them with, or `nullptr` if not known
+            const Effects *effects;
+            //! Whether to fold the lowered expressions before generating them
+            bool fold;
+            //! Whether to fuse products into the sums and differences of the same expression
+            bool contract;
+
+            //! Expressions of the function being built, or of the last statement outside of a function
+            flat::Buffer expressions;
+            //! Index of the next expression to generate
+            std::size_t next = 0;
+
+            /**
+             * \brief Generate the value of the next expression
+             *
+             * Expressions outside of a function (initializers of global variables) are lowered on their own first.
+             *
+             * \param node Expression node
+             * \return Pointer to the value of the expression
+             */
+            llvm::Value *generate(ast::Expression &node);
         public:
             /**
              * \brief Construct an AST visitor to generate LLVM IR from function definition and statement nodes into the
              *  provided module
              *
+             * When the effects are provided, functions are annotated with the attributes they imply (`readnone` for
+             *  pure functions, `readonly` for functions that only read globals, and `willreturn` for functions that
+             *  always return).
+             * All functions are `nounwind`.
+             *
              * \param context LLVM context
              * \param builder LLVM IR builder
              * \param module LLVM module
              * \param variables Variable scope
+             * \param effects Effects of the functions, or `nullptr` if not known
+             * \param fold Whether to fold constant expressions (see \ref flat::Buffer::fold)
+             * \param contract Whether to fuse products into the sums and differences using them (see
+             *  \ref generate_expression)
              */
             FunctionCodegen(llvm::LLVMContext &context, llvm::IRBuilder<> &builder,
-                    llvm::Module *module, NamedValues &variables)
-            : context(context), builder(builder), module(module), variables(variables) {}
+                    llvm::Module *module, NamedValues &variables, const Effects *effects = nullptr, bool fold = false,
+                    bool contract = false)
+            : context(context), builder(builder), module(module), variables(variables), effects(effects), fold(fold),
+              contract(contract) {}
 
             void visit(ast::Statement &node) override;
             void visit(ast::statements::Assignment &node) override;
@@ -213,10 +266,57 @@ namespace basilisk::codegen {
             llvm::Function* get() { return function; }
     };
 
+    /** \struct Settings
+     * \brief Optional code generation features
+     */
+    struct Settings {
+        //! Whether to fold constant expressions while generating code (see \ref flat::Buffer::fold)
+        bool fold = true;
+        //! Whether to initialize global variables of values known at compile time in their definitions, instead of in
+        //!  the global variable initializer
+        bool constant_globals = true;
+        //! Whether to generate a `<name>_map` companion of each pure function (see \ref generate_map)
+        bool map_companions = false;
+        //! Whether to memoize pure functions that call other functions (see \ref generate_memo)
+        bool memoize = false;
+        //! Base-2 logarithm of the number of entries of each memoization cache
+        unsigned memo_bits = 10;
+        //! Whether `println` writes into the per-thread output buffers of \ref runtime instead of calling `printf`,
+        //!  flushed by a global destructor
+        bool buffered_output = false;
+        //! Fast-math flags of the generated arithmetic, none for strict IEEE 754 semantics
+        llvm::FastMathFlags fast_math;
+        //! Whether to fuse products into the sums and differences of the same expression (see \ref generate_expression)
+        bool contract = false;
+
+        /**
+         * \brief Describe the settings, for keys of generated code
+         *
+         * Every setting is included, so that code generated with different settings never shares a key.
+         *
+         * \return Description of the settings
+         */
+        std::string describe() const;
+
+        /**
+         * \brief Whether the fast-math flags allow unsafe floating-point math in code generation for the target
+         *
+         * As with `-funsafe-math-optimizations`, this needs reassociation, reciprocals, approximate functions and
+         *  ignoring the sign of zeros, but not contraction, which the target is told about on its own.
+         *
+         * \return Whether to set `UnsafeFPMath` and the `unsafe-fp-math` function attribute
+         */
+        bool unsafe_fp_math() const;
+    };
+
     /** \class ProgramCodegen
      * \brief Program-specific code generation AST visitor
      *
      * AST visitor that generates LLVM IR from program nodes.
+     *
+     * Global variables are initialized at compile time where possible, falling back to the global variable initializer
+     *  that is run as a global constructor (see \ref Settings::constant_globals).
+     * Those never assigned again are then constant, so their values can be propagated into functions.
      */
     class ProgramCodegen : public ast::Visitor {
         private:
@@ -228,6 +328,32 @@ namespace basilisk::codegen {
             llvm::Module *module;
             //! Pointers to variables
             NamedValues &variables;
+            //! Optional features
+            Settings settings;
+            //! Effects of the functions of the program
+            Effects effects;
+            //! Whether to generate function bodies, or only their prototypes
+            bool bodies = true;
+            //! Values of the global variables known at compile time at the current point of initialization
+            std::unordered_map<ast::Identifier, double> constants;
+            //! Global variables initialized at compile time
+            std::vector<llvm::GlobalVariable *> initialized;
+
+            //! Generate the program, with function bodies if \ref bodies is set
+            void generate(ast::Program &node);
+
+            /**
+             * \brief Try to initialize a global variable at compile time
+             *
+             * The value is known when the expression only refers to literals and to global variables of known values,
+             *  and it is then folded (see \ref flat::Buffer::fold).
+             * A new global variable is defined with the value as its initializer, as is a redefined one while the
+             *  global variable initializer is still empty, and otherwise the value is stored in the initializer.
+             *
+             * \param node Assignment of the global variable
+             * \return `true` if the value was known, `false` if the assignment is left to the initializer
+             */
+            bool initialize_constant(ast::statements::Assignment &node);
         public:
             /**
              * \brief Construct an AST visitor to generate LLVM IR from the program node into the provided module
@@ -236,10 +362,11 @@ namespace basilisk::codegen {
              * \param builder LLVM IR builder
              * \param module LLVM module
              * \param variables Variable scope
+             * \param settings Optional features
              */
             ProgramCodegen(llvm::LLVMContext &context, llvm::IRBuilder<> &builder,
-                    llvm::Module *module, NamedValues &variables)
-            : context(context), builder(builder), module(module), variables(variables) {}
+                    llvm::Module *module, NamedValues &variables, Settings settings = {})
+            : context(context), builder(builder), module(module), variables(variables), settings(settings) {}
 
             void visit(ast::Definition &node) override;
             void visit(ast::definitions::Function &node) override;
@@ -248,8 +375,129 @@ namespace basilisk::codegen {
             void visit(ast::Program &node) override;
 
             void visit(ast::Node &node) override;
+
+            /**
+             * \brief Generate a program with only prototypes of its functions
+             *
+             * Everything else is generated as when visiting the program: the standard library, the global variables
+             *  and their initializer, and the `main` wrapper.
+             * The function definitions can then be generated elsewhere and linked in.
+             *
+             * \param node Program node
+             */
+            void declare(ast::Program &node);
+
+            /**
+             * \brief Get the effects of the functions of the last program generated
+             *
+             * \return Effects of the functions
+             */
+            const Effects &get_effects() const { return effects; }
     };
 
+    /**
+     * \brief Get the name of the LLVM function generated from a function definition
+     *
+     * `main` without arguments is renamed to `main_`, so that a wrapper returning `i32` can take its place.
+     *
+     * \param node Function definition node
+     * \return Name of the LLVM function
+     */
+    std::string function_name(const ast::definitions::Function &node);
+
+    /** \struct Prototype
+     * \brief Signature of a function defined by another program, which a program can call
+     */
+    struct Prototype {
+        //! Name of the LLVM function
+        std::string name;
+        //! Number of arguments
+        std::size_t arity;
+    };
+
+    /**
+     * \brief Get the prototypes of the functions of a program that other programs can call
+     *
+     * `main` without arguments is renamed (see \ref function_name), so other programs can't call it.
+     *
+     * \param program Program node
+     * \return Prototypes of the functions, in order of definition
+     */
+    std::vector<Prototype> prototypes(const ast::Program &program);
+
+    /**
+     * \brief Declare the functions of other programs that a program calls, so that the calls resolve as if the programs
+     *  were one
+     *
+     * Functions the program defines itself are never declared, so its own definitions take precedence.
+     *
+     * \param program Program node
+     * \param module Module to declare the functions in
+     * \param prototypes Functions of the other programs
+     */
+    void declare_prototypes(ast::Program &program, llvm::Module &module, const std::vector<Prototype> &prototypes);
+
+    /**
+     * \brief Generate a function definition together with its optional features
+     *
+     * \param node Function definition node
+     * \param context LLVM context
+     * \param builder LLVM IR builder
+     * \param module LLVM module
+     * \param variables Variable scope
+     * \param effects Effects of the functions of the program
+     * \param settings Optional features
+     * \param reserved Names of functions defined outside the module, which companions must not take, or `nullptr`
+     * \return The generated function
+     */
+    llvm::Function *generate_function(ast::definitions::Function &node, llvm::LLVMContext &context,
+            llvm::IRBuilder<> &builder, llvm::Module *module, NamedValues &variables, const Effects &effects,
+            const Settings &settings, const std::unordered_set<std::string> *reserved = nullptr);
+
+    /**
+     * \brief Generate LLVM IR definitions for the STL function `println` and the supporting external function `printf`
+     *
+     * `println` is private, so every module calling it needs its own definition.
+     * With buffered output, it calls \ref runtime::basilisk_println instead.
+     *
+     * \param context LLVM context
+     * \param module LLVM module
+     * \param builder IR builder
+     * \param settings Optional features, of which buffered output is used
+     */
+    void generate_stl(llvm::LLVMContext &context, llvm::Module *module, llvm::IRBuilder<> &builder,
+            const Settings &settings = {});
+
+    /**
+     * \brief Generate a function applying a function elementwise over arrays
+     *
+     * The generated `void name(const double *x_1, ..., const double *x_k, double *out, i64 n)` evaluates
+     *  `out[i] = function(x_1[i], ..., x_k[i])` for each `i` below `n`.
+     * All the pointers are `noalias`, so the output must not overlap the inputs.
+     * The call is always inlined, so that the loop can be vectorized.
+     *
+     * \param function Function over doubles to apply
+     * \param name Name of the generated function
+     * \return The generated function
+     */
+    llvm::Function *generate_map(llvm::Function &function, const std::string &name);
+
+    /**
+     * \brief Memoize a function in a direct-mapped cache of its results
+     *
+     * The body of the function is moved into an internal `<name>.compute`, and the function is replaced by a lookup
+     *  of its arguments in the cache, falling back to computing and storing the result.
+     * Recursive calls go through the cache as well.
+     * Arguments are compared bitwise, so that `-0.0` and `0.0` are distinct and NaN arguments can be cached.
+     * The memory attributes of the function are dropped, as it now accesses the cache.
+     * The cache is not thread-safe.
+     *
+     * \param function Pure function over doubles with at least one argument
+     * \param bits Base-2 logarithm of the number of cache entries, between 1 and 32
+     * \return The function computing uncached results
+     */
+    llvm::Function *generate_memo(llvm::Function &function, unsigned bits);
+
     /** \class CodegenException
      * \brief Exception during code generation
      */
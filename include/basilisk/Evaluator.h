@@ -0,0 +1,127 @@
+/** \file Evaluator.h
+ * Embeddable evaluation of Basilisk functions
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_EVALUATOR_H
+#define BASILISK_EVALUATOR_H
+
+#include <basilisk/JIT.h>
+#include <basilisk/Optimization.h>
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+/** \namespace basilisk::evaluator
+ * \brief Embeddable evaluation of Basilisk functions
+ *
+ * Compilation of a program once into the memory of the current process, and evaluation of its functions from C++,
+ *  either one call at a time or over columns of inputs.
+ */
+namespace basilisk::evaluator {
+    /**
+     * \brief Batch form of a function, evaluating it over columns of inputs
+     *
+     * Evaluates `out[i] = f(args[0][i], ..., args[k - 1][i])` for each `i` below `n`.
+     * The output must not overlap any of the inputs.
+     */
+    typedef void (*batch_t)(const double *const *args, double *out, std::size_t n);
+
+    /** \class EvaluatorException
+     * \brief Exception on use of a function the program doesn't define as requested
+     */
+    class EvaluatorException : public std::runtime_error {
+        public:
+            //! Construct an evaluator exception from its message
+            explicit EvaluatorException(const std::string &message) : std::runtime_error(message) {}
+    };
+
+    /** \class Evaluator
+     * \brief Program compiled for evaluation of its functions
+     *
+     * Every function of the program gets a batch form (\ref batch_t), generated as a loop in IR over the inlined
+     *  function so that LLVM can vectorize it.
+     * Global variables are initialized on construction, and `main` is not run.
+     */
+    class Evaluator {
+        private:
+            //! Engine holding the compiled program
+            jit::Engine engine;
+            //! Numbers of arguments of the functions by name
+            std::unordered_map<std::string, std::size_t> arities;
+        public:
+            //! Suffix of the names of the batch forms
+            static constexpr const char *batch_suffix = ".batch";
+
+            /**
+             * \brief Compile a program
+             *
+             * Lexer, parser and codegen exceptions of invalid programs are propagated.
+             *
+             * \param source Source of the program
+             * \param level Optimization level
+             */
+            explicit Evaluator(std::string_view source, optimization::Level level = optimization::Level::O2);
+
+            /**
+             * \brief Check whether the program defines a function
+             *
+             * \param name Name of the function
+             * \return `true` if the function is defined, `false` otherwise
+             */
+            bool has(const std::string &name) const { return arities.count(name) > 0; }
+
+            /**
+             * \brief Get the number of arguments of a function
+             *
+             * \param name Name of the function
+             * \return Number of arguments
+             */
+            std::size_t arity(const std::string &name) const;
+
+            /**
+             * \brief Get a function
+             *
+             * The number of template arguments must match the number of arguments of the function.
+             *
+             * \tparam Args Argument types, all `double`
+             * \param name Name of the function
+             * \return Pointer to the function
+             */
+            template<typename... Args>
+            double (*function(const std::string &name))(Args...) {
+                static_assert((std::is_same_v<Args, double> && ...), "Basilisk functions only take doubles.");
+                if (arity(name) != sizeof...(Args)) {
+                    throw EvaluatorException("Function " + name + " takes " + std::to_string(arity(name))
+                                             + " arguments.");
+                }
+                return reinterpret_cast<double (*)(Args...)>(engine.lookup(name));
+            }
+
+            /**
+             * \brief Get the batch form of a function
+             *
+             * \param name Name of the function
+             * \return Pointer to the batch form
+             */
+            batch_t batch(const std::string &name);
+
+            /**
+             * \brief Evaluate a function over columns of inputs
+             *
+             * \param name Name of the function
+             * \param args Input columns, one per argument of the function, each of `n` values
+             * \param out Output column of `n` values
+             * \param n Number of rows
+             */
+            void evaluate(const std::string &name, const double *const *args, double *out, std::size_t n) {
+                batch(name)(args, out, n);
+            }
+    };
+}
+
+#endif //BASILISK_EVALUATOR_H
@@ -0,0 +1,125 @@
+/** \file Flat.h
+ * Flat expression representation
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_FLAT_H
+#define BASILISK_FLAT_H
+
+#include <basilisk/AST.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** \namespace basilisk::flat
+ * \brief Flat expression representation
+ *
+ * Lowering of the expressions of a definition into one contiguous buffer, which passes walk in a single loop with a
+ *  switch over the operations instead of visiting a tree of nodes.
+ * Precedence is explicit in the order of the nodes, so parentheses are dropped.
+ */
+namespace basilisk::flat {
+    //! Index of a node in a buffer
+    typedef std::uint32_t index_t;
+
+    /** \enum Op
+     * \brief Operation of a node
+     */
+    enum class Op : std::uint8_t {
+        literal,        //!< Constant at the index of the first operand
+        identifier,     //!< Variable named by the identifier at the index of the first operand
+        call,           //!< Call described by the call at the index of the first operand
+        negate,         //!< Negation of the first operand
+        add,            //!< Sum of the operands
+        subtract,       //!< Difference of the operands
+        multiply,       //!< Product of the operands
+        divide,         //!< Quotient of the operands
+        modulo          //!< Remainder of the division of the operands (as `fmod`)
+    };
+
+    /** \struct Call
+     * \brief Function call of a call node
+     */
+    struct Call {
+        //! Function identifier
+        ast::Identifier identifier;
+        //! Position of the first argument in \ref Buffer::arguments
+        index_t first;
+        //! Number of arguments
+        index_t count;
+    };
+
+    /** \class Buffer
+     * \brief Expressions of a definition as a struct of arrays of nodes
+     *
+     * Nodes are in post-order, so the operands of a node always precede it and every expression occupies the range of
+     *  nodes after the previous root up to and including its own root.
+     * Operands of operations are indices of nodes, and operands of the other nodes are indices into the side tables.
+     */
+    class Buffer {
+        public:
+            //! Operations of the nodes
+            std::vector<Op> ops;
+            //! First operands of the nodes
+            std::vector<index_t> lhs;
+            //! Second operands of the nodes, if any
+            std::vector<index_t> rhs;
+
+            //! Constants of the literal nodes
+            std::vector<double> constants;
+            //! Identifiers of the identifier nodes
+            std::vector<ast::Identifier> identifiers;
+            //! Calls of the call nodes
+            std::vector<Call> calls;
+            //! Indices of the argument nodes of the calls
+            std::vector<index_t> arguments;
+
+            //! Root nodes of the expressions in order of lowering
+            std::vector<index_t> roots;
+
+            /**
+             * \brief Lower the expressions of a function definition, one for each statement in order
+             *
+             * \param node Function definition node
+             * \return Buffer of the expressions
+             */
+            static Buffer lower(ast::definitions::Function &node);
+
+            /**
+             * \brief Lower an expression onto the end of the buffer
+             *
+             * \param node Expression node
+             * \return Index of the expression in \ref roots
+             */
+            std::size_t add(ast::Expression &node);
+
+            /**
+             * \brief Fold constant expressions and exact identities, and compact the remaining nodes
+             *
+             * Folds the same as \ref ast::util::FoldVisitor.
+             *
+             * \return Number of nodes replaced
+             */
+            std::size_t fold();
+
+            //! Index of the first node of an expression
+            index_t begin(std::size_t expression) const { return expression == 0 ? 0 : roots[expression - 1] + 1; }
+
+            //! Number of nodes
+            std::size_t size() const { return ops.size(); }
+    };
+
+    /** \class FlatException
+     * \brief Exception during lowering into a buffer
+     */
+    class FlatException : public std::runtime_error {
+        public:
+            //! Construct a flat exception from its message
+            explicit FlatException(const std::string &message) : std::runtime_error(message) {}
+    };
+}
+
+#endif //BASILISK_FLAT_H
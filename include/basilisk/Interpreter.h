@@ -0,0 +1,208 @@
+/** \file Interpreter.h
+ * Bytecode interpreter
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_INTERPRETER_H
+#define BASILISK_INTERPRETER_H
+
+#include <basilisk/AST.h>
+#include <basilisk/Optimization.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Forward declarations
+///\cond
+namespace basilisk::jit {
+    class Engine;
+}
+///\endcond
+
+/** \namespace basilisk::interpreter
+ * \brief Bytecode interpreter
+ *
+ * Compilation of a program into a compact stack bytecode and its interpretation, which starts much faster than LLVM.
+ * Hot pure functions are compiled with LLVM into the JIT once they have been called often enough, and called natively
+ *  from then on.
+ * The results are the same as those of the compiled program, as all operations are the same IEEE 754 double operations.
+ */
+namespace basilisk::interpreter {
+    /** \enum Op
+     * \brief Bytecode operation
+     *
+     * Operations take their operands from the top of the value stack and push their result onto it.
+     */
+    enum class Op : std::uint8_t {
+        constant,       //!< Push the constant at the index of the operand
+        load_local,     //!< Push the local variable in the slot of the operand
+        store_local,    //!< Pop into the local variable in the slot of the operand
+        load_global,    //!< Push the global variable at the index of the operand
+        store_global,   //!< Pop into the global variable at the index of the operand
+        add,            //!< Pop two values and push their sum
+        subtract,       //!< Pop two values and push their difference
+        multiply,       //!< Pop two values and push their product
+        divide,         //!< Pop two values and push their quotient
+        modulo,         //!< Pop two values and push the remainder of their division (as `fmod`)
+        negate,         //!< Pop a value and push its negation
+        call,           //!< Pop the arguments of the function at the index of the operand, call it and push its result
+        println,        //!< Pop a value, print it on its own line and push `0`
+        discard,        //!< Pop a value
+        ret             //!< Pop a value and return it from the current function
+    };
+
+    /** \struct Instruction
+     * \brief Bytecode instruction
+     */
+    struct Instruction {
+        //! Operation
+        Op op;
+        //! Operand of the operation, if any
+        std::uint32_t operand = 0;
+    };
+
+    //! Native form of a function compiled with LLVM, taking its arguments in an array
+    typedef double (*native_t)(const double *args);
+
+    /** \struct Function
+     * \brief Function compiled into bytecode
+     */
+    struct Function {
+        //! Name of the function, as the compiled program names it
+        std::string name;
+        //! Number of arguments, which occupy the first local slots
+        std::size_t arity = 0;
+        //! Number of local slots, including the arguments
+        std::size_t locals = 0;
+        //! Instructions of the body
+        std::vector<Instruction> code;
+        //! Definition node, used to compile the function with LLVM
+        ast::definitions::Function *node = nullptr;
+        //! Whether the function is pure, and so can be compiled on its own
+        bool pure = false;
+
+        //! Number of calls so far
+        std::size_t calls = 0;
+        //! Whether compilation with LLVM was attempted
+        bool tiered = false;
+        //! Native form of the function taking its arguments in an array, or `nullptr` if not compiled
+        native_t native = nullptr;
+    };
+
+    /** \struct Settings
+     * \brief Settings of the interpreter
+     */
+    struct Settings {
+        //! Whether to fold constant expressions before compiling into bytecode
+        bool fold = true;
+        //! Number of calls after which a pure function is compiled with LLVM, `0` to never compile
+        std::size_t tier_up = 1000;
+        //! Optimization level of the functions compiled with LLVM
+        optimization::Level level = optimization::Level::O2;
+        //! Maximum depth of calls, beyond which interpretation stops
+        std::size_t max_depth = 1u << 16u;
+    };
+
+    /** \class InterpreterException
+     * \brief Exception during compilation into bytecode or interpretation (for example a call to an unknown function)
+     */
+    class InterpreterException : public std::runtime_error {
+        public:
+            //! Construct an interpreter exception from its message
+            explicit InterpreterException(const std::string &message) : std::runtime_error(message) {}
+    };
+
+    /** \class Interpreter
+     * \brief Program compiled into bytecode for interpretation
+     *
+     * Functions and global variables resolve as in the compiled program, and the same programs are rejected.
+     * Global variables are initialized on construction, and `main` is only run by \ref run.
+     */
+    class Interpreter {
+        private:
+            //! Program, kept to compile hot functions with LLVM
+            ast::Program program;
+            //! Settings
+            Settings settings;
+            //! Compiled functions in order of definition
+            std::vector<Function> functions;
+            //! Initializer of the global variables, as a function without arguments
+            Function initializer;
+            //! Indices of the functions that calls resolve to by name
+            std::unordered_map<std::string, std::size_t> names;
+            //! Constants of all of the functions
+            std::vector<double> constants;
+            //! Values of the global variables
+            std::vector<double> globals;
+            //! Value stack, holding the local slots of the active calls and their operands
+            std::vector<double> stack;
+            //! Engine holding the functions compiled with LLVM, created on the first compilation
+            std::unique_ptr<jit::Engine> engine;
+            //! Number of functions compiled with LLVM
+            std::size_t compiled = 0;
+
+            /**
+             * \brief Count a call of a function, compiling it with LLVM once it is hot
+             *
+             * \param index Index of the function
+             * \return Native form of the function, or `nullptr` if it is interpreted
+             */
+            native_t count_call(std::size_t index);
+
+            /**
+             * \brief Run a function on the arguments on top of the value stack, popping them
+             *
+             * \param function Function to run
+             * \return Result of the function
+             */
+            double execute(Function &function);
+
+            /**
+             * \brief Try to compile a function with LLVM, along with the functions it calls
+             *
+             * Failures leave the function interpreted.
+             *
+             * \param index Index of the function
+             */
+            void tier_up(std::size_t index);
+
+        public:
+            /**
+             * \brief Compile a program into bytecode and initialize its global variables
+             *
+             * \param program Program node
+             * \param settings Settings of the interpreter
+             */
+            explicit Interpreter(ast::Program program, const Settings &settings = {});
+            ~Interpreter();
+
+            /**
+             * \brief Call a function
+             *
+             * \param name Name of the function
+             * \param args Arguments, as many as the function takes
+             * \return Result of the function
+             */
+            double call(const std::string &name, const std::vector<double> &args);
+
+            /**
+             * \brief Run `main` of the program
+             *
+             * \return Result of `main` converted to an integer, as the exit code of the compiled program
+             */
+            int run();
+
+            //! Compiled function that calls resolve to by name, or `nullptr` if there is none
+            const Function *function(const std::string &name) const;
+
+            //! Number of functions compiled with LLVM so far
+            std::size_t tiered() const { return compiled; }
+    };
+}
+
+#endif //BASILISK_INTERPRETER_H
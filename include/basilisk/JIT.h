@@ -0,0 +1,158 @@
+/** \file JIT.h
+ * In-process execution of generated LLVM IR
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_JIT_H
+#define BASILISK_JIT_H
+
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/** \namespace basilisk::jit
+ * \brief In-process execution of generated LLVM IR
+ *
+ * Compilation of modules produced by `codegen::ProgramCodegen` into the memory of the current process using LLVM ORC,
+ * and execution of their global variable initializers and `main`.
+ */
+namespace basilisk::jit {
+    /** \struct Object
+     * \brief Relocatable object code compiled by an engine, along with its global constructors and destructors
+     */
+    struct Object {
+        //! Object file contents
+        std::string code;
+        //! Names of the global constructors in priority order
+        std::vector<std::string> constructors;
+        //! Names of the global destructors in priority order
+        std::vector<std::string> destructors;
+
+        //! Serialize the object, for example to store it in a cache
+        std::string serialize() const;
+        /**
+         * \brief Deserialize an object
+         *
+         * \param data Serialized object
+         * \param object Object to deserialize into
+         * \return `true` if the data is a valid serialized object, `false` otherwise
+         */
+        static bool deserialize(std::string_view data, Object &object);
+    };
+
+    /** \class Engine
+     * \brief JIT compiler for the host, holding the compiled modules
+     *
+     * The STL function `println` calls the host `printf`, or \ref runtime::basilisk_println when generated with buffered
+     *  output, and the engine resolves `basilisk_println` and `basilisk_flush` to the runtime linked into the host.
+     * Global constructors and destructors of added modules are run by `run`, or explicitly by `initialize` and
+     * `finalize`.
+     */
+    class Engine {
+        private:
+            //! Underlying ORC JIT
+            std::unique_ptr<llvm::orc::LLJIT> jit;
+            //! Target machine of the host, to compile objects with
+            std::unique_ptr<llvm::TargetMachine> target_machine;
+            //! Target triple of the host
+            std::string triple;
+            //! Names of global constructors of the added modules, pending a run
+            std::vector<std::string> constructors;
+            //! Names of global destructors of the added modules, pending a run
+            std::vector<std::string> destructors;
+        public:
+            /**
+             * \brief Construct an engine compiling for the host CPU
+             *
+             * \param level Code generation optimization level
+             */
+            explicit Engine(llvm::CodeGenOpt::Level level = llvm::CodeGenOpt::Default);
+
+            //! Data layout the added modules are compiled with
+            const llvm::DataLayout &data_layout() const;
+            //! Target machine of the host, for example to tune the optimization pipeline to before adding a module
+            llvm::TargetMachine &host_machine() { return *target_machine; }
+
+            /**
+             * \brief Add a module to be compiled
+             *
+             * The module is configured for the host if it has no data layout.
+             * Global constructors and destructors of the module are taken out of `llvm.global_ctors` and
+             * `llvm.global_dtors` to be run by the engine.
+             *
+             * \param context Context of the module
+             * \param module Module to add
+             */
+            void add(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module);
+
+            /**
+             * \brief Compile a module into an object, without adding it
+             *
+             * The module is configured for the host if it has no data layout.
+             * Its global constructors and destructors are taken out of `llvm.global_ctors` and `llvm.global_dtors`
+             *  into the object.
+             *
+             * \param module Module to compile
+             * \return Compiled object
+             */
+            Object compile(llvm::Module &module);
+
+            /**
+             * \brief Add a previously compiled object
+             *
+             * \param object Object to add
+             */
+            void add(Object object);
+
+            /**
+             * \brief Look up the address of a symbol, compiling it if necessary
+             *
+             * \param name Unmangled name of the symbol
+             * \return Address of the symbol
+             */
+            void *lookup(const std::string &name);
+
+            //! Run the pending global constructors in priority order
+            void initialize();
+            //! Run the pending global destructors in priority order
+            void finalize();
+
+            /**
+             * \brief Run the program: the global constructors, `main` and the global destructors
+             *
+             * \return Return value of `main`
+             */
+            int run();
+    };
+
+    /**
+     * \brief Compile and run a module in the current process
+     *
+     * \param context Context of the module
+     * \param module Module to run
+     * \param level Code generation optimization level
+     * \return Return value of `main`
+     */
+    int run(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module,
+            llvm::CodeGenOpt::Level level = llvm::CodeGenOpt::Default);
+
+    /** \class JITException
+     * \brief Exception during JIT compilation or symbol lookup
+     */
+    class JITException : public std::runtime_error {
+        public:
+            //! Construct a JIT exception from its message
+            explicit JITException(const std::string &message) : std::runtime_error(message) {}
+    };
+}
+
+#endif //BASILISK_JIT_H
@@ -6,24 +6,29 @@
 #ifndef BASILISK_LEXER_H
 #define BASILISK_LEXER_H
 
+#include <basilisk/Tokens.h>
+
 #include <vector>
 #include <functional>
 #include <exception>
-
-// Forward declarations
-///\cond
-namespace basilisk::tokens {
-    struct Token;
-}
-///\endcond
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <cstddef>
 
 /** \namespace basilisk::lexer
  * \brief Namespace for all lexer-related code
  *
  * The main lexing function is \ref lex.
- * It needs a function to get the next input character (\ref get_function_t), a function to peek at the next input
- *  character (\ref peek_function_t, and a function to append a Token to the output buffer (\ref append_function_t).
+ * The preferred form scans a contiguous input buffer (for example a whole source file in memory) and returns the
+ *  resulting tokens directly.
+ * The callback form needs a function to get the next input character (\ref get_function_t), a function to peek at the
+ *  next input character (\ref peek_function_t, and a function to append a Token to the output buffer
+ *  (\ref append_function_t). It reads the input into a caller-provided buffer and delegates to the buffer form.
+ * Alternatively, \ref TokenStream lexes a contiguous input buffer on demand as its tokens are consumed.
+ * Token contents are views into the input buffer, which therefore has to outlive the tokens.
  * Whitespace is ignored when lexing, apart from separating tokens.
+ * Input ends at the end of the buffer, or at the first null or end of file character.
  */
 namespace basilisk::lexer {
     //! Input get function type - no arguments and return a single character
@@ -33,7 +38,74 @@ namespace basilisk::lexer {
     //! Output append function type - single Token argument and no return
     typedef std::function<void (tokens::Token)> append_function_t;
 
-    void lex(const get_function_t &get, const peek_function_t &peek, const append_function_t &append);
+    void lex(const get_function_t &get, const peek_function_t &peek, const append_function_t &append,
+             std::string &input);
+    void lex(std::string_view input, std::vector<tokens::Token> &output);
+    std::vector<tokens::Token> lex(std::string_view input);
+    std::vector<tokens::Token> lex(const char *input, std::size_t length);
+
+    /** \class TokenStream
+     * \brief Stream of tokens lexed on demand from a contiguous input buffer
+     *
+     * Only the tokens looked ahead at are kept, in a ring buffer, so that parsing can consume them as they are lexed.
+     * The stream ends with the `END` token, after which \ref get returns error tokens.
+     * Lexing errors are thrown as \ref LexerException from the call that needed the invalid token.
+     */
+    class TokenStream {
+        public:
+            //! Number of tokens that can be looked ahead at
+            static constexpr unsigned lookahead = 4;
+
+        private:
+            //! Ring buffer of the tokens looked ahead at
+            tokens::Token buffer[lookahead]{};
+            //! Position of the front token in the ring buffer
+            unsigned first = 0;
+            //! Number of tokens in the ring buffer
+            unsigned size = 0;
+            //! Next character to lex
+            const char *position;
+            //! One past the last character of the input buffer
+            const char *end;
+            //! Whether the `END` token was lexed
+            bool finished = false;
+            //! Number of tokens lexed so far
+            std::size_t lexed = 0;
+
+            /**
+             * \brief Lex tokens until the ring buffer holds at least a number of them
+             *
+             * \param count Number of tokens to hold
+             * \return `false` when the input ended before that many tokens, `true` otherwise
+             */
+            bool fill(unsigned count);
+
+        public:
+            /**
+             * \brief Construct a stream lexing an input buffer
+             *
+             * \param input Input buffer, which has to outlive the stream and its tokens
+             */
+            explicit TokenStream(std::string_view input);
+
+            /**
+             * \brief Peek at the token a number of tokens from the front of the stream
+             *
+             * \param offset Offset of the token from the front, less than \ref lookahead
+             * \return Reference to the token, valid until it is removed, or an error token when not present
+             */
+            const tokens::Token &peek(unsigned offset);
+
+            /**
+             * \brief Remove the token at the front of the stream and return it
+             *
+             * \return Front token, or an error token after the end of the stream
+             */
+            tokens::Token get();
+
+            //! Number of tokens lexed so far
+            std::size_t count() const { return lexed; }
+    };
 
     /** \class LexerException
      * \brief Exception during lexing (for example an invalid character)
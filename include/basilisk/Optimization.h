@@ -0,0 +1,103 @@
+/** \file Optimization.h
+ * LLVM IR optimization
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_OPTIMIZATION_H
+#define BASILISK_OPTIMIZATION_H
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+/** \namespace basilisk::optimization
+ * \brief LLVM IR optimization
+ *
+ * Optimization pass pipeline run on the generated LLVM IR.
+ * The pipeline is the default LLVM pipeline of the chosen level, the same one clang uses, with tail recursion
+ *  elimination at every level but `O0`.
+ */
+namespace basilisk::optimization {
+    /** \enum Level
+     * \brief Optimization level
+     */
+    enum class Level {
+        O0,     //!< No optimization
+        O1,     //!< Quick optimizations
+        O2,     //!< Default optimizations, including inlining and vectorization
+        O3,     //!< Aggressive optimizations
+        Os      //!< Optimizations favoring code size
+    };
+
+    /** \struct Profile
+     * \brief Profile-guided optimization of the pass pipeline
+     *
+     * Instrumentation counts the executions of the functions and of the edges between their blocks, and the merged
+     *  profile of instrumented runs then guides the pipeline, for example in inlining and block placement.
+     * Both use the IR of the same point of the pipeline, so a profile is only valid for the level and code generation
+     *  options it was generated with.
+     */
+    struct Profile {
+        //! Whether to instrument the module, whose program then needs to be linked with the profile runtime
+        bool generate = false;
+        //! File the instrumented program writes its raw profile into, empty for the default of the profile runtime
+        std::string generate_file;
+        //! Merged profile to optimize with, empty for none
+        std::string use_file;
+    };
+
+    /**
+     * \brief Parse an optimization level flag (`-O0`, `-O1`, `-O2`, `-O3` or `-Os`)
+     *
+     * \param flag Flag to parse
+     * \param level Level to set when the flag is valid
+     * \return `true` if the flag is an optimization level, `false` otherwise
+     */
+    bool parse_level(std::string_view flag, Level &level);
+
+    /**
+     * \brief Get the code generation optimization level matching an optimization level
+     *
+     * \param level Optimization level
+     * \return Code generation optimization level to create the target machine with
+     */
+    llvm::CodeGenOpt::Level codegen_level(Level level);
+
+    /**
+     * \brief Configure a module for a target machine
+     *
+     * Sets the data layout and triple of the module, and the attributes of its defined functions that let the
+     *  optimization pipeline see the same subtarget and floating-point semantics as code generation.
+     *
+     * \param module Module to configure
+     * \param target_machine Target machine the module is optimized and emitted with
+     */
+    void configure(llvm::Module &module, const llvm::TargetMachine &target_machine);
+
+    /**
+     * \brief Create another target machine with the same configuration, for use on another thread
+     *
+     * \param target_machine Target machine to copy the configuration of
+     * \return New target machine
+     */
+    std::unique_ptr<llvm::TargetMachine> copy_target_machine(const llvm::TargetMachine &target_machine);
+
+    /**
+     * \brief Run the optimization pass pipeline on a module
+     *
+     * Running at `O0` leaves the module unchanged, even with a profile.
+     *
+     * \param module Module to optimize
+     * \param level Optimization level
+     * \param target_machine Target machine to tune the pipeline to (for example vectorization costs), or `nullptr`
+     * \param profile Profile to instrument the module for or to optimize it with
+     */
+    void optimize(llvm::Module &module, Level level = Level::O2, llvm::TargetMachine *target_machine = nullptr,
+            const Profile &profile = {});
+}
+
+#endif //BASILISK_OPTIMIZATION_H
@@ -0,0 +1,112 @@
+/** \file Parallel.h
+ * Parallel parsing and code generation
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_PARALLEL_H
+#define BASILISK_PARALLEL_H
+
+#include <basilisk/AST.h>
+#include <basilisk/Cache.h>
+#include <basilisk/Tokens.h>
+#include <basilisk/Codegen.h>
+#include <basilisk/Optimization.h>
+
+#include <llvm/IR/Module.h>
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <vector>
+
+/** \namespace basilisk::parallel
+ * \brief Parallel parsing and code generation
+ *
+ * Parsing of the definitions of a program on multiple threads, each range of them into its own arena, which are then
+ *  merged together.
+ * Generation of the functions of a program on multiple threads, each into a module in its own context, which are
+ *  then linked together.
+ */
+namespace basilisk::parallel {
+    /**
+     * \brief Resolve a requested number of threads
+     *
+     * \param jobs Requested number of threads, `0` for one per hardware thread
+     * \return Number of threads to use, at least one
+     */
+    unsigned resolve_jobs(unsigned jobs);
+
+    /**
+     * \brief Run a task for each index below a count on multiple threads
+     *
+     * Indices are handed out in increasing order, and the calling thread is one of the threads.
+     * All tasks run even when some of them throw, and the exception of the lowest failed index is then rethrown.
+     *
+     * \param count Number of indices
+     * \param jobs Number of threads, `0` for one per hardware thread
+     * \param task Task to run for each index
+     */
+    void for_each(std::size_t count, unsigned jobs, const std::function<void(std::size_t)> &task);
+
+    /**
+     * \brief Parse tokens into a program on multiple threads
+     *
+     * The tokens are split into ranges of whole definitions, at each `SEMICOLON` outside of braces and each `RBRAC`
+     *  closing them, and each range is parsed by its own \ref parser::ProgramParser.
+     * The definitions are then gathered in source order and their arenas merged, so the program is the same as when
+     *  parsed on one thread.
+     * When parsing fails, the exception of the first range that failed is rethrown.
+     *
+     * \param tokens Tokens in order, ending with the `END` token
+     * \param jobs Number of threads, `0` for one per hardware thread
+     * \return Program node
+     */
+    ast::Program parse(const std::vector<tokens::Token> &tokens, unsigned jobs = 0);
+
+    /** \struct Settings
+     * \brief Settings of parallel code generation
+     */
+    struct Settings {
+        //! Number of threads, `0` for one per hardware thread
+        unsigned jobs = 0;
+        //! Number of functions per shard
+        std::size_t shard_size = 32;
+        //! Optimization level to optimize each shard at before linking, if any
+        std::optional<optimization::Level> level;
+        //! Target machine to configure and optimize each shard for (see \ref optimization::configure), copied for each
+        //!  shard, or `nullptr` for none
+        const llvm::TargetMachine *target_machine = nullptr;
+        //! Cache of generated shards to reuse, or `nullptr` for none
+        cache::ObjectCache *cache = nullptr;
+    };
+
+    /**
+     * \brief Generate LLVM IR from a program on multiple threads
+     *
+     * The program is first generated into the module with only prototypes of its functions (see
+     *  \ref codegen::ProgramCodegen::declare).
+     * Its functions are then split in order into shards of a fixed size, each generated in its own context along with
+     *  declarations of the functions and global variables it refers to, and linked into the module in order.
+     * The shards don't depend on the number of threads, so neither does the generated module.
+     * Functions are resolved as when generating the program on one thread, except that functions sharing a name are
+     *  rejected, as their shards couldn't be linked.
+     * Functions already declared in the module, such as functions defined in other modules, can be called as well.
+     *
+     * With a cache, the bitcode of each shard is stored under a key of everything it depends on: the structural hashes
+     *  of its functions (see \ref ast::util::HashVisitor), their effects, the arities of the functions and the
+     *  visibility of the global variables they refer to, and the settings, including the target machine.
+     * With a target machine, the module should already be configured for it, so that the shards link into it.
+     * Shards whose key is found are not generated again, so changing a function only regenerates the shards of the
+     *  functions that depend on it.
+     *
+     * \param program Program node
+     * \param module Module to generate into
+     * \param codegen Optional code generation features
+     * \param settings Settings of parallel code generation
+     * \return Number of shards taken from the cache
+     */
+    std::size_t generate(ast::Program &program, llvm::Module &module, const codegen::Settings &codegen = {},
+            const Settings &settings = {});
+}
+
+#endif //BASILISK_PARALLEL_H
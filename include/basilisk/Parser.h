@@ -10,6 +10,9 @@
 #include <functional>
 #include <exception>
 #include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <cstddef>
 
 // Forward declarations
 ///\cond
@@ -17,6 +20,7 @@ namespace basilisk::tokens {
     struct Token;
 }
 namespace basilisk::ast {
+    class Arena;
     class Expression;
     namespace expressions {
         class Expression1;
@@ -58,6 +62,7 @@ namespace basilisk::parser {
      * Input get function type.
      * Takes no argument.
      * Pop the top element from the buffer and returns it.
+     * The token is returned by value, as it is no longer in the buffer.
      */
     typedef std::function<tokens::Token ()> get_f_t;
     /**
@@ -65,9 +70,9 @@ namespace basilisk::parser {
      *
      * Input peek function type.
      * Takes an unsigned argument that is the offset of the token (top of the buffer has offset `0`).
-     * Returns the token `offset` elements from the top of the buffer.
+     * Returns a reference to the token `offset` elements from the top of the buffer, valid until the next get.
      */
-    typedef std::function<tokens::Token (unsigned)> peek_f_t;
+    typedef std::function<const tokens::Token &(unsigned)> peek_f_t;
 
     /** \class ExpressionParser
      * \brief Parser dedicated to expressions
@@ -81,15 +86,18 @@ namespace basilisk::parser {
             const get_f_t &get;
             //! Function to peek at the next input token
             const peek_f_t &peek;
+            //! Arena to allocate the nodes from, or `nullptr` to allocate them on the heap
+            ast::Arena *arena;
         public:
             /**
              * \brief Construct an Expression Parser on an input token buffer
              *
              * \param get Function to get the next input token
              * \param peek Function to peek at the next input token
+             * \param arena Arena to allocate the nodes from, or `nullptr` to allocate them on the heap
              */
-            ExpressionParser(const get_f_t &get, const peek_f_t &peek)
-                    : get(get), peek(peek) {}
+            ExpressionParser(const get_f_t &get, const peek_f_t &peek, ast::Arena *arena = nullptr)
+                    : get(get), peek(peek), arena(arena) {}
 
             std::unique_ptr<ast::expressions::Parenthesised> parenthesised();
             std::vector<std::unique_ptr<ast::Expression>> list();
@@ -115,15 +123,18 @@ namespace basilisk::parser {
             const get_f_t &get;
             //! Function to peek at the next input token
             const peek_f_t &peek;
+            //! Arena to allocate the nodes from, or `nullptr` to allocate them on the heap
+            ast::Arena *arena;
         public:
             /**
              * \brief Construct a Statement Parser on an input token buffer
              *
              * \param get Function to get the next input token
              * \param peek Function to peek at the next input token
+             * \param arena Arena to allocate the nodes from, or `nullptr` to allocate them on the heap
              */
-            StatementParser(const get_f_t &get, const peek_f_t &peek)
-                    : get(get), peek(peek) {}
+            StatementParser(const get_f_t &get, const peek_f_t &peek, ast::Arena *arena = nullptr)
+                    : get(get), peek(peek), arena(arena) {}
 
             std::unique_ptr<ast::statements::Return> return_kw();
             std::unique_ptr<ast::statements::Discard> discard();
@@ -143,15 +154,18 @@ namespace basilisk::parser {
             const get_f_t &get;
             //! Function to peek at the next input token
             const peek_f_t &peek;
+            //! Arena to allocate the nodes from, or `nullptr` to allocate them on the heap
+            ast::Arena *arena;
         public:
             /**
              * \brief Construct a Definition Parser on an input token buffer
              *
              * \param get Function to get the next input token
              * \param peek Function to peek at the next input token
+             * \param arena Arena to allocate the nodes from, or `nullptr` to allocate them on the heap
              */
-            DefinitionParser(const get_f_t &get, const peek_f_t &peek)
-                    : get(get), peek(peek) {}
+            DefinitionParser(const get_f_t &get, const peek_f_t &peek, ast::Arena *arena = nullptr)
+                    : get(get), peek(peek), arena(arena) {}
 
             std::unique_ptr<ast::definitions::Variable> variable();
             std::unique_ptr<ast::definitions::Function> function();
@@ -163,6 +177,7 @@ namespace basilisk::parser {
      *
      * Dedicated parser for programs.
      * This class groups program-specific parsing together.
+     * The nodes of the program are allocated from an arena owned by the resulting Program node.
      */
     class ProgramParser {
         private:
@@ -183,6 +198,15 @@ namespace basilisk::parser {
             ast::Program program();
     };
 
+    /**
+     * \brief Parse a program from source code, lexing it as the parser consumes the tokens
+     *
+     * \param source Source code of the program
+     * \param count Optional output for the number of tokens lexed
+     * \return Resulting Program node
+     */
+    ast::Program parse(std::string_view source, std::size_t *count = nullptr);
+
     /** \class ParserException
      * \brief Exception during parsing (for example an unexpected token)
      */
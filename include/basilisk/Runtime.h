@@ -0,0 +1,50 @@
+/** \file Runtime.h
+ * Runtime support of compiled programs
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_RUNTIME_H
+#define BASILISK_RUNTIME_H
+
+#include <cstddef>
+
+/** \namespace basilisk::runtime
+ * \brief Runtime support of compiled programs
+ *
+ * Functions that programs generated with buffered output call instead of the C library (see
+ *  \ref codegen::Settings::buffered_output).
+ * They are resolved by the JIT, and compiled objects are linked with the `basilisk_runtime` library.
+ *
+ * Output is buffered per thread, so writing a value takes no lock and no format parsing, and a buffer only goes to
+ *  the standard output stream when it fills up, when it is flushed and when its thread exits.
+ */
+namespace basilisk::runtime {
+    //! Size of the output buffer of each thread in bytes
+    constexpr std::size_t buffer_size = 1 << 16;
+
+    //! Maximum length of a formatted value, the longest being the 309 integral digits of the largest finite value
+    constexpr std::size_t max_length = 330;
+
+    /**
+     * \brief Format a value as `printf("%f\n", x)` does in the "C" locale
+     *
+     * \param x Value to format
+     * \param out Buffer of at least \ref max_length characters to format into
+     * \return Number of characters written
+     */
+    std::size_t format(double x, char *out);
+
+    extern "C" {
+        /**
+         * \brief Write a value followed by a new line into the output buffer of the calling thread
+         *
+         * \param x Value to write
+         */
+        void basilisk_println(double x);
+
+        //! Write the output buffer of the calling thread into the standard output stream
+        void basilisk_flush();
+    }
+}
+
+#endif //BASILISK_RUNTIME_H
@@ -0,0 +1,102 @@
+/** \file Symbols.h
+ * Interned identifier symbols
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_SYMBOLS_H
+#define BASILISK_SYMBOLS_H
+
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+/** \namespace basilisk::symbols
+ * \brief Interned identifier symbols
+ *
+ * Identifiers are interned into a single process-wide pool, and each distinct name is represented by a compact symbol.
+ * Symbols of equal names are equal, so comparing and hashing them does not touch the name.
+ * The pool is safe to use from multiple threads and only ever grows, so the name of a symbol stays valid for the
+ *  remainder of the process.
+ */
+namespace basilisk::symbols {
+    /** \class Symbol
+     * \brief Interned identifier
+     *
+     * Represents a name by its index in the symbol pool.
+     * The default symbol represents the empty name.
+     */
+    class Symbol {
+        public:
+            //! Type of the symbol index
+            typedef std::uint32_t id_t;
+        private:
+            //! Index of the name in the symbol pool
+            id_t index = 0;
+        public:
+            //! Construct the symbol of the empty name
+            Symbol() = default;
+            /**
+             * \brief Construct the symbol of a name, interning it if not seen before
+             *
+             * \param name Name to intern
+             */
+            Symbol(std::string_view name);
+            //! Construct the symbol of a null-terminated name, interning it if not seen before
+            Symbol(const char *name) : Symbol(std::string_view(name)) {}
+            //! Construct the symbol of a name, interning it if not seen before
+            Symbol(const std::string &name) : Symbol(std::string_view(name)) {}
+
+            /**
+             * \brief Name represented by this symbol
+             *
+             * \return Reference to the interned name, valid for the remainder of the process
+             */
+            const std::string &str() const;
+            /**
+             * \brief Index of this symbol in the symbol pool
+             *
+             * Indices are assigned in order of interning, so they are only stable within a single process.
+             *
+             * \return Index of the symbol
+             */
+            id_t id() const { return index; }
+            //! Whether this symbol represents the empty name
+            bool empty() const { return index == 0; }
+
+            //! Symbols are equal when they represent the same name
+            bool operator==(const Symbol &rhs) const { return index == rhs.index; }
+            //! Symbols are equal when they represent the same name
+            bool operator!=(const Symbol &rhs) const { return index != rhs.index; }
+            //! Symbols are ordered by interning order, not by name
+            bool operator<(const Symbol &rhs) const { return index < rhs.index; }
+    };
+
+    /**
+     * \brief Write the name of a symbol to an output stream
+     *
+     * \param os Output stream
+     * \param symbol Symbol to write
+     * \return Output stream
+     */
+    std::ostream &operator<<(std::ostream &os, const Symbol &symbol);
+
+    /**
+     * \brief Number of names in the symbol pool, including the empty name
+     *
+     * \return Number of interned names
+     */
+    std::size_t pool_size();
+}
+
+//! Hash symbols by their index
+template<>
+struct std::hash<basilisk::symbols::Symbol> {
+    std::size_t operator()(const basilisk::symbols::Symbol &symbol) const noexcept {
+        return std::hash<basilisk::symbols::Symbol::id_t>()(symbol.id());
+    }
+};
+
+#endif //BASILISK_SYMBOLS_H
@@ -7,8 +7,11 @@
 #define BASILISK_TOKENS_H
 
 #include <string>
+#include <string_view>
 #include <ostream>
 
+#include <basilisk/Symbols.h>
+
 /** \namespace basilisk::tokens
  * \brief Token definitions
  *
@@ -67,15 +70,20 @@ namespace basilisk::tokens {
      *  \brief Token information
      *
      *  Token information containing at least the token tag.
-     *  Also contains the token contents (string) if the tag is not enough (for example with identifier tokens).
+     *  Also contains the token contents if the tag is not enough (for example with identifier tokens).
+     *  The contents are a view into the lexed source buffer (the offending text for `ERROR` tokens), so the buffer has to
+     *   outlive the token.
+     *  Identifier tokens also carry the interned symbol of their contents, other tokens carry the empty symbol.
      */
     struct Token {
         //! Token tag
         tags::token_tag tag;
         //! Tag content if tag is not enough, empty otherwise
-        std::string content;
+        std::string_view content;
+        //! Interned symbol of the content for identifier tokens, empty otherwise
+        symbols::Symbol symbol{};
 
-        //! Tokens are equal iff their tag and content are equal
+        //! Tokens are equal iff their tag and content are equal (the symbol follows from the content)
         friend bool operator==(const Token &lhs, const Token &rhs) {
             return lhs.tag == rhs.tag && lhs.content == rhs.content;
         }
@@ -8,8 +8,65 @@
 #include <basilisk/AST_util.h>
 
 #include <algorithm>
+#include <new>
+#include <cstdint>
+#include <iterator>
 
 namespace basilisk::ast {
+    //--- Start Arena implementation
+    void *Arena::allocate(std::size_t size, std::size_t alignment) {
+        // Dedicated block for large allocations, keeping the current block in use
+        if (size > block_size / 4) {
+            auto block = std::make_unique<std::byte[]>(size + alignment);
+            auto pointer = reinterpret_cast<std::uintptr_t>(block.get());
+            auto aligned = reinterpret_cast<std::byte *>((pointer + alignment - 1) & ~(alignment - 1));
+            blocks.insert(blocks.begin(), std::move(block));
+            used += size;
+            reserved += size + alignment;
+            return aligned;
+        }
+
+        // Align the position, moving to a new block if the allocation does not fit
+        auto pointer = reinterpret_cast<std::uintptr_t>(position);
+        auto aligned = reinterpret_cast<std::byte *>((pointer + alignment - 1) & ~(alignment - 1));
+        if (position == nullptr || aligned + size > end) {
+            blocks.push_back(std::make_unique<std::byte[]>(block_size));
+            reserved += block_size;
+            position = blocks.back().get();
+            end = position + block_size;
+            pointer = reinterpret_cast<std::uintptr_t>(position);
+            aligned = reinterpret_cast<std::byte *>((pointer + alignment - 1) & ~(alignment - 1));
+        }
+
+        // Bump the position
+        position = aligned + size;
+        used += size;
+        return aligned;
+    }
+
+    void Arena::merge(Arena &other) {
+        // Move the blocks over, keeping own current block last
+        blocks.insert(blocks.begin(), std::make_move_iterator(other.blocks.begin()),
+                std::make_move_iterator(other.blocks.end()));
+        used += other.used;
+        reserved += other.reserved;
+
+        // Leave the other arena empty
+        other.blocks.clear();
+        other.position = nullptr;
+        other.end = nullptr;
+        other.used = 0;
+        other.reserved = 0;
+    }
+    //--- End Arena implementation
+
+    //--- Start Program implementation
+    Program &Program::operator=(Program &&other) noexcept {
+        definitions = std::move(other.definitions);
+        arena = std::move(other.arena);
+        return *this;
+    }
+    //--- End Program implementation
 
     //--- Start visitor accepting
     void Node::accept(Visitor &visitor) { visitor.visit(*this); }
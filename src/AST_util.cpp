@@ -8,6 +8,7 @@
 #include <sstream>
 #include <algorithm>
 #include <utility>
+#include <cmath>
 
 namespace basilisk::ast::util {
 
@@ -276,4 +277,906 @@ namespace basilisk::ast::util {
         stream << "-Unknown Node\n";
     }
     //--- End PrintVisitor implementation
+
+    //--- Start CountVisitor implementation
+    /**
+     * \brief Count the nodes in the AST under a node using this visitor
+     *
+     * \param node Node to count from
+     * \return Node counts
+     */
+    CountVisitor::Counts CountVisitor::count(Node &node) {
+        CountVisitor visitor;
+        node.accept(visitor);
+        return visitor.get();
+    }
+
+    void CountVisitor::visit(expressions::Modulo &node) {
+        counts.nodes++;
+        counts.expressions++;
+        node.x->accept(*this);
+        node.m->accept(*this);
+    }
+
+    void CountVisitor::visit(expressions::Summation &node) {
+        counts.nodes++;
+        counts.expressions++;
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void CountVisitor::visit(expressions::Subtraction &node) {
+        counts.nodes++;
+        counts.expressions++;
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void CountVisitor::visit(expressions::Multiplication &node) {
+        counts.nodes++;
+        counts.expressions++;
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void CountVisitor::visit(expressions::Division &node) {
+        counts.nodes++;
+        counts.expressions++;
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void CountVisitor::visit(expressions::NumericNegation &node) {
+        counts.nodes++;
+        counts.expressions++;
+        node.x->accept(*this);
+    }
+
+    void CountVisitor::visit(expressions::IdentifierExpression &) {
+        counts.nodes++;
+        counts.expressions++;
+    }
+
+    void CountVisitor::visit(expressions::Parenthesised &node) {
+        counts.nodes++;
+        counts.expressions++;
+        node.expression->accept(*this);
+    }
+
+    void CountVisitor::visit(expressions::FunctionCall &node) {
+        counts.nodes++;
+        counts.expressions++;
+        for (auto &expression : node.arguments) {
+            expression->accept(*this);
+        }
+    }
+
+    void CountVisitor::visit(expressions::LiteralDouble &) {
+        counts.nodes++;
+        counts.expressions++;
+    }
+
+    void CountVisitor::visit(statements::Assignment &node) {
+        counts.nodes++;
+        counts.statements++;
+        node.value->accept(*this);
+    }
+
+    void CountVisitor::visit(statements::Discard &node) {
+        counts.nodes++;
+        counts.statements++;
+        node.expression->accept(*this);
+    }
+
+    void CountVisitor::visit(statements::Return &node) {
+        counts.nodes++;
+        counts.statements++;
+        node.expression->accept(*this);
+    }
+
+    void CountVisitor::visit(definitions::Function &node) {
+        counts.nodes++;
+        counts.functions++;
+        for (auto &statement : node.body) {
+            statement->accept(*this);
+        }
+    }
+
+    void CountVisitor::visit(definitions::Variable &node) {
+        counts.nodes++;
+        counts.variables++;
+        node.statement->accept(*this);
+    }
+
+    void CountVisitor::visit(Program &node) {
+        counts.nodes++;
+        for (auto &definition : node.definitions) {
+            definition->accept(*this);
+        }
+    }
+
+    void CountVisitor::visit(Node &) {
+        // Unknown node
+        counts.nodes++;
+    }
+    //--- End CountVisitor implementation
+
+    //--- Start PurityVisitor implementation
+    /**
+     * \brief Determine the purity of the functions of a program using this visitor
+     *
+     * \param program Program to analyze
+     * \return Purity of the functions of the program
+     */
+    PurityVisitor::result_t PurityVisitor::analyze(Program &program) {
+        PurityVisitor visitor;
+        program.accept(visitor);
+        return visitor.get();
+    }
+
+    PurityVisitor::result_t PurityVisitor::get() const {
+        // Start from the direct effects
+        result_t result;
+        for (auto &entry : summaries) {
+            result[entry.first] = entry.second.purity;
+        }
+
+        // Propagate effects of callees until nothing changes
+        // Note: purity only ever increases, so this terminates even for recursive functions
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto &entry : summaries) {
+                auto &purity = result[entry.first];
+                for (auto &callee : entry.second.callees) {
+                    auto found = result.find(callee);
+                    auto callee_purity = found == result.end() ? Purity::impure : found->second;
+                    if (callee_purity > purity) {
+                        purity = callee_purity;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    std::unordered_set<Identifier> PurityVisitor::recursive() const {
+        // Find the strongly connected components of the call graph (Tarjan's algorithm, without recursion)
+        // Note: functions in components of more than one function, or calling themselves, are recursive
+        std::unordered_set<Identifier> result;
+        std::unordered_map<Identifier, std::size_t> indices;
+        std::unordered_map<Identifier, std::size_t> lowlinks;
+        std::unordered_set<Identifier> on_stack;
+        std::vector<Identifier> stack;
+        auto open = [&](const Identifier &function){
+            auto index = indices.size();
+            indices[function] = index;
+            lowlinks[function] = index;
+            stack.push_back(function);
+            on_stack.insert(function);
+        };
+
+        for (auto &root : summaries) {
+            if (indices.count(root.first) > 0) {
+                continue;
+            }
+
+            // Depth-first search frames of function and position of its next callee
+            std::vector<std::pair<Identifier, std::size_t>> frames{{root.first, 0}};
+            open(root.first);
+            while (!frames.empty()) {
+                auto function = frames.back().first;
+                auto &callees = summaries.at(function).callees;
+                if (frames.back().second < callees.size()) {
+                    auto callee = callees[frames.back().second++];
+                    if (callee == function) {
+                        result.insert(function);
+                    } else if (summaries.count(callee) == 0) {
+                        // Unknown function -> not part of the graph
+                    } else if (indices.count(callee) == 0) {
+                        open(callee);
+                        frames.emplace_back(callee, 0);
+                    } else if (on_stack.count(callee) > 0) {
+                        lowlinks[function] = std::min(lowlinks[function], indices[callee]);
+                    }
+                    continue;
+                }
+
+                // All callees visited -> update the caller, and pop the component if this is its root
+                frames.pop_back();
+                if (!frames.empty()) {
+                    auto &caller = lowlinks[frames.back().first];
+                    caller = std::min(caller, lowlinks[function]);
+                }
+                if (lowlinks[function] == indices[function]) {
+                    std::vector<Identifier> component;
+                    do {
+                        component.push_back(stack.back());
+                        on_stack.erase(stack.back());
+                        stack.pop_back();
+                    } while (component.back() != function);
+                    if (component.size() > 1) {
+                        result.insert(component.begin(), component.end());
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    std::unordered_set<Identifier> PurityVisitor::calling() const {
+        std::unordered_set<Identifier> result;
+        for (auto &entry : summaries) {
+            if (!entry.second.callees.empty()) {
+                result.insert(entry.first);
+            }
+        }
+        return result;
+    }
+
+    std::unordered_set<Identifier> PurityVisitor::callers_of(const std::unordered_set<Identifier> &callees) const {
+        // Walk the call graph backwards from the callees
+        std::unordered_map<Identifier, std::vector<Identifier>> callers;
+        for (auto &entry : summaries) {
+            for (auto &callee : entry.second.callees) {
+                callers[callee].push_back(entry.first);
+            }
+        }
+        std::unordered_set<Identifier> result(callees);
+        std::vector<Identifier> pending(callees.begin(), callees.end());
+        while (!pending.empty()) {
+            auto function = pending.back();
+            pending.pop_back();
+            for (auto &caller : callers[function]) {
+                if (result.insert(caller).second) {
+                    pending.push_back(caller);
+                }
+            }
+        }
+        return result;
+    }
+
+    std::unordered_set<Identifier> PurityVisitor::returning() const {
+        // Functions that may not return are the recursive ones, the ones calling unknown functions, and their callers
+        auto excluded = recursive();
+        std::vector<Identifier> pending(excluded.begin(), excluded.end());
+        std::unordered_map<Identifier, std::vector<Identifier>> callers;
+        for (auto &entry : summaries) {
+            for (auto &callee : entry.second.callees) {
+                if (summaries.count(callee) > 0) {
+                    callers[callee].push_back(entry.first);
+                } else if (excluded.insert(entry.first).second) {
+                    pending.push_back(entry.first);
+                }
+            }
+        }
+        while (!pending.empty()) {
+            auto function = pending.back();
+            pending.pop_back();
+            for (auto &caller : callers[function]) {
+                if (excluded.insert(caller).second) {
+                    pending.push_back(caller);
+                }
+            }
+        }
+
+        std::unordered_set<Identifier> result;
+        for (auto &entry : summaries) {
+            if (excluded.count(entry.first) == 0) {
+                result.insert(entry.first);
+            }
+        }
+        return result;
+    }
+
+    void PurityVisitor::visit(expressions::Modulo &node) {
+        node.x->accept(*this);
+        node.m->accept(*this);
+    }
+
+    void PurityVisitor::visit(expressions::Summation &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void PurityVisitor::visit(expressions::Subtraction &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void PurityVisitor::visit(expressions::Multiplication &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void PurityVisitor::visit(expressions::Division &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void PurityVisitor::visit(expressions::NumericNegation &node) {
+        node.x->accept(*this);
+    }
+
+    void PurityVisitor::visit(expressions::IdentifierExpression &node) {
+        // Reading a global variable makes the result depend on it
+        if (current && locals.count(node.identifier) == 0 && globals.count(node.identifier) > 0) {
+            current->purity = std::max(current->purity, Purity::reads_globals);
+        }
+    }
+
+    void PurityVisitor::visit(expressions::Parenthesised &node) {
+        node.expression->accept(*this);
+    }
+
+    void PurityVisitor::visit(expressions::FunctionCall &node) {
+        if (current) {
+            if (node.identifier == "println") {
+                // Output -> side effect
+                current->purity = Purity::impure;
+            } else {
+                current->callees.push_back(node.identifier);
+            }
+        }
+        for (auto &expression : node.arguments) {
+            expression->accept(*this);
+        }
+    }
+
+    void PurityVisitor::visit(expressions::LiteralDouble &) {}
+
+    void PurityVisitor::visit(statements::Assignment &node) {
+        node.value->accept(*this);
+
+        if (!current) {
+            // Outside of function -> global variable definition
+            globals.insert(node.identifier);
+        } else if (locals.count(node.identifier) == 0) {
+            if (globals.count(node.identifier) > 0) {
+                // Assigning a global variable -> side effect
+                current->purity = Purity::impure;
+            } else {
+                // Otherwise -> new local variable
+                locals.insert(node.identifier);
+            }
+        }
+    }
+
+    void PurityVisitor::visit(statements::Discard &node) {
+        node.expression->accept(*this);
+    }
+
+    void PurityVisitor::visit(statements::Return &node) {
+        node.expression->accept(*this);
+    }
+
+    void PurityVisitor::visit(definitions::Function &node) {
+        // Note: functions sharing an identifier share a summary, which covers the effects of all of them
+        current = &summaries[node.identifier];
+        locals = std::unordered_set<Identifier>(node.arguments.begin(), node.arguments.end());
+        for (auto &statement : node.body) {
+            statement->accept(*this);
+        }
+        current = nullptr;
+        locals.clear();
+    }
+
+    void PurityVisitor::visit(definitions::Variable &node) {
+        node.statement->accept(*this);
+    }
+
+    void PurityVisitor::visit(Program &node) {
+        for (auto &definition : node.definitions) {
+            definition->accept(*this);
+        }
+    }
+
+    void PurityVisitor::visit(Node &) {
+        // Unknown node -> assume the worst
+        if (current) {
+            current->purity = Purity::impure;
+        }
+    }
+    //--- End PurityVisitor implementation
+
+    //--- Start ReferenceVisitor implementation
+    void ReferenceVisitor::visit(expressions::Modulo &node) {
+        node.x->accept(*this);
+        node.m->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(expressions::Summation &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(expressions::Subtraction &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(expressions::Multiplication &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(expressions::Division &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(expressions::NumericNegation &node) {
+        node.x->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(expressions::IdentifierExpression &node) {
+        variables.insert(node.identifier);
+    }
+
+    void ReferenceVisitor::visit(expressions::Parenthesised &node) {
+        node.expression->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(expressions::FunctionCall &node) {
+        functions.insert(node.identifier);
+        for (auto &argument : node.arguments) {
+            argument->accept(*this);
+        }
+    }
+
+    void ReferenceVisitor::visit(expressions::LiteralDouble &) {}
+
+    void ReferenceVisitor::visit(statements::Assignment &node) {
+        variables.insert(node.identifier);
+        node.value->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(statements::Discard &node) {
+        node.expression->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(statements::Return &node) {
+        node.expression->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(definitions::Function &node) {
+        for (auto &statement : node.body) {
+            statement->accept(*this);
+        }
+    }
+
+    void ReferenceVisitor::visit(definitions::Variable &node) {
+        node.statement->accept(*this);
+    }
+
+    void ReferenceVisitor::visit(Program &node) {
+        for (auto &definition : node.definitions) {
+            definition->accept(*this);
+        }
+    }
+
+    void ReferenceVisitor::visit(Node &) {
+        // Unknown node -> nothing to collect
+    }
+    //--- End ReferenceVisitor implementation
+
+    //--- Start SelfCallVisitor implementation
+    SelfCallVisitor::result_t SelfCallVisitor::analyze(Program &program) {
+        SelfCallVisitor visitor;
+        program.accept(visitor);
+        return visitor.get();
+    }
+
+    void SelfCallVisitor::visit(expressions::Modulo &node) {
+        node.x->accept(*this);
+        node.m->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(expressions::Summation &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(expressions::Subtraction &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(expressions::Multiplication &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(expressions::Division &node) {
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(expressions::NumericNegation &node) {
+        node.x->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(expressions::IdentifierExpression &) {}
+
+    void SelfCallVisitor::visit(expressions::Parenthesised &node) {
+        node.expression->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(expressions::FunctionCall &node) {
+        if (current && node.identifier == *current) {
+            auto &calls = result[node.identifier];
+            (&node == tail_call ? calls.tail : calls.other)++;
+        }
+        for (auto &argument : node.arguments) {
+            argument->accept(*this);
+        }
+    }
+
+    void SelfCallVisitor::visit(expressions::LiteralDouble &) {}
+
+    void SelfCallVisitor::visit(statements::Assignment &node) {
+        node.value->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(statements::Discard &node) {
+        node.expression->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(statements::Return &node) {
+        // Strip the parentheses to find the call in tail position, if any
+        Expression *expression = node.expression.get();
+        while (auto parenthesised = dynamic_cast<expressions::Parenthesised *>(expression)) {
+            expression = parenthesised->expression.get();
+        }
+        tail_call = dynamic_cast<expressions::FunctionCall *>(expression);
+        node.expression->accept(*this);
+        tail_call = nullptr;
+    }
+
+    void SelfCallVisitor::visit(definitions::Function &node) {
+        current = &node.identifier;
+        for (auto &statement : node.body) {
+            statement->accept(*this);
+        }
+        current = nullptr;
+    }
+
+    void SelfCallVisitor::visit(definitions::Variable &node) {
+        node.statement->accept(*this);
+    }
+
+    void SelfCallVisitor::visit(Program &node) {
+        for (auto &definition : node.definitions) {
+            definition->accept(*this);
+        }
+    }
+
+    void SelfCallVisitor::visit(Node &) {
+        // Unknown node -> nothing to count
+    }
+    //--- End SelfCallVisitor implementation
+
+    //--- Start FoldVisitor implementation
+    template<typename T>
+    void FoldVisitor::fold(std::unique_ptr<T> &slot) {
+        value.reset();
+        forward = nullptr;
+        release = nullptr;
+        slot->accept(*this);
+
+        if (value && !dynamic_cast<expressions::LiteralDouble *>(slot.get())) {
+            // Constant -> replace by a literal, which can take the place of any expression
+            slot = make_node<expressions::LiteralDouble>(arena, *value);
+            replaced++;
+        } else if (forward && dynamic_cast<T *>(forward)) {
+            // Replaceable by a subexpression that fits the slot -> move it up
+            auto expression = release();
+            slot.reset(static_cast<T *>(expression.release()));
+            replaced++;
+
+            // Parentheses moved up may now be redundant
+            auto parenthesised = dynamic_cast<expressions::Parenthesised *>(slot.get());
+            if (parenthesised && dynamic_cast<T *>(parenthesised->expression.get())) {
+                std::unique_ptr<Expression> inner = std::move(parenthesised->expression);
+                slot.reset(static_cast<T *>(inner.release()));
+                replaced++;
+            }
+        }
+        forward = nullptr;
+        release = nullptr;
+    }
+
+    template<typename T>
+    void FoldVisitor::forward_to(std::unique_ptr<T> &slot) {
+        value.reset();
+        forward = slot.get();
+        release = [&slot](){ return std::unique_ptr<Expression>(std::move(slot)); };
+    }
+
+    std::size_t FoldVisitor::fold(Program &program) {
+        FoldVisitor visitor(program.arena.get());
+        program.accept(visitor);
+        return visitor.count();
+    }
+
+    void FoldVisitor::visit(expressions::Modulo &node) {
+        fold(node.x);
+        auto x = value;
+        fold(node.m);
+        auto m = value;
+
+        // Note: `frem` has the semantics of `fmod`
+        value = x && m ? std::optional<double>(std::fmod(*x, *m)) : std::nullopt;
+    }
+
+    void FoldVisitor::visit(expressions::Summation &node) {
+        fold(node.lhs);
+        auto lhs = value;
+        fold(node.rhs);
+        auto rhs = value;
+
+        if (lhs && rhs) {
+            value = *lhs + *rhs;
+        } else if (rhs && *rhs == 0.0 && std::signbit(*rhs)) {
+            forward_to(node.lhs);
+        } else if (lhs && *lhs == 0.0 && std::signbit(*lhs)) {
+            forward_to(node.rhs);
+        } else {
+            value.reset();
+        }
+    }
+
+    void FoldVisitor::visit(expressions::Subtraction &node) {
+        fold(node.lhs);
+        auto lhs = value;
+        fold(node.rhs);
+        auto rhs = value;
+
+        if (lhs && rhs) {
+            value = *lhs - *rhs;
+        } else if (rhs && *rhs == 0.0 && !std::signbit(*rhs)) {
+            forward_to(node.lhs);
+        } else {
+            value.reset();
+        }
+    }
+
+    void FoldVisitor::visit(expressions::Multiplication &node) {
+        fold(node.lhs);
+        auto lhs = value;
+        fold(node.rhs);
+        auto rhs = value;
+
+        if (lhs && rhs) {
+            value = *lhs * *rhs;
+        } else if (rhs && *rhs == 1.0) {
+            forward_to(node.lhs);
+        } else if (lhs && *lhs == 1.0) {
+            forward_to(node.rhs);
+        } else {
+            value.reset();
+        }
+    }
+
+    void FoldVisitor::visit(expressions::Division &node) {
+        fold(node.lhs);
+        auto lhs = value;
+        fold(node.rhs);
+        auto rhs = value;
+
+        if (lhs && rhs) {
+            value = *lhs / *rhs;
+        } else if (rhs && *rhs == 1.0) {
+            forward_to(node.lhs);
+        } else {
+            value.reset();
+        }
+    }
+
+    void FoldVisitor::visit(expressions::NumericNegation &node) {
+        fold(node.x);
+
+        if (value) {
+            value = -*value;
+        } else if (auto inner = dynamic_cast<expressions::NumericNegation *>(node.x.get())) {
+            forward_to(inner->x);
+        }
+    }
+
+    void FoldVisitor::visit(expressions::IdentifierExpression &) {
+        value.reset();
+    }
+
+    void FoldVisitor::visit(expressions::Parenthesised &node) {
+        fold(node.expression);
+
+        // Note: a constant inner expression keeps its value, so the parentheses get replaced by a literal
+        if (!value) {
+            forward_to(node.expression);
+        }
+    }
+
+    void FoldVisitor::visit(expressions::FunctionCall &node) {
+        for (auto &argument : node.arguments) {
+            fold(argument);
+        }
+        value.reset();
+    }
+
+    void FoldVisitor::visit(expressions::LiteralDouble &node) {
+        value = node.value;
+    }
+
+    void FoldVisitor::visit(statements::Assignment &node) {
+        fold(node.value);
+    }
+
+    void FoldVisitor::visit(statements::Discard &node) {
+        fold(node.expression);
+    }
+
+    void FoldVisitor::visit(statements::Return &node) {
+        fold(node.expression);
+    }
+
+    void FoldVisitor::visit(definitions::Function &node) {
+        for (auto &statement : node.body) {
+            statement->accept(*this);
+        }
+    }
+
+    void FoldVisitor::visit(definitions::Variable &node) {
+        node.statement->accept(*this);
+    }
+
+    void FoldVisitor::visit(Program &node) {
+        for (auto &definition : node.definitions) {
+            definition->accept(*this);
+        }
+    }
+
+    void FoldVisitor::visit(Node &) {
+        // Unknown node -> leave as is
+        value.reset();
+    }
+    //--- End FoldVisitor implementation
+
+    //--- Start HashVisitor implementation
+    namespace {
+        //! Kinds of nodes, mixed into the hash before their contents
+        enum class Kind : std::uint64_t {
+            modulo, summation, subtraction, multiplication, division, negation, identifier, call, literal,
+            assignment, discard, ret, function, variable, program, unknown
+        };
+    }
+
+    void HashVisitor::mix(const void *data, std::size_t size) {
+        auto bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < size; i++) {
+            state ^= bytes[i];
+            state *= 1099511628211ull;
+        }
+    }
+
+    void HashVisitor::mix(const Identifier &identifier) {
+        // Note: symbols are interned in order of appearance, so their names are hashed rather than their indices
+        auto &name = identifier.str();
+        mix(static_cast<std::uint64_t>(name.size()));
+        mix(name.data(), name.size());
+    }
+
+    std::uint64_t HashVisitor::hash(Node &node) {
+        HashVisitor visitor;
+        node.accept(visitor);
+        return visitor.get();
+    }
+
+    void HashVisitor::visit(expressions::Modulo &node) {
+        mix(static_cast<std::uint64_t>(Kind::modulo));
+        node.x->accept(*this);
+        node.m->accept(*this);
+    }
+
+    void HashVisitor::visit(expressions::Summation &node) {
+        mix(static_cast<std::uint64_t>(Kind::summation));
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void HashVisitor::visit(expressions::Subtraction &node) {
+        mix(static_cast<std::uint64_t>(Kind::subtraction));
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void HashVisitor::visit(expressions::Multiplication &node) {
+        mix(static_cast<std::uint64_t>(Kind::multiplication));
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void HashVisitor::visit(expressions::Division &node) {
+        mix(static_cast<std::uint64_t>(Kind::division));
+        node.lhs->accept(*this);
+        node.rhs->accept(*this);
+    }
+
+    void HashVisitor::visit(expressions::NumericNegation &node) {
+        mix(static_cast<std::uint64_t>(Kind::negation));
+        node.x->accept(*this);
+    }
+
+    void HashVisitor::visit(expressions::IdentifierExpression &node) {
+        mix(static_cast<std::uint64_t>(Kind::identifier));
+        mix(node.identifier);
+    }
+
+    void HashVisitor::visit(expressions::Parenthesised &node) {
+        node.expression->accept(*this);
+    }
+
+    void HashVisitor::visit(expressions::FunctionCall &node) {
+        mix(static_cast<std::uint64_t>(Kind::call));
+        mix(node.identifier);
+        mix(static_cast<std::uint64_t>(node.arguments.size()));
+        for (auto &argument : node.arguments) {
+            argument->accept(*this);
+        }
+    }
+
+    void HashVisitor::visit(expressions::LiteralDouble &node) {
+        // Note: the bits are hashed, so that `-0.0` and `0.0` differ
+        mix(static_cast<std::uint64_t>(Kind::literal));
+        mix(&node.value, sizeof(node.value));
+    }
+
+    void HashVisitor::visit(statements::Assignment &node) {
+        mix(static_cast<std::uint64_t>(Kind::assignment));
+        mix(node.identifier);
+        node.value->accept(*this);
+    }
+
+    void HashVisitor::visit(statements::Discard &node) {
+        mix(static_cast<std::uint64_t>(Kind::discard));
+        node.expression->accept(*this);
+    }
+
+    void HashVisitor::visit(statements::Return &node) {
+        mix(static_cast<std::uint64_t>(Kind::ret));
+        node.expression->accept(*this);
+    }
+
+    void HashVisitor::visit(definitions::Function &node) {
+        mix(static_cast<std::uint64_t>(Kind::function));
+        mix(node.identifier);
+        mix(static_cast<std::uint64_t>(node.arguments.size()));
+        for (auto &argument : node.arguments) {
+            mix(argument);
+        }
+        mix(static_cast<std::uint64_t>(node.body.size()));
+        for (auto &statement : node.body) {
+            statement->accept(*this);
+        }
+    }
+
+    void HashVisitor::visit(definitions::Variable &node) {
+        mix(static_cast<std::uint64_t>(Kind::variable));
+        node.statement->accept(*this);
+    }
+
+    void HashVisitor::visit(Program &node) {
+        mix(static_cast<std::uint64_t>(Kind::program));
+        mix(static_cast<std::uint64_t>(node.definitions.size()));
+        for (auto &definition : node.definitions) {
+            definition->accept(*this);
+        }
+    }
+
+    void HashVisitor::visit(Node &) {
+        mix(static_cast<std::uint64_t>(Kind::unknown));
+    }
+    //--- End HashVisitor implementation
 }
@@ -0,0 +1,104 @@
+/** \file Cache.cpp
+ * On-disk compilation cache implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Cache.h>
+#include <basilisk/config.h>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <utility>
+
+namespace basilisk::cache {
+    namespace {
+        /**
+         * \brief Add a length-prefixed part to a digest, so that different splits of the same bytes differ
+         *
+         * \param hash Digest to update
+         * \param part Part to add
+         */
+        void update(llvm::SHA1 &hash, std::string_view part) {
+            auto size = static_cast<std::uint64_t>(part.size());
+            hash.update(llvm::StringRef(reinterpret_cast<const char *>(&size), sizeof(size)));
+            hash.update(llvm::StringRef(part.data(), part.size()));
+        }
+    }
+
+    //--- Start ObjectCache implementation
+    ObjectCache::ObjectCache(std::string directory) : directory(std::move(directory)) {
+        llvm::sys::fs::create_directories(this->directory);
+    }
+
+    std::string ObjectCache::path(const std::string &key) const {
+        llvm::SmallString<128> result(directory);
+        llvm::sys::path::append(result, key + ".o");
+        return result.str().str();
+    }
+
+    std::string ObjectCache::key(std::string_view source, std::string_view triple, std::string_view cpu,
+            std::string_view features, optimization::Level level, std::string_view kind) {
+        llvm::SHA1 hash;
+        update(hash, version_full);
+        update(hash, kind);
+        update(hash, triple);
+        update(hash, cpu);
+        update(hash, features);
+        update(hash, std::to_string(static_cast<int>(level)));
+        update(hash, source);
+        return llvm::toHex(hash.result(), true);
+    }
+
+    std::string ObjectCache::key(std::string_view data, std::string_view kind) {
+        llvm::SHA1 hash;
+        update(hash, version_full);
+        update(hash, kind);
+        update(hash, data);
+        return llvm::toHex(hash.result(), true);
+    }
+
+    std::optional<std::string> ObjectCache::get(const std::string &key) {
+        auto buffer = llvm::MemoryBuffer::getFile(path(key));
+        if (!buffer) {
+            miss_count++;
+            return std::nullopt;
+        }
+        hit_count++;
+        return (*buffer)->getBuffer().str();
+    }
+
+    bool ObjectCache::put(const std::string &key, std::string_view data) {
+        auto destination = path(key);
+
+        // Write into a temporary file next to the entry
+        int fd;
+        llvm::SmallString<128> temporary;
+        if (llvm::sys::fs::createUniqueFile(destination + "-%%%%%%.tmp", fd, temporary)) {
+            return false;
+        }
+        {
+            llvm::raw_fd_ostream stream(fd, true);
+            stream.write(data.data(), data.size());
+            stream.close();
+            if (stream.has_error()) {
+                stream.clear_error();
+                llvm::sys::fs::remove(temporary);
+                return false;
+            }
+        }
+
+        // Move the complete entry into place
+        if (llvm::sys::fs::rename(temporary, destination)) {
+            llvm::sys::fs::remove(temporary);
+            return false;
+        }
+        return true;
+    }
+    //--- End ObjectCache implementation
+}
@@ -6,8 +6,13 @@
 
 #include <basilisk/Codegen.h>
 
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Config/llvm-config.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <sstream>
 #include <vector>
 
@@ -24,10 +29,345 @@ namespace basilisk::codegen {
      */
     llvm::AllocaInst *create_entry_block_alloca(llvm::LLVMContext &context, llvm::Function *f, ast::Identifier identifier) {
         llvm::IRBuilder<> temp_builder(&f->getEntryBlock(), f->getEntryBlock().begin());
-        return temp_builder.CreateAlloca(llvm::Type::getDoubleTy(context), 0, identifier + "_ptr");
+        return temp_builder.CreateAlloca(llvm::Type::getDoubleTy(context), 0, identifier.str() + "_ptr");
+    }
+
+    /**
+     * \brief Set a list of global constructors or destructors of a module to one function
+     *
+     * \param module Module to set the list in
+     * \param list Name of the list global (`llvm.global_ctors` or `llvm.global_dtors`)
+     * \param function Function to run, with the default priority
+     */
+    void set_structor(llvm::Module *module, const std::string &list, llvm::Function *function) {
+        auto &context = module->getContext();
+
+        // Prepare type
+        auto struct_type = llvm::StructType::create(
+                list == "llvm.global_ctors" ? "global_ctors_element" : "global_dtors_element",
+                llvm::Type::getInt32Ty(context),
+                llvm::PointerType::get(llvm::FunctionType::get(llvm::Type::getVoidTy(context), false), 0),
+                llvm::Type::getInt8PtrTy(context));
+        auto type = llvm::ArrayType::get(struct_type, 1);
+
+        // Create global
+        module->getOrInsertGlobal(list, type);
+        auto list_ptr = module->getGlobalVariable(list);
+        list_ptr->setLinkage(llvm::GlobalVariable::AppendingLinkage);
+
+        // Create and set initializer
+        std::vector<llvm::Constant *> elements{
+                llvm::ConstantInt::get(llvm::Type::getInt32Ty(context), 65535),
+                function,
+                llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(context))};
+        auto strct = llvm::ConstantStruct::get(struct_type, elements);
+        list_ptr->setInitializer(llvm::ConstantArray::get(type, strct));
+    }
+
+    llvm::Function *generate_map(llvm::Function &function, const std::string &name) {
+        auto &context = function.getContext();
+        auto double_ty = llvm::Type::getDoubleTy(context);
+        auto index_ty = llvm::Type::getInt64Ty(context);
+
+        // void (double *x_1, ..., double *x_k, double *out, i64 n)
+        std::vector<llvm::Type *> arg_types(function.arg_size() + 1, llvm::Type::getDoublePtrTy(context));
+        arg_types.push_back(index_ty);
+        auto func_type = llvm::FunctionType::get(llvm::Type::getVoidTy(context), arg_types, false);
+        auto map = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, name, function.getParent());
+        auto inputs = map->arg_begin();
+        auto out = inputs + function.arg_size();
+        auto n = out + 1;
+        for (unsigned i = 0; i < function.arg_size(); i++) {
+            inputs[i].setName("x_" + std::to_string(i + 1));
+        }
+        out->setName("out");
+        n->setName("n");
+        for (auto arg = inputs; arg != n; arg++) {
+            arg->addAttr(llvm::Attribute::NoAlias);
+            arg->addAttr(llvm::Attribute::NoCapture);
+            if (arg != out) {
+                arg->addAttr(llvm::Attribute::ReadOnly);
+            }
+        }
+
+        auto entry = llvm::BasicBlock::Create(context, "entry", map);
+        auto loop = llvm::BasicBlock::Create(context, "loop", map);
+        auto exit = llvm::BasicBlock::Create(context, "exit", map);
+        llvm::IRBuilder<> builder(entry);
+        builder.CreateCondBr(builder.CreateICmpEQ(n, llvm::ConstantInt::get(index_ty, 0), "empty"), exit, loop);
+
+        // Apply the function to one element per iteration
+        builder.SetInsertPoint(loop);
+        auto index = builder.CreatePHI(index_ty, 2, "i");
+        index->addIncoming(llvm::ConstantInt::get(index_ty, 0), entry);
+        std::vector<llvm::Value *> values;
+        for (auto arg = inputs; arg != out; arg++) {
+            auto element = builder.CreateInBoundsGEP(double_ty, arg, index, "element");
+            values.push_back(builder.CreateLoad(llvm::Type::getDoubleTy(context), element, "value"));
+        }
+        auto result = builder.CreateCall(&function, values, "result");
+        result->addAttribute(llvm::AttributeList::FunctionIndex, llvm::Attribute::AlwaysInline);
+        builder.CreateStore(result, builder.CreateInBoundsGEP(double_ty, out, index, "result_element"));
+        auto next = builder.CreateAdd(index, llvm::ConstantInt::get(index_ty, 1), "next", true, true);
+        index->addIncoming(next, loop);
+        builder.CreateCondBr(builder.CreateICmpEQ(next, n, "done"), exit, loop);
+
+        builder.SetInsertPoint(exit);
+        builder.CreateRetVoid();
+
+        // Validate generated code
+        llvm::verifyFunction(*map);
+
+        return map;
+    }
+    llvm::Function *generate_memo(llvm::Function &function, unsigned bits) {
+        if (bits < 1 || bits > 32) {
+            throw CodegenException("Memoization cache of 2^" + std::to_string(bits) + " entries is not supported.");
+        }
+        auto &context = function.getContext();
+        auto module = function.getParent();
+        auto name = function.getName().str();
+        auto arity = function.arg_size();
+        auto bits_ty = llvm::Type::getInt64Ty(context);
+        auto index_ty = llvm::Type::getInt64Ty(context);
+        auto zero = llvm::ConstantInt::get(index_ty, 0);
+
+        // Move the body into the internal computing function
+        auto compute = llvm::Function::Create(function.getFunctionType(), llvm::Function::InternalLinkage,
+                name + ".compute", module);
+        compute->getBasicBlockList().splice(compute->begin(), function.getBasicBlockList());
+        for (unsigned i = 0; i < arity; i++) {
+            auto arg = function.arg_begin() + i;
+            auto compute_arg = compute->arg_begin() + i;
+            compute_arg->setName(arg->getName());
+            arg->replaceAllUsesWith(compute_arg);
+        }
+        compute->addFnAttr(llvm::Attribute::NoUnwind);
+        for (auto kind : {llvm::Attribute::ReadNone, llvm::Attribute::ReadOnly}) {
+            function.removeFnAttr(kind);
+        }
+
+        // Cache of arguments bits, results and whether each entry is used
+        auto entries = std::uint64_t(1) << bits;
+        auto keys_ty = llvm::ArrayType::get(llvm::ArrayType::get(bits_ty, arity), entries);
+        auto values_ty = llvm::ArrayType::get(llvm::Type::getDoubleTy(context), entries);
+        auto used_ty = llvm::ArrayType::get(llvm::Type::getInt8Ty(context), entries);
+        auto keys = new llvm::GlobalVariable(*module, keys_ty, false, llvm::GlobalValue::InternalLinkage,
+                llvm::ConstantAggregateZero::get(keys_ty), name + ".memo.keys");
+        auto values = new llvm::GlobalVariable(*module, values_ty, false, llvm::GlobalValue::InternalLinkage,
+                llvm::ConstantAggregateZero::get(values_ty), name + ".memo.values");
+        auto used = new llvm::GlobalVariable(*module, used_ty, false, llvm::GlobalValue::InternalLinkage,
+                llvm::ConstantAggregateZero::get(used_ty), name + ".memo.used");
+
+        auto entry = llvm::BasicBlock::Create(context, "entry", &function);
+        auto check = llvm::BasicBlock::Create(context, "check", &function);
+        auto hit = llvm::BasicBlock::Create(context, "hit", &function);
+        auto miss = llvm::BasicBlock::Create(context, "miss", &function);
+        llvm::IRBuilder<> builder(entry);
+
+        // Hash the argument bits multiplicatively, taking the top bits as the entry index
+        std::vector<llvm::Value *> arg_bits;
+        llvm::Value *hash = llvm::ConstantInt::get(bits_ty, 0);
+        for (auto &arg : function.args()) {
+            arg_bits.push_back(builder.CreateBitCast(&arg, bits_ty, arg.getName() + "_bits"));
+            hash = builder.CreateMul(builder.CreateXor(hash, arg_bits.back()),
+                    llvm::ConstantInt::get(bits_ty, 0x9E3779B97F4A7C15ull), "hash");
+        }
+        auto slot = builder.CreateLShr(hash, 64 - bits, "slot");
+        auto used_ptr = builder.CreateInBoundsGEP(used_ty, used, {zero, slot}, "used_ptr");
+        auto is_used = builder.CreateLoad(llvm::Type::getInt8Ty(context), used_ptr, "used");
+        builder.CreateCondBr(builder.CreateICmpNE(is_used, llvm::ConstantInt::get(is_used->getType(), 0)),
+                check, miss);
+
+        // Compare the stored arguments
+        builder.SetInsertPoint(check);
+        llvm::Value *match = builder.getTrue();
+        for (unsigned i = 0; i < arity; i++) {
+            auto key_ptr = builder.CreateInBoundsGEP(keys_ty, keys,
+                    {zero, slot, llvm::ConstantInt::get(index_ty, i)}, "key_ptr");
+            auto key = builder.CreateLoad(llvm::Type::getInt64Ty(context), key_ptr, "key");
+            match = builder.CreateAnd(match, builder.CreateICmpEQ(key, arg_bits[i]), "match");
+        }
+        builder.CreateCondBr(match, hit, miss);
+
+        // Return the stored result
+        builder.SetInsertPoint(hit);
+        auto value_ptr = builder.CreateInBoundsGEP(values_ty, values, {zero, slot}, "value_ptr");
+        builder.CreateRet(builder.CreateLoad(llvm::Type::getDoubleTy(context), value_ptr, "value"));
+
+        // Compute and store the result
+        builder.SetInsertPoint(miss);
+        std::vector<llvm::Value *> args;
+        for (auto &arg : function.args()) {
+            args.push_back(&arg);
+        }
+        auto result = builder.CreateCall(compute, args, "result");
+        for (unsigned i = 0; i < arity; i++) {
+            builder.CreateStore(arg_bits[i], builder.CreateInBoundsGEP(keys_ty, keys,
+                    {zero, slot, llvm::ConstantInt::get(index_ty, i)}, "key_ptr"));
+        }
+        builder.CreateStore(result, builder.CreateInBoundsGEP(values_ty, values, {zero, slot}, "value_ptr"));
+        builder.CreateStore(llvm::ConstantInt::get(is_used->getType(), 1), used_ptr);
+        builder.CreateRet(result);
+
+        // Validate generated code
+        llvm::verifyFunction(function);
+        llvm::verifyFunction(*compute);
+
+        return compute;
+    }
+
+    /**
+     * \brief Annotate a function with the attributes implied by its effects
+     *
+     * \param f Function to annotate
+     * \param identifier Identifier of the function in the program
+     * \param effects Effects of the functions, or `nullptr` if not known
+     */
+    void add_effect_attributes(llvm::Function *f, const ast::Identifier &identifier, const Effects *effects) {
+        // Basilisk has no exceptions
+        f->addFnAttr(llvm::Attribute::NoUnwind);
+        if (!effects) {
+            return;
+        }
+
+        // Note: functions writing memoization caches keep neither attribute, or inlining the caches would be undefined
+        auto found = effects->purity.find(identifier);
+        if (found != effects->purity.end() && effects->writing.count(identifier) == 0) {
+            switch (found->second) {
+                case ast::util::PurityVisitor::Purity::pure:
+                    f->addFnAttr(llvm::Attribute::ReadNone);
+                    break;
+                case ast::util::PurityVisitor::Purity::reads_globals:
+                    f->addFnAttr(llvm::Attribute::ReadOnly);
+                    break;
+                case ast::util::PurityVisitor::Purity::impure:
+                    break;
+            }
+        }
+
+#if LLVM_VERSION_MAJOR >= 10
+        if (effects->returning.count(identifier) > 0) {
+            f->addFnAttr(llvm::Attribute::WillReturn);
+        }
+#endif
+    }
+    std::string function_name(const ast::definitions::Function &node) {
+        if (node.identifier == "main" && node.arguments.empty()) {
+            return "main_";
+        }
+        return node.identifier.str();
+    }
+
+    std::vector<Prototype> prototypes(const ast::Program &program) {
+        std::vector<Prototype> result;
+        for (auto &definition : program.definitions) {
+            auto function = dynamic_cast<const ast::definitions::Function *>(definition.get());
+            if (function && function_name(*function) == function->identifier.str()) {
+                result.push_back(Prototype{function->identifier.str(), function->arguments.size()});
+            }
+        }
+        return result;
+    }
+
+    void declare_prototypes(ast::Program &program, llvm::Module &module, const std::vector<Prototype> &prototypes) {
+        if (prototypes.empty()) {
+            return;
+        }
+
+        // Find the functions the program calls and those it defines
+        ast::util::ReferenceVisitor references;
+        program.accept(references);
+        std::unordered_set<std::string> defined;
+        for (auto &prototype : codegen::prototypes(program)) {
+            defined.insert(prototype.name);
+        }
+
+        auto double_ty = llvm::Type::getDoubleTy(module.getContext());
+        for (auto &prototype : prototypes) {
+            if (references.functions.count(prototype.name) > 0 && defined.count(prototype.name) == 0
+                && !module.getFunction(prototype.name)) {
+                std::vector<llvm::Type *> arg_types(prototype.arity, double_ty);
+                llvm::Function::Create(llvm::FunctionType::get(double_ty, arg_types, false),
+                        llvm::Function::ExternalLinkage, prototype.name, &module);
+            }
+        }
+    }
+
+    llvm::Function *generate_function(ast::definitions::Function &node, llvm::LLVMContext &context,
+            llvm::IRBuilder<> &builder, llvm::Module *module, NamedValues &variables, const Effects &effects,
+            const Settings &settings, const std::unordered_set<std::string> *reserved) {
+        // Note: effects are looked up first, as `main` gets renamed during generation
+        auto found = effects.purity.find(node.identifier);
+        bool pure = found != effects.purity.end() && found->second != ast::util::PurityVisitor::Purity::impure;
+        bool memoized = settings.memoize && effects.memoized.count(node.identifier) > 0;
+
+        // Create function codegen and have it visit the function definition
+        llvm::IRBuilderBase::FastMathFlagGuard guard(builder);
+        builder.setFastMathFlags(settings.fast_math);
+        FunctionCodegen func_cg(context, builder, module, variables, &effects, settings.fold, settings.contract);
+        node.accept(func_cg);
+        auto f = func_cg.get();
+
+        // Memoize a pure function
+        if (memoized) {
+            generate_memo(*f, settings.memo_bits);
+        }
+
+        // Add the map companion of a pure function unless its name is taken
+        if (settings.map_companions && pure) {
+            auto name = node.identifier.str() + "_map";
+            if (!module->getFunction(name) && (!reserved || reserved->count(name) == 0)) {
+                generate_map(*f, name);
+            }
+        }
+
+        return f;
     }
     //--- End Helper functions
 
+    //--- Start Settings implementation
+    std::string Settings::describe() const {
+        std::ostringstream description;
+        description << "fold " << fold << " constant " << constant_globals << " map " << map_companions
+                    << " memo " << memoize << ' ' << memo_bits << " buffered " << buffered_output
+                    << " fp " << fast_math.allowReassoc() << fast_math.noNaNs() << fast_math.noInfs()
+                    << fast_math.noSignedZeros() << fast_math.allowReciprocal() << fast_math.allowContract()
+                    << fast_math.approxFunc() << " contract " << contract;
+        return description.str();
+    }
+
+    bool Settings::unsafe_fp_math() const {
+        return fast_math.allowReassoc() && fast_math.allowReciprocal() && fast_math.approxFunc()
+               && fast_math.noSignedZeros();
+    }
+    //--- End Settings implementation
+
+    //--- Start Effects implementation
+    Effects Effects::analyze(ast::Program &program, bool memoize) {
+        ast::util::PurityVisitor visitor;
+        program.accept(visitor);
+        Effects effects{visitor.get(), visitor.recursive(), visitor.calling(), visitor.returning(), {}, {}};
+        if (!memoize) {
+            return effects;
+        }
+
+        // Note: leaf functions are cheaper to compute than to look up
+        for (auto &definition : program.definitions) {
+            auto function = dynamic_cast<ast::definitions::Function *>(definition.get());
+            if (!function || function->arguments.empty() || effects.calling.count(function->identifier) == 0) {
+                continue;
+            }
+            auto found = effects.purity.find(function->identifier);
+            if (found != effects.purity.end() && found->second == ast::util::PurityVisitor::Purity::pure) {
+                effects.memoized.insert(function->identifier);
+            }
+        }
+        effects.writing = visitor.callers_of(effects.memoized);
+        return effects;
+    }
+    //--- End Effects implementation
+
     //--- Start NamedValuesStacks implementation
     void NamedValuesStacks::put(ast::Identifier identifier, llvm::Value *value) {
         // Try to find in current scope
@@ -92,13 +432,10 @@ namespace basilisk::codegen {
     llvm::Value* NamedValuesMap::get(ast::Identifier identifier) {
         // Check scopes in reverse order
         for (auto iter = scopes.rbegin(); iter != scopes.rend(); iter++) {
-            // Check identifier present
-            auto scope = *iter;
-            try {
-                return scope.at(identifier);
-            } catch (std::out_of_range &) {
-                // Ignore exception and continue to parent scope
-                continue;
+            // Check identifier present, otherwise continue to parent scope
+            auto found = iter->find(identifier);
+            if (found != iter->end()) {
+                return found->second;
             }
         }
 
@@ -120,235 +457,182 @@ namespace basilisk::codegen {
     }
     //--- End NamedValuesMap implementation
 
-    //--- Start ExpressionCodegen implementation
-    /**
-     * \brief Throw an exception on visiting an unsupported Expression node
-     *
-     * \param node Expression node
-     */
-    void ExpressionCodegen::visit(ast::Expression &/*node*/) {
-        throw CodegenException("Expression code generator encountered an unsupported Expression node.");
-    }
-
-    /**
-     * \brief Generate remainder after division of the contained expressions
-     *
-     * \param node Modulo node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Modulo &node) {
-         // Generate the values of the contained expressions
-         node.x->accept(*this);
-         llvm::Value *x = value;
-         node.m->accept(*this);
-         llvm::Value *m = value;
-
-         // Set value as division of those
-         value = builder.CreateFRem(x, m, "subtraction_tmp");
-    }
-
-    /**
-     * \brief Throw an exception on visiting an unsupported Expression1 node
-     *
-     * \param node Expression1 node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Expression1 &/*node*/) {
-        throw CodegenException("Expression code generator encountered an unsupported Expression1 node.");
-    }
-
-    /**
-     * \brief Generate sum of the contained expressions
-     *
-     * \param node Summation node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Summation &node) {
-        // Generate the values of the contained expressions
-        node.lhs->accept(*this);
-        llvm::Value *l = value;
-        node.rhs->accept(*this);
-        llvm::Value *r = value;
-
-        // Set value as division of those
-        value = builder.CreateFAdd(l, r, "sum_tmp");
-    }
-
-    /**
-     * \brief Generate difference of the contained expressions
-     *
-     * \param node Subtraction node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Subtraction &node) {
-        // Generate the values of the contained expressions
-        node.lhs->accept(*this);
-        llvm::Value *l = value;
-        node.rhs->accept(*this);
-        llvm::Value *r = value;
-
-        // Set value as division of those
-        value = builder.CreateFSub(l, r, "subtraction_tmp");
-    }
-
-    /**
-     * \brief Throw an exception on visiting an unsupported Expression2 node
-     *
-     * \param node Expression2 node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Expression2 &/*node*/) {
-        throw CodegenException("Expression code generator encountered an unsupported Expression2 node.");
-    }
-
-    /**
-     * \brief Generate multiplication of the contained expressions
-     *
-     * \param node Multiplication node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Multiplication &node) {
-        // Generate the values of the contained expressions
-        node.lhs->accept(*this);
-        llvm::Value *l = value;
-        node.rhs->accept(*this);
-        llvm::Value *r = value;
-
-        // Set value as multiplication of those
-        value = builder.CreateFMul(l, r, "multiplication_tmp");
-    }
-
-    /**
-     * \brief Generate division of the contained expressions
-     *
-     * \param node Division node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Division &node) {
-        // Generate the values of the contained expressions
-        node.lhs->accept(*this);
-        llvm::Value *l = value;
-        node.rhs->accept(*this);
-        llvm::Value *r = value;
-
-        // Set value as division of those
-        value = builder.CreateFDiv(l, r, "division_tmp");
-    }
-
-    /**
-     * \brief Throw an exception on visiting an unsupported Expression3 node
-     *
-     * \param node Expression3 node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Expression3 &/*node*/) {
-        throw CodegenException("Expression code generator encountered an unsupported Expression3 node.");
-    }
-
-    /**
-     * \brief Generate negation of the contained value
-     *
-     * \param node Numeric negation node
-     */
-    void ExpressionCodegen::visit(ast::expressions::NumericNegation &node) {
-        // Generate the value of the contained expression
-        node.x->accept(*this);
-
-        // Set value as negation of the generated one
-        value = builder.CreateFNeg(value, "numeric_negation_tmp");
-    }
+    //--- Start NamedValuesHash implementation
+    void NamedValuesHash::put(ast::Identifier identifier, llvm::Value *value) {
+        // Overwrite if already bound in the current scope
+        auto depth = marks.size();
+        auto &stack = bindings[identifier];
+        if (!stack.empty() && stack.back().first == depth) {
+            stack.back().second = value;
+            return;
+        }
 
-    /**
-     * \brief Throw an exception on visiting an unsupported Expression4 node
-     *
-     * \param node Expression4 node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Expression4 &/*node*/) {
-        throw CodegenException("Expression code generator encountered an unsupported Expression4 node.");
+        // Otherwise bind in the current scope and log it for undoing
+        stack.emplace_back(depth, value);
+        log.push_back(identifier);
     }
 
-    /**
-     * \brief Load value of variable represented by the identifier
-     *
-     * \param node Identifier expression node
-     */
-    void ExpressionCodegen::visit(ast::expressions::IdentifierExpression &node) {
-        // Look up pointer
-        llvm::Value *ptr = variables.get(node.identifier);
-
-        // Check pointer was found
-        if (!ptr) {
-            std::ostringstream message;
-            message << "Could not find pointer for identifier \"" << node.identifier << "\".";
-            throw CodegenException(message.str());
+    llvm::Value *NamedValuesHash::get(ast::Identifier identifier) {
+        // The top binding is from the top-most scope where the identifier is present
+        auto iter = bindings.find(identifier);
+        if (iter == bindings.end() || iter->second.empty()) {
+            return nullptr;
         }
-
-        // Load the value
-        llvm::Value *v = builder.CreateLoad(ptr, node.identifier + "_value");
-
-        // Set value as the found one
-        value = v;
+        return iter->second.back().second;
     }
 
-    /**
-     * \brief Generate value of the contained parenthesised expression
-     *
-     * \param node Parenthesised expression node
-     */
-    void ExpressionCodegen::visit(ast::expressions::Parenthesised &node) {
-        // Generate the value of the contained expression
-        node.expression->accept(*this);
-
-        // Note: value gets automatically set to the contained expression's value
+    void NamedValuesHash::push() {
+        // Mark the start of the new scope in the log
+        marks.push_back(log.size());
     }
 
-    /**
-     * \brief Generate value that is the result of a function call
-     *
-     * \param node Function call node
-     */
-    void ExpressionCodegen::visit(ast::expressions::FunctionCall &node) {
-        // Look up the function name
-        llvm::Function *f = module->getFunction(node.identifier);
-
-        // Check function was found
-        if (!f) {
-            std::ostringstream message;
-            message << "Could not find function for identifier \"" << node.identifier << "\".";
-            throw CodegenException(message.str());
+    void NamedValuesHash::pop() {
+        // Don't pop global scope
+        if (marks.size() <= 1) {
+            return;
         }
 
-        // Check argument sizes match
-        if (f->arg_size() != node.arguments.size()) {
-            std::ostringstream message;
-            message << "Function \"" << node.identifier << "\" given " << node.arguments.size() << " arguments, takes "
-                << f->arg_size() << ".";
-            throw CodegenException(message.str());
+        // Undo the bindings logged since the start of the scope
+        // Note: the emptied stacks are kept, as the same identifiers are usually bound again in the next scope
+        auto mark = marks.back();
+        marks.pop_back();
+        for (auto i = log.size(); i > mark; i--) {
+            bindings[log[i - 1]].pop_back();
         }
-
-        // Generate values of arguments
-        std::vector<llvm::Value *> args;
-        for (auto &expr : node.arguments) {
-            expr->accept(*this);
-            args.push_back(value);
-        }
-
-        // Set value as the function call
-        value = builder.CreateCall(f, args, "call_tmp");
+        log.resize(mark);
     }
-
-    /**
-     * \brief Generate numeric constant with the value of the double literal
-     *
-     * \param node Double literal node
-     */
-    void ExpressionCodegen::visit(ast::expressions::LiteralDouble &node) {
-        value = llvm::ConstantFP::get(context, llvm::APFloat(node.value));
+    //--- End NamedValuesHash implementation
+
+    //--- Start Expression generation implementation
+    llvm::Value *generate_expression(const flat::Buffer &buffer, std::size_t expression, llvm::LLVMContext &context,
+            llvm::IRBuilder<> &builder, llvm::Module *module, NamedValues &variables, bool contract) {
+        auto begin = buffer.begin(expression);
+        auto root = buffer.roots[expression];
+
+        // Generate the nodes in order, recording their values relative to the start of the expression
+        std::vector<llvm::Value *> values(root - begin + 1, nullptr);
+        auto operand = [&](flat::index_t i){ return values[i - begin]; };
+
+        // Fuse a product into the sum using it, negating one of its factors if it is subtracted
+        // Note: every node has one user, so the product is not used anywhere else
+        auto fuse = [&](flat::index_t product, llvm::Value *addend, bool negate) -> llvm::Value * {
+            auto multiplication = llvm::dyn_cast<llvm::BinaryOperator>(operand(product));
+            if (!contract || buffer.ops[product] != flat::Op::multiply || !multiplication) {
+                return nullptr;
+            }
+            auto x = multiplication->getOperand(0);
+            if (negate) {
+                x = builder.CreateFNeg(x, "numeric_negation_tmp");
+            }
+            // Note: the product carries the fast-math flags of the settings, which the intrinsic keeps
+            auto value = builder.CreateIntrinsic(llvm::Intrinsic::fmuladd, {x->getType()},
+                                                 {x, multiplication->getOperand(1), addend}, multiplication,
+                                                 "fmuladd_tmp");
+            multiplication->eraseFromParent();
+            return value;
+        };
+        for (auto i = begin; i <= root; i++) {
+            llvm::Value *value = nullptr;
+            switch (buffer.ops[i]) {
+                case flat::Op::literal:
+                    value = llvm::ConstantFP::get(context, llvm::APFloat(buffer.constants[buffer.lhs[i]]));
+                    break;
+                case flat::Op::identifier: {
+                    auto &identifier = buffer.identifiers[buffer.lhs[i]];
+
+                    // Look up pointer
+                    llvm::Value *ptr = variables.get(identifier);
+
+                    // Check pointer was found
+                    if (!ptr) {
+                        std::ostringstream message;
+                        message << "Could not find pointer for identifier \"" << identifier << "\".";
+                        throw CodegenException(message.str());
+                    }
+
+                    // Load the value
+                    value = builder.CreateLoad(ptr, identifier.str() + "_value");
+                    break;
+                }
+                case flat::Op::call: {
+                    auto &call = buffer.calls[buffer.lhs[i]];
+
+                    // Look up the function name
+                    llvm::Function *f = module->getFunction(call.identifier.str());
+
+                    // Check function was found
+                    if (!f) {
+                        std::ostringstream message;
+                        message << "Could not find function for identifier \"" << call.identifier << "\".";
+                        throw CodegenException(message.str());
+                    }
+
+                    // Check argument sizes match
+                    if (f->arg_size() != call.count) {
+                        std::ostringstream message;
+                        message << "Function \"" << call.identifier << "\" given " << call.count
+                                << " arguments, takes " << f->arg_size() << ".";
+                        throw CodegenException(message.str());
+                    }
+
+                    // Gather values of arguments, which precede the call
+                    std::vector<llvm::Value *> args;
+                    args.reserve(call.count);
+                    for (auto a = call.first; a < call.first + call.count; a++) {
+                        args.push_back(operand(buffer.arguments[a]));
+                    }
+
+                    value = builder.CreateCall(f, args, "call_tmp");
+                    break;
+                }
+                case flat::Op::negate:
+                    value = builder.CreateFNeg(operand(buffer.lhs[i]), "numeric_negation_tmp");
+                    break;
+                case flat::Op::add:
+                    if (!(value = fuse(buffer.lhs[i], operand(buffer.rhs[i]), false))
+                        && !(value = fuse(buffer.rhs[i], operand(buffer.lhs[i]), false))) {
+                        value = builder.CreateFAdd(operand(buffer.lhs[i]), operand(buffer.rhs[i]), "sum_tmp");
+                    }
+                    break;
+                case flat::Op::subtract:
+                    // Note: x * y - z is x * y + (-z), and z - x * y is (-x) * y + z
+                    if (auto product = llvm::dyn_cast<llvm::BinaryOperator>(operand(buffer.lhs[i]));
+                            contract && product && buffer.ops[buffer.lhs[i]] == flat::Op::multiply) {
+                        value = fuse(buffer.lhs[i], builder.CreateFNeg(operand(buffer.rhs[i]), "numeric_negation_tmp"),
+                                     false);
+                    } else if (!(value = fuse(buffer.rhs[i], operand(buffer.lhs[i]), true))) {
+                        value = builder.CreateFSub(operand(buffer.lhs[i]), operand(buffer.rhs[i]), "subtraction_tmp");
+                    }
+                    break;
+                case flat::Op::multiply:
+                    value = builder.CreateFMul(operand(buffer.lhs[i]), operand(buffer.rhs[i]), "multiplication_tmp");
+                    break;
+                case flat::Op::divide:
+                    value = builder.CreateFDiv(operand(buffer.lhs[i]), operand(buffer.rhs[i]), "division_tmp");
+                    break;
+                case flat::Op::modulo:
+                    value = builder.CreateFRem(operand(buffer.lhs[i]), operand(buffer.rhs[i]), "modulo_tmp");
+                    break;
+            }
+            values[i - begin] = value;
+        }
+        return values.back();
     }
+    //--- End Expression generation implementation
 
-    /**
-     * \brief Throw an exception on visiting an unsupported node
-     *
-     * \param node Visited node
-     */
-    void ExpressionCodegen::visit(ast::Node &/*node*/) {
-        throw CodegenException("Expression code generator encountered an unsupported node.");
+    //--- Start FunctionCodegen implementation
+    llvm::Value *FunctionCodegen::generate(ast::Expression &node) {
+        if (!current) {
+            expressions = flat::Buffer();
+            expressions.add(node);
+            if (fold) {
+                expressions.fold();
+            }
+            next = 0;
+        }
+        return generate_expression(expressions, next++, context, builder, module, variables, contract);
     }
-    //--- End ExpressionCodegen implementation
 
-    //--- Start FunctionCodegen implementation
     /**
      * \brief Throw an exception on visiting an unsupported statement node
      *
@@ -381,9 +665,7 @@ namespace basilisk::codegen {
             }
 
             // Generate value
-            ExpressionCodegen expr_cg(context, builder, module, variables);
-            node.value->accept(expr_cg);
-            llvm::Value *val = expr_cg.get();
+            llvm::Value *val = generate(*node.value);
 
             // Store value
             builder.CreateStore(val, ptr);
@@ -393,8 +675,8 @@ namespace basilisk::codegen {
             // Allocate if not found
             if (!ptr) {
                 // Create global variable initialized as 0.0
-                module->getOrInsertGlobal(node.identifier, llvm::Type::getDoubleTy(context));
-                auto var = module->getGlobalVariable(node.identifier);
+                module->getOrInsertGlobal(node.identifier.str(), llvm::Type::getDoubleTy(context));
+                auto var = module->getGlobalVariable(node.identifier.str());
                 var->setInitializer(llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), 0.0));
                 ptr = var;
 
@@ -418,9 +700,7 @@ namespace basilisk::codegen {
                 builder.SetInsertPoint(&init_f->getEntryBlock());
 
                 // Generate value
-                ExpressionCodegen expr_cg(context, builder, module, variables);
-                node.value->accept(expr_cg);
-                llvm::Value *val = expr_cg.get();
+                llvm::Value *val = generate(*node.value);
 
                 // Store value
                 builder.CreateStore(val, ptr);
@@ -438,21 +718,32 @@ namespace basilisk::codegen {
      */
     void FunctionCodegen::visit(ast::statements::Discard &node) {
         // Generate value
-        ExpressionCodegen expr_cg(context, builder, module, variables);
-        node.expression->accept(expr_cg);
-        expr_cg.get();
+        generate(*node.expression);
     }
 
     /**
      * \brief Generate return instruction
      *
+     * A returned call is marked as a tail call, which must be performed as one when the callee has the prototype of the
+     *  caller, so that recursion through it runs in constant stack space and tail recursion elimination can turn it
+     *  into a loop.
+     *
      * \param node Return statement node
      */
     void FunctionCodegen::visit(ast::statements::Return &node) {
         // Generate value
-        ExpressionCodegen expr_cg(context, builder, module, variables);
-        node.expression->accept(expr_cg);
-        llvm::Value *val = expr_cg.get();
+        llvm::Value *val = generate(*node.expression);
+
+        // Mark a returned call to a function as a tail call
+        // Note: arguments are passed by value, so no callee can refer to the frame of the caller
+        auto call = llvm::dyn_cast<llvm::CallInst>(val);
+        if (call && !llvm::isa<llvm::IntrinsicInst>(call)) {
+            auto caller = builder.GetInsertBlock()->getParent();
+            auto callee = call->getCalledFunction();
+            bool must = callee && callee->getFunctionType() == caller->getFunctionType()
+                        && callee->getCallingConv() == caller->getCallingConv();
+            call->setTailCallKind(must ? llvm::CallInst::TCK_MustTail : llvm::CallInst::TCK_Tail);
+        }
 
         // Generate instruction
         builder.CreateRet(val);
@@ -464,13 +755,14 @@ namespace basilisk::codegen {
      * \param node Function definition node
      */
     void FunctionCodegen::visit(ast::definitions::Function &node) {
+        // Note: the identifier is kept for the effects lookup, as `main` gets renamed
+        auto identifier = node.identifier;
+
         // Change main() function name to main_ to support wrapper
-        if (node.identifier == "main" && node.arguments.empty()) {
-            node.identifier = "main_";
-        }
+        node.identifier = function_name(node);
 
         // Check if already present
-        if (auto f = module->getFunction(node.identifier)) {
+        if (auto f = module->getFunction(node.identifier.str())) {
             // Check for same number of arguments
             if (f->arg_size() == node.arguments.size()) {
                 std::ostringstream message;
@@ -483,7 +775,7 @@ namespace basilisk::codegen {
         // Prepare the function pointer
         std::vector<llvm::Type *> arg_types(node.arguments.size(), llvm::Type::getDoubleTy(context));
         llvm::FunctionType *func_type = llvm::FunctionType::get(llvm::Type::getDoubleTy(context), arg_types, false);
-        llvm::Function *f = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, node.identifier, module);
+        llvm::Function *f = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, node.identifier.str(), module);
         current = f;
 
         // Add body and start inserting to it
@@ -498,7 +790,7 @@ namespace basilisk::codegen {
             auto identifier = node.arguments[i];
 
             // Name the argument
-            arg.setName(identifier);
+            arg.setName(identifier.str());
 
             // Add alloca to function entry block
             llvm::Value *ptr = create_entry_block_alloca(context, current, identifier);
@@ -513,6 +805,13 @@ namespace basilisk::codegen {
             i++;
         }
 
+        // Lower the expressions of the body, one per statement
+        expressions = flat::Buffer::lower(node);
+        if (fold) {
+            expressions.fold();
+        }
+        next = 0;
+
         // Emit body
         for (auto &stmt : node.body) {
             stmt->accept(*this);
@@ -532,6 +831,9 @@ namespace basilisk::codegen {
         // Validate generated code
         llvm::verifyFunction(*f);
 
+        // Annotate with the known effects
+        add_effect_attributes(f, identifier, effects);
+
         // Set the function to the generated one
         function = f;
         current = nullptr;
@@ -563,9 +865,24 @@ namespace basilisk::codegen {
      * \param node Function definition node
      */
     void ProgramCodegen::visit(ast::definitions::Function &node) {
-        // Create function codegen and have it visit the function definition
-        FunctionCodegen func_cg(context, builder, module, variables);
-        node.accept(func_cg);
+        if (bodies) {
+            generate_function(node, context, builder, module, variables, effects, settings);
+            return;
+        }
+
+        // Only declare the prototype, checking for redefinition as when generating the body
+        auto name = function_name(node);
+        if (auto f = module->getFunction(name)) {
+            if (f->arg_size() == node.arguments.size()) {
+                std::ostringstream message;
+                message << "Function \"" << name << "\" with " << node.arguments.size()
+                        << " arguments is already defined.";
+                throw CodegenException(message.str());
+            }
+        }
+        std::vector<llvm::Type *> arg_types(node.arguments.size(), llvm::Type::getDoubleTy(context));
+        auto func_type = llvm::FunctionType::get(llvm::Type::getDoubleTy(context), arg_types, false);
+        llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, name, module);
     }
 
     /**
@@ -574,19 +891,97 @@ namespace basilisk::codegen {
      * \param node Variable definition node
      */
     void ProgramCodegen::visit(ast::definitions::Variable &node) {
-        // Create function codegen and have it visit the assignment statement
-        FunctionCodegen func_cg(context, builder, module, variables);
-        node.statement->accept(func_cg);
+        // Initialize at compile time if the value is known
+        if (settings.constant_globals && initialize_constant(*node.statement)) {
+            return;
+        }
+
+        // Otherwise -> create function codegen and have it visit the assignment statement
+        auto &entry = module->getFunction("global_var_init")->getEntryBlock();
+        auto last = entry.empty() ? nullptr : &entry.back();
+        {
+            llvm::IRBuilderBase::FastMathFlagGuard guard(builder);
+            builder.setFastMathFlags(settings.fast_math);
+            FunctionCodegen func_cg(context, builder, module, variables, nullptr, settings.fold, settings.contract);
+            node.statement->accept(func_cg);
+        }
+
+        // The value is only known at run time, and calls that may write memory may change any other global variable
+        constants.erase(node.statement->identifier);
+        for (auto i = last ? std::next(last->getIterator()) : entry.begin(); i != entry.end(); i++) {
+            if (llvm::isa<llvm::CallInst>(*i) && i->mayWriteToMemory()) {
+                constants.clear();
+                break;
+            }
+        }
     }
 
-    /**
-     * \brief Generate LLVM IR definitions for the STL function `println` and the supporting external function `printf`
-     *
-     * \param context LLVM context
-     * \param module LLVM module
-     * \param builder IR builder
-     */
-    void generate_stl(llvm::LLVMContext &context, llvm::Module *module, llvm::IRBuilder<> &builder) {
+    bool ProgramCodegen::initialize_constant(ast::statements::Assignment &node) {
+        // Lower the value, replacing the global variables of known values by literals
+        flat::Buffer buffer;
+        auto root = buffer.roots[buffer.add(*node.value)];
+        for (flat::index_t i = 0; i < buffer.size(); i++) {
+            if (buffer.ops[i] == flat::Op::call) {
+                return false;
+            }
+            if (buffer.ops[i] == flat::Op::identifier) {
+                auto found = constants.find(buffer.identifiers[buffer.lhs[i]]);
+                if (found == constants.end()) {
+                    return false;
+                }
+                buffer.ops[i] = flat::Op::literal;
+                buffer.lhs[i] = static_cast<flat::index_t>(buffer.constants.size());
+                buffer.constants.push_back(found->second);
+            }
+        }
+
+        // Fold it into a single literal
+        // Note: a lone literal is not replaced by folding
+        if (buffer.ops[root] != flat::Op::literal) {
+            buffer.fold();
+            root = buffer.roots.front();
+        }
+        auto value = buffer.constants[buffer.lhs[root]];
+        auto constant = llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), value);
+        constants[node.identifier] = value;
+
+        // Define a new global variable with the value as its initializer
+        auto ptr = variables.get(node.identifier);
+        if (!ptr) {
+            auto var = new llvm::GlobalVariable(*module, llvm::Type::getDoubleTy(context), false,
+                                                llvm::GlobalValue::ExternalLinkage, constant, node.identifier.str());
+            variables.put(node.identifier, var);
+            initialized.push_back(var);
+            return true;
+        }
+
+        // Replace the initializer of a redefined one unless the initializer may have read it
+        auto &entry = module->getFunction("global_var_init")->getEntryBlock();
+        auto var = llvm::dyn_cast<llvm::GlobalVariable>(ptr);
+        if (var && entry.empty()) {
+            var->setInitializer(constant);
+            return true;
+        }
+
+        // Otherwise -> store it in the initializer
+        builder.SetInsertPoint(&entry);
+        builder.CreateStore(constant, ptr);
+        builder.ClearInsertionPoint();
+        return true;
+    }
+
+    void generate_stl(llvm::LLVMContext &context, llvm::Module *module, llvm::IRBuilder<> &builder,
+            const Settings &settings) {
+        // Add external runtime output function
+        llvm::Function *runtime_println = nullptr;
+        if (settings.buffered_output) {
+            // void basilisk_println(double)
+            std::vector<llvm::Type *> arg_types{llvm::Type::getDoubleTy(context)};
+            auto *func_type = llvm::FunctionType::get(llvm::Type::getVoidTy(context), arg_types, false);
+            runtime_println = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "basilisk_println",
+                    module);
+        }
+
         // Add external printf
         llvm::Function *printf;
         {
@@ -612,23 +1007,28 @@ namespace basilisk::codegen {
             // Start inserting into the body
             builder.SetInsertPoint(body);
 
-            // Check printf was found
-            if (!printf) {
-                std::ostringstream message;
-                message << "Could not find STL function \'printf\'.";
-                throw CodegenException(message.str());
-            }
+            if (runtime_println) {
+                // Emit runtime call, which only buffers the output
+                builder.CreateCall(runtime_println, {println->arg_begin()});
+            } else {
+                // Check printf was found
+                if (!printf) {
+                    std::ostringstream message;
+                    message << "Could not find STL function \'printf\'.";
+                    throw CodegenException(message.str());
+                }
 
-            // Generate pointer to format string
-            auto format_ptr = builder.CreateGlobalStringPtr("%f\n", "println_format");
+                // Generate pointer to format string
+                auto format_ptr = builder.CreateGlobalStringPtr("%f\n", "println_format");
 
-            // Put arguments into vector
-            std::vector<llvm::Value *> args;
-            args.push_back(format_ptr);
-            args.push_back(println->arg_begin());
+                // Put arguments into vector
+                std::vector<llvm::Value *> args;
+                args.push_back(format_ptr);
+                args.push_back(println->arg_begin());
 
-            // Emit function call
-            builder.CreateCall(printf, args, "printf_tmp");
+                // Emit function call
+                builder.CreateCall(printf, args, "printf_tmp");
+            }
 
             // Return 0
             llvm::Value *ret_val = llvm::ConstantFP::get(context, llvm::APFloat(0.0));
@@ -648,8 +1048,29 @@ namespace basilisk::codegen {
      * \param node Program node
      */
     void ProgramCodegen::visit(ast::Program &node) {
+        bodies = true;
+        generate(node);
+    }
+
+    void ProgramCodegen::declare(ast::Program &node) {
+        bodies = false;
+        generate(node);
+        bodies = true;
+    }
+
+    /**
+     * \brief Generate code for definitions in a program
+     *
+     * \param node Program node
+     */
+    void ProgramCodegen::generate(ast::Program &node) {
+        // Analyze the effects of the functions
+        effects = Effects::analyze(node, settings.memoize);
+        constants.clear();
+        initialized.clear();
+
         // Add standard library definitions
-        generate_stl(context, module, builder);
+        generate_stl(context, module, builder, settings);
 
         // Add global variable initializer function
         llvm::Function *init_f;
@@ -666,29 +1087,15 @@ namespace basilisk::codegen {
             llvm::verifyFunction(*init_f);
 
             // Set as global constructor
-            {
-                // Prepare type
-                auto struct_type = llvm::StructType::create(
-                        "global_ctors_element",
-                        llvm::Type::getInt32Ty(context),
-                        llvm::PointerType::get(llvm::FunctionType::get(llvm::Type::getVoidTy(context), false), 0),
-                        llvm::Type::getInt8PtrTy(context));
-                auto type = llvm::ArrayType::get(struct_type, 1);
-
-                // Create global
-                module->getOrInsertGlobal("llvm.global_ctors", type);
-                auto ctors_ptr = module->getGlobalVariable("llvm.global_ctors");
-                ctors_ptr->setLinkage(llvm::GlobalVariable::AppendingLinkage);
-
-                // Create and set initializer
-                std::vector<llvm::Constant *> elements{
-                        llvm::ConstantInt::get(llvm::Type::getInt32Ty(context), 65535),
-                        init_f,
-                        llvm::ConstantPointerNull::get(llvm::Type::getInt8PtrTy(context))};
-                auto strct = llvm::ConstantStruct::get(struct_type, elements);
-                auto ctors_val = llvm::ConstantArray::get(type, strct);
-                ctors_ptr->setInitializer(ctors_val);
-            }
+            set_structor(module, "llvm.global_ctors", init_f);
+        }
+
+        // Flush the buffered output at exit
+        if (settings.buffered_output) {
+            // void basilisk_flush()
+            auto func_type = llvm::FunctionType::get(llvm::Type::getVoidTy(context), false);
+            auto flush = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "basilisk_flush", module);
+            set_structor(module, "llvm.global_dtors", flush);
         }
 
         // Visit definitions in the program in order
@@ -703,6 +1110,17 @@ namespace basilisk::codegen {
             builder.ClearInsertionPoint();
         }
 
+        // Make the global variables initialized at compile time constant when nothing assigns them
+        // Note: without the bodies, functions defined elsewhere may assign them
+        if (bodies) {
+            for (auto var : initialized) {
+                auto stored = std::any_of(var->user_begin(), var->user_end(), [](llvm::User *user){
+                    return llvm::isa<llvm::StoreInst>(user);
+                });
+                var->setConstant(!stored);
+            }
+        }
+
         // Insert main wrapper
         if (auto main = module->getFunction("main_")) {
             // Define new main that calls the renamed one
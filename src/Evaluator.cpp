@@ -0,0 +1,136 @@
+/** \file Evaluator.cpp
+ * Embeddable evaluation implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Evaluator.h>
+#include <basilisk/Parser.h>
+#include <basilisk/Codegen.h>
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Verifier.h>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace basilisk::evaluator {
+    namespace {
+        /**
+         * \brief Check whether a function can be evaluated, taking and returning only doubles
+         *
+         * \param function Function to check
+         * \return `true` if the function is an external definition over doubles, `false` otherwise
+         */
+        bool is_evaluable(const llvm::Function &function) {
+            if (function.isDeclaration() || !function.hasExternalLinkage()
+                || !function.getReturnType()->isDoubleTy()) {
+                return false;
+            }
+            return std::all_of(function.arg_begin(), function.arg_end(),
+                    [](const llvm::Argument &arg){ return arg.getType()->isDoubleTy(); });
+        }
+
+        /**
+         * \brief Generate the batch form of a function (\ref batch_t)
+         *
+         * The batch form passes the columns to a map of the function (see \ref codegen::generate_map), which gets
+         *  inlined into it.
+         *
+         * \param function Function to generate the batch form of
+         */
+        void generate_batch(llvm::Function &function) {
+            auto &context = function.getContext();
+            auto name = function.getName().str();
+            auto size_ty = llvm::Type::getIntNTy(context, sizeof(std::size_t) * 8);
+
+            // Internal map of the function
+            auto map = codegen::generate_map(function, name + ".map");
+            map->setLinkage(llvm::GlobalValue::InternalLinkage);
+
+            // void (double **args, double *out, size n)
+            std::vector<llvm::Type *> arg_types{
+                    llvm::PointerType::get(llvm::Type::getDoublePtrTy(context), 0),
+                    llvm::Type::getDoublePtrTy(context),
+                    size_ty};
+            auto func_type = llvm::FunctionType::get(llvm::Type::getVoidTy(context), arg_types, false);
+            auto batch = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage,
+                    name + Evaluator::batch_suffix, function.getParent());
+            auto args = batch->arg_begin();
+            auto out = args + 1;
+            auto n = args + 2;
+            args->addAttr(llvm::Attribute::NoCapture);
+            args->addAttr(llvm::Attribute::ReadOnly);
+
+            // Load the input columns and pass them on to the map
+            llvm::IRBuilder<> builder(llvm::BasicBlock::Create(context, "entry", batch));
+            std::vector<llvm::Value *> values;
+            for (unsigned i = 0; i < function.arg_size(); i++) {
+                auto slot = builder.CreateInBoundsGEP(llvm::Type::getDoublePtrTy(context), args,
+                        llvm::ConstantInt::get(size_ty, i), "column_slot");
+                values.push_back(builder.CreateLoad(llvm::Type::getDoublePtrTy(context), slot, "column"));
+            }
+            values.push_back(out);
+            values.push_back(builder.CreateZExtOrTrunc(n, llvm::Type::getInt64Ty(context), "count"));
+            builder.CreateCall(map, values);
+            builder.CreateRetVoid();
+
+            // Validate generated code
+            llvm::verifyFunction(*batch);
+        }
+    }
+
+    //--- Start Evaluator implementation
+    Evaluator::Evaluator(std::string_view source, optimization::Level level)
+            : engine(optimization::codegen_level(level)) {
+        // Parse, lexing as the parser consumes the tokens
+        auto program = parser::parse(source);
+
+        // Generate LLVM IR
+        auto context = std::make_unique<llvm::LLVMContext>();
+        auto module = std::make_unique<llvm::Module>("evaluator", *context);
+        {
+            llvm::IRBuilder<> builder(*context);
+            codegen::NamedValuesHash variables;
+            codegen::ProgramCodegen program_cg(*context, builder, module.get(), variables);
+            program.accept(program_cg);
+        }
+
+        // Add the batch forms of the evaluable functions
+        std::vector<llvm::Function *> functions;
+        for (auto &function : *module) {
+            if (is_evaluable(function)) {
+                functions.push_back(&function);
+            }
+        }
+        for (auto function : functions) {
+            arities.emplace(function->getName().str(), function->arg_size());
+            generate_batch(*function);
+        }
+
+        // Optimize for the host and add to the engine
+        module->setDataLayout(engine.data_layout());
+        module->setTargetTriple(engine.host_machine().getTargetTriple().str());
+        optimization::optimize(*module, level, &engine.host_machine());
+        engine.add(std::move(context), std::move(module));
+        engine.initialize();
+    }
+
+    std::size_t Evaluator::arity(const std::string &name) const {
+        auto found = arities.find(name);
+        if (found == arities.end()) {
+            throw EvaluatorException("Function " + name + " is not defined.");
+        }
+        return found->second;
+    }
+
+    batch_t Evaluator::batch(const std::string &name) {
+        // Check the function is defined
+        arity(name);
+
+        return reinterpret_cast<batch_t>(engine.lookup(name + batch_suffix));
+    }
+    //--- End Evaluator implementation
+}
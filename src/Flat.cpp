@@ -0,0 +1,306 @@
+/** \file Flat.cpp
+ * Flat expression representation implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Flat.h>
+
+#include <cmath>
+#include <optional>
+
+namespace basilisk::flat {
+    namespace {
+        /** \class Lowering
+         * \brief Lowering of expressions into a buffer, appending their nodes in post-order
+         */
+        class Lowering : public ast::Visitor {
+            private:
+                //! Buffer to append to
+                Buffer &buffer;
+
+                //! Append a node and return its index
+                index_t emit(Op op, index_t lhs, index_t rhs = 0) {
+                    buffer.ops.push_back(op);
+                    buffer.lhs.push_back(lhs);
+                    buffer.rhs.push_back(rhs);
+                    return last = static_cast<index_t>(buffer.ops.size() - 1);
+                }
+
+                //! Lower both sides of a binary operation and then the operation
+                void binary(ast::Node &lhs, ast::Node &rhs, Op op) {
+                    lhs.accept(*this);
+                    auto l = last;
+                    rhs.accept(*this);
+                    emit(op, l, last);
+                }
+            public:
+                //! Index of the last node appended
+                index_t last = 0;
+
+                //! Construct a lowering appending to a buffer
+                explicit Lowering(Buffer &buffer) : buffer(buffer) {}
+
+                void visit(ast::expressions::Modulo &node) override { binary(*node.x, *node.m, Op::modulo); }
+                void visit(ast::expressions::Summation &node) override { binary(*node.lhs, *node.rhs, Op::add); }
+                void visit(ast::expressions::Subtraction &node) override {
+                    binary(*node.lhs, *node.rhs, Op::subtract);
+                }
+                void visit(ast::expressions::Multiplication &node) override {
+                    binary(*node.lhs, *node.rhs, Op::multiply);
+                }
+                void visit(ast::expressions::Division &node) override { binary(*node.lhs, *node.rhs, Op::divide); }
+
+                void visit(ast::expressions::NumericNegation &node) override {
+                    node.x->accept(*this);
+                    emit(Op::negate, last);
+                }
+
+                void visit(ast::expressions::Parenthesised &node) override {
+                    // Note: the contained expression takes the place of the parentheses
+                    node.expression->accept(*this);
+                }
+
+                void visit(ast::expressions::LiteralDouble &node) override {
+                    emit(Op::literal, static_cast<index_t>(buffer.constants.size()));
+                    buffer.constants.push_back(node.value);
+                }
+
+                void visit(ast::expressions::IdentifierExpression &node) override {
+                    emit(Op::identifier, static_cast<index_t>(buffer.identifiers.size()));
+                    buffer.identifiers.push_back(node.identifier);
+                }
+
+                void visit(ast::expressions::FunctionCall &node) override {
+                    // Note: arguments are lowered before their positions are recorded, as they may contain calls
+                    std::vector<index_t> arguments;
+                    arguments.reserve(node.arguments.size());
+                    for (auto &argument : node.arguments) {
+                        argument->accept(*this);
+                        arguments.push_back(last);
+                    }
+
+                    Call call{node.identifier, static_cast<index_t>(buffer.arguments.size()),
+                              static_cast<index_t>(arguments.size())};
+                    buffer.arguments.insert(buffer.arguments.end(), arguments.begin(), arguments.end());
+                    emit(Op::call, static_cast<index_t>(buffer.calls.size()));
+                    buffer.calls.push_back(call);
+                }
+
+                void visit(ast::statements::Assignment &node) override { buffer.add(*node.value); }
+                void visit(ast::statements::Discard &node) override { buffer.add(*node.expression); }
+                void visit(ast::statements::Return &node) override { buffer.add(*node.expression); }
+
+                void visit(ast::Node &) override {
+                    throw FlatException("Lowering encountered an unsupported node.");
+                }
+        };
+    }
+
+    //--- Start Buffer implementation
+    Buffer Buffer::lower(ast::definitions::Function &node) {
+        Buffer buffer;
+        Lowering lowering(buffer);
+        for (auto &statement : node.body) {
+            statement->accept(lowering);
+        }
+        return buffer;
+    }
+
+    std::size_t Buffer::add(ast::Expression &node) {
+        Lowering lowering(*this);
+        node.accept(lowering);
+        roots.push_back(lowering.last);
+        return roots.size() - 1;
+    }
+
+    std::size_t Buffer::fold() {
+        std::size_t replaced = 0;
+
+        // Fold in order, with every node forwarding to the node that takes its place
+        // Note: operands precede their nodes, so they are already folded and can be forwarded immediately
+        std::vector<index_t> forward(size());
+        auto value = [this](index_t i) -> std::optional<double> {
+            return ops[i] == Op::literal ? std::optional<double>(constants[lhs[i]]) : std::nullopt;
+        };
+        auto make_literal = [this, &replaced](index_t i, double v) {
+            ops[i] = Op::literal;
+            lhs[i] = static_cast<index_t>(constants.size());
+            constants.push_back(v);
+            replaced++;
+        };
+        auto forward_to = [&forward, &replaced](index_t i, index_t to) {
+            forward[i] = to;
+            replaced++;
+        };
+        for (index_t i = 0; i < size(); i++) {
+            forward[i] = i;
+            switch (ops[i]) {
+                case Op::literal:
+                case Op::identifier:
+                    break;
+                case Op::call: {
+                    auto &call = calls[lhs[i]];
+                    for (auto a = call.first; a < call.first + call.count; a++) {
+                        arguments[a] = forward[arguments[a]];
+                    }
+                    break;
+                }
+                case Op::negate: {
+                    lhs[i] = forward[lhs[i]];
+                    if (auto x = value(lhs[i])) {
+                        make_literal(i, -*x);
+                    } else if (ops[lhs[i]] == Op::negate) {
+                        forward_to(i, lhs[lhs[i]]);
+                    }
+                    break;
+                }
+                default: {
+                    lhs[i] = forward[lhs[i]];
+                    rhs[i] = forward[rhs[i]];
+                    auto l = value(lhs[i]);
+                    auto r = value(rhs[i]);
+                    switch (ops[i]) {
+                        case Op::add:
+                            if (l && r) {
+                                make_literal(i, *l + *r);
+                            } else if (r && *r == 0.0 && std::signbit(*r)) {
+                                forward_to(i, lhs[i]);
+                            } else if (l && *l == 0.0 && std::signbit(*l)) {
+                                forward_to(i, rhs[i]);
+                            }
+                            break;
+                        case Op::subtract:
+                            if (l && r) {
+                                make_literal(i, *l - *r);
+                            } else if (r && *r == 0.0 && !std::signbit(*r)) {
+                                forward_to(i, lhs[i]);
+                            }
+                            break;
+                        case Op::multiply:
+                            if (l && r) {
+                                make_literal(i, *l * *r);
+                            } else if (r && *r == 1.0) {
+                                forward_to(i, lhs[i]);
+                            } else if (l && *l == 1.0) {
+                                forward_to(i, rhs[i]);
+                            }
+                            break;
+                        case Op::divide:
+                            if (l && r) {
+                                make_literal(i, *l / *r);
+                            } else if (r && *r == 1.0) {
+                                forward_to(i, lhs[i]);
+                            }
+                            break;
+                        default:
+                            // Note: `frem` has the semantics of `fmod`
+                            if (l && r) {
+                                make_literal(i, std::fmod(*l, *r));
+                            }
+                            break;
+                    }
+                    break;
+                }
+            }
+        }
+        for (auto &root : roots) {
+            root = forward[root];
+        }
+        if (replaced == 0) {
+            return 0;
+        }
+
+        // Mark the nodes still reachable from the roots
+        std::vector<bool> live(size(), false);
+        for (auto root : roots) {
+            live[root] = true;
+        }
+        for (auto i = size(); i-- > 0;) {
+            if (!live[i]) {
+                continue;
+            }
+            switch (ops[i]) {
+                case Op::literal:
+                case Op::identifier:
+                    break;
+                case Op::call: {
+                    auto &call = calls[lhs[i]];
+                    for (auto a = call.first; a < call.first + call.count; a++) {
+                        live[arguments[a]] = true;
+                    }
+                    break;
+                }
+                case Op::negate:
+                    live[lhs[i]] = true;
+                    break;
+                default:
+                    live[lhs[i]] = true;
+                    live[rhs[i]] = true;
+                    break;
+            }
+        }
+
+        // Compact them in place and in order, which keeps every expression in its own range
+        // Note: every folded literal replaces at least one literal before it, so the compacted constants never overtake
+        //  the ones still to be read
+        auto &position = forward;
+        index_t nodes = 0;
+        index_t literals = 0;
+        index_t names = 0;
+        index_t call_count = 0;
+        index_t argument_count = 0;
+        for (index_t i = 0; i < size(); i++) {
+            if (!live[i]) {
+                continue;
+            }
+            index_t l = 0;
+            index_t r = 0;
+            switch (ops[i]) {
+                case Op::literal:
+                    constants[literals] = constants[lhs[i]];
+                    l = literals++;
+                    break;
+                case Op::identifier:
+                    identifiers[names] = identifiers[lhs[i]];
+                    l = names++;
+                    break;
+                case Op::call: {
+                    auto call = calls[lhs[i]];
+                    for (index_t a = 0; a < call.count; a++) {
+                        arguments[argument_count + a] = position[arguments[call.first + a]];
+                    }
+                    call.first = argument_count;
+                    argument_count += call.count;
+                    calls[call_count] = call;
+                    l = call_count++;
+                    break;
+                }
+                case Op::negate:
+                    l = position[lhs[i]];
+                    break;
+                default:
+                    l = position[lhs[i]];
+                    r = position[rhs[i]];
+                    break;
+            }
+            ops[nodes] = ops[i];
+            lhs[nodes] = l;
+            rhs[nodes] = r;
+            position[i] = nodes++;
+        }
+        for (auto &root : roots) {
+            root = position[root];
+        }
+        ops.resize(nodes);
+        lhs.resize(nodes);
+        rhs.resize(nodes);
+        constants.resize(literals);
+        identifiers.resize(names);
+        calls.resize(call_count);
+        arguments.resize(argument_count);
+
+        return replaced;
+    }
+    //--- End Buffer implementation
+}
@@ -0,0 +1,514 @@
+/** \file Interpreter.cpp
+ * Bytecode interpreter implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Interpreter.h>
+#include <basilisk/AST_util.h>
+#include <basilisk/Codegen.h>
+#include <basilisk/JIT.h>
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Verifier.h>
+
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <utility>
+
+namespace basilisk::interpreter {
+    namespace {
+        //! Functions of the standard library by name, with their numbers of arguments
+        const std::unordered_map<std::string, std::size_t> builtins{{"println", 1}, {"printf", 1}};
+
+        /** \class Compiler
+         * \brief Compiler of a program into bytecode
+         *
+         * Resolves functions and variables the same way the code generator does, in order of definition.
+         */
+        class Compiler : public ast::Visitor {
+            private:
+                //! Compiled functions
+                std::vector<Function> &functions;
+                //! Initializer of the global variables
+                Function &initializer;
+                //! Indices of the functions that calls resolve to by name
+                std::unordered_map<std::string, std::size_t> &names;
+                //! Constants of all of the functions
+                std::vector<double> &constants;
+                //! Values of the global variables
+                std::vector<double> &globals;
+                //! Purity of the functions
+                const ast::util::PurityVisitor::result_t &purity;
+
+                //! Indices of the global variables defined so far
+                std::unordered_map<ast::Identifier, std::uint32_t> global_indices;
+                //! Slots of the local variables of the function being compiled
+                std::unordered_map<ast::Identifier, std::uint32_t> locals;
+                //! Function being compiled into
+                Function *current = nullptr;
+
+                //! Append an instruction to the function being compiled
+                void emit(Op op, std::uint32_t operand = 0) { current->code.push_back(Instruction{op, operand}); }
+
+                //! Compile both sides of a binary operation and then the operation
+                void binary(ast::Node &lhs, ast::Node &rhs, Op op) {
+                    lhs.accept(*this);
+                    rhs.accept(*this);
+                    emit(op);
+                }
+
+                //! Find the slot of a local variable, or the index of a global one, as the code generator would
+                bool find(const ast::Identifier &identifier, bool &local, std::uint32_t &index) const {
+                    if (current != &initializer) {
+                        auto found = locals.find(identifier);
+                        if (found != locals.end()) {
+                            local = true;
+                            index = found->second;
+                            return true;
+                        }
+                    }
+                    auto found = global_indices.find(identifier);
+                    if (found != global_indices.end()) {
+                        local = false;
+                        index = found->second;
+                        return true;
+                    }
+                    return false;
+                }
+
+            public:
+                /**
+                 * \brief Construct a compiler into the tables of an interpreter
+                 *
+                 * \param functions Compiled functions
+                 * \param initializer Initializer of the global variables
+                 * \param names Indices of the functions that calls resolve to by name
+                 * \param constants Constants of all of the functions
+                 * \param globals Values of the global variables
+                 * \param purity Purity of the functions
+                 */
+                Compiler(std::vector<Function> &functions, Function &initializer,
+                        std::unordered_map<std::string, std::size_t> &names, std::vector<double> &constants,
+                        std::vector<double> &globals, const ast::util::PurityVisitor::result_t &purity)
+                        : functions(functions), initializer(initializer), names(names), constants(constants),
+                          globals(globals), purity(purity) {}
+
+                void visit(ast::expressions::Modulo &node) override { binary(*node.x, *node.m, Op::modulo); }
+                void visit(ast::expressions::Summation &node) override { binary(*node.lhs, *node.rhs, Op::add); }
+                void visit(ast::expressions::Subtraction &node) override {
+                    binary(*node.lhs, *node.rhs, Op::subtract);
+                }
+                void visit(ast::expressions::Multiplication &node) override {
+                    binary(*node.lhs, *node.rhs, Op::multiply);
+                }
+                void visit(ast::expressions::Division &node) override { binary(*node.lhs, *node.rhs, Op::divide); }
+
+                void visit(ast::expressions::NumericNegation &node) override {
+                    node.x->accept(*this);
+                    emit(Op::negate);
+                }
+
+                void visit(ast::expressions::LiteralDouble &node) override {
+                    emit(Op::constant, static_cast<std::uint32_t>(constants.size()));
+                    constants.push_back(node.value);
+                }
+
+                void visit(ast::expressions::Parenthesised &node) override { node.expression->accept(*this); }
+
+                void visit(ast::expressions::IdentifierExpression &node) override {
+                    bool local;
+                    std::uint32_t index;
+                    if (!find(node.identifier, local, index)) {
+                        std::ostringstream message;
+                        message << "Could not find pointer for identifier \"" << node.identifier << "\".";
+                        throw InterpreterException(message.str());
+                    }
+                    emit(local ? Op::load_local : Op::load_global, index);
+                }
+
+                void visit(ast::expressions::FunctionCall &node) override {
+                    // Look up the function, where the standard library comes first
+                    auto name = node.identifier.str();
+                    auto builtin = builtins.find(name);
+                    auto found = names.find(name);
+                    if (builtin == builtins.end() && found == names.end()) {
+                        std::ostringstream message;
+                        message << "Could not find function for identifier \"" << node.identifier << "\".";
+                        throw InterpreterException(message.str());
+                    }
+
+                    // Check argument sizes match
+                    auto arity = builtin != builtins.end() ? builtin->second : functions[found->second].arity;
+                    if (arity != node.arguments.size()) {
+                        std::ostringstream message;
+                        message << "Function \"" << node.identifier << "\" given " << node.arguments.size()
+                                << " arguments, takes " << arity << ".";
+                        throw InterpreterException(message.str());
+                    }
+                    if (name == "printf") {
+                        throw InterpreterException("Function \"printf\" can only be called through println.");
+                    }
+
+                    // Compile the arguments and the call
+                    for (auto &argument : node.arguments) {
+                        argument->accept(*this);
+                    }
+                    if (builtin != builtins.end()) {
+                        emit(Op::println);
+                    } else {
+                        emit(Op::call, static_cast<std::uint32_t>(found->second));
+                    }
+                }
+
+                void visit(ast::statements::Assignment &node) override {
+                    // Find the variable, or add it to the current scope before compiling the value
+                    bool local;
+                    std::uint32_t index;
+                    if (!find(node.identifier, local, index)) {
+                        local = current != &initializer;
+                        if (local) {
+                            index = static_cast<std::uint32_t>(current->locals++);
+                            locals.emplace(node.identifier, index);
+                        } else {
+                            index = static_cast<std::uint32_t>(globals.size());
+                            globals.push_back(0.0);
+                            global_indices.emplace(node.identifier, index);
+                        }
+                    }
+
+                    node.value->accept(*this);
+                    emit(local ? Op::store_local : Op::store_global, index);
+                }
+
+                void visit(ast::statements::Discard &node) override {
+                    node.expression->accept(*this);
+                    emit(Op::discard);
+                }
+
+                void visit(ast::statements::Return &node) override {
+                    node.expression->accept(*this);
+                    emit(Op::ret);
+                }
+
+                void visit(ast::definitions::Function &node) override {
+                    auto name = codegen::function_name(node);
+
+                    // Check for redefinition with the same number of arguments
+                    auto builtin = builtins.find(name);
+                    auto found = names.find(name);
+                    if ((builtin != builtins.end() && builtin->second == node.arguments.size())
+                        || (found != names.end() && functions[found->second].arity == node.arguments.size())) {
+                        std::ostringstream message;
+                        message << "Function \"" << name << "\" with " << node.arguments.size()
+                                << " arguments is already defined.";
+                        throw InterpreterException(message.str());
+                    }
+
+                    // Add the function, which can call itself, unless it shadows another one
+                    // Note: redefinitions with another number of arguments are only reachable on their own
+                    auto index = functions.size();
+                    auto &function = functions.emplace_back();
+                    function.name = name;
+                    function.arity = node.arguments.size();
+                    function.locals = node.arguments.size();
+                    function.node = &node;
+                    auto purity_found = purity.find(node.identifier);
+                    function.pure = purity_found != purity.end()
+                                    && purity_found->second == ast::util::PurityVisitor::Purity::pure;
+                    if (builtin == builtins.end() && found == names.end()) {
+                        names.emplace(name, index);
+                    }
+
+                    // Compile the body with the arguments in the first slots
+                    current = &function;
+                    locals.clear();
+                    for (std::size_t i = 0; i < node.arguments.size(); i++) {
+                        locals[node.arguments[i]] = static_cast<std::uint32_t>(i);
+                    }
+                    for (auto &statement : node.body) {
+                        statement->accept(*this);
+                    }
+
+                    // Return 0 if last statement wasn't return
+                    if (node.body.empty() || !dynamic_cast<ast::statements::Return *>(node.body.back().get())) {
+                        ast::expressions::LiteralDouble zero(0.0);
+                        zero.accept(*this);
+                        emit(Op::ret);
+                    }
+                    current = nullptr;
+                }
+
+                void visit(ast::definitions::Variable &node) override {
+                    current = &initializer;
+                    node.statement->accept(*this);
+                    current = nullptr;
+                }
+
+                void visit(ast::Program &node) override {
+                    for (auto &definition : node.definitions) {
+                        definition->accept(*this);
+                    }
+
+                    // Finish the initializer
+                    current = &initializer;
+                    ast::expressions::LiteralDouble zero(0.0);
+                    zero.accept(*this);
+                    emit(Op::ret);
+                    current = nullptr;
+                }
+
+                void visit(ast::Node &/*node*/) override {
+                    throw InterpreterException("Bytecode compiler encountered an unsupported node.");
+                }
+        };
+    }
+
+    //--- Start Interpreter implementation
+    Interpreter::Interpreter(ast::Program program, const Settings &settings)
+            : program(std::move(program)), settings(settings) {
+        // Simplify the expressions, as the code generator does
+        if (settings.fold) {
+            ast::util::FoldVisitor::fold(this->program);
+        }
+
+        // Compile into bytecode
+        auto purity = ast::util::PurityVisitor::analyze(this->program);
+        initializer.name = "global_var_init";
+        Compiler compiler(functions, initializer, names, constants, globals, purity);
+        this->program.accept(compiler);
+
+        // Initialize the global variables
+        execute(initializer);
+    }
+
+    // Note: defined here, where the engine is a complete type
+    Interpreter::~Interpreter() = default;
+
+    native_t Interpreter::count_call(std::size_t index) {
+        auto &function = functions[index];
+        if (!function.native && ++function.calls >= settings.tier_up && settings.tier_up > 0 && function.pure
+            && !function.tiered) {
+            tier_up(index);
+        }
+        return function.native;
+    }
+
+    double Interpreter::execute(Function &function) {
+        /** \struct Frame
+         * \brief Active call of a function
+         */
+        struct Frame {
+            //! Function being run
+            const Function *function;
+            //! Next instruction to run
+            const Instruction *next;
+            //! Position of the first local slot in the value stack
+            std::size_t base;
+        };
+        std::vector<Frame> frames;
+        auto enter = [&](const Function &f){
+            if (frames.size() >= settings.max_depth) {
+                throw InterpreterException("Maximum call depth of " + std::to_string(settings.max_depth)
+                                           + " exceeded.");
+            }
+            auto base = stack.size() - f.arity;
+            stack.resize(base + f.locals, 0.0);
+            frames.push_back(Frame{&f, f.code.data(), base});
+        };
+        auto pop = [this](){
+            auto value = stack.back();
+            stack.pop_back();
+            return value;
+        };
+
+        enter(function);
+        while (true) {
+            auto &frame = frames.back();
+            auto instruction = *frame.next++;
+            switch (instruction.op) {
+                case Op::constant:
+                    stack.push_back(constants[instruction.operand]);
+                    break;
+                case Op::load_local: {
+                    auto value = stack[frame.base + instruction.operand];
+                    stack.push_back(value);
+                    break;
+                }
+                case Op::store_local:
+                    stack[frame.base + instruction.operand] = pop();
+                    break;
+                case Op::load_global:
+                    stack.push_back(globals[instruction.operand]);
+                    break;
+                case Op::store_global:
+                    globals[instruction.operand] = pop();
+                    break;
+                case Op::add: {
+                    auto r = pop();
+                    stack.back() += r;
+                    break;
+                }
+                case Op::subtract: {
+                    auto r = pop();
+                    stack.back() -= r;
+                    break;
+                }
+                case Op::multiply: {
+                    auto r = pop();
+                    stack.back() *= r;
+                    break;
+                }
+                case Op::divide: {
+                    auto r = pop();
+                    stack.back() /= r;
+                    break;
+                }
+                case Op::modulo: {
+                    auto r = pop();
+                    stack.back() = std::fmod(stack.back(), r);
+                    break;
+                }
+                case Op::negate:
+                    stack.back() = -stack.back();
+                    break;
+                case Op::call: {
+                    // Note: the frame reference is invalidated by entering the callee
+                    auto &callee = functions[instruction.operand];
+                    if (auto native = count_call(instruction.operand)) {
+                        auto base = stack.size() - callee.arity;
+                        auto result = native(stack.data() + base);
+                        stack.resize(base);
+                        stack.push_back(result);
+                    } else {
+                        enter(callee);
+                    }
+                    break;
+                }
+                case Op::println:
+                    // Note: same format as the compiled println, but always written straight to the C stream, as only
+                    //  pure functions are compiled and the runtime output buffers are never used
+                    std::printf("%f\n", stack.back());
+                    stack.back() = 0.0;
+                    break;
+                case Op::discard:
+                    stack.pop_back();
+                    break;
+                case Op::ret: {
+                    auto value = pop();
+                    stack.resize(frame.base);
+                    frames.pop_back();
+                    if (frames.empty()) {
+                        return value;
+                    }
+                    stack.push_back(value);
+                    break;
+                }
+            }
+        }
+    }
+
+    void Interpreter::tier_up(std::size_t index) {
+        auto &function = functions[index];
+        function.tiered = true;
+
+        // Gather the functions it calls, which are defined before it and pure as well
+        std::vector<bool> needed(index + 1, false);
+        needed[index] = true;
+        for (auto i = index + 1; i-- > 0;) {
+            if (needed[i]) {
+                for (auto &instruction : functions[i].code) {
+                    if (instruction.op == Op::call) {
+                        needed[instruction.operand] = true;
+                    }
+                }
+            }
+        }
+
+        try {
+            if (!engine) {
+                engine = std::make_unique<jit::Engine>(optimization::codegen_level(settings.level));
+            }
+
+            // Generate the functions in order of definition, internal to their module
+            auto context = std::make_unique<llvm::LLVMContext>();
+            auto module = std::make_unique<llvm::Module>("tier." + std::to_string(compiled), *context);
+            module->setDataLayout(engine->data_layout());
+            module->setTargetTriple(engine->host_machine().getTargetTriple().str());
+            llvm::IRBuilder<> builder(*context);
+            codegen::NamedValuesHash variables;
+            llvm::Function *target = nullptr;
+            for (std::size_t i = 0; i <= index; i++) {
+                if (needed[i]) {
+                    codegen::FunctionCodegen function_cg(*context, builder, module.get(), variables);
+                    functions[i].node->accept(function_cg);
+                    target = function_cg.get();
+                    target->setLinkage(llvm::GlobalValue::InternalLinkage);
+                }
+            }
+
+            // Add the entry taking the arguments in an array
+            // double (const double *args)
+            auto double_ty = llvm::Type::getDoubleTy(*context);
+            auto func_type = llvm::FunctionType::get(double_ty, {llvm::Type::getDoublePtrTy(*context)}, false);
+            auto name = module->getName().str() + ".entry";
+            auto entry = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, name, module.get());
+            builder.SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", entry));
+            std::vector<llvm::Value *> args;
+            for (std::size_t i = 0; i < function.arity; i++) {
+                auto slot = builder.CreateInBoundsGEP(double_ty, entry->arg_begin(),
+                        llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), i), "arg_slot");
+                args.push_back(builder.CreateLoad(llvm::Type::getDoubleTy(*context), slot, "arg"));
+            }
+            builder.CreateRet(builder.CreateCall(target, args, "call_tmp"));
+            builder.ClearInsertionPoint();
+            llvm::verifyFunction(*entry);
+
+            // Optimize for the host and add to the engine
+            optimization::optimize(*module, settings.level, &engine->host_machine());
+            engine->add(std::move(context), std::move(module));
+            function.native = reinterpret_cast<native_t>(engine->lookup(name));
+            compiled++;
+        } catch (std::exception &) {
+            // Note: the function stays interpreted
+            function.native = nullptr;
+        }
+    }
+
+    double Interpreter::call(const std::string &name, const std::vector<double> &args) {
+        auto found = names.find(name);
+        if (found == names.end()) {
+            throw InterpreterException("Function " + name + " is not defined.");
+        }
+        auto index = found->second;
+        if (functions[index].arity != args.size()) {
+            throw InterpreterException("Function " + name + " takes " + std::to_string(functions[index].arity)
+                                       + " arguments.");
+        }
+
+        if (auto native = count_call(index)) {
+            return native(args.data());
+        }
+        stack.assign(args.begin(), args.end());
+        return execute(functions[index]);
+    }
+
+    int Interpreter::run() {
+        if (names.count("main_") == 0) {
+            throw InterpreterException("Program has no main function without arguments.");
+        }
+        auto result = call("main_", {});
+
+        // Flush the output of println before returning to the host
+        std::fflush(stdout);
+        return static_cast<int>(result);
+    }
+
+    const Function *Interpreter::function(const std::string &name) const {
+        auto found = names.find(name);
+        return found == names.end() ? nullptr : &functions[found->second];
+    }
+    //--- End Interpreter implementation
+}
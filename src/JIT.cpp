@@ -0,0 +1,278 @@
+/** \file JIT.cpp
+ * In-process execution implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/JIT.h>
+#include <basilisk/Runtime.h>
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+
+namespace basilisk::jit {
+    namespace {
+        // Note: a serialized object is a header line, a line per constructor and destructor, an end line and the code
+        //! Header line of a serialized object
+        constexpr std::string_view object_header = "basilisk-object 1\n";
+        //! End line of the names of a serialized object
+        constexpr std::string_view object_end = "code\n";
+        //! Number of local constructors and destructors made external so far, to give each a unique name
+        std::atomic<std::uint64_t> structors_taken{0};
+
+        /**
+         * \brief Throw a JIT exception describing an LLVM error, if it is one
+         *
+         * \param error Error to check
+         * \param what Description of the failed action
+         */
+        void check(llvm::Error error, const std::string &what) {
+            if (error) {
+                throw JITException(what + " - " + llvm::toString(std::move(error)));
+            }
+        }
+
+        /**
+         * \brief Take the value of an LLVM expected, or throw a JIT exception describing its error
+         *
+         * \param expected Expected value
+         * \param what Description of the failed action
+         * \return The value
+         */
+        template<typename T>
+        T take(llvm::Expected<T> expected, const std::string &what) {
+            check(expected.takeError(), what);
+            return std::move(*expected);
+        }
+
+        /**
+         * \brief Take the functions out of a list of global constructors or destructors, making them external
+         *
+         * The list global is erased from the module, so that only the engine runs the functions.
+         * Local functions are renamed as they are made external, so that those of different modules don't clash.
+         *
+         * \param module Module holding the list
+         * \param list Name of the list global (`llvm.global_ctors` or `llvm.global_dtors`)
+         * \param names Names to append the functions to, in priority order
+         */
+        void take_structors(llvm::Module &module, const std::string &list, std::vector<std::string> &names) {
+            auto global = module.getGlobalVariable(list);
+            if (!global) {
+                return;
+            }
+
+            // Collect the functions with their priorities
+            auto elements = list == "llvm.global_ctors" ? llvm::orc::getConstructors(module)
+                                                        : llvm::orc::getDestructors(module);
+            std::vector<std::pair<unsigned, llvm::Function *>> functions;
+            for (auto element : elements) {
+                if (element.Func) {
+                    functions.emplace_back(element.Priority, element.Func);
+                }
+            }
+            std::stable_sort(functions.begin(), functions.end(),
+                    [](auto &a, auto &b){ return a.first < b.first; });
+
+            // Make each function visible to lookup
+            for (auto &function : functions) {
+                if (function.second->hasLocalLinkage()) {
+                    function.second->setName(function.second->getName() + "." + std::to_string(structors_taken++));
+                }
+                function.second->setLinkage(llvm::GlobalValue::ExternalLinkage);
+                function.second->setVisibility(llvm::GlobalValue::DefaultVisibility);
+                names.push_back(function.second->getName().str());
+            }
+
+            global->eraseFromParent();
+        }
+    }
+
+    //--- Start Object implementation
+    std::string Object::serialize() const {
+        std::string result(object_header);
+        for (auto &name : constructors) {
+            result.append("ctor ").append(name).append("\n");
+        }
+        for (auto &name : destructors) {
+            result.append("dtor ").append(name).append("\n");
+        }
+        result.append(object_end);
+        result.append(code);
+        return result;
+    }
+
+    bool Object::deserialize(std::string_view data, Object &object) {
+        if (data.substr(0, object_header.size()) != object_header) {
+            return false;
+        }
+        data.remove_prefix(object_header.size());
+
+        Object result;
+        while (data.substr(0, object_end.size()) != object_end) {
+            // Split off the line
+            auto end = data.find('\n');
+            if (end == std::string_view::npos || end < 5) {
+                return false;
+            }
+            auto kind = data.substr(0, 5);
+            auto name = std::string(data.substr(5, end - 5));
+            data.remove_prefix(end + 1);
+
+            if (kind == "ctor ") {
+                result.constructors.push_back(std::move(name));
+            } else if (kind == "dtor ") {
+                result.destructors.push_back(std::move(name));
+            } else {
+                return false;
+            }
+        }
+        data.remove_prefix(object_end.size());
+        result.code = std::string(data);
+
+        object = std::move(result);
+        return true;
+    }
+    //--- End Object implementation
+
+    //--- Start Engine implementation
+    Engine::Engine(llvm::CodeGenOpt::Level level) {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+
+        // Target the host CPU
+        auto machine = take(llvm::orc::JITTargetMachineBuilder::detectHost(), "Failed to detect the host");
+        machine.setCPU(llvm::sys::getHostCPUName().str());
+        machine.setCodeGenOptLevel(level);
+        triple = machine.getTargetTriple().str();
+        target_machine = take(machine.createTargetMachine(), "Failed to create the target machine");
+
+        jit = take(llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(machine)).create(),
+                   "Failed to create the JIT");
+
+        // Resolve external dependencies of the STL, of buffered output and of remainders, which LLVM lowers to calls to
+        //  fmod
+        llvm::orc::MangleAndInterner mangle(jit->getExecutionSession(), jit->getDataLayout());
+        llvm::orc::SymbolMap symbols;
+        symbols[mangle("printf")] = llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&std::printf),
+                                                             llvm::JITSymbolFlags::Exported);
+        symbols[mangle("fmod")] = llvm::JITEvaluatedSymbol(
+                llvm::pointerToJITTargetAddress(static_cast<double (*)(double, double)>(&std::fmod)),
+                llvm::JITSymbolFlags::Exported);
+        symbols[mangle("basilisk_println")] = llvm::JITEvaluatedSymbol(
+                llvm::pointerToJITTargetAddress(&runtime::basilisk_println), llvm::JITSymbolFlags::Exported);
+        symbols[mangle("basilisk_flush")] = llvm::JITEvaluatedSymbol(
+                llvm::pointerToJITTargetAddress(&runtime::basilisk_flush), llvm::JITSymbolFlags::Exported);
+        check(jit->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols))),
+              "Failed to define the STL symbols");
+    }
+
+    const llvm::DataLayout &Engine::data_layout() const {
+        return jit->getDataLayout();
+    }
+
+    void Engine::add(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module) {
+        // Configure the module for the host if not yet configured
+        if (module->getDataLayout().isDefault()) {
+            module->setDataLayout(jit->getDataLayout());
+        }
+        if (module->getTargetTriple().empty()) {
+            module->setTargetTriple(triple);
+        }
+
+        // Take over the global constructors and destructors
+        take_structors(*module, "llvm.global_ctors", constructors);
+        take_structors(*module, "llvm.global_dtors", destructors);
+
+        check(jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module),
+                                                            llvm::orc::ThreadSafeContext(std::move(context)))),
+              "Failed to add module");
+    }
+
+    Object Engine::compile(llvm::Module &module) {
+        // Configure the module for the host if not yet configured
+        if (module.getDataLayout().isDefault()) {
+            module.setDataLayout(jit->getDataLayout());
+        }
+        if (module.getTargetTriple().empty()) {
+            module.setTargetTriple(triple);
+        }
+
+        // Take over the global constructors and destructors
+        Object object;
+        take_structors(module, "llvm.global_ctors", object.constructors);
+        take_structors(module, "llvm.global_dtors", object.destructors);
+
+        // Emit object code
+        llvm::SmallString<0> code;
+        llvm::raw_svector_ostream stream(code);
+        llvm::legacy::PassManager pass;
+        if (target_machine->addPassesToEmitFile(pass, stream, nullptr, llvm::TargetMachine::CGFT_ObjectFile)) {
+            throw JITException("Target machine can't emit object code");
+        }
+        pass.run(module);
+        object.code = code.str().str();
+
+        return object;
+    }
+
+    void Engine::add(Object object) {
+        check(jit->addObjectFile(llvm::MemoryBuffer::getMemBufferCopy(object.code, "basilisk-object")),
+              "Failed to add object");
+        constructors.insert(constructors.end(), object.constructors.begin(), object.constructors.end());
+        destructors.insert(destructors.end(), object.destructors.begin(), object.destructors.end());
+    }
+
+    void *Engine::lookup(const std::string &name) {
+        auto symbol = take(jit->lookup(name), "Failed to look up symbol " + name);
+        return reinterpret_cast<void *>(static_cast<std::uintptr_t>(symbol.getAddress()));
+    }
+
+    void Engine::initialize() {
+        auto pending = std::move(constructors);
+        constructors.clear();
+        for (auto &name : pending) {
+            reinterpret_cast<void (*)()>(lookup(name))();
+        }
+    }
+
+    void Engine::finalize() {
+        auto pending = std::move(destructors);
+        destructors.clear();
+        for (auto &name : pending) {
+            reinterpret_cast<void (*)()>(lookup(name))();
+        }
+    }
+
+    int Engine::run() {
+        auto main = reinterpret_cast<int (*)()>(lookup("main"));
+        initialize();
+        int result = main();
+        finalize();
+
+        // Flush the output of println before returning to the host
+        std::fflush(stdout);
+        return result;
+    }
+    //--- End Engine implementation
+
+    int run(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module,
+            llvm::CodeGenOpt::Level level) {
+        Engine engine(level);
+        engine.add(std::move(context), std::move(module));
+        return engine.run();
+    }
+}
@@ -8,9 +8,15 @@
 #include <basilisk/Tokens.h>
 
 #include <sstream>
-#include <algorithm>
-#include <cctype>
 #include <string>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace basilisk::lexer {
     //! Symbols that translate directly to tokens
@@ -23,163 +29,458 @@ namespace basilisk::lexer {
     //! End of file character
     constexpr char end_of_file = std::char_traits<char>::eof();
 
-    // Character classification helpers
+    // Character classification
+    //! Character class flags
+    namespace classes {
+        constexpr std::uint8_t end = 1u << 0u;          //!< End of input (null or end of file)
+        constexpr std::uint8_t whitespace = 1u << 1u;   //!< Whitespace in the C locale
+        constexpr std::uint8_t alpha = 1u << 2u;        //!< ASCII letter
+        constexpr std::uint8_t digit = 1u << 3u;        //!< ASCII digit
+        constexpr std::uint8_t underscore = 1u << 4u;   //!< Underscore
+        constexpr std::uint8_t special = 1u << 5u;      //!< Symbol that translates directly to a token
+        //! Characters that can continue an identifier
+        constexpr std::uint8_t identifier = alpha | digit | underscore;
+    }
+
+    /** \struct CharacterTable
+     * \brief Classification of all 256 character values
+     */
+    struct CharacterTable {
+        //! Class flags of each character
+        std::uint8_t classes[256];
+        //! Token tag of each special symbol (only meaningful for characters with the special flag)
+        tokens::tags::token_tag specials[256];
+    };
+
     /**
-     * \brief Whether a character is end of input
+     * \brief Build the character classification table
+     *
+     * \return Character classification table
+     */
+    constexpr CharacterTable make_character_table() {
+        CharacterTable table{};
+
+        // End of input
+        table.classes[static_cast<std::uint8_t>('\0')] |= classes::end;
+        table.classes[static_cast<std::uint8_t>(end_of_file)] |= classes::end;
+
+        // Whitespace (same as std::isspace in the C locale)
+        for (char c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+            table.classes[static_cast<std::uint8_t>(c)] |= classes::whitespace;
+        }
+
+        // Letters, digits and underscore
+        for (char c = 'a'; c <= 'z'; c++) {
+            table.classes[static_cast<std::uint8_t>(c)] |= classes::alpha;
+        }
+        for (char c = 'A'; c <= 'Z'; c++) {
+            table.classes[static_cast<std::uint8_t>(c)] |= classes::alpha;
+        }
+        for (char c = '0'; c <= '9'; c++) {
+            table.classes[static_cast<std::uint8_t>(c)] |= classes::digit;
+        }
+        table.classes[static_cast<std::uint8_t>('_')] |= classes::underscore;
+
+        // Special symbols
+        for (std::size_t i = 0; i < sizeof(special_symbols); i++) {
+            auto c = static_cast<std::uint8_t>(special_symbols[i]);
+            table.classes[c] |= classes::special;
+            table.specials[c] = special_tags[i];
+        }
+
+        return table;
+    }
+
+    //! Character classification table
+    constexpr CharacterTable character_table = make_character_table();
+
+    /**
+     * \brief Whether a character belongs to any of the classes
      *
      * \param c Character to check
-     * \return `true` when end of input, `false` otherwise
+     * \param flags Class flags to check for
+     * \return `true` when the character has any of the class flags, `false` otherwise
      */
-    bool is_end(char c) { return c == '\0' || c == end_of_file; }
+    constexpr bool is(char c, std::uint8_t flags) {
+        return (character_table.classes[static_cast<std::uint8_t>(c)] & flags) != 0;
+    }
 
+    // Run scanning
+    // Note: the vector paths only run while a whole vector of input remains, the scalar loop handles the tail
     /**
-     * \brief Compute index of the character in the special symbols array, or `-1` if not found
+     * \brief Find the end of a run of whitespace
      *
-     * \param c Character to find
-     * \return index into the special symbols array, or `-1` if not found
+     * \param p First character of the run
+     * \param end End of the input buffer
+     * \return Pointer to the first non-whitespace character, or `end`
      */
-    long which_special(char c) {
-        const char *p = std::find(std::begin(special_symbols), std::end(special_symbols), c);
-        if (p == std::end(special_symbols)) {
-            return -1;
-        } else {
-            return p - special_symbols;
+    const char *skip_whitespace(const char *p, const char *end) {
+#if defined(__AVX2__)
+        for (; end - p >= 32; p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            // Space, or between tab and carriage return
+            __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+            __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                               _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+            auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(space, control)));
+            if (mask != 0xFFFFFFFFu) {
+                return p + __builtin_ctz(~mask);
+            }
+        }
+#endif
+#if defined(__SSE2__)
+        for (; end - p >= 16; p += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            // Space, or between tab and carriage return
+            __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+            __m128i control = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                            _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+            auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(space, control)));
+            if (mask != 0xFFFFu) {
+                return p + __builtin_ctz(~mask);
+            }
+        }
+#endif
+        while (p < end && is(*p, classes::whitespace)) {
+            p++;
         }
+        return p;
     }
 
+    /**
+     * \brief Find the end of a run of identifier characters (alphanumeric or `_`)
+     *
+     * \param p First character of the run
+     * \param end End of the input buffer
+     * \return Pointer to the first character that cannot continue an identifier, or `end`
+     */
+    const char *skip_identifier(const char *p, const char *end) {
+#if defined(__AVX2__)
+        for (; end - p >= 32; p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            // Letters are contiguous once lower-cased by setting bit 5
+            __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+            __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+            __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+            __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+            auto mask = static_cast<std::uint32_t>(
+                    _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), underscore)));
+            if (mask != 0xFFFFFFFFu) {
+                return p + __builtin_ctz(~mask);
+            }
+        }
+#endif
+#if defined(__SSE2__)
+        for (; end - p >= 16; p += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            // Letters are contiguous once lower-cased by setting bit 5
+            __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+            __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                          _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                          _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+            __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+            auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), underscore)));
+            if (mask != 0xFFFFu) {
+                return p + __builtin_ctz(~mask);
+            }
+        }
+#endif
+        while (p < end && is(*p, classes::identifier)) {
+            p++;
+        }
+        return p;
+    }
+
+    /**
+     * \brief Find the end of a run of digits
+     *
+     * \param p First character of the run
+     * \param end End of the input buffer
+     * \return Pointer to the first non-digit character, or `end`
+     */
+    const char *skip_digits(const char *p, const char *end) {
+#if defined(__AVX2__)
+        for (; end - p >= 32; p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                             _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+            auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(digit));
+            if (mask != 0xFFFFFFFFu) {
+                return p + __builtin_ctz(~mask);
+            }
+        }
+#endif
+#if defined(__SSE2__)
+        for (; end - p >= 16; p += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                          _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+            auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(digit));
+            if (mask != 0xFFFFu) {
+                return p + __builtin_ctz(~mask);
+            }
+        }
+#endif
+        while (p < end && is(*p, classes::digit)) {
+            p++;
+        }
+        return p;
+    }
+
+    /** \struct Cursor
+     * \brief Position in a contiguous input buffer
+     *
+     * Mirrors the get and peek functions of the callback interface, reading the null character at the end of the buffer.
+     */
+    struct Cursor {
+        //! Next character to read
+        const char *position;
+        //! One past the last character of the buffer
+        const char *end;
+
+        //! Peek at the next character, or null at the end of the buffer
+        char peek() const { return position < end ? *position : '\0'; }
+        //! Get the next character, or null at the end of the buffer
+        char get() { return position < end ? *position++ : '\0'; }
+        //! View of the characters consumed since the provided position
+        std::string_view since(const char *start) const {
+            return std::string_view(start, static_cast<std::size_t>(position - start));
+        }
+    };
+
     // Specific lexing cases
     /**
-     * \brief Lex from an input character buffer into an output Token buffer, assuming an alpha character was peeked.
+     * \brief Lex a token from an input buffer, assuming an alpha character was peeked.
      *
-     * Use `get` function to obtain characters from an input buffer, lex the resulting string, and use `append` to write
-     *  them into an output Token buffer.
      * We are expecting either an identifier or a keyword.
      * By principle of maximum munch, consume the maximum valid identifier and before tokenization check it against the
      *  valid keywords.
      *
-     * \param get Function to get next input character
-     * \param peek Function to peek at next input character
-     * \param append Function to write next output Token
+     * \param input Input buffer cursor
+     * \param token Token to lex into
      */
-    void lex_alpha(const get_function_t &get, const peek_function_t &peek, const append_function_t &append) {
+    void lex_alpha(Cursor &input, tokens::Token &token) {
         // Alpha was detected and we are not expecting anything --> expect return or identifier
-        constexpr auto return_pattern = "return";
-        std::ostringstream stream;
+        constexpr std::string_view return_pattern = "return";
+        const char *start = input.position;
 
         // Consume characters until the next one is not alphanumeric or underscore
         // Note: the requirement for the first character to be only alpha is satisfied by how this function is called
-        for (char c = peek(); std::isalnum(c) > 0 || c == '_'; c = peek()) {
-            stream << get();
-        }
+        input.position = skip_identifier(input.position, input.end);
 
         // Decide what token to append
-        std::string content = stream.str();
+        auto content = input.since(start);
         if (content == return_pattern) {
-            append(tokens::Token{tokens::tags::kw_return, ""});
+            token = tokens::Token{tokens::tags::kw_return, ""};
         } else {
-            append(tokens::Token{tokens::tags::identifier, content});
+            token = tokens::Token{tokens::tags::identifier, content, symbols::Symbol(content)};
         }
     }
 
-
     /**
-     * \brief Lex from an input character buffer into an output Token buffer, assuming an digit was peeked.
+     * \brief Lex a token from an input buffer, assuming an digit was peeked.
      *
-     * Use `get` function to obtain characters from an input buffer, lex the resulting string, and use `append` to write
-     *  them into an output Token buffer.
      * We are expecting a double literal.
      * Consume a sequence of digits, a decimal point, and a sequence of digits.
+     * On invalid input the token is set to the `ERROR` token before throwing.
      *
-     * \param get Function to get next input character
-     * \param peek Function to peek at next input character
-     * \param append Function to write next output Token
+     * \param input Input buffer cursor
+     * \param token Token to lex into
      */
-    void lex_digit(const get_function_t &get, const peek_function_t &peek, const append_function_t &append) {
+    void lex_digit(Cursor &input, tokens::Token &token) {
         // Digit was detected and we are not expecting anything --> expect double literal
-        std::ostringstream stream;
+        const char *start = input.position;
 
         // Consume digits
-        for (char c = peek(); std::isdigit(c) > 0; c = peek()) {
-            stream << get();
-        }
+        input.position = skip_digits(input.position, input.end);
 
         // Check that the next character is a decimal point
         {
-            char c = get();
+            char c = input.get();
             if (c != '.') {
                 // Invalid input --> append error token and throw exception
                 std::ostringstream message;
                 message << "Unexpected character: \'" << c << "\', expecting a decimal point.";
-                append(tokens::Token{tokens::tags::error, message.str()});
+                token = tokens::Token{tokens::tags::error, input.since(start)};
                 throw LexerException(message.str());
-            } else {
-                stream << c;
             }
         }
 
         // Check at least one digit follows
         {
-            char c = peek();
-            if (std::isdigit(c) == 0) {
+            char c = input.peek();
+            if (!is(c, classes::digit)) {
                 // Invalid input --> eat it, append error token and throw exception
-                get();
+                input.get();
                 std::ostringstream message;
                 message << "Unexpected character: \'" << c << "\', expecting a digit.";
-                append(tokens::Token{tokens::tags::error, message.str()});
+                token = tokens::Token{tokens::tags::error, input.since(start)};
                 throw LexerException(message.str());
             }
         }
 
         // Consume digits
-        for (char c = peek(); std::isdigit(c) > 0; c = peek()) {
-            stream << get();
-        }
+        input.position = skip_digits(input.position, input.end);
 
         // Append the token
-        append(tokens::Token{tokens::tags::double_literal, stream.str()});
+        token = tokens::Token{tokens::tags::double_literal, input.since(start)};
     }
 
     // Lexing itself
+    /**
+     * \brief Lex the next token from an input buffer, skipping the whitespace before it
+     *
+     * At the end of the buffer or at an end of input character the token is set to the `END` token.
+     * On invalid input the token is set to the `ERROR` token before throwing.
+     *
+     * \param cursor Input buffer cursor
+     * \param token Token to lex into
+     */
+    void lex_token(Cursor &cursor, tokens::Token &token) {
+        // Eat the whitespace before the token
+        cursor.position = skip_whitespace(cursor.position, cursor.end);
+
+        // Peek at the next character and look up its class
+        char next = cursor.peek();
+        std::uint8_t flags = character_table.classes[static_cast<std::uint8_t>(next)];
+
+        if (flags & classes::end) {                 // Detect end of input
+            token = tokens::Token{tokens::tags::end_of_input, ""};
+        } else if (flags & classes::alpha) {        // Detect alpha
+            lex_alpha(cursor, token);
+        } else if (flags & classes::digit) {        // Detect digit
+            lex_digit(cursor, token);
+        } else if (flags & classes::special) {      // Detect special characters
+            // Eat it and set the token
+            token = tokens::Token{character_table.specials[static_cast<std::uint8_t>(cursor.get())], ""};
+        } else {
+            // Invalid input --> eat it, set error token and throw exception
+            const char *start = cursor.position;
+            cursor.get();
+            std::ostringstream message;
+            message << "Unknown character: \'" << next << "\'.";
+            token = tokens::Token{tokens::tags::error, cursor.since(start)};
+            throw LexerException(message.str());
+        }
+    }
+
+    /**
+     * \brief Lex a contiguous input buffer, appending the tokens to an output Token buffer
+     *
+     * Lexing stops at the end of the buffer or at the first end of input character, appending the `END` token.
+     * On invalid input the `ERROR` token is appended before throwing, so the output contains all tokens up to the error.
+     * The contents of the tokens are views into the input buffer.
+     *
+     * \param input Input buffer
+     * \param output Output Token buffer to append to
+     */
+    void lex(std::string_view input, std::vector<tokens::Token> &output) {
+        Cursor cursor{input.data(), input.data() + input.size()};
+        do {
+            lex_token(cursor, output.emplace_back());
+        } while (output.back().tag != tokens::tags::end_of_input);
+    }
+
+    /**
+     * \brief Lex a contiguous input buffer into a vector of tokens
+     *
+     * \param input Input buffer
+     * \return Tokens in order, ending with the `END` token
+     */
+    std::vector<tokens::Token> lex(std::string_view input) {
+        std::vector<tokens::Token> output;
+        lex(input, output);
+        return output;
+    }
+
+    /**
+     * \brief Lex a contiguous input buffer into a vector of tokens
+     *
+     * \param input Pointer to the first character of the input buffer
+     * \param length Number of characters in the input buffer
+     * \return Tokens in order, ending with the `END` token
+     */
+    std::vector<tokens::Token> lex(const char *input, std::size_t length) {
+        return lex(std::string_view(input, length));
+    }
+
     /**
      * \brief Lex from an input character buffer into an output Token buffer
      *
-     * Use `get` function to obtain characters from an input buffer, lex the resulting string, and use `append` to write
-     *  them into an output Token buffer.
+     * Use `get` function to obtain characters from an input buffer until end of input, lex the resulting string, and use
+     *  `append` to write them into an output Token buffer.
+     * The characters are read into `input`, which the contents of the tokens refer to.
+     * It therefore has to outlive the tokens and must not be modified while they are in use.
      *
      * \param get Function to get next input character
      * \param peek Function to peek at next input character
      * \param append Function to write next output Token
+     * \param input Buffer to read the input into
      */
-    void lex(const get_function_t &get, const peek_function_t &peek, const append_function_t &append) {
-        bool stop = false;
+    void lex(const get_function_t &get, const peek_function_t &peek, const append_function_t &append,
+             std::string &input) {
+        // Read the input up to end of input, eating the end character
+        input.clear();
+        for (char c = peek(); !is(c, classes::end); c = peek()) {
+            input.push_back(get());
+        }
+        get();
 
-        do {
-            // Peek at the next character
-            char next = peek();
-
-            if (is_end(next)) {                         // Detect end of input
-                // Eat it, append token, stop
-                get();
-                append(tokens::Token{tokens::tags::end_of_input, ""});
-                stop = true;
-            } else if (std::isspace(next) > 0) {        // Detect whitespace
-                // Eat it
-                get();
-            } else if (std::isalpha(next) > 0) {        // Detect alpha
-                lex_alpha(get, peek, append);
-            } else if (std::isdigit(next) > 0) {        // Detect digit
-                lex_digit(get, peek, append);
-            } else if (which_special(next) >= 0) {      // Detect special characters
-                // Eat it and append the token
-                append(tokens::Token{special_tags[which_special(get())], ""});
-            } else {
-                // Invalid input --> eat it, append error token and throw exception
-                get();
-                std::ostringstream message;
-                message << "Unknown character: \'" << next << "\'.";
-                append(tokens::Token{tokens::tags::error, message.str()});
-                throw LexerException(message.str());
+        // Lex the buffer, passing on the tokens even when lexing fails
+        std::vector<tokens::Token> output;
+        try {
+            lex(input, output);
+        } catch (LexerException &) {
+            for (auto &t : output) {
+                append(t);
             }
-        } while (!stop);
+            throw;
+        }
+        for (auto &t : output) {
+            append(t);
+        }
+    }
+
+    //--- Start TokenStream implementation
+    TokenStream::TokenStream(std::string_view input) : position(input.data()), end(input.data() + input.size()) {}
+
+    bool TokenStream::fill(unsigned count) {
+        while (size < count) {
+            if (finished) {
+                return false;
+            }
+
+            // Lex the next token into the slot after the last one
+            Cursor cursor{position, end};
+            auto &token = buffer[(first + size) % lookahead];
+            lex_token(cursor, token);
+            position = cursor.position;
+            finished = token.tag == tokens::tags::end_of_input;
+            size++;
+            lexed++;
+        }
+        return true;
+    }
+
+    const tokens::Token &TokenStream::peek(unsigned offset) {
+        static const tokens::Token too_far{tokens::tags::error, "No token that far from the front of the input queue."};
+        if (offset >= lookahead || !fill(offset + 1)) {
+            return too_far;
+        }
+        return buffer[(first + offset) % lookahead];
+    }
+
+    tokens::Token TokenStream::get() {
+        if (!fill(1)) {
+            return tokens::Token{tokens::tags::error, "No more input tokens."};
+        }
+        auto token = buffer[first];
+        first = (first + 1) % lookahead;
+        size--;
+        return token;
     }
+    //--- End TokenStream implementation
 }
@@ -0,0 +1,145 @@
+/** \file Optimization.cpp
+ * LLVM IR optimization implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Optimization.h>
+
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Passes/StandardInstrumentations.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Transforms/Scalar/TailRecursionElimination.h>
+
+namespace basilisk::optimization {
+    bool parse_level(std::string_view flag, Level &level) {
+        if (flag == "-O0") {
+            level = Level::O0;
+        } else if (flag == "-O1") {
+            level = Level::O1;
+        } else if (flag == "-O2") {
+            level = Level::O2;
+        } else if (flag == "-O3") {
+            level = Level::O3;
+        } else if (flag == "-Os") {
+            level = Level::Os;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    llvm::CodeGenOpt::Level codegen_level(Level level) {
+        switch (level) {
+            case Level::O0:
+                return llvm::CodeGenOpt::None;
+            case Level::O1:
+                return llvm::CodeGenOpt::Less;
+            case Level::O3:
+                return llvm::CodeGenOpt::Aggressive;
+            case Level::O2:
+            case Level::Os:
+            default:
+                return llvm::CodeGenOpt::Default;
+        }
+    }
+
+    void configure(llvm::Module &module, const llvm::TargetMachine &target_machine) {
+        module.setDataLayout(target_machine.createDataLayout());
+        module.setTargetTriple(target_machine.getTargetTriple().str());
+
+        auto cpu = target_machine.getTargetCPU();
+        auto features = target_machine.getTargetFeatureString();
+        auto &options = target_machine.Options;
+        for (auto &function : module) {
+            if (function.isDeclaration()) {
+                continue;
+            }
+            function.addFnAttr("target-cpu", cpu);
+            if (!features.empty()) {
+                function.addFnAttr("target-features", features);
+            }
+
+            // Note: code generation resets these target options from the attributes of each function
+            auto flag = [&function](llvm::StringRef attribute, bool value) {
+                if (value) {
+                    function.addFnAttr(attribute, "true");
+                }
+            };
+            flag("unsafe-fp-math", options.UnsafeFPMath);
+            flag("no-infs-fp-math", options.NoInfsFPMath);
+            flag("no-nans-fp-math", options.NoNaNsFPMath);
+            flag("no-signed-zeros-fp-math", options.NoSignedZerosFPMath);
+        }
+    }
+
+    std::unique_ptr<llvm::TargetMachine> copy_target_machine(const llvm::TargetMachine &target_machine) {
+        return std::unique_ptr<llvm::TargetMachine>(target_machine.getTarget().createTargetMachine(
+                target_machine.getTargetTriple().str(), target_machine.getTargetCPU(),
+                target_machine.getTargetFeatureString(), target_machine.Options, target_machine.getRelocationModel(),
+                target_machine.getCodeModel(), target_machine.getOptLevel()));
+    }
+
+    void optimize(llvm::Module &module, Level level, llvm::TargetMachine *target_machine, const Profile &profile) {
+        // Nothing to do at O0
+        if (level == Level::O0) {
+            return;
+        }
+
+        // Pick the pipeline level
+        llvm::PassBuilder::OptimizationLevel pipeline_level;
+        switch (level) {
+            case Level::O1:
+                pipeline_level = llvm::PassBuilder::OptimizationLevel::O1;
+                break;
+            case Level::O3:
+                pipeline_level = llvm::PassBuilder::OptimizationLevel::O3;
+                break;
+            case Level::Os:
+                pipeline_level = llvm::PassBuilder::OptimizationLevel::Os;
+                break;
+            case Level::O2:
+            default:
+                pipeline_level = llvm::PassBuilder::OptimizationLevel::O2;
+                break;
+        }
+
+        // Prepare the pass builder, with the standard instrumentation (for example pass timing with -time-passes)
+        llvm::PassInstrumentationCallbacks callbacks;
+        llvm::StandardInstrumentations instrumentations;
+        instrumentations.registerCallbacks(callbacks);
+        // Instrument the module for a profile, or optimize it with one
+        llvm::Optional<llvm::PGOOptions> pgo;
+        if (profile.generate) {
+            pgo = llvm::PGOOptions(profile.generate_file, "", "", llvm::PGOOptions::IRInstr);
+        } else if (!profile.use_file.empty()) {
+            pgo = llvm::PGOOptions(profile.use_file, "", "", llvm::PGOOptions::IRUse);
+        }
+
+        llvm::PassBuilder builder(target_machine, llvm::PipelineTuningOptions(), pgo, &callbacks);
+
+        // Eliminate tail recursion at O1 as well, where the default pipeline doesn't, turning it into loops
+        // Note: recursion is the only way to repeat code, so it is worth it even for quick optimizations
+        if (level == Level::O1) {
+            builder.registerScalarOptimizerLateEPCallback([](llvm::FunctionPassManager &passes, auto) {
+                passes.addPass(llvm::TailCallElimPass());
+            });
+        }
+
+        // Register and connect the analyses
+        llvm::LoopAnalysisManager loop_analyses;
+        llvm::FunctionAnalysisManager function_analyses;
+        llvm::CGSCCAnalysisManager cgscc_analyses;
+        llvm::ModuleAnalysisManager module_analyses;
+        builder.registerModuleAnalyses(module_analyses);
+        builder.registerCGSCCAnalyses(cgscc_analyses);
+        builder.registerFunctionAnalyses(function_analyses);
+        builder.registerLoopAnalyses(loop_analyses);
+        builder.crossRegisterProxies(loop_analyses, function_analyses, cgscc_analyses, module_analyses);
+
+        // Build and run the default pipeline of the level
+        llvm::ModulePassManager passes = builder.buildPerModuleDefaultPipeline(pipeline_level);
+        passes.run(module, module_analyses);
+    }
+}
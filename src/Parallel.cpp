@@ -0,0 +1,409 @@
+/** \file Parallel.cpp
+ * Parallel parsing and code generation implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Parallel.h>
+#include <basilisk/AST_util.h>
+#include <basilisk/Parser.h>
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace basilisk::parallel {
+    unsigned resolve_jobs(unsigned jobs) {
+        if (jobs == 0) {
+            jobs = std::thread::hardware_concurrency();
+        }
+        return std::max(jobs, 1u);
+    }
+
+    void for_each(std::size_t count, unsigned jobs, const std::function<void(std::size_t)> &task) {
+        std::vector<std::exception_ptr> errors(count);
+        std::atomic<std::size_t> next{0};
+        auto work = [&](){
+            for (auto i = next++; i < count; i = next++) {
+                try {
+                    task(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+
+        // Note: the calling thread works as well, so one fewer thread is started
+        std::vector<std::thread> threads;
+        auto workers = std::min<std::size_t>(resolve_jobs(jobs), count);
+        for (std::size_t i = 1; i < workers; i++) {
+            threads.emplace_back(work);
+        }
+        work();
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        for (auto &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    ast::Program parse(const std::vector<tokens::Token> &tokens, unsigned jobs) {
+        // Ignore anything after the first END, as the parser would
+        auto end = std::find_if(tokens.begin(), tokens.end(),
+                [](const tokens::Token &t){ return t.tag == tokens::tags::end_of_input; }) - tokens.begin();
+        auto size = static_cast<std::size_t>(end);
+
+        // Split the tokens into ranges of about the same size at definition boundaries
+        // Note: a few ranges per thread balance definitions of different sizes
+        auto threads = resolve_jobs(jobs);
+        auto target = std::max<std::size_t>(size / (threads * 4), 1);
+        std::vector<std::size_t> cuts{0};
+        std::size_t depth = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            auto tag = tokens[i].tag;
+            if (tag == tokens::tags::lbrac) {
+                depth++;
+            } else if (tag == tokens::tags::rbrac && depth > 0) {
+                depth--;
+            }
+            bool boundary = depth == 0 && (tag == tokens::tags::semicolon || tag == tokens::tags::rbrac);
+            if (boundary && i + 1 - cuts.back() >= target) {
+                cuts.push_back(i + 1);
+            }
+        }
+        if (cuts.back() != size || cuts.size() == 1) {
+            cuts.push_back(size);
+        }
+
+        // Parse each range up to an END token in place of the next range
+        std::vector<std::optional<ast::Program>> parts(cuts.size() - 1);
+        for_each(parts.size(), threads, [&](std::size_t part){
+            auto position = cuts[part];
+            auto limit = cuts[part + 1];
+            auto at = [&](std::size_t i) -> const tokens::Token & {
+                static const tokens::Token end{tokens::tags::end_of_input, ""};
+                static const tokens::Token too_far{tokens::tags::error, "No token that far from the front of the input queue."};
+                if (i < limit) {
+                    return tokens[i];
+                } else if (i == limit) {
+                    return end;
+                }
+                return too_far;
+            };
+            parser::get_f_t get = [&](){
+                if (position > limit) {
+                    return tokens::Token{tokens::tags::error, "No more input tokens."};
+                }
+                return at(position++);
+            };
+            parser::peek_f_t peek = [&](unsigned offset) -> const tokens::Token & { return at(position + offset); };
+            parts[part] = parser::ProgramParser(get, peek).program();
+        });
+
+        // Gather the definitions in order, along with their arenas
+        auto arena = std::make_unique<ast::Arena>();
+        std::vector<std::unique_ptr<ast::Definition>> definitions;
+        for (auto &part : parts) {
+            arena->merge(*part->arena);
+            std::move(part->definitions.begin(), part->definitions.end(), std::back_inserter(definitions));
+            part->definitions.clear();
+        }
+        return ast::Program(std::move(definitions), std::move(arena));
+    }
+
+    namespace {
+        /** \struct Index
+         * \brief Definitions of a program, in the order functions see them
+         */
+        struct Index {
+            //! Function definitions in order
+            std::vector<ast::definitions::Function *> functions;
+            //! Positions of the functions by the names of their LLVM functions
+            std::unordered_map<std::string, std::size_t> positions;
+            //! Names of the LLVM functions
+            std::unordered_set<std::string> names;
+            //! Numbers of functions defined before the first definitions of global variables
+            std::unordered_map<ast::Identifier, std::size_t> globals;
+            //! Numbers of arguments of the functions declared in the module beforehand, defined in other modules
+            std::unordered_map<std::string, std::size_t> imports;
+
+            /**
+             * \brief Index the definitions of a program
+             *
+             * \param program Program to index
+             * \param module Module to generate into, before anything is generated into it
+             */
+            Index(ast::Program &program, const llvm::Module &module) {
+                for (auto &function : module) {
+                    if (function.isDeclaration()) {
+                        imports.emplace(function.getName().str(), function.arg_size());
+                    }
+                }
+
+                for (auto &definition : program.definitions) {
+                    if (auto function = dynamic_cast<ast::definitions::Function *>(definition.get())) {
+                        auto name = codegen::function_name(*function);
+                        if (!positions.emplace(name, functions.size()).second) {
+                            throw codegen::CodegenException("Function \"" + name + "\" is defined more than once, "
+                                                            "which parallel code generation does not support.");
+                        }
+                        names.insert(name);
+                        functions.push_back(function);
+                    } else if (auto variable = dynamic_cast<ast::definitions::Variable *>(definition.get())) {
+                        globals.emplace(variable->statement->identifier, functions.size());
+                    }
+                }
+            }
+        };
+
+        /**
+         * \brief Generate a shard of the functions of a program into bitcode
+         *
+         * \param index Index of the program
+         * \param begin Position of the first function of the shard
+         * \param end Position after the last function of the shard
+         * \param name Name of the shard module
+         * \param effects Effects of the functions of the program
+         * \param codegen Optional code generation features
+         * \param settings Settings, of which the optimization level and target machine are used
+         * \return Bitcode of the shard module
+         */
+        std::string generate_shard(const Index &index, std::size_t begin, std::size_t end, const std::string &name,
+                const codegen::Effects &effects, const codegen::Settings &codegen, const Settings &settings) {
+            llvm::LLVMContext context;
+            llvm::Module module(name, context);
+            llvm::IRBuilder<> builder(context);
+            codegen::NamedValuesHash variables;
+            auto double_ty = llvm::Type::getDoubleTy(context);
+
+            // Note: println is private, so each shard has its own
+            codegen::generate_stl(context, &module, builder, codegen);
+
+            for (auto i = begin; i < end; i++) {
+                auto &node = *index.functions[i];
+                ast::util::ReferenceVisitor references;
+                node.accept(references);
+
+                // Declare the functions defined before the shard or in other modules that the function calls
+                // Note: functions of the shard before it are already defined
+                for (auto &callee : references.functions) {
+                    if (module.getFunction(callee.str())) {
+                        continue;
+                    }
+                    std::optional<std::size_t> arity;
+                    auto found = index.positions.find(callee.str());
+                    if (found != index.positions.end()) {
+                        if (found->second < begin) {
+                            arity = index.functions[found->second]->arguments.size();
+                        }
+                    } else if (auto imported = index.imports.find(callee.str()); imported != index.imports.end()) {
+                        arity = imported->second;
+                    }
+                    if (arity) {
+                        std::vector<llvm::Type *> arg_types(*arity, double_ty);
+                        llvm::Function::Create(llvm::FunctionType::get(double_ty, arg_types, false),
+                                llvm::Function::ExternalLinkage, callee.str(), &module);
+                    }
+                }
+
+                // Declare the global variables defined before the function that it refers to
+                // Note: global variables visible to a function are visible to the functions after it
+                for (auto &variable : references.variables) {
+                    auto found = index.globals.find(variable);
+                    if (found != index.globals.end() && found->second <= i && !variables.get(variable)) {
+                        variables.put(variable, new llvm::GlobalVariable(module, double_ty, false,
+                                llvm::GlobalValue::ExternalLinkage, nullptr, variable.str()));
+                    }
+                }
+
+                codegen::generate_function(node, context, builder, &module, variables, effects, codegen, &index.names);
+            }
+
+            // Note: target machines are not safe to share between threads, so each shard has its own
+            std::unique_ptr<llvm::TargetMachine> target_machine;
+            if (settings.target_machine) {
+                target_machine = optimization::copy_target_machine(*settings.target_machine);
+                optimization::configure(module, *target_machine);
+            }
+            if (settings.level) {
+                optimization::optimize(module, *settings.level, target_machine.get());
+            }
+
+            std::string bitcode;
+            llvm::raw_string_ostream stream(bitcode);
+            llvm::WriteBitcodeToFile(module, stream);
+            stream.flush();
+            return bitcode;
+        }
+
+        /**
+         * \brief Describe everything the bitcode of a shard depends on
+         *
+         * Callees and global variables are described as \ref generate_shard declares them, and callees in the shard
+         *  are covered by the hashes of the functions.
+         *
+         * \param index Index of the program
+         * \param begin Position of the first function of the shard
+         * \param end Position after the last function of the shard
+         * \param effects Effects of the functions of the program
+         * \param codegen Optional code generation features
+         * \param settings Settings, of which the optimization level and target machine are used
+         * \return Description of the shard
+         */
+        std::string describe_shard(const Index &index, std::size_t begin, std::size_t end,
+                const codegen::Effects &effects, const codegen::Settings &codegen, const Settings &settings) {
+            std::ostringstream description;
+            description << codegen.describe() << " level " << (settings.level ? static_cast<int>(*settings.level) : -1);
+            if (auto target_machine = settings.target_machine) {
+                auto &options = target_machine->Options;
+                description << " target " << target_machine->getTargetTriple().str() << ' '
+                            << target_machine->getTargetCPU().str() << ' '
+                            << target_machine->getTargetFeatureString().str() << " fp " << options.UnsafeFPMath
+                            << options.NoInfsFPMath << options.NoNaNsFPMath << options.NoSignedZerosFPMath << ' '
+                            << static_cast<int>(options.AllowFPOpFusion);
+            }
+            description << '\n';
+
+            // Note: names are sorted, as references are collected into unordered sets
+            auto sorted = [](const std::unordered_set<ast::Identifier> &identifiers){
+                std::vector<std::string> names;
+                for (auto &identifier : identifiers) {
+                    names.push_back(identifier.str());
+                }
+                std::sort(names.begin(), names.end());
+                return names;
+            };
+
+            for (auto i = begin; i < end; i++) {
+                auto &node = *index.functions[i];
+                description << "function " << std::hex << ast::util::HashVisitor::hash(node) << std::dec;
+
+                // Effects the function is annotated with
+                auto purity = effects.purity.find(node.identifier);
+                description << " purity " << (purity != effects.purity.end() ? static_cast<int>(purity->second) : -1)
+                            << " recursive " << effects.recursive.count(node.identifier)
+                            << " calling " << effects.calling.count(node.identifier)
+                            << " returning " << effects.returning.count(node.identifier)
+                            << " memoized " << effects.memoized.count(node.identifier)
+                            << " writing " << effects.writing.count(node.identifier);
+                if (codegen.map_companions) {
+                    description << " companion " << index.names.count(node.identifier.str() + "_map");
+                }
+                description << '\n';
+
+                ast::util::ReferenceVisitor references;
+                node.accept(references);
+
+                // Callees defined before the shard or in other modules by their arities, and whether the others are
+                //  visible at all
+                for (auto &callee : sorted(references.functions)) {
+                    description << "call " << callee << ' ';
+                    auto found = index.positions.find(callee);
+                    auto imported = index.imports.find(callee);
+                    if (found == index.positions.end() && imported != index.imports.end()) {
+                        description << "import " << imported->second;
+                    } else if (found == index.positions.end() || found->second > i) {
+                        description << "none";
+                    } else if (found->second < begin) {
+                        description << index.functions[found->second]->arguments.size();
+                    } else {
+                        description << "shard";
+                    }
+                    description << '\n';
+                }
+
+                // Global variables visible to the function
+                for (auto &variable : sorted(references.variables)) {
+                    auto found = index.globals.find(variable);
+                    description << "variable " << variable << ' '
+                                << (found != index.globals.end() && found->second <= i) << '\n';
+                }
+            }
+            return description.str();
+        }
+    }
+
+    std::size_t generate(ast::Program &program, llvm::Module &module, const codegen::Settings &codegen,
+            const Settings &settings) {
+        auto &context = module.getContext();
+
+        // Generate everything but the function bodies, which also analyzes the program
+        // Note: the program is indexed first, to tell the functions of other modules from the ones declared here
+        llvm::IRBuilder<> builder(context);
+        codegen::NamedValuesHash variables;
+        codegen::ProgramCodegen program_cg(context, builder, &module, variables, codegen);
+        Index index(program, module);
+        program_cg.declare(program);
+
+        // Look up the shards in the cache
+        // Note: keys are described before generating, as generation renames `main`
+        auto shard_size = std::max<std::size_t>(settings.shard_size, 1);
+        auto shards = (index.functions.size() + shard_size - 1) / shard_size;
+        std::vector<std::string> bitcode(shards);
+        std::vector<std::string> keys(shards);
+        std::vector<bool> cached(shards, false);
+        std::size_t reused = 0;
+        if (settings.cache) {
+            for (std::size_t shard = 0; shard < shards; shard++) {
+                auto begin = shard * shard_size;
+                auto end = std::min(begin + shard_size, index.functions.size());
+                keys[shard] = cache::ObjectCache::key(
+                        describe_shard(index, begin, end, program_cg.get_effects(), codegen, settings),
+                        "shard");
+                if (auto entry = settings.cache->get(keys[shard])) {
+                    bitcode[shard] = std::move(*entry);
+                    cached[shard] = true;
+                    reused++;
+                }
+            }
+        }
+
+        // Generate the other shards, storing them into the cache if any
+        for_each(shards, settings.jobs, [&](std::size_t shard){
+            if (cached[shard]) {
+                return;
+            }
+            auto begin = shard * shard_size;
+            auto end = std::min(begin + shard_size, index.functions.size());
+            bitcode[shard] = generate_shard(index, begin, end, module.getName().str() + "." + std::to_string(shard),
+                    program_cg.get_effects(), codegen, settings);
+            if (settings.cache) {
+                settings.cache->put(keys[shard], bitcode[shard]);
+            }
+        });
+
+        // Link them in order
+        llvm::Linker linker(module);
+        for (std::size_t shard = 0; shard < shards; shard++) {
+            auto shard_module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode[shard], "shard"), context);
+            if (!shard_module) {
+                throw codegen::CodegenException("Could not read shard " + std::to_string(shard) + ": "
+                                                + llvm::toString(shard_module.takeError()));
+            }
+            if (linker.linkInModule(std::move(*shard_module))) {
+                throw codegen::CodegenException("Could not link shard " + std::to_string(shard) + ".");
+            }
+        }
+        return reused;
+    }
+}
@@ -7,6 +7,7 @@
 #include <basilisk/Parser.h>
 #include <basilisk/Tokens.h>
 #include <basilisk/AST.h>
+#include <basilisk/Lexer.h>
 
 namespace exp = basilisk::ast::expressions;
 
@@ -51,7 +52,7 @@ namespace basilisk::parser {
             throw ParserException(message.str());
         }
 
-        return std::make_unique<exp::Parenthesised>(std::move(expr));
+        return ast::make_node<exp::Parenthesised>(arena, std::move(expr));
     }
 
     /**
@@ -69,7 +70,7 @@ namespace basilisk::parser {
         result.push_back(expression());
 
         // On each following comma, parse another one
-        for (tokens::Token t = peek(0); t.tag == tokens::tags::comma; t = peek(0)) {
+        while (peek(0).tag == tokens::tags::comma) {
             // Consume the comma
             get();
 
@@ -97,7 +98,7 @@ namespace basilisk::parser {
             // Parse value
             double value;
             try {
-                value = std::stod(t.content);
+                value = std::stod(std::string(t.content));
             } catch (const std::invalid_argument &/*e*/) {
                 // Value cannot be parsed
                 std::ostringstream message;
@@ -111,7 +112,7 @@ namespace basilisk::parser {
             }
 
             // Return LiteralDouble
-            return std::make_unique<exp::LiteralDouble>(value);
+            return ast::make_node<exp::LiteralDouble>(arena, value);
         } else {
             // Unexpected token
             std::ostringstream message;
@@ -129,7 +130,7 @@ namespace basilisk::parser {
         // Function Call Expression -> expecting IDENTIFIER LPAR (optional expression list) RPAR
 
         // Identifier
-        std::string id;
+        ast::Identifier id;
         {
             // Get the token
             tokens::Token t = get();
@@ -143,7 +144,7 @@ namespace basilisk::parser {
             }
 
             // Extract content
-            id = t.content;
+            id = t.symbol;
         }
 
         // Left parenthesis
@@ -181,7 +182,7 @@ namespace basilisk::parser {
             }
         }
 
-        return std::make_unique<exp::FunctionCall>(id, std::move(arguments));
+        return ast::make_node<exp::FunctionCall>(arena, id, std::move(arguments));
     }
 
     /**
@@ -193,7 +194,7 @@ namespace basilisk::parser {
         // Identifier Expression -> expecting IDENTIFIER
 
         // Identifier
-        std::string id;
+        ast::Identifier id;
         {
             // Get the token
             tokens::Token t = get();
@@ -207,10 +208,10 @@ namespace basilisk::parser {
             }
 
             // Extract content
-            id = t.content;
+            id = t.symbol;
         }
 
-        return std::make_unique<exp::IdentifierExpression>(id);
+        return ast::make_node<exp::IdentifierExpression>(arena, id);
     }
 
     /**
@@ -222,7 +223,7 @@ namespace basilisk::parser {
         // Expression4 -> DOUBLE_LITERAL, LPAR Expression RPAR, IDENTIFIER, IDENTIFIER LPAR (optional expression list) RPAR
 
         // Check next token
-        tokens::Token t = peek(0);
+        const tokens::Token &t = peek(0);
         if (t.tag == tokens::tags::double_literal) {
             // Double literal
             return literal_double();
@@ -267,7 +268,7 @@ namespace basilisk::parser {
             auto exp3 = expression_3();
 
             // Return Multiplication
-            return std::make_unique<exp::NumericNegation>(std::move(exp3));
+            return ast::make_node<exp::NumericNegation>(arena, std::move(exp3));
         } else {
             // Absent -> parse ex Expression4
             return expression_4();
@@ -286,7 +287,7 @@ namespace basilisk::parser {
         auto exp3 = expression_3();
 
         // Check for operator
-        tokens::Token t = peek(0);
+        const tokens::Token &t = peek(0);
         if (t.tag == tokens::tags::star) {
             // Star -> combine with a rhs
 
@@ -297,7 +298,7 @@ namespace basilisk::parser {
             auto exp2 = expression_2();
 
             // Return Multiplication
-            return std::make_unique<exp::Multiplication>(std::move(exp3), std::move(exp2));
+            return ast::make_node<exp::Multiplication>(arena, std::move(exp3), std::move(exp2));
         } else if (t.tag == tokens::tags::slash) {
             // Minus -> combine with a rhs
 
@@ -308,7 +309,7 @@ namespace basilisk::parser {
             auto exp2 = expression_2();
 
             // Return Division
-            return std::make_unique<exp::Division>(std::move(exp3), std::move(exp2));
+            return ast::make_node<exp::Division>(arena, std::move(exp3), std::move(exp2));
         } else {
             // Absent -> return just the lhs
             return exp3;
@@ -327,7 +328,7 @@ namespace basilisk::parser {
         auto exp2 = expression_2();
 
         // Check for operator
-        tokens::Token t = peek(0);
+        const tokens::Token &t = peek(0);
         if (t.tag == tokens::tags::plus) {
             // Plus -> combine with a rhs
 
@@ -338,7 +339,7 @@ namespace basilisk::parser {
             auto exp1 = expression_1();
 
             // Return Summation
-            return std::make_unique<exp::Summation>(std::move(exp2), std::move(exp1));
+            return ast::make_node<exp::Summation>(arena, std::move(exp2), std::move(exp1));
         } else if (t.tag == tokens::tags::minus) {
             // Minus -> combine with a rhs
 
@@ -349,7 +350,7 @@ namespace basilisk::parser {
             auto exp1 = expression_1();
 
             // Return Subtraction
-            return std::make_unique<exp::Subtraction>(std::move(exp2), std::move(exp1));
+            return ast::make_node<exp::Subtraction>(arena, std::move(exp2), std::move(exp1));
         } else {
             // Absent -> return just the lhs
             return exp2;
@@ -378,7 +379,7 @@ namespace basilisk::parser {
             auto exp = expression();
 
             // Return Modulo
-            return std::make_unique<exp::Modulo>(std::move(exp1), std::move(exp));
+            return ast::make_node<exp::Modulo>(arena, std::move(exp1), std::move(exp));
         } else {
             // Absent -> return just the lhs
             return exp1;
@@ -410,7 +411,7 @@ namespace basilisk::parser {
         }
 
         // Expression
-        auto expr = ExpressionParser(get, peek).expression();
+        auto expr = ExpressionParser(get, peek, arena).expression();
 
         // SEMICOLON
         {
@@ -426,7 +427,7 @@ namespace basilisk::parser {
             }
         }
 
-        return std::make_unique<ast::statements::Return>(std::move(expr));
+        return ast::make_node<ast::statements::Return>(arena, std::move(expr));
     }
 
     /**
@@ -438,7 +439,7 @@ namespace basilisk::parser {
         // Discard Statement -> expecting Expression SEMICOLON
 
         // Expression
-        auto expr = ExpressionParser(get, peek).expression();
+        auto expr = ExpressionParser(get, peek, arena).expression();
 
         // SEMICOLON
         {
@@ -454,7 +455,7 @@ namespace basilisk::parser {
             }
         }
 
-        return std::make_unique<ast::statements::Discard>(std::move(expr));
+        return ast::make_node<ast::statements::Discard>(arena, std::move(expr));
     }
 
     /**
@@ -466,7 +467,7 @@ namespace basilisk::parser {
         // Assignment statement -> expecting IDENTIFIER, ASSIGN, value expression and SEMICOLON
 
         // Identifier
-        std::string id;
+        ast::Identifier id;
         {
             // Get the token
             tokens::Token t = get();
@@ -480,7 +481,7 @@ namespace basilisk::parser {
             }
 
             // Extract content
-            id = t.content;
+            id = t.symbol;
         }
 
         // Assign
@@ -498,7 +499,7 @@ namespace basilisk::parser {
         }
 
         // Value expression
-        auto val = ExpressionParser(get, peek).expression();
+        auto val = ExpressionParser(get, peek, arena).expression();
 
         // Semicolon
         {
@@ -514,7 +515,7 @@ namespace basilisk::parser {
             }
         }
 
-        return std::make_unique<ast::statements::Assignment>(id, std::move(val));
+        return ast::make_node<ast::statements::Assignment>(arena, id, std::move(val));
     }
 
     /**
@@ -526,7 +527,7 @@ namespace basilisk::parser {
         // Statement -> expecting RETURN Expression SEMICOLON, Assignment Statement, or Expression SEMICOLON
 
         // Check first token
-        tokens::Token t = peek(0);
+        const tokens::Token &t = peek(0);
         if (t.tag == tokens::tags::kw_return) {
             // RETURN -> Return Statement
             return return_kw();
@@ -558,9 +559,9 @@ namespace basilisk::parser {
         // Variable Definition -> expecting Assignment Statement
 
         // Assignment statement
-        auto stmt = StatementParser(get, peek).assignment();
+        auto stmt = StatementParser(get, peek, arena).assignment();
 
-        return std::make_unique<ast::definitions::Variable>(std::move(stmt));
+        return ast::make_node<ast::definitions::Variable>(arena, std::move(stmt));
     }
 
     /**
@@ -572,7 +573,7 @@ namespace basilisk::parser {
         // Function definition -> expecting IDENTIFIER, LPAR, optional identifier list, RPAR, LBRAC, statement block and RBRAC
 
         // Identifier
-        std::string id;
+        ast::Identifier id;
         {
             // Get the token
             tokens::Token t = get();
@@ -586,7 +587,7 @@ namespace basilisk::parser {
             }
 
             // Extract content
-            id = t.content;
+            id = t.symbol;
         }
 
         // Left parenthesis
@@ -607,9 +608,9 @@ namespace basilisk::parser {
         std::vector<ast::Identifier> args;
         {
             // Gather identifiers until right parenthesis
-            tokens::Token t = peek(0);
-            while (t.tag != tokens::tags::rpar) {
+            while (peek(0).tag != tokens::tags::rpar) {
                 // Check the token is identifier
+                const tokens::Token &t = peek(0);
                 if (t.tag != tokens::tags::identifier) {
                     // Unexpected token
                     std::ostringstream message;
@@ -617,19 +618,18 @@ namespace basilisk::parser {
                     throw ParserException(message.str());
                 }
 
-                // Add the identifier content, consuming the token
-                args.push_back(get().content);
+                // Add the identifier symbol, consuming the token
+                args.emplace_back(get().symbol);
 
                 // Check next is COMMA or RPAR
-                t = peek(0);
-                if (t.tag == tokens::tags::comma) {
+                const tokens::Token &next = peek(0);
+                if (next.tag == tokens::tags::comma) {
                     // COMMA -> consume and repeek
                     get();
-                    t = peek(0);
-                } else if (t.tag != tokens::tags::rpar) {
+                } else if (next.tag != tokens::tags::rpar) {
                     // Not RPAR -> unexpected token
                     std::ostringstream message;
-                    message << "Unexpected token " << t << " when parsing Function Definition and expecting COMMA or RPAR.";
+                    message << "Unexpected token " << next << " when parsing Function Definition and expecting COMMA or RPAR.";
                     throw ParserException(message.str());
                 }   // RPAR -> leave to terminate
             }
@@ -667,9 +667,9 @@ namespace basilisk::parser {
         std::vector<std::unique_ptr<ast::Statement>> body;
         {
             // Gather statements until right bracket
-            for (tokens::Token t = peek(0); t.tag != tokens::tags::rbrac; t = peek(0)) {
+            while (peek(0).tag != tokens::tags::rbrac) {
                 // Parse statement
-                auto stmt = StatementParser(get, peek).statement();
+                auto stmt = StatementParser(get, peek, arena).statement();
 
                 // Add to body
                 body.push_back(std::move(stmt));
@@ -690,7 +690,7 @@ namespace basilisk::parser {
             }
         }
 
-        return std::make_unique<ast::definitions::Function>(id, args, std::move(body));
+        return ast::make_node<ast::definitions::Function>(arena, id, args, std::move(body));
     }
 
     /**
@@ -702,7 +702,7 @@ namespace basilisk::parser {
         // Definition -> expecting IDENTIFIER followed by LPAR for function definition, ASSIGN for variable definition
 
         // Decide by second token
-        tokens::Token t = peek(1);
+        const tokens::Token &t = peek(1);
         if (t.tag == tokens::tags::lpar) {
             // Function definition
             return function();
@@ -726,18 +726,21 @@ namespace basilisk::parser {
      */
     ast::Program ProgramParser::program() {
         // Program -> expecting set of variable and function definitions
+        // Note: the arena is declared first so that it outlives the definitions when parsing fails
+        auto arena = std::make_unique<ast::Arena>();
         std::vector<std::unique_ptr<ast::Definition>> definitions;
 
         // Try to gather definitions until END
-        for (tokens::Token t = peek(0); t.tag != tokens::tags::end_of_input; t = peek(0)) {
+        while (peek(0).tag != tokens::tags::end_of_input) {
             // All definitions start with an identifier
+            const tokens::Token &t = peek(0);
             if (t.tag == tokens::tags::identifier) {
                 // Consume definition
-                definitions.push_back(DefinitionParser(get, peek).definition());
+                definitions.push_back(DefinitionParser(get, peek, arena.get()).definition());
             } else if (t.tag == tokens::tags::error) {
                 // Lexer error
                 std::ostringstream message;
-                message << "Lexer error: " << t.content;
+                message << "Lexer error at \'" << t.content << "\'.";
                 throw ParserException(message.str());
             } else {
                 // Unexpected token
@@ -751,8 +754,21 @@ namespace basilisk::parser {
         // Note: top token is now END by termination condition of the loop
         get();
 
-        // Return the program with the gathered definitions
-        return ast::Program(std::move(definitions));
+        // Return the program with the gathered definitions and the arena they live in
+        return ast::Program(std::move(definitions), std::move(arena));
     }
     //--- End ProgramParser implementation
+
+    ast::Program parse(std::string_view source, std::size_t *count) {
+        // Lex as the parser consumes the tokens
+        lexer::TokenStream stream(source);
+        get_f_t get = [&stream](){ return stream.get(); };
+        peek_f_t peek = [&stream](unsigned offset) -> const tokens::Token & { return stream.peek(offset); };
+        auto program = ProgramParser(get, peek).program();
+
+        if (count) {
+            *count = stream.count();
+        }
+        return program;
+    }
 }
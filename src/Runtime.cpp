@@ -0,0 +1,76 @@
+/** \file Runtime.cpp
+ * Runtime support of compiled programs implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Runtime.h>
+
+#include <charconv>
+#include <cstdio>
+
+namespace basilisk::runtime {
+    namespace {
+        /** \struct Buffer
+         * \brief Output buffer of a thread
+         */
+        struct Buffer {
+            //! Buffered characters
+            char data[buffer_size];
+            //! Number of buffered characters
+            std::size_t size;
+
+            //! Write the buffered characters into the standard output stream
+            void flush() {
+                if (size > 0) {
+                    std::fwrite(data, 1, size, stdout);
+                    std::fflush(stdout);
+                    size = 0;
+                }
+            }
+        };
+
+        /** \struct ExitFlush
+         * \brief Flush of the output buffer of a thread when the thread exits
+         */
+        struct ExitFlush {
+            ~ExitFlush();
+        };
+
+        //! Output buffer of the calling thread
+        // Note: the buffer is trivially destructible, so that it can still be flushed by the global destructor of a
+        //  program after the exit handlers of the thread
+        thread_local Buffer buffer{};
+        //! Flush of the output buffer of the calling thread, registered on first use
+        thread_local ExitFlush exit_flush;
+
+        ExitFlush::~ExitFlush() {
+            buffer.flush();
+        }
+    }
+
+    std::size_t format(double x, char *out) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        // Note: NaN and infinities are spelled as by printf, and the digits are exact in both
+        auto result = std::to_chars(out, out + max_length - 1, x, std::chars_format::fixed, 6);
+        *result.ptr = '\n';
+        return static_cast<std::size_t>(result.ptr - out) + 1;
+#else
+        return static_cast<std::size_t>(std::snprintf(out, max_length, "%f\n", x));
+#endif
+    }
+
+    extern "C" {
+        void basilisk_println(double x) {
+            static_cast<void>(exit_flush);
+            if (buffer.size + max_length > buffer_size) {
+                buffer.flush();
+            }
+            buffer.size += format(x, buffer.data + buffer.size);
+        }
+
+        void basilisk_flush() {
+            buffer.flush();
+        }
+    }
+}
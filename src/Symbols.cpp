@@ -0,0 +1,147 @@
+/** \file Symbols.cpp
+ * Symbol pool implementation
+ *
+ * \author Filip Smola
+ */
+
+#include <basilisk/Symbols.h>
+
+#include <deque>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <vector>
+
+namespace basilisk::symbols {
+    namespace {
+        /** \class Pool
+         * \brief Process-wide pool of interned names
+         */
+        class Pool {
+            private:
+                //! Interned names by symbol index
+                // Note: a deque does not move its elements when growing, so the index can refer to them
+                std::deque<std::string> names{""};
+                //! Symbol indices by name
+                std::unordered_map<std::string_view, Symbol::id_t> index{{names.front(), 0}};
+                //! Guard of the names and index
+                mutable std::shared_mutex mutex;
+            public:
+                //! Find the index of the name, interning it if not seen before
+                // Note: the name of the result is returned through `interned`, for use as a stable key
+                Symbol::id_t intern(std::string_view name, const std::string *&interned) {
+                    // Look up under the shared lock first as names are usually seen before
+                    {
+                        std::shared_lock lock(mutex);
+                        auto iter = index.find(name);
+                        if (iter != index.end()) {
+                            interned = &names[iter->second];
+                            return iter->second;
+                        }
+                    }
+
+                    // Insert under the exclusive lock, checking again as another thread may have inserted it since
+                    std::unique_lock lock(mutex);
+                    auto iter = index.find(name);
+                    if (iter != index.end()) {
+                        interned = &names[iter->second];
+                        return iter->second;
+                    }
+                    auto id = static_cast<Symbol::id_t>(names.size());
+                    names.emplace_back(name);
+                    index.emplace(names.back(), id);
+                    interned = &names.back();
+                    return id;
+                }
+
+                //! Get the name of the index
+                const std::string &name(Symbol::id_t id) const {
+                    std::shared_lock lock(mutex);
+                    return names[id];
+                }
+
+                //! Get the number of names
+                std::size_t size() const {
+                    std::shared_lock lock(mutex);
+                    return names.size();
+                }
+        };
+
+        //! Get the process-wide pool
+        Pool &pool() {
+            static Pool instance;
+            return instance;
+        }
+
+        /** \struct NameHash
+         * \brief FNV-1a hash of names
+         *
+         * Identifiers are short, so a byte-wise hash beats the general-purpose string hash here.
+         */
+        struct NameHash {
+            std::size_t operator()(std::string_view name) const noexcept {
+                std::uint64_t hash = 14695981039346656037ull;
+                for (char c : name) {
+                    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+                }
+                return static_cast<std::size_t>(hash);
+            }
+        };
+
+        /** \struct Cache
+         * \brief Per-thread cache of the pool
+         *
+         * Names never leave the pool, so once a thread has seen a name it can resolve it again without locking.
+         */
+        struct Cache {
+            //! Symbol indices by name, keyed by views of the interned names
+            std::unordered_map<std::string_view, Symbol::id_t, NameHash> index;
+            //! Interned names by symbol index, `nullptr` where not seen yet
+            std::vector<const std::string *> names;
+        };
+
+        //! Get the cache of the calling thread
+        Cache &cache() {
+            thread_local Cache instance;
+            return instance;
+        }
+
+        //! Find the index of the name through the cache of the calling thread
+        Symbol::id_t intern(std::string_view name) {
+            auto &local = cache();
+            auto iter = local.index.find(name);
+            if (iter != local.index.end()) {
+                return iter->second;
+            }
+
+            const std::string *interned = nullptr;
+            auto id = pool().intern(name, interned);
+            local.index.emplace(*interned, id);
+            return id;
+        }
+    }
+
+    Symbol::Symbol(std::string_view name) : index(name.empty() ? 0 : intern(name)) {}
+
+    const std::string &Symbol::str() const {
+        auto &local = cache();
+        if (index < local.names.size() && local.names[index] != nullptr) {
+            return *local.names[index];
+        }
+
+        const std::string &name = pool().name(index);
+        if (index >= local.names.size()) {
+            local.names.resize(index + 1, nullptr);
+        }
+        local.names[index] = &name;
+        return name;
+    }
+
+    std::ostream &operator<<(std::ostream &os, const Symbol &symbol) {
+        return os << symbol.str();
+    }
+
+    std::size_t pool_size() {
+        return pool().size();
+    }
+}
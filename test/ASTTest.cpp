@@ -11,7 +11,12 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include "Common.h"
+
 #include <vector>
+#include <cstdint>
+#include <unordered_set>
+#include <cmath>
 #include <basilisk/Lexer.h>
 
 namespace tokens = basilisk::tokens;
@@ -1213,5 +1218,351 @@ BOOST_AUTO_TEST_SUITE(AST)
 
     BOOST_AUTO_TEST_SUITE_END()
 
+    BOOST_AUTO_TEST_SUITE(count)
+
+        // Check nodes are counted by kind
+        BOOST_AUTO_TEST_CASE( kinds ) {
+            // Prepare program `x = 1.0; f(a) { return a + x; }`
+            std::vector<std::unique_ptr<ast::Definition>> defs;
+            defs.push_back(std::make_unique<ast::definitions::Variable>(std::make_unique<ast::statements::Assignment>(
+                    "x", std::make_unique<ast::expressions::LiteralDouble>(1.0))));
+            std::vector<std::unique_ptr<ast::Statement>> body;
+            body.push_back(std::make_unique<ast::statements::Return>(std::make_unique<ast::expressions::Summation>(
+                    std::make_unique<ast::expressions::IdentifierExpression>("a"),
+                    std::make_unique<ast::expressions::IdentifierExpression>("x"))));
+            defs.push_back(std::make_unique<ast::definitions::Function>("f", std::vector<ast::Identifier>{"a"},
+                    std::move(body)));
+            ast::Program program(std::move(defs));
+
+            // Count
+            auto counts = ast::util::CountVisitor::count(program);
+
+            // Check
+            BOOST_TEST_CHECK(counts.nodes == 9, "Wrong number of nodes.");
+            BOOST_TEST_CHECK(counts.expressions == 4, "Wrong number of expressions.");
+            BOOST_TEST_CHECK(counts.statements == 2, "Wrong number of statements.");
+            BOOST_TEST_CHECK(counts.functions == 1, "Wrong number of functions.");
+            BOOST_TEST_CHECK(counts.variables == 1, "Wrong number of variables.");
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+    BOOST_AUTO_TEST_SUITE(arena)
+
+        // Check arena nodes equal their heap counterparts
+        BOOST_AUTO_TEST_CASE( matches_heap ) {
+            // Prepare the same expression in an arena and on the heap
+            ast::Arena arena;
+            auto a = arena.make<ast::expressions::Summation>(
+                    arena.make<ast::expressions::LiteralDouble>(1.0),
+                    arena.make<ast::expressions::IdentifierExpression>("x"));
+            auto b = std::make_unique<ast::expressions::Summation>(
+                    std::make_unique<ast::expressions::LiteralDouble>(1.0),
+                    std::make_unique<ast::expressions::IdentifierExpression>("x"));
+
+            // Check equal both ways
+            BOOST_TEST_CHECK(a->equals(b.get()), "Arena node not equal to matching heap node.");
+            BOOST_TEST_CHECK(b->equals(a.get()), "Heap node not equal to matching arena node.");
+        }
+
+        // Check arena and heap nodes can be mixed in one tree
+        BOOST_AUTO_TEST_CASE( mixed ) {
+            // Prepare a heap node holding arena children
+            ast::Arena arena;
+            auto a = ast::make_node<ast::expressions::Summation>(nullptr,
+                    ast::make_node<ast::expressions::LiteralDouble>(&arena, 1.0),
+                    ast::make_node<ast::expressions::LiteralDouble>(&arena, 2.0));
+
+            // Check the children are in the arena and survive release of the parent
+            BOOST_TEST_CHECK(arena.size() >= 2 * sizeof(ast::expressions::LiteralDouble), "Nodes not allocated in arena.");
+            a.reset();
+        }
+
+        // Check nodes take only their own size in an arena, and are destroyed in place
+        BOOST_AUTO_TEST_CASE( in_place ) {
+            ast::Arena arena;
+            auto a = arena.make<ast::expressions::LiteralDouble>(1.0);
+            BOOST_TEST_CHECK(arena.size() == sizeof(ast::expressions::LiteralDouble), "Arena node has extra bytes.");
+            BOOST_TEST_CHECK(dynamic_cast<ast::expressions::LiteralDouble *>(a.get()), "Arena node of the wrong type.");
+
+            // Check deleting through a base pointer leaves the memory to the arena, which can't hand it out again
+            std::unique_ptr<ast::Expression> base(a.release());
+            base.reset();
+            auto b = arena.make<ast::expressions::LiteralDouble>(2.0);
+            BOOST_TEST_CHECK(arena.size() == 2 * sizeof(ast::expressions::LiteralDouble), "Arena memory reused.");
+        }
+
+        // Check allocations are aligned and large allocations are served
+        BOOST_AUTO_TEST_CASE( allocate ) {
+            ast::Arena arena(256);
+            for (std::size_t size : {1, 7, 16, 33, 100, 1000, 3}) {
+                auto p = reinterpret_cast<std::uintptr_t>(arena.allocate(size, 16));
+                BOOST_TEST_CHECK(p % 16 == 0, "Allocation of " << size << " bytes not aligned.");
+            }
+            BOOST_TEST_CHECK(arena.size() == 1160, "Arena does not account for all allocations.");
+            BOOST_TEST_CHECK(arena.capacity() >= arena.size(), "Arena reserved less than it handed out.");
+        }
+
+        // Check merging keeps the nodes of the merged arena alive
+        BOOST_AUTO_TEST_CASE( merge ) {
+            // Prepare nodes in two arenas
+            ast::Arena a;
+            auto x = a.make<ast::expressions::LiteralDouble>(1.0);
+            auto used = a.size();
+            ast::Arena b;
+            {
+                ast::Arena c;
+                auto y = c.make<ast::expressions::LiteralDouble>(1.0);
+                used += c.size();
+                b.merge(c);
+
+                // Check the other arena is left empty and the node is still valid
+                BOOST_TEST_CHECK(c.size() == 0, "Merged arena not left empty.");
+                BOOST_TEST_CHECK(y->equals(x.get()), "Node of merged arena invalidated.");
+            }
+            a.merge(b);
+            BOOST_TEST_CHECK(a.size() == used, "Merging does not carry over the allocation size.");
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+    BOOST_AUTO_TEST_SUITE(purity)
+        using Purity = ast::util::PurityVisitor::Purity;
+
+        // Check direct effects of function bodies
+        BOOST_AUTO_TEST_CASE( direct ) {
+            auto program = parse_program("g = 1.0;\n"
+                                         "arg(x) { return x * 2.0; }\n"
+                                         "local(x) { y = x + 1.0; return y; }\n"
+                                         "read(x) { return x + g; }\n"
+                                         "write(x) { g = x; return x; }\n"
+                                         "print(x) { println(x); return x; }");
+            auto purity = ast::util::PurityVisitor::analyze(program);
+
+            BOOST_TEST_CHECK((purity.at("arg") == Purity::pure), "Function of its arguments must be pure.");
+            BOOST_TEST_CHECK((purity.at("local") == Purity::pure), "Function with locals must be pure.");
+            BOOST_TEST_CHECK((purity.at("read") == Purity::reads_globals), "Function reading a global must read globals.");
+            BOOST_TEST_CHECK((purity.at("write") == Purity::impure), "Function writing a global must be impure.");
+            BOOST_TEST_CHECK((purity.at("print") == Purity::impure), "Function printing must be impure.");
+        }
+
+        // Check identifiers resolve to globals only when defined before the function and not shadowed
+        BOOST_AUTO_TEST_CASE( scope ) {
+            auto program = parse_program("g = 1.0;\n"
+                                         "shadow(g) { g = g + 1.0; return g; }\n"
+                                         "later(x) { h = x; return h; }\n"
+                                         "h = 2.0;");
+            auto purity = ast::util::PurityVisitor::analyze(program);
+
+            BOOST_TEST_CHECK((purity.at("shadow") == Purity::pure), "Argument must shadow the global.");
+            BOOST_TEST_CHECK((purity.at("later") == Purity::pure), "Global defined later must be a local.");
+        }
+
+        // Check effects propagate through calls, including recursive ones
+        BOOST_AUTO_TEST_CASE( calls ) {
+            auto program = parse_program("g = 1.0;\n"
+                                         "square(x) { return x * x; }\n"
+                                         "read(x) { return g * x; }\n"
+                                         "print(x) { println(x); return x; }\n"
+                                         "calls_square(x) { return square(x) + 1.0; }\n"
+                                         "calls_read(x) { return square(read(x)); }\n"
+                                         "calls_print(x) { return calls_square(print(x)); }\n"
+                                         "recursive(x) { return recursive(x - 1.0); }\n"
+                                         "mutual_a(x) { return mutual_b(x); }\n"
+                                         "mutual_b(x) { return mutual_a(x) + print(x); }");
+            auto purity = ast::util::PurityVisitor::analyze(program);
+
+            BOOST_TEST_CHECK((purity.at("calls_square") == Purity::pure), "Calling a pure function must be pure.");
+            BOOST_TEST_CHECK((purity.at("calls_read") == Purity::reads_globals),
+                             "Calling a function reading globals must read globals.");
+            BOOST_TEST_CHECK((purity.at("calls_print") == Purity::impure), "Calling an impure function must be impure.");
+            BOOST_TEST_CHECK((purity.at("recursive") == Purity::pure), "Pure recursive function must be pure.");
+            BOOST_TEST_CHECK((purity.at("mutual_a") == Purity::impure), "Impurity must propagate through recursion.");
+        }
+
+        // Check calls to unknown functions are impure
+        BOOST_AUTO_TEST_CASE( unknown ) {
+            auto program = parse_program("f(x) { return unknown(x); }");
+            auto purity = ast::util::PurityVisitor::analyze(program);
+
+            BOOST_TEST_CHECK((purity.at("f") == Purity::impure), "Calling an unknown function must be impure.");
+        }
+
+        // Check call graph properties
+        BOOST_AUTO_TEST_CASE( call_graph ) {
+            auto program = parse_program("leaf(x) { return x * x; }\n"
+                                         "calls_leaf(x) { return leaf(x) + leaf(x); }\n"
+                                         "recursive(x) { return recursive(x - 1.0); }\n"
+                                         "calls_recursive(x) { return recursive(x); }\n"
+                                         "mutual_a(x) { return mutual_b(x); }\n"
+                                         "mutual_b(x) { return mutual_a(x); }\n"
+                                         "unknown_call(x) { return unknown(x); }");
+            ast::util::PurityVisitor visitor;
+            program.accept(visitor);
+
+            auto recursive = visitor.recursive();
+            BOOST_TEST_CHECK((recursive == std::unordered_set<ast::Identifier>({"recursive", "mutual_a", "mutual_b"})),
+                             "Only functions on call cycles must be recursive.");
+
+            auto calling = visitor.calling();
+            BOOST_TEST_CHECK(calling.count("leaf") == 0u, "Leaf function must not be calling.");
+            BOOST_TEST_CHECK(calling.count("calls_leaf") == 1u, "Function with calls must be calling.");
+
+            auto returning = visitor.returning();
+            BOOST_TEST_CHECK((returning == std::unordered_set<ast::Identifier>({"leaf", "calls_leaf"})),
+                             "Only functions without reachable recursion or unknown calls must always return.");
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+    BOOST_AUTO_TEST_SUITE(self_calls)
+
+        // Check calls to themselves are split by tail position
+        BOOST_AUTO_TEST_CASE( tail_position ) {
+            auto program = parse_program("tail(x) { return tail(x - 1.0); }\n"
+                                         "parenthesised(x) { return ((parenthesised(x))); }\n"
+                                         "argument(x) { return argument(argument(x)); }\n"
+                                         "sum(x) { return sum(x) + 1.0; }\n"
+                                         "statements(x) { y = statements(x); println(statements(y)); return y; }\n"
+                                         "mutual_a(x) { return mutual_b(x); }\n"
+                                         "mutual_b(x) { return mutual_a(x); }");
+            auto calls = ast::util::SelfCallVisitor::analyze(program);
+
+            BOOST_TEST_REQUIRE(calls.size() == 5u, "Only functions calling themselves must be counted.");
+            BOOST_TEST_CHECK((calls.at("tail").tail == 1u && calls.at("tail").other == 0u));
+            BOOST_TEST_CHECK((calls.at("parenthesised").tail == 1u && calls.at("parenthesised").other == 0u),
+                             "Parentheses must not change the tail position.");
+            BOOST_TEST_CHECK((calls.at("argument").tail == 1u && calls.at("argument").other == 1u),
+                             "Arguments of a tail call must not be in tail position.");
+            BOOST_TEST_CHECK((calls.at("sum").tail == 0u && calls.at("sum").other == 1u));
+            BOOST_TEST_CHECK((calls.at("statements").tail == 0u && calls.at("statements").other == 2u));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+    BOOST_AUTO_TEST_SUITE(fold)
+
+        /**
+         * \brief Check a program folds into another
+         *
+         * \param src Source of the program to fold
+         * \param folded Source of the expected folded program
+         */
+        void check_fold(const std::string &src, const std::string &folded) {
+            auto program = parse_program(src);
+            auto expected = parse_program(folded);
+            ast::util::FoldVisitor::fold(program);
+            BOOST_TEST_CHECK(program.equals(&expected), "Folded program must match " << folded);
+        }
+
+        /**
+         * \brief Fold a program returning a single expression and get the value of the folded literal
+         *
+         * \param expression Source of the returned expression
+         * \return Value of the literal the expression folds into
+         */
+        double fold_value(const std::string &expression) {
+            auto program = parse_program("f() { return " + expression + "; }");
+            ast::util::FoldVisitor::fold(program);
+            auto &function = dynamic_cast<ast::definitions::Function &>(*program.definitions.front());
+            auto &ret = dynamic_cast<ast::statements::Return &>(*function.body.front());
+            auto literal = dynamic_cast<ast::expressions::LiteralDouble *>(ret.expression.get());
+            BOOST_TEST_REQUIRE(literal, "Constant expression must fold into a literal.");
+            return literal->value;
+        }
+
+        // Check constant subtrees fold into their value
+        BOOST_AUTO_TEST_CASE( constants ) {
+            check_fold("f(x) { return x + 2.0 * 3.0; }", "f(x) { return x + 6.0; }");
+            check_fold("a = 1.0 + 2.0 + 3.0;", "a = 6.0;");
+            check_fold("f(x) { return g(4.0 / 2.0, x); }", "f(x) { return g(2.0, x); }");
+            check_fold("f(x) { y = 7.0 % 4.0; println(y - 1.0); }", "f(x) { y = 3.0; println(y - 1.0); }");
+
+            BOOST_TEST(fold_value("- (1.0 + 2.0)") == -3.0);
+            // Note: operators are right associative, so this is 1 - (2 - 3)
+            BOOST_TEST(fold_value("1.0 - 2.0 - 3.0") == 2.0);
+            BOOST_TEST(fold_value("0.0 - 7.5 % 2.0") == -1.5);
+            BOOST_TEST(std::isinf(fold_value("1.0 / 0.0")));
+            BOOST_TEST(std::signbit(fold_value("-0.0")));
+        }
+
+        // Check parentheses are stripped only where the inner expression fits
+        BOOST_AUTO_TEST_CASE( parentheses ) {
+            check_fold("f(x) { return ((x)); }", "f(x) { return x; }");
+            check_fold("f(x, y) { return (x + y); }", "f(x, y) { return x + y; }");
+            check_fold("f(x, y) { return (-x) * y; }", "f(x, y) { return -x * y; }");
+            check_fold("f(x, y) { return (x + y) * x; }", "f(x, y) { return (x + y) * x; }");
+        }
+
+        // Check exact identities are simplified, and inexact ones are not
+        BOOST_AUTO_TEST_CASE( identities ) {
+            check_fold("f(x) { return x * 1.0; }", "f(x) { return x; }");
+            check_fold("f(x) { return 1.0 * x; }", "f(x) { return x; }");
+            check_fold("f(x, y) { return (x + y) / 1.0; }", "f(x, y) { return x + y; }");
+            check_fold("f(x) { return x - 0.0; }", "f(x) { return x; }");
+            check_fold("f(x) { return x + -0.0; }", "f(x) { return x; }");
+            check_fold("f(x) { return - - x; }", "f(x) { return x; }");
+            check_fold("f(x) { return x * (2.0 - 1.0); }", "f(x) { return x; }");
+
+            check_fold("f(x) { return x + 0.0; }", "f(x) { return x + 0.0; }");
+            check_fold("f(x) { return x * 0.0; }", "f(x) { return x * 0.0; }");
+            check_fold("f(x) { return 0.0 - x; }", "f(x) { return 0.0 - x; }");
+        }
+
+        // Check the number of replaced nodes is reported
+        BOOST_AUTO_TEST_CASE( count ) {
+            auto program = parse_program("f(x) { return (x) * (1.0 + 1.0); }");
+            // Note: the sum is replaced before the parentheses around it
+            BOOST_TEST(ast::util::FoldVisitor::fold(program) == 3u);
+            BOOST_TEST(ast::util::FoldVisitor::fold(program) == 0u);
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
+    BOOST_AUTO_TEST_SUITE(hash)
+
+        /**
+         * \brief Hash a program
+         *
+         * \param src Source of the program
+         * \return Structural hash of the program
+         */
+        std::uint64_t hash_of(const std::string &src) {
+            auto program = parse_program(src);
+            return ast::util::HashVisitor::hash(program);
+        }
+
+        // Check equal programs hash the same, ignoring formatting and parentheses
+        BOOST_AUTO_TEST_CASE( equal ) {
+            auto base = hash_of("a = 1.0;\nf(x) { y = a * x; return g(y, -x) % 2.0; }");
+            BOOST_TEST(hash_of("a = 1.0; f(x) {\n    y = a * x;\n    return g(y, -x) % 2.0;\n}") == base);
+            BOOST_TEST(hash_of("a = (1.0);\nf(x) { y = (a * x); return (g((y), -x)) % 2.0; }") == base);
+        }
+
+        // Check any structural difference changes the hash
+        BOOST_AUTO_TEST_CASE( different ) {
+            std::unordered_set<std::uint64_t> hashes{
+                    hash_of("f(x) { return x + 1.0; }"),
+                    hash_of("f(y) { return y + 1.0; }"),
+                    hash_of("g(x) { return x + 1.0; }"),
+                    hash_of("f(x, y) { return x + 1.0; }"),
+                    hash_of("f(x) { return x - 1.0; }"),
+                    hash_of("f(x) { return x + 2.0; }"),
+                    hash_of("f(x) { return x + -0.0; }"),
+                    hash_of("f(x) { return x + 0.0; }"),
+                    hash_of("f(x) { return 1.0 + x; }"),
+                    hash_of("f(x) { x + 1.0; }"),
+                    hash_of("f(x) { y = x + 1.0; }"),
+                    hash_of("f(x) { return h(x + 1.0); }"),
+                    hash_of("f(x) { return h(x, 1.0); }"),
+                    hash_of("f = 1.0;")};
+            BOOST_TEST(hashes.size() == 14u);
+
+            // Identifiers can't be shifted into one another
+            BOOST_TEST(hash_of("f(ab, c) { return 0.0; }") != hash_of("f(a, bc) { return 0.0; }"));
+        }
+
+    BOOST_AUTO_TEST_SUITE_END()
+
 BOOST_AUTO_TEST_SUITE_END()
 
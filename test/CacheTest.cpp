@@ -0,0 +1,91 @@
+/** \file CacheTest.cpp
+ * Compilation cache test module
+ *
+ * \author Filip Smola
+ */
+#define BOOST_TEST_MODULE "Cache"
+
+#include <basilisk/Cache.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+
+#include <set>
+#include <string>
+
+using namespace basilisk;
+
+/** \class Directory
+ * \brief Unique temporary directory, removed with its contents on destruction
+ */
+class Directory {
+    public:
+        llvm::SmallString<128> path;
+
+        Directory() { llvm::sys::fs::createUniqueDirectory("basilisk-cache-test", path); }
+        ~Directory() { llvm::sys::fs::remove_directories(path); }
+};
+
+BOOST_AUTO_TEST_SUITE(ObjectCache)
+
+    BOOST_AUTO_TEST_CASE( key ) {
+        using optimization::Level;
+        auto base = cache::ObjectCache::key("main() {}", "x86_64", "generic", "", Level::O2, "object");
+
+        // Same inputs -> same key
+        BOOST_TEST(base == cache::ObjectCache::key("main() {}", "x86_64", "generic", "", Level::O2, "object"));
+
+        // Any different input -> different key
+        std::set<std::string> keys{
+                base,
+                cache::ObjectCache::key("main() { }", "x86_64", "generic", "", Level::O2, "object"),
+                cache::ObjectCache::key("main() {}", "aarch64", "generic", "", Level::O2, "object"),
+                cache::ObjectCache::key("main() {}", "x86_64", "skylake", "", Level::O2, "object"),
+                cache::ObjectCache::key("main() {}", "x86_64", "generic", "+avx2", Level::O2, "object"),
+                cache::ObjectCache::key("main() {}", "x86_64", "generic", "", Level::O3, "object"),
+                cache::ObjectCache::key("main() {}", "x86_64", "generic", "", Level::O2, "jit")};
+        BOOST_TEST(keys.size() == 7u);
+
+        // Parts can't be shifted into one another
+        BOOST_TEST(cache::ObjectCache::key("a", "bc", "", "", Level::O2, "")
+                   != cache::ObjectCache::key("ab", "c", "", "", Level::O2, ""));
+    }
+
+    BOOST_AUTO_TEST_CASE( put_get ) {
+        Directory directory;
+        cache::ObjectCache cache(directory.path.str().str());
+
+        // Miss
+        BOOST_TEST(!cache.get("a").has_value());
+        BOOST_TEST(cache.hits() == 0u);
+        BOOST_TEST(cache.misses() == 1u);
+
+        // Hit, including binary data
+        std::string data("\x7f" "ELF\0\1\2", 7);
+        BOOST_TEST(cache.put("a", data));
+        auto entry = cache.get("a");
+        BOOST_TEST_REQUIRE(entry.has_value());
+        BOOST_TEST(*entry == data);
+        BOOST_TEST(cache.hits() == 1u);
+        BOOST_TEST(cache.misses() == 1u);
+
+        // Replace
+        BOOST_TEST(cache.put("a", "b"));
+        BOOST_TEST(*cache.get("a") == "b");
+    }
+
+    BOOST_AUTO_TEST_CASE( shared_directory ) {
+        Directory directory;
+        cache::ObjectCache writer(directory.path.str().str());
+        BOOST_TEST(writer.put("a", "b"));
+
+        // Another cache over the same directory sees the entry
+        cache::ObjectCache reader(directory.path.str().str());
+        auto entry = reader.get("a");
+        BOOST_TEST_REQUIRE(entry.has_value());
+        BOOST_TEST(*entry == "b");
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
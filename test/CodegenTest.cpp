@@ -11,8 +11,14 @@
 #include <basilisk/AST_util.h>
 #include <basilisk/Lexer.h>
 #include <basilisk/Codegen.h>
+#include <basilisk/Optimization.h>
 
 #include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
 
 #include <vector>
 #include <memory>
@@ -28,6 +34,7 @@ class Generator {
         llvm::IRBuilder<> builder;
         llvm::Module module;
         basilisk::codegen::NamedValuesStacks variables;
+        basilisk::codegen::Settings settings;
 
         Generator() : builder(context), module("test_source", context) {}
 
@@ -40,36 +47,9 @@ class Generator {
             // Lex
             std::vector<basilisk::tokens::Token> buffer;
             {
-                // Prepare iterator
-                auto iterator = src.begin();
-                auto end = src.end();
-
-                // Prepare functions
-                basilisk::lexer::get_function_t lexer_get = [&iterator, &end]() {
-                    // Return null character when no more input
-                    if (iterator >= end) {
-                        return '\0';
-                    }
-
-                    // Pop and return character
-                    auto b = *iterator;
-                    iterator++;
-                    return b;
-                };
-                basilisk::lexer::peek_function_t lexer_peek = [&iterator, &end]() {
-                    // Return null character when no more input
-                    if (iterator >= end) {
-                        return '\0';
-                    }
-
-                    // Return character
-                    return *iterator;
-                };
-                basilisk::lexer::append_function_t lexer_append = [&buffer](tokens::Token t) { buffer.push_back(t); };
-
                 // Lex
                 try {
-                    basilisk::lexer::lex(lexer_get, lexer_peek, lexer_append);
+                    basilisk::lexer::lex(src, buffer);
                 } catch (std::exception &/*e*/) {}
 
                 // Reverse order to move top of the queue to the back of the vector
@@ -87,12 +67,11 @@ class Generator {
                 buffer.pop_back();
                 return t;
             };
-            basilisk::parser::peek_f_t parser_peek = [&buffer](int offset){
+            basilisk::parser::peek_f_t parser_peek = [&buffer](int offset) -> const tokens::Token & {
                 // Return error token if not valid
+                static const tokens::Token too_far{basilisk::tokens::tags::error, "No token that far from the front of the input queue."};
                 if (static_cast<unsigned int>(offset) >= buffer.size()) {
-                    std::ostringstream message;
-                    message << "No token " << offset << " elements from the front of the input queue.";
-                    return tokens::Token{basilisk::tokens::tags::error, message.str()};
+                    return too_far;
                 }
 
                 // Compute index
@@ -103,7 +82,7 @@ class Generator {
             auto program = basilisk::parser::ProgramParser(parser_get, parser_peek).program();
 
             // Codegen
-            basilisk::codegen::ProgramCodegen program_cg(context, builder, &module, variables);
+            basilisk::codegen::ProgramCodegen program_cg(context, builder, &module, variables, settings);
             program.accept(program_cg);
         }
 };
@@ -233,8 +212,9 @@ BOOST_AUTO_TEST_SUITE(Codegen)
     }
 
     BOOST_AUTO_TEST_CASE( global_vars_last_init ) {
-        // Generate code
+        // Generate code, initializing the global variables in the initializer
         Generator generator;
+        generator.settings.constant_globals = false;
         generator.from_source("a = 1.0;\n"
                               "a = 2.0;");
 
@@ -273,9 +253,84 @@ BOOST_AUTO_TEST_SUITE(Codegen)
         }
     }
 
-    BOOST_AUTO_TEST_CASE( example_program ) {
+    BOOST_AUTO_TEST_CASE( global_vars_constant ) {
+        // Generate code
+        Generator generator;
+        generator.from_source("a = 2.0;\n"
+                              "b = a * 3.0 - 1.0;\n"
+                              "a = b + a;\n"
+                              "c = 1.0;\n"
+                              "get() {\n"
+                              "    return a + b + c;\n"
+                              "}\n"
+                              "set(x) {\n"
+                              "    c = x;\n"
+                              "    return x;\n"
+                              "}");
+
+        // Check the values are known at compile time, without any stores in the initializer
+        auto check = [&generator](const char *name, double value, bool constant){
+            auto var = generator.module.getGlobalVariable(name);
+            BOOST_TEST_REQUIRE(var, "Global variable " << name << " must be present.");
+            auto expected = llvm::ConstantFP::get(generator.context, llvm::APFloat(value));
+            BOOST_TEST_CHECK(var->getInitializer() == expected, "Global variable " << name << " must be " << value);
+            BOOST_TEST_CHECK(var->isConstant() == constant, "Global variable " << name << " constness must match.");
+        };
+        check("a", 7.0, true);
+        check("b", 5.0, true);
+        check("c", 1.0, false);
+        auto &entry = generator.module.getFunction("global_var_init")->getEntryBlock();
+        BOOST_TEST_CHECK(entry.size() == 1u, "Global variable initializer must only return.");
+    }
+
+    BOOST_AUTO_TEST_CASE( global_vars_fallback ) {
         // Generate code
         Generator generator;
+        generator.from_source("a = 2.0;\n"
+                              "square(x) {\n"
+                              "    return x * x;\n"
+                              "}\n"
+                              "write(x) {\n"
+                              "    println(x);\n"
+                              "    a = x;\n"
+                              "    return x;\n"
+                              "}\n"
+                              "b = square(a);\n"
+                              "c = a + 1.0;\n"
+                              "d = write(4.0);\n"
+                              "e = a + 1.0;\n"
+                              "b = 1.0;");
+
+        // Check which values are stored in the initializer
+        auto &entry = generator.module.getFunction("global_var_init")->getEntryBlock();
+        auto stored = [&](const char *name){
+            auto var = generator.module.getGlobalVariable(name);
+            std::vector<llvm::Value *> values;
+            for (auto &instruction : entry) {
+                if (auto store = llvm::dyn_cast<llvm::StoreInst>(&instruction); store && store->getOperand(1) == var) {
+                    values.push_back(store->getOperand(0));
+                }
+            }
+            return values;
+        };
+        auto one = llvm::ConstantFP::get(generator.context, llvm::APFloat(1.0));
+        auto three = llvm::ConstantFP::get(generator.context, llvm::APFloat(3.0));
+        BOOST_TEST_CHECK(stored("a").empty(), "Known value must not be stored.");
+        BOOST_TEST_CHECK(stored("b").size() == 2u, "Calls and redefinitions after them must be stored.");
+        BOOST_TEST_CHECK(stored("b").back() == one, "Redefinition must store its known value.");
+        BOOST_TEST_CHECK((stored("c").empty() && generator.module.getGlobalVariable("c")->getInitializer() == three),
+                         "Pure calls must not forget the known values.");
+        BOOST_TEST_CHECK(stored("d").size() == 1u, "Impure call must be stored.");
+        BOOST_TEST_CHECK(stored("e").size() == 1u, "Impure call must forget the known values.");
+        BOOST_TEST_CHECK(!generator.module.getGlobalVariable("a")->isConstant(),
+                         "Global variable assigned by a function must not be constant.");
+        BOOST_TEST_CHECK(!llvm::verifyModule(generator.module, &llvm::errs()), "Module must be valid.");
+    }
+
+    BOOST_AUTO_TEST_CASE( example_program ) {
+        // Generate code, initializing the global variables in the initializer
+        Generator generator;
+        generator.settings.constant_globals = false;
         generator.from_source("pi = 3.14;\n"
                          "\n"
                          "get_pi() {\n"
@@ -420,4 +475,407 @@ BOOST_AUTO_TEST_SUITE(Codegen)
             BOOST_TEST_CHECK(write->arg_size() == 1, "Function write must take one argument.");
         }
     }
+    BOOST_AUTO_TEST_CASE( map_companions ) {
+        // Generate code
+        Generator generator;
+        generator.settings.map_companions = true;
+        generator.from_source("g = 2.0;\n"
+                              "scale(x, y) {\n"
+                              "    return g * x + y;\n"
+                              "}\n"
+                              "\n"
+                              "write(x) {\n"
+                              "    println(x);\n"
+                              "    return x;\n"
+                              "}");
+
+        // Check companion of the pure function
+        auto map = generator.module.getFunction("scale_map");
+        BOOST_TEST_REQUIRE(map, "Pure function must have a map companion.");
+        BOOST_TEST_CHECK(map->getReturnType()->isVoidTy(), "Map companion must return void.");
+        BOOST_TEST_REQUIRE(map->arg_size() == 4u, "Map companion must take the inputs, output and count.");
+        for (unsigned i = 0; i < 3; i++) {
+            BOOST_TEST_CHECK((map->arg_begin() + i)->getType() == llvm::Type::getDoublePtrTy(generator.context),
+                             "Map companion inputs and output must be double pointers.");
+            BOOST_TEST_CHECK(map->hasParamAttribute(i, llvm::Attribute::NoAlias),
+                             "Map companion pointers must be noalias.");
+        }
+        BOOST_TEST_CHECK((map->arg_begin() + 3)->getType() == llvm::Type::getInt64Ty(generator.context),
+                         "Map companion count must be i64.");
+        BOOST_TEST_CHECK(!llvm::verifyFunction(*map), "Map companion must be valid.");
+
+        // Check no companion of the impure function
+        BOOST_TEST_CHECK(!generator.module.getFunction("write_map"), "Impure function must not have a map companion.");
+    }
+
+    BOOST_AUTO_TEST_CASE( map_companions_disabled ) {
+        // Generate code
+        Generator generator;
+        generator.from_source("square(x) {\n"
+                              "    return x * x;\n"
+                              "}");
+
+        BOOST_TEST_CHECK(!generator.module.getFunction("square_map"), "Map companions must be opt-in.");
+    }
+
+    BOOST_AUTO_TEST_CASE( fold ) {
+        // Generate code with and without folding
+        const char *source = "f(x) {\n"
+                             "    return (x * (3.0 - 2.0)) / 1.0;\n"
+                             "}";
+        Generator folded;
+        folded.from_source(source);
+        Generator unfolded;
+        unfolded.settings.fold = false;
+        unfolded.from_source(source);
+
+        // Count the arithmetic instructions
+        auto arithmetic = [](llvm::Function *f){
+            std::size_t count = 0;
+            for (auto &block : *f) {
+                for (auto &instruction : block) {
+                    count += instruction.isBinaryOp() ? 1 : 0;
+                }
+            }
+            return count;
+        };
+        auto f_folded = folded.module.getFunction("f");
+        auto f_unfolded = unfolded.module.getFunction("f");
+        BOOST_TEST_REQUIRE((f_folded && f_unfolded));
+        BOOST_TEST_CHECK(arithmetic(f_folded) == 0u, "Folded identities must not generate instructions.");
+        BOOST_TEST_CHECK(arithmetic(f_unfolded) == 2u, "Folding must be possible to disable.");
+    }
+
+    BOOST_AUTO_TEST_CASE( effect_attributes ) {
+        // Generate code
+        Generator generator;
+        generator.from_source("g = 2.0;\n"
+                              "square(x) {\n"
+                              "    return x * x;\n"
+                              "}\n"
+                              "\n"
+                              "scale(x) {\n"
+                              "    return g * x;\n"
+                              "}\n"
+                              "\n"
+                              "write(x) {\n"
+                              "    println(x);\n"
+                              "    return x;\n"
+                              "}");
+
+        auto square = generator.module.getFunction("square");
+        auto scale = generator.module.getFunction("scale");
+        auto write = generator.module.getFunction("write");
+        BOOST_TEST_REQUIRE((square && scale && write));
+        BOOST_TEST_CHECK(square->doesNotAccessMemory(), "Pure function must be readnone.");
+        BOOST_TEST_CHECK((scale->onlyReadsMemory() && !scale->doesNotAccessMemory()),
+                         "Function reading globals must be readonly.");
+        BOOST_TEST_CHECK(!write->onlyReadsMemory(), "Impure function must access memory.");
+        for (auto f : {square, scale, write}) {
+            BOOST_TEST_CHECK(f->doesNotThrow(), "Functions must be nounwind.");
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( memoize ) {
+        // Generate code
+        Generator generator;
+        generator.settings.memoize = true;
+        generator.from_source("square(x) {\n"
+                              "    return x * x;\n"
+                              "}\n"
+                              "\n"
+                              "sum(x, y) {\n"
+                              "    return square(x) + square(y);\n"
+                              "}");
+
+        // Check the calling function is memoized
+        auto sum = generator.module.getFunction("sum");
+        auto compute = generator.module.getFunction("sum.compute");
+        BOOST_TEST_REQUIRE((sum && compute), "Calling pure function must be memoized.");
+        BOOST_TEST_CHECK(compute->hasInternalLinkage(), "Computing function must be internal.");
+        BOOST_TEST_CHECK(!sum->onlyReadsMemory(), "Memoized function must not keep its memory attributes.");
+        BOOST_TEST_CHECK(generator.module.getGlobalVariable("sum.memo.keys", true), "Memoized function must have a cache.");
+        BOOST_TEST_CHECK(!llvm::verifyFunction(*sum), "Memoized function must be valid.");
+        BOOST_TEST_CHECK(!llvm::verifyFunction(*compute), "Computing function must be valid.");
+
+        // Check the leaf function is not
+        BOOST_TEST_CHECK(!generator.module.getFunction("square.compute"), "Leaf function must not be memoized.");
+    }
+
+    BOOST_AUTO_TEST_CASE( memoize_callers ) {
+        // Generate code with pure callers of a memoized function
+        Generator generator;
+        generator.settings.memoize = true;
+        generator.from_source("square(x) {\n"
+                              "    return x * x;\n"
+                              "}\n"
+                              "\n"
+                              "sum(x, y) {\n"
+                              "    return square(x) + square(y);\n"
+                              "}\n"
+                              "\n"
+                              "twice() {\n"
+                              "    return sum(1.0, 2.0) * 2.0;\n"
+                              "}\n"
+                              "\n"
+                              "outer(x) {\n"
+                              "    return twice() + x;\n"
+                              "}");
+
+        // Check the callers write memory through the cache, unlike the leaf function
+        auto square = generator.module.getFunction("square");
+        auto twice = generator.module.getFunction("twice");
+        auto outer = generator.module.getFunction("outer");
+        BOOST_TEST_REQUIRE((square && twice && outer && generator.module.getFunction("outer.compute")));
+        BOOST_TEST_CHECK(square->doesNotAccessMemory(), "Leaf function must keep its memory attributes.");
+        BOOST_TEST_CHECK(!twice->onlyReadsMemory(), "Caller of a memoized function must not only read memory.");
+        BOOST_TEST_CHECK(!outer->onlyReadsMemory(), "Callers must not only read memory through other callers.");
+        BOOST_TEST_CHECK(!llvm::verifyModule(generator.module, &llvm::errs()), "Module must be valid.");
+
+        // Check the cache survives optimization, inlined into the callers
+        basilisk::optimization::optimize(generator.module, basilisk::optimization::Level::O2);
+        BOOST_TEST_CHECK(!llvm::verifyModule(generator.module, &llvm::errs()), "Optimized module must be valid.");
+        twice = generator.module.getFunction("twice");
+        BOOST_TEST_REQUIRE(twice);
+        BOOST_TEST_CHECK(!twice->onlyReadsMemory(), "Optimized caller must still write the cache.");
+        BOOST_TEST_CHECK(generator.module.getGlobalVariable("sum.memo.used", true), "Cache must not be removed.");
+    }
+
+    BOOST_AUTO_TEST_CASE( buffered_output ) {
+        // Generate code
+        Generator generator;
+        generator.settings.buffered_output = true;
+        generator.from_source("main() {\n"
+                              "    println(1.0);\n"
+                              "    return 0.0;\n"
+                              "}");
+
+        // Check println writes through the runtime
+        auto write = generator.module.getFunction("basilisk_println");
+        BOOST_TEST_REQUIRE(write, "Runtime output function must be declared.");
+        BOOST_TEST_CHECK(write->getNumUses() == 1u, "Only println must call the runtime output function.");
+        BOOST_TEST_CHECK(generator.module.getFunction("printf")->use_empty(), "println must not call printf.");
+
+        // Check the output is flushed at exit
+        auto dtors = generator.module.getGlobalVariable("llvm.global_dtors");
+        BOOST_TEST_REQUIRE(dtors, "Global destructors must be set.");
+        auto flush = generator.module.getFunction("basilisk_flush");
+        BOOST_TEST_REQUIRE(flush, "Runtime flush function must be declared.");
+        BOOST_TEST_CHECK(dtors->getInitializer()->getAggregateElement(0u)->getAggregateElement(1u) == flush,
+                         "Global destructor must flush the output.");
+        BOOST_TEST_CHECK(!llvm::verifyModule(generator.module, &llvm::errs()), "Module must be valid.");
+    }
+
+    BOOST_AUTO_TEST_CASE( fast_math ) {
+        // Generate code with fast-math flags and without any
+        const char *source = "f(x, y) {\n"
+                             "    return x * y - x / y;\n"
+                             "}";
+        Generator fast;
+        fast.settings.fast_math.setNoNaNs();
+        fast.settings.fast_math.setAllowReciprocal();
+        fast.from_source(source);
+        Generator strict;
+        strict.from_source(source);
+
+        // Check the flags of the arithmetic instructions
+        auto f_fast = fast.module.getFunction("f");
+        auto f_strict = strict.module.getFunction("f");
+        BOOST_TEST_REQUIRE((f_fast && f_strict));
+        std::size_t count = 0;
+        for (auto &instruction : f_fast->getEntryBlock()) {
+            if (instruction.isBinaryOp()) {
+                count++;
+                BOOST_TEST_CHECK((instruction.hasNoNaNs() && instruction.hasAllowReciprocal()),
+                                 "Arithmetic must have the fast-math flags.");
+                BOOST_TEST_CHECK(!instruction.hasNoInfs(), "Arithmetic must only have the set fast-math flags.");
+            }
+        }
+        BOOST_TEST_CHECK(count == 3u, "Arithmetic must not be contracted by default.");
+        for (auto &instruction : f_strict->getEntryBlock()) {
+            if (instruction.isBinaryOp()) {
+                BOOST_TEST_CHECK(!instruction.getFastMathFlags().any(), "Arithmetic must be strict by default.");
+            }
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( unsafe_fp_math ) {
+        // Check turning contraction off after all of the fast-math flags, as `--ffast-math --fp-contract=off` does
+        basilisk::codegen::Settings settings;
+        settings.fast_math.setFast();
+        BOOST_TEST_CHECK(settings.unsafe_fp_math(), "All of the fast-math flags must allow unsafe math.");
+        settings.fast_math.setAllowContract(false);
+        BOOST_TEST_CHECK(settings.unsafe_fp_math(), "Unsafe math must not depend on contraction.");
+        settings.fast_math.setNoNaNs(false);
+        settings.fast_math.setNoInfs(false);
+        BOOST_TEST_CHECK(settings.unsafe_fp_math(), "Unsafe math must not depend on NaNs and infinities.");
+
+        // Check each of the needed flags on its own
+        settings.fast_math.setNoSignedZeros(false);
+        BOOST_TEST_CHECK(!settings.unsafe_fp_math(), "Unsafe math must need ignoring the sign of zeros.");
+        basilisk::codegen::Settings reassociation;
+        reassociation.fast_math.setAllowReassoc();
+        BOOST_TEST_CHECK(!reassociation.unsafe_fp_math(), "Reassociation alone must not allow unsafe math.");
+        BOOST_TEST_CHECK(!basilisk::codegen::Settings().unsafe_fp_math(), "Math must be safe by default.");
+    }
+
+    BOOST_AUTO_TEST_CASE( settings_describe ) {
+        // Check every setting changes the description
+        basilisk::codegen::Settings base;
+        std::vector<basilisk::codegen::Settings> changed(9, base);
+        changed[0].fold = false;
+        changed[1].constant_globals = false;
+        changed[2].map_companions = true;
+        changed[3].memoize = true;
+        changed[4].memo_bits = 4;
+        changed[5].buffered_output = true;
+        changed[6].fast_math.setNoNaNs();
+        changed[7].fast_math.setAllowContract();
+        changed[8].contract = true;
+        for (std::size_t i = 0; i < changed.size(); i++) {
+            BOOST_TEST_CHECK(changed[i].describe() != base.describe(), "Setting " << i << " must change the description.");
+            for (std::size_t j = 0; j < i; j++) {
+                BOOST_TEST_CHECK(changed[i].describe() != changed[j].describe(),
+                                 "Settings " << j << " and " << i << " must be described differently.");
+            }
+        }
+        BOOST_TEST_CHECK(basilisk::codegen::Settings().describe() == base.describe(), "Description must be stable.");
+    }
+
+    BOOST_AUTO_TEST_CASE( contract ) {
+        // Generate code
+        Generator generator;
+        generator.settings.contract = true;
+        generator.settings.fast_math.setNoNaNs();
+        generator.settings.fast_math.setNoSignedZeros();
+        generator.from_source("f(x, y, z) {\n"
+                              "    a = x * y + z;\n"
+                              "    b = z - x * y;\n"
+                              "    c = x * y - z;\n"
+                              "    return a + b * c;\n"
+                              "}");
+
+        // Check every product is fused into the sum or difference using it, keeping the fast-math flags
+        auto f = generator.module.getFunction("f");
+        BOOST_TEST_REQUIRE(f);
+        std::size_t fused = 0;
+        for (auto &instruction : f->getEntryBlock()) {
+            BOOST_TEST_CHECK(instruction.getOpcode() != llvm::Instruction::FMul,
+                             "Products must be fused into sums and differences.");
+            auto call = llvm::dyn_cast<llvm::IntrinsicInst>(&instruction);
+            if (call && call->getIntrinsicID() == llvm::Intrinsic::fmuladd) {
+                fused++;
+                auto flags = call->getFastMathFlags();
+                BOOST_TEST_CHECK((flags.noNaNs() && flags.noSignedZeros()),
+                                 "Fused products must keep the fast-math flags of the settings.");
+                BOOST_TEST_CHECK(!flags.allowReassoc(), "Fused products must not gain fast-math flags.");
+            }
+        }
+        BOOST_TEST_CHECK(fused == 4u, "Every product must be fused.");
+        BOOST_TEST_CHECK(!llvm::verifyFunction(*f, &llvm::errs()), "Contracted function must be valid.");
+    }
+
+    BOOST_AUTO_TEST_CASE( tail_calls ) {
+        // Generate code
+        Generator generator;
+        generator.from_source("count(x) {\n"
+                              "    return count(x + 1.0);\n"
+                              "}\n"
+                              "\n"
+                              "pair(x, y) {\n"
+                              "    return count(x + y);\n"
+                              "}\n"
+                              "\n"
+                              "not_tail(x) {\n"
+                              "    return not_tail(x) * 2.0;\n"
+                              "}");
+
+        // Find the calls of each function
+        auto calls = [&generator](const char *name){
+            std::vector<llvm::CallInst *> result;
+            for (auto &block : *generator.module.getFunction(name)) {
+                for (auto &instruction : block) {
+                    if (auto call = llvm::dyn_cast<llvm::CallInst>(&instruction)) {
+                        result.push_back(call);
+                    }
+                }
+            }
+            return result;
+        };
+        auto count = calls("count");
+        auto pair = calls("pair");
+        auto not_tail = calls("not_tail");
+        BOOST_TEST_REQUIRE((count.size() == 1u && pair.size() == 1u && not_tail.size() == 1u));
+        BOOST_TEST_CHECK(count[0]->isMustTailCall(), "Returned call to the same prototype must be a musttail call.");
+        BOOST_TEST_CHECK((pair[0]->isTailCall() && !pair[0]->isMustTailCall()),
+                         "Returned call to another prototype must be a tail call.");
+        BOOST_TEST_CHECK(!not_tail[0]->isTailCall(), "Call that is not returned must not be a tail call.");
+        BOOST_TEST_CHECK(!llvm::verifyModule(generator.module, &llvm::errs()), "Module must be valid.");
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//! Named values implementations to test
+typedef boost::mpl::list<codegen::NamedValuesStacks, codegen::NamedValuesMap, codegen::NamedValuesHash> named_values_types;
+
+//! Fixture with distinct values to bind
+struct ValuesFixture {
+    llvm::LLVMContext context;
+    llvm::Value *a = llvm::ConstantFP::get(context, llvm::APFloat(1.0));
+    llvm::Value *b = llvm::ConstantFP::get(context, llvm::APFloat(2.0));
+    llvm::Value *c = llvm::ConstantFP::get(context, llvm::APFloat(3.0));
+};
+
+BOOST_AUTO_TEST_SUITE(NamedValues)
+
+    // Check values can be bound and looked up
+    BOOST_FIXTURE_TEST_CASE_TEMPLATE( put_get, T, named_values_types, ValuesFixture ) {
+        T values;
+        values.put("x", a);
+        values.put("y", b);
+
+        BOOST_TEST_CHECK(values.get("x") == a, "Bound value not found.");
+        BOOST_TEST_CHECK(values.get("y") == b, "Bound value not found.");
+        BOOST_TEST_CHECK(values.get("z") == nullptr, "Unbound identifier found.");
+    }
+
+    // Check binding again in the same scope overwrites
+    BOOST_FIXTURE_TEST_CASE_TEMPLATE( overwrite, T, named_values_types, ValuesFixture ) {
+        T values;
+        values.push();
+        values.put("x", a);
+        values.put("x", b);
+        BOOST_TEST_CHECK(values.get("x") == b, "Binding in the same scope does not overwrite.");
+
+        values.pop();
+        BOOST_TEST_CHECK(values.get("x") == nullptr, "Binding outlives its scope.");
+    }
+
+    // Check inner scopes shadow outer ones until popped
+    BOOST_FIXTURE_TEST_CASE_TEMPLATE( shadowing, T, named_values_types, ValuesFixture ) {
+        T values;
+        values.put("x", a);
+        values.put("y", a);
+        values.push();
+        values.put("x", b);
+        values.push();
+        values.put("x", c);
+
+        BOOST_TEST_CHECK(values.get("x") == c, "Inner binding does not shadow outer.");
+        BOOST_TEST_CHECK(values.get("y") == a, "Outer binding not visible in inner scope.");
+        values.pop();
+        BOOST_TEST_CHECK(values.get("x") == b, "Popping does not restore the shadowed binding.");
+        values.pop();
+        BOOST_TEST_CHECK(values.get("x") == a, "Popping does not restore the shadowed binding.");
+    }
+
+    // Check the global scope cannot be popped
+    BOOST_FIXTURE_TEST_CASE_TEMPLATE( global_scope, T, named_values_types, ValuesFixture ) {
+        T values;
+        values.put("x", a);
+        values.pop();
+
+        BOOST_TEST_CHECK(values.get("x") == a, "Global scope was popped.");
+    }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,24 @@
+/** \file Common.h
+ * Helpers shared by the test modules
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_TEST_COMMON_H
+#define BASILISK_TEST_COMMON_H
+
+#include <basilisk/AST.h>
+#include <basilisk/Parser.h>
+
+#include <string>
+
+/**
+ * \brief Parse a program from Basilisk source code
+ *
+ * \param src Basilisk source code
+ * \return Parsed program
+ */
+inline basilisk::ast::Program parse_program(const std::string &src) {
+    return basilisk::parser::parse(src);
+}
+
+#endif //BASILISK_TEST_COMMON_H
@@ -0,0 +1,95 @@
+/** \file EvaluatorTest.cpp
+ * Evaluator test module
+ *
+ * \author Filip Smola
+ */
+#define BOOST_TEST_MODULE "Evaluator"
+
+#include <basilisk/Evaluator.h>
+#include <basilisk/Parser.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+using namespace basilisk;
+
+//! Program used in the tests
+const char *source = "scale = 2.0;\n"
+                     "offset = scale + 1.0;\n"
+                     "\n"
+                     "constant() {\n"
+                     "    return 4.0;\n"
+                     "}\n"
+                     "\n"
+                     "linear(x) {\n"
+                     "    return scale * x + offset;\n"
+                     "}\n"
+                     "\n"
+                     "norm(x, y) {\n"
+                     "    return x * x + y * y;\n"
+                     "}";
+
+BOOST_AUTO_TEST_SUITE(Evaluator)
+
+    BOOST_AUTO_TEST_CASE( function ) {
+        evaluator::Evaluator evaluator(source);
+
+        auto constant = evaluator.function<>("constant");
+        auto linear = evaluator.function<double>("linear");
+        auto norm = evaluator.function<double, double>("norm");
+        BOOST_TEST(constant() == 4.0);
+        BOOST_TEST(linear(1.5) == 6.0);
+        BOOST_TEST(norm(3.0, 4.0) == 25.0);
+    }
+
+    BOOST_AUTO_TEST_CASE( arity ) {
+        evaluator::Evaluator evaluator(source);
+
+        BOOST_TEST(evaluator.has("norm"));
+        BOOST_TEST(!evaluator.has("missing"));
+        BOOST_TEST(evaluator.arity("norm") == 2u);
+        BOOST_CHECK_THROW(evaluator.arity("missing"), evaluator::EvaluatorException);
+        BOOST_CHECK_THROW(evaluator.function<double>("norm"), evaluator::EvaluatorException);
+        BOOST_CHECK_THROW(evaluator.batch("missing"), evaluator::EvaluatorException);
+    }
+
+    BOOST_AUTO_TEST_CASE( batch ) {
+        evaluator::Evaluator evaluator(source);
+
+        // Odd number of rows to cover the remainder of the vectorized loop
+        const std::size_t n = 1001;
+        std::vector<double> x(n), y(n), out(n);
+        for (std::size_t i = 0; i < n; i++) {
+            x[i] = static_cast<double>(i);
+            y[i] = static_cast<double>(n - i);
+        }
+
+        const double *args[] = {x.data(), y.data()};
+        evaluator.evaluate("norm", args, out.data(), n);
+        for (std::size_t i = 0; i < n; i++) {
+            BOOST_TEST_REQUIRE(out[i] == x[i] * x[i] + y[i] * y[i]);
+        }
+
+        evaluator.batch("linear")(args, out.data(), n);
+        for (std::size_t i = 0; i < n; i++) {
+            BOOST_TEST_REQUIRE(out[i] == 2.0 * x[i] + 3.0);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( batch_no_arguments ) {
+        evaluator::Evaluator evaluator(source, optimization::Level::O0);
+
+        std::vector<double> out(3);
+        evaluator.evaluate("constant", nullptr, out.data(), out.size());
+        BOOST_TEST(out == std::vector<double>({4.0, 4.0, 4.0}), boost::test_tools::per_element());
+
+        // Empty batch doesn't touch the output
+        evaluator.evaluate("constant", nullptr, nullptr, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE( invalid_program ) {
+        BOOST_CHECK_THROW(evaluator::Evaluator("f( {"), parser::ParserException);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
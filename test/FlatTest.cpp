@@ -0,0 +1,155 @@
+/** \file FlatTest.cpp
+ * Flat expression representation test module
+ *
+ * \author Filip Smola
+ */
+#define BOOST_TEST_MODULE "Flat"
+
+#include <basilisk/Parser.h>
+#include <basilisk/Tokens.h>
+#include <basilisk/Lexer.h>
+#include <basilisk/AST_util.h>
+#include <basilisk/Flat.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "Common.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace basilisk;
+
+/**
+ * \brief Lower the first definition of a program, which must be a function
+ *
+ * \param program Program to lower from
+ * \return Buffer of the expressions of the function
+ */
+flat::Buffer lower_first(ast::Program &program) {
+    auto function = dynamic_cast<ast::definitions::Function *>(program.definitions.front().get());
+    BOOST_TEST_REQUIRE(function, "First definition must be a function.");
+    return flat::Buffer::lower(*function);
+}
+
+/**
+ * \brief Check two buffers hold the same nodes and side tables
+ *
+ * \param lhs Left hand side
+ * \param rhs Right hand side
+ * \return `true` if all of their arrays are equal
+ */
+bool same_buffer(const flat::Buffer &lhs, const flat::Buffer &rhs) {
+    auto same_calls = lhs.calls.size() == rhs.calls.size();
+    for (std::size_t i = 0; same_calls && i < lhs.calls.size(); i++) {
+        same_calls = lhs.calls[i].identifier == rhs.calls[i].identifier && lhs.calls[i].first == rhs.calls[i].first
+                     && lhs.calls[i].count == rhs.calls[i].count;
+    }
+    return same_calls && lhs.ops == rhs.ops && lhs.lhs == rhs.lhs && lhs.rhs == rhs.rhs
+           && lhs.constants == rhs.constants && lhs.identifiers == rhs.identifiers && lhs.arguments == rhs.arguments
+           && lhs.roots == rhs.roots;
+}
+
+BOOST_AUTO_TEST_SUITE(Lower)
+
+    BOOST_AUTO_TEST_CASE( post_order ) {
+        auto program = parse_program("f(x, y) { return x + y * 2.0; }");
+        auto buffer = lower_first(program);
+
+        using flat::Op;
+        BOOST_TEST_REQUIRE((buffer.ops == std::vector<Op>{Op::identifier, Op::identifier, Op::literal, Op::multiply,
+                                                          Op::add}));
+        BOOST_TEST((buffer.lhs[3] == 1u && buffer.rhs[3] == 2u));
+        BOOST_TEST((buffer.lhs[4] == 0u && buffer.rhs[4] == 3u));
+        BOOST_TEST((buffer.identifiers == std::vector<ast::Identifier>{"x", "y"}));
+        BOOST_TEST(buffer.constants == std::vector<double>{2.0});
+        BOOST_TEST(buffer.roots == std::vector<flat::index_t>{4});
+    }
+
+    BOOST_AUTO_TEST_CASE( parentheses ) {
+        auto parenthesised = parse_program("f(x, y) { return ((x) - (y)); }");
+        auto plain = parse_program("f(x, y) { return x - y; }");
+        BOOST_TEST(same_buffer(lower_first(parenthesised), lower_first(plain)));
+    }
+
+    BOOST_AUTO_TEST_CASE( calls ) {
+        // Arguments of both calls are recorded after the nested call is lowered
+        auto program = parse_program("f(x) { return g(x, h(1.0)); }");
+        auto buffer = lower_first(program);
+
+        BOOST_TEST_REQUIRE(buffer.calls.size() == 2u);
+        auto &inner = buffer.calls[0];
+        auto &outer = buffer.calls[1];
+        BOOST_TEST(inner.identifier == "h");
+        BOOST_TEST(inner.count == 1u);
+        BOOST_TEST(buffer.arguments[inner.first] == 1u);
+        BOOST_TEST(outer.identifier == "g");
+        BOOST_TEST(outer.count == 2u);
+        BOOST_TEST(buffer.arguments[outer.first] == 0u);
+        BOOST_TEST(buffer.arguments[outer.first + 1] == 2u);
+        BOOST_TEST(buffer.roots.back() == 3u);
+    }
+
+    BOOST_AUTO_TEST_CASE( statements ) {
+        // One expression per statement, each in its own range
+        auto program = parse_program("f(x) { y = x * 2.0; println(y); return -y; }");
+        auto buffer = lower_first(program);
+
+        BOOST_TEST_REQUIRE(buffer.roots.size() == 3u);
+        BOOST_TEST(buffer.begin(0) == 0u);
+        BOOST_TEST(buffer.roots[0] == 2u);
+        BOOST_TEST(buffer.begin(1) == 3u);
+        BOOST_TEST(buffer.roots[1] == 4u);
+        BOOST_TEST(buffer.begin(2) == 5u);
+        BOOST_TEST(buffer.roots[2] == 6u);
+        BOOST_TEST(buffer.size() == 7u);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Fold)
+
+    BOOST_AUTO_TEST_CASE( matches_ast ) {
+        // Folding the buffer must give the buffer of the folded program
+        for (auto src : {"f(x) { return x + 2.0 * 3.0; }",
+                         "f(x) { return g(4.0 / 2.0, x); }",
+                         "f(x) { y = 7.0 % 4.0; println(y - 1.0); return 0.0 - 7.5 % 2.0; }",
+                         "f(x) { return - (1.0 + 2.0) + 1.0 - 2.0 - 3.0; }",
+                         "f(x, y) { return (x + y) / 1.0 * (2.0 - 1.0); }",
+                         "f(x) { return x * 1.0 + 1.0 * x - 0.0 + -0.0; }",
+                         "f(x) { return - - x + - - - x; }",
+                         "f(x) { return x + 0.0 - (x * 0.0) + (0.0 - x); }",
+                         "f(x) { return g(x * 1.0, h(2.0 * 0.5) / 1.0); }"}) {
+            auto expected = parse_program(src);
+            ast::util::FoldVisitor::fold(expected);
+            auto program = parse_program(src);
+            auto buffer = lower_first(program);
+            buffer.fold();
+            BOOST_TEST(same_buffer(buffer, lower_first(expected)), "Folded buffer must match for " << src);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( compact ) {
+        // Replaced nodes are dropped, keeping the roots at the ends of their ranges
+        auto program = parse_program("f(x) { y = x * 1.0; return (2.0 + 3.0) * y; }");
+        auto buffer = lower_first(program);
+        BOOST_TEST(buffer.fold() == 2u);
+        BOOST_TEST(buffer.size() == 4u);
+        BOOST_TEST((buffer.roots == std::vector<flat::index_t>{0, 3}));
+        BOOST_TEST(buffer.constants == std::vector<double>{5.0});
+        BOOST_TEST(buffer.fold() == 0u);
+    }
+
+    BOOST_AUTO_TEST_CASE( values ) {
+        auto program = parse_program("f() { return 1.0 / 0.0; return -0.0; return 1.0 - 2.0 - 3.0; }");
+        auto buffer = lower_first(program);
+        buffer.fold();
+        BOOST_TEST_REQUIRE(buffer.size() == 3u);
+        BOOST_TEST(std::isinf(buffer.constants[buffer.lhs[0]]));
+        BOOST_TEST(std::signbit(buffer.constants[buffer.lhs[1]]));
+        // Note: operators are right associative, so this is 1 - (2 - 3)
+        BOOST_TEST(buffer.constants[buffer.lhs[2]] == 2.0);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,163 @@
+/** \file InterpreterTest.cpp
+ * Bytecode interpreter test module
+ *
+ * \author Filip Smola
+ */
+#define BOOST_TEST_MODULE "Interpreter"
+
+#include <basilisk/Parser.h>
+#include <basilisk/Tokens.h>
+#include <basilisk/Lexer.h>
+#include <basilisk/Codegen.h>
+#include <basilisk/JIT.h>
+#include <basilisk/Interpreter.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "Common.h"
+
+#include <llvm/IR/IRBuilder.h>
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace basilisk;
+
+/**
+ * \brief Compile Basilisk source code into bytecode
+ *
+ * \param src Basilisk source code
+ * \param tier_up Number of calls after which pure functions are compiled with LLVM, `0` for never
+ * \return Interpreter of the program
+ */
+std::unique_ptr<interpreter::Interpreter> interpret(const std::string &src, std::size_t tier_up = 0) {
+    interpreter::Settings settings;
+    settings.tier_up = tier_up;
+    return std::make_unique<interpreter::Interpreter>(parse_program(src), settings);
+}
+
+//! Program used in the tests, with global variables, local variables, calls and every operator
+const char *source = "a = 2.0;\n"
+                     "b = a * 3.0;\n"
+                     "f(x, y) { t = x % y; return -t / (a - y) + x * b; }\n"
+                     "g(x) { s = f(x, 3.0); s = s + f(s, x); return s; }\n"
+                     "set(x) { a = x; return a; }\n"
+                     "main() { set(5.0); return g(1.5) - b; }";
+
+BOOST_AUTO_TEST_SUITE(Run)
+
+    BOOST_AUTO_TEST_CASE( matches_jit ) {
+        // Compile the same program with LLVM
+        auto context = std::make_unique<llvm::LLVMContext>();
+        auto module = std::make_unique<llvm::Module>("test_source", *context);
+        {
+            auto program = parse_program(source);
+            llvm::IRBuilder<> builder(*context);
+            codegen::NamedValuesHash variables;
+            codegen::ProgramCodegen program_cg(*context, builder, module.get(), variables);
+            program.accept(program_cg);
+        }
+        jit::Engine engine;
+        engine.add(std::move(context), std::move(module));
+        engine.initialize();
+        auto f = reinterpret_cast<double (*)(double, double)>(engine.lookup("f"));
+        auto g = reinterpret_cast<double (*)(double)>(engine.lookup("g"));
+
+        // Compare, including negative zeros and remainders of negative values
+        // Note: signs of NaN results may differ, as IEEE 754 leaves them unspecified
+        auto same = [](double result, double expected){
+            if (std::isnan(expected)) {
+                return std::isnan(result);
+            }
+            return result == expected && std::signbit(result) == std::signbit(expected);
+        };
+        auto interpreter = interpret(source);
+        for (double x : {-7.5, -1.0, -0.0, 0.0, 0.25, 3.0, 10.0}) {
+            for (double y : {-2.0, 0.5, 3.0}) {
+                BOOST_TEST_REQUIRE(same(interpreter->call("f", {x, y}), f(x, y)));
+            }
+            BOOST_TEST_REQUIRE(same(interpreter->call("g", {x}), g(x)));
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( main_return ) {
+        // g(1.5) with a = 5 and b = 6, minus b
+        double t = std::fmod(1.5, 3.0);
+        double s = -t / (5.0 - 3.0) + 1.5 * 6.0;
+        s = s + (-std::fmod(s, 1.5) / (5.0 - 1.5) + s * 6.0);
+        BOOST_TEST(interpret(source)->run() == static_cast<int>(s - 6.0));
+    }
+
+    BOOST_AUTO_TEST_CASE( implicit_return ) {
+        BOOST_TEST(interpret("f(x) { y = x; }")->call("f", {2.0}) == 0.0);
+        BOOST_TEST(interpret("f() { println(1.0); }")->call("f", {}) == 0.0);
+    }
+
+    BOOST_AUTO_TEST_CASE( max_depth ) {
+        BOOST_CHECK_THROW(interpret("f(x) { return f(x); }")->call("f", {1.0}), interpreter::InterpreterException);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Resolution)
+
+    BOOST_AUTO_TEST_CASE( errors ) {
+        // Later functions and variables, wrong numbers of arguments and redefinitions
+        BOOST_CHECK_THROW(interpret("f() { return g(); }\ng() { return 1.0; }"), interpreter::InterpreterException);
+        BOOST_CHECK_THROW(interpret("f() { return a; }\na = 1.0;"), interpreter::InterpreterException);
+        BOOST_CHECK_THROW(interpret("f(x) { return x; }\ng() { return f(); }"), interpreter::InterpreterException);
+        BOOST_CHECK_THROW(interpret("f(x) { return x; }\nf(y) { return y; }"), interpreter::InterpreterException);
+        BOOST_CHECK_THROW(interpret("println(x) { return x; }"), interpreter::InterpreterException);
+    }
+
+    BOOST_AUTO_TEST_CASE( missing ) {
+        auto interpreter = interpret("f(x) { return x; }");
+        BOOST_CHECK_THROW(interpreter->run(), interpreter::InterpreterException);
+        BOOST_CHECK_THROW(interpreter->call("g", {}), interpreter::InterpreterException);
+        BOOST_CHECK_THROW(interpreter->call("f", {}), interpreter::InterpreterException);
+    }
+
+    BOOST_AUTO_TEST_CASE( shadowing ) {
+        // Arguments shadow global variables, and functions assign global variables they don't shadow
+        auto interpreter = interpret("a = 1.0;\n"
+                                     "f(a) { a = a + 1.0; return a; }\n"
+                                     "g(x) { a = x; return a; }\n"
+                                     "h() { return a; }");
+        BOOST_TEST(interpreter->call("f", {5.0}) == 6.0);
+        BOOST_TEST(interpreter->call("h", {}) == 1.0);
+        BOOST_TEST(interpreter->call("g", {7.0}) == 7.0);
+        BOOST_TEST(interpreter->call("h", {}) == 7.0);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(TierUp)
+
+    BOOST_AUTO_TEST_CASE( impure_functions ) {
+        // All functions of the program read or assign global variables
+        auto interpreter = interpret(source, 3);
+        for (int i = 0; i < 10; i++) {
+            interpreter->call("g", {i + 0.5});
+        }
+        BOOST_TEST(interpreter->tiered() == 0u);
+        BOOST_TEST(interpreter->function("f")->native == nullptr);
+    }
+
+    BOOST_AUTO_TEST_CASE( native_results ) {
+        auto src = "square(x) { return x * x; }\n"
+                   "f(x, y) { return square(x) - square(y) % 3.0; }\n"
+                   "count(x) { println(x); return x; }";
+        auto interpreted = interpret(src);
+        auto tiered = interpret(src, 2);
+        for (int i = 0; i < 10; i++) {
+            BOOST_TEST_REQUIRE(tiered->call("f", {i * 1.5, -i * 0.5}) == interpreted->call("f", {i * 1.5, -i * 0.5}));
+        }
+        BOOST_TEST(tiered->function("f")->native != nullptr);
+        BOOST_TEST(tiered->function("square")->native != nullptr);
+        BOOST_TEST(tiered->function("count")->native == nullptr);
+        BOOST_TEST(interpreted->tiered() == 0u);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
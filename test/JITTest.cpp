@@ -0,0 +1,301 @@
+/** \file JITTest.cpp
+ * JIT test module
+ *
+ * \author Filip Smola
+ */
+#define BOOST_TEST_MODULE "JIT"
+
+#include <basilisk/Parser.h>
+#include <basilisk/Tokens.h>
+#include <basilisk/Lexer.h>
+#include <basilisk/Codegen.h>
+#include <basilisk/Optimization.h>
+#include <basilisk/JIT.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+using namespace basilisk;
+
+/** \class Compiled
+ * \brief Context and module generated from Basilisk source code
+ */
+class Compiled {
+    public:
+        std::unique_ptr<llvm::LLVMContext> context = std::make_unique<llvm::LLVMContext>();
+        std::unique_ptr<llvm::Module> module = std::make_unique<llvm::Module>("test_source", *context);
+
+        /**
+         * \brief Generate LLVM IR from Basilisk source code
+         *
+         * \param src Basilisk source code
+         * \param memoize Whether to memoize functions
+         * \param imports Functions of other programs that the program can call
+         */
+        explicit Compiled(const std::string &src, bool memoize = false,
+                          const std::vector<codegen::Prototype> &imports = {}) {
+            // Lex, reversing order to move top of the queue to the back of the vector
+            std::vector<tokens::Token> buffer;
+            lexer::lex(src, buffer);
+            std::reverse(buffer.begin(), buffer.end());
+
+            // Parse
+            parser::get_f_t parser_get = [&buffer](){
+                if (buffer.empty()) {
+                    return tokens::Token{tokens::tags::error, "No more input tokens."};
+                }
+                tokens::Token t = buffer.back();
+                buffer.pop_back();
+                return t;
+            };
+            parser::peek_f_t parser_peek = [&buffer](int offset) -> const tokens::Token & {
+                static const tokens::Token too_far{tokens::tags::error, "No token that far from the front of the input queue."};
+                if (static_cast<unsigned int>(offset) >= buffer.size()) {
+                    return too_far;
+                }
+                return buffer[buffer.size() - 1 - offset];
+            };
+            auto program = parser::ProgramParser(parser_get, parser_peek).program();
+
+            // Codegen
+            llvm::IRBuilder<> builder(*context);
+            codegen::NamedValuesStacks variables;
+            codegen::Settings settings;
+            settings.map_companions = true;
+            settings.memoize = memoize;
+            codegen::declare_prototypes(program, *module, imports);
+            codegen::ProgramCodegen program_cg(*context, builder, module.get(), variables, settings);
+            program.accept(program_cg);
+        }
+};
+
+BOOST_AUTO_TEST_SUITE(Engine)
+
+    BOOST_AUTO_TEST_CASE( main_return ) {
+        Compiled compiled("main() {\n"
+                          "    return 42.0;\n"
+                          "}");
+        BOOST_TEST(jit::run(std::move(compiled.context), std::move(compiled.module)) == 42);
+    }
+
+    BOOST_AUTO_TEST_CASE( global_init ) {
+        Compiled compiled("a = 2.0;\n"
+                          "b = a * 3.0;\n"
+                          "main() {\n"
+                          "    return b + 1.0;\n"
+                          "}");
+        BOOST_TEST(jit::run(std::move(compiled.context), std::move(compiled.module)) == 7);
+    }
+
+    BOOST_AUTO_TEST_CASE( optimized ) {
+        Compiled compiled("a = 5.0;\n"
+                          "square(x) {\n"
+                          "    return x * x;\n"
+                          "}\n"
+                          "main() {\n"
+                          "    println(a);\n"
+                          "    return square(a);\n"
+                          "}");
+        optimization::optimize(*compiled.module, optimization::Level::O3);
+        BOOST_TEST(jit::run(std::move(compiled.context), std::move(compiled.module)) == 25);
+    }
+
+    BOOST_AUTO_TEST_CASE( profile_instrumented ) {
+        // Instrumented code needs the profile runtime, so it is only checked for its counters
+        Compiled compiled("square(x) {\n"
+                          "    return x * x;\n"
+                          "}\n"
+                          "main() {\n"
+                          "    return square(3.0);\n"
+                          "}");
+        optimization::Profile profile;
+        profile.generate = true;
+        profile.generate_file = "square.profraw";
+        optimization::optimize(*compiled.module, optimization::Level::O2, nullptr, profile);
+        BOOST_TEST(compiled.module->getGlobalVariable("__profc_square", true), "Functions must have counters.");
+        BOOST_TEST(compiled.module->getGlobalVariable("__llvm_profile_filename"), "Profile file must be set.");
+    }
+
+    BOOST_AUTO_TEST_CASE( lookup_function ) {
+        Compiled compiled("scale = 1.5;\n"
+                          "f(x, y) {\n"
+                          "    return scale * x + y;\n"
+                          "}");
+        jit::Engine engine;
+        engine.add(std::move(compiled.context), std::move(compiled.module));
+        engine.initialize();
+        auto f = reinterpret_cast<double (*)(double, double)>(engine.lookup("f"));
+        BOOST_TEST(f(2.0, 0.5) == 3.5);
+    }
+
+    BOOST_AUTO_TEST_CASE( several_modules ) {
+        // Each module initializes its own global variables, so the initializers must not clash
+        Compiled first("a = 2.0;\n"
+                       "f() {\n"
+                       "    a = a + 1.0;\n"
+                       "    return a;\n"
+                       "}");
+        Compiled second("b = 5.0;\n"
+                        "g() {\n"
+                        "    b = b * 2.0;\n"
+                        "    return b;\n"
+                        "}");
+        jit::Engine engine;
+        engine.add(std::move(first.context), std::move(first.module));
+        engine.add(std::move(second.context), std::move(second.module));
+        engine.initialize();
+        auto f = reinterpret_cast<double (*)()>(engine.lookup("f"));
+        auto g = reinterpret_cast<double (*)()>(engine.lookup("g"));
+        BOOST_TEST(f() == 3.0);
+        BOOST_TEST(g() == 10.0);
+    }
+
+    BOOST_AUTO_TEST_CASE( cross_program_calls ) {
+        // Each program can call the functions of the other, whichever comes first
+        std::string first_src = "half(x) {\n"
+                                "    return x / 2.0;\n"
+                                "}\n"
+                                "f(x) {\n"
+                                "    return twice(half(x)) + 1.0;\n"
+                                "}";
+        std::string second_src = "twice(x) {\n"
+                                 "    return x * 2.0;\n"
+                                 "}\n"
+                                 "g(x) {\n"
+                                 "    return half(twice(x)) - 1.0;\n"
+                                 "}";
+        auto first_prototypes = codegen::prototypes(parser::parse(first_src));
+        auto second_prototypes = codegen::prototypes(parser::parse(second_src));
+        BOOST_TEST_REQUIRE(first_prototypes.size() == 2);
+        BOOST_TEST(first_prototypes[0].name == "half");
+        BOOST_TEST(first_prototypes[0].arity == 1);
+
+        Compiled first(first_src, false, second_prototypes);
+        Compiled second(second_src, false, first_prototypes);
+        jit::Engine engine;
+        engine.add(std::move(first.context), std::move(first.module));
+        engine.add(std::move(second.context), std::move(second.module));
+        engine.initialize();
+        auto f = reinterpret_cast<double (*)(double)>(engine.lookup("f"));
+        auto g = reinterpret_cast<double (*)(double)>(engine.lookup("g"));
+        BOOST_TEST(f(6.0) == 7.0);
+        BOOST_TEST(g(6.0) == 5.0);
+    }
+
+    BOOST_AUTO_TEST_CASE( cross_program_own_definition ) {
+        // A function the program defines itself takes precedence over one of another program, and `main` is not shared
+        auto prototypes = codegen::prototypes(parser::parse("half(x) {\n"
+                                                            "    return x / 2.0;\n"
+                                                            "}\n"
+                                                            "main() {\n"
+                                                            "    return 0.0;\n"
+                                                            "}"));
+        BOOST_TEST(prototypes.size() == 1);
+        Compiled compiled("half(x) {\n"
+                          "    return x / 4.0;\n"
+                          "}\n"
+                          "main() {\n"
+                          "    return half(8.0);\n"
+                          "}", false, prototypes);
+        BOOST_TEST(jit::run(std::move(compiled.context), std::move(compiled.module)) == 2);
+    }
+
+    BOOST_AUTO_TEST_CASE( map_companion ) {
+        Compiled compiled("offset = 0.5;\n"
+                          "f(x, y) {\n"
+                          "    return x * y + offset;\n"
+                          "}");
+        optimization::optimize(*compiled.module, optimization::Level::O2);
+        jit::Engine engine;
+        engine.add(std::move(compiled.context), std::move(compiled.module));
+        engine.initialize();
+
+        // Odd number of elements to cover the remainder of the vectorized loop
+        std::vector<double> x{1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0}, y{7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0}, out(7);
+        auto f_map = reinterpret_cast<void (*)(const double *, const double *, double *, std::int64_t)>(
+                engine.lookup("f_map"));
+        f_map(x.data(), y.data(), out.data(), 7);
+        for (std::size_t i = 0; i < out.size(); i++) {
+            BOOST_TEST(out[i] == x[i] * y[i] + 0.5);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( memoized ) {
+        Compiled compiled("square(x) {\n"
+                          "    return x * x;\n"
+                          "}\n"
+                          "f(x, y) {\n"
+                          "    return square(x) - square(y);\n"
+                          "}", true);
+        optimization::optimize(*compiled.module, optimization::Level::O2);
+        jit::Engine engine;
+        engine.add(std::move(compiled.context), std::move(compiled.module));
+        engine.initialize();
+
+        // Repeated and colliding arguments, including zeros of both signs
+        auto f = reinterpret_cast<double (*)(double, double)>(engine.lookup("f"));
+        for (int round = 0; round < 2; round++) {
+            for (int i = 0; i < 3000; i++) {
+                BOOST_TEST_REQUIRE(f(i, 1.0) == i * i - 1.0);
+            }
+        }
+        BOOST_TEST(f(-0.0, 0.0) == 0.0);
+        BOOST_TEST(f(2.0, 3.0) == -5.0);
+        BOOST_TEST(f(3.0, 2.0) == 5.0);
+    }
+
+    BOOST_AUTO_TEST_CASE( missing_main ) {
+        Compiled compiled("f() {\n"
+                          "    return 1.0;\n"
+                          "}");
+        BOOST_CHECK_THROW(jit::run(std::move(compiled.context), std::move(compiled.module)), jit::JITException);
+    }
+
+    BOOST_AUTO_TEST_CASE( object ) {
+        Compiled compiled("a = 2.0;\n"
+                          "main() {\n"
+                          "    return a + 1.0;\n"
+                          "}");
+
+        // Compile the object in one engine
+        jit::Object object;
+        {
+            jit::Engine engine;
+            object = engine.compile(*compiled.module);
+        }
+        BOOST_TEST(!object.code.empty());
+        BOOST_TEST(object.constructors.size() == 1u);
+
+        // Run it in another
+        jit::Engine engine;
+        engine.add(object);
+        BOOST_TEST(engine.run() == 3);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Object)
+
+    BOOST_AUTO_TEST_CASE( serialize ) {
+        jit::Object object{std::string("\x7f" "ELF\ncode\n\0", 12), {"init_a", "init_b"}, {"fini"}};
+
+        jit::Object result;
+        BOOST_TEST_REQUIRE(jit::Object::deserialize(object.serialize(), result));
+        BOOST_TEST(result.code == object.code);
+        BOOST_TEST(result.constructors == object.constructors);
+        BOOST_TEST(result.destructors == object.destructors);
+    }
+
+    BOOST_AUTO_TEST_CASE( invalid ) {
+        jit::Object result;
+        BOOST_TEST(!jit::Object::deserialize("", result));
+        BOOST_TEST(!jit::Object::deserialize("\x7f" "ELF", result));
+        BOOST_TEST(!jit::Object::deserialize("basilisk-object 1\nctor a\n", result));
+        BOOST_TEST(!jit::Object::deserialize("basilisk-object 1\nname a\ncode\n", result));
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -16,6 +16,7 @@
 #include <string>
 #include <functional>
 #include <map>
+#include <vector>
 
 namespace tokens = basilisk::tokens;
 namespace tags = tokens::tags;
@@ -32,6 +33,8 @@ struct QueuesFixture {
     in_queue_t input;
     //! Lexer output queue
     out_queue_t output;
+    //! Buffer holding the lexed input, which the output tokens refer to
+    std::string source;
 
     /**
      * \brief Pop a character from the front of the input queue and return it
@@ -88,7 +91,7 @@ struct QueuesFixture {
         auto get_f = std::bind(&QueuesFixture::get, this);
         auto peek_f = std::bind(&QueuesFixture::peek, this);
         auto append_f = std::bind(&QueuesFixture::append, this, std::placeholders::_1);
-        lexer::lex(get_f, peek_f, append_f);
+        lexer::lex(get_f, peek_f, append_f, source);
     }
 };
 
@@ -439,4 +442,170 @@ BOOST_AUTO_TEST_CASE(empty) {
     test_input(input, correct);
 }
 
+//! Test lexing directly from a contiguous buffer
+BOOST_AUTO_TEST_SUITE(buffer)
+
+//! Test buffer lexing produces the same tokens as the callback interface
+BOOST_AUTO_TEST_CASE(matches_callback) {
+    // Data
+    std::string input = "pi = 3.14;\nget_pi() {\n    return pi % (2.0 * -x);\n}\n";
+
+    // Lex through the callback interface
+    QueuesFixture q;
+    q.load(input);
+    q.lex();
+    std::vector<tokens::Token> correct;
+    for (; !q.output.empty(); q.output.pop()) {
+        correct.push_back(q.output.front());
+    }
+
+    // Lex the buffer
+    auto result = lexer::lex(input);
+
+    // Check
+    BOOST_TEST_CHECK(result == correct, "Buffer lexing must produce the same tokens as callback lexing.");
+}
+
+//! Test lexing a pointer and length stops at the end of the provided span
+BOOST_AUTO_TEST_CASE(span) {
+    // Data
+    std::string input = "abc def";
+    std::vector<tokens::Token> correct{{tags::identifier, "abc"}, {tags::end_of_input, ""}};
+
+    // Lex only the first three characters
+    auto result = lexer::lex(input.data(), 3);
+
+    // Check
+    BOOST_TEST_CHECK(result == correct, "Lexing a span must ignore characters past its end.");
+}
+
+//! Test lexing stops at the null character inside the buffer
+BOOST_AUTO_TEST_CASE(null_terminated) {
+    // Data
+    std::string input("abc\0def", 7);
+    std::vector<tokens::Token> correct{{tags::identifier, "abc"}, {tags::end_of_input, ""}};
+
+    // Lex
+    auto result = lexer::lex(input);
+
+    // Check
+    BOOST_TEST_CHECK(result == correct, "Lexing must stop at the null character.");
+}
+
+//! Test output contains the tokens before the error when lexing fails
+BOOST_AUTO_TEST_CASE(partial_output) {
+    // Data
+    std::string input = "a = $";
+    std::vector<tokens::Token> output;
+
+    // Lex the input (should throw LexerException)
+    BOOST_CHECK_THROW(lexer::lex(input, output), lexer::LexerException);
+
+    // Check the tokens before the error and the error itself were appended
+    BOOST_TEST_CHECK(output.size() == 3);
+    BOOST_TEST_CHECK(output.back().tag == tags::error);
+}
+
+//! Test token contents refer to the input buffer instead of copying it
+BOOST_AUTO_TEST_CASE(zero_copy) {
+    // Data
+    std::string input = "abc = 1.5;";
+
+    // Lex
+    auto result = lexer::lex(input);
+
+    // Check the identifier and literal contents point into the input
+    BOOST_TEST_CHECK(result[0].content.data() == input.data(), "Identifier content must refer to the input.");
+    BOOST_TEST_CHECK(result[2].content.data() == input.data() + 6, "Literal content must refer to the input.");
+}
+
+//! Test error token contains the offending text
+BOOST_AUTO_TEST_CASE(error_content) {
+    // Data
+    std::string input = "a 12x";
+    std::vector<tokens::Token> output;
+
+    // Lex the input (should throw LexerException)
+    BOOST_CHECK_THROW(lexer::lex(input, output), lexer::LexerException);
+
+    // Check the error token refers to the offending text
+    BOOST_TEST_CHECK((output.back() == tokens::Token{tags::error, "12x"}), "Error token must contain the offending text.");
+}
+
+//! Test long runs of whitespace, identifier characters and digits of every length around the vector widths
+BOOST_AUTO_TEST_CASE(long_runs) {
+    for (std::size_t n = 1; n <= 70; n++) {
+        // Data
+        std::string name = "a" + std::string(n, '_') + std::string(n, 'Z') + std::string(n, '9');
+        std::string number = std::string(n, '1') + "." + std::string(n, '2');
+        std::string input = std::string(n, ' ') + name + std::string(n, '\t') + "=\n\r\v\f" + number + std::string(n, ' ');
+        std::vector<tokens::Token> correct{
+                tokens::Token{tags::identifier, name},
+                tokens::Token{tags::assign, ""},
+                tokens::Token{tags::double_literal, number},
+                tokens::Token{tags::end_of_input, ""}
+        };
+
+        // Lex the buffer
+        auto result = lexer::lex(input);
+
+        // Check
+        BOOST_TEST_CHECK(result == correct, "Runs of length " << n << " must be lexed whole.");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END() // buffer
+
+//! Test lexing on demand through a token stream
+BOOST_AUTO_TEST_SUITE(stream)
+
+//! Test the stream produces the same tokens as buffer lexing
+BOOST_AUTO_TEST_CASE(matches_buffer) {
+    // Data
+    std::string input = "pi = 3.14;\nget_pi() {\n    return pi % (2.0 * -x);\n}\n";
+    auto correct = lexer::lex(input);
+
+    // Read the stream, peeking ahead before each token
+    lexer::TokenStream stream(input);
+    std::vector<tokens::Token> result;
+    for (std::size_t i = 0; i < correct.size(); i++) {
+        if (i + 1 < correct.size()) {
+            BOOST_TEST_CHECK(stream.peek(1) == correct[i + 1]);
+        }
+        BOOST_TEST_CHECK(stream.peek(0) == correct[i]);
+        result.push_back(stream.get());
+    }
+
+    // Check
+    BOOST_TEST_CHECK(result == correct, "Stream must produce the same tokens as buffer lexing.");
+    BOOST_TEST_CHECK(stream.count() == correct.size());
+    BOOST_TEST_CHECK(stream.get().tag == tags::error, "Stream must produce error tokens after its end.");
+}
+
+//! Test the stream lexes only as far as it was looked ahead
+BOOST_AUTO_TEST_CASE(on_demand) {
+    // Data
+    std::string input = "a b c d e f $";
+    lexer::TokenStream stream(input);
+
+    // Look ahead as far as possible, but not past the lookahead
+    BOOST_TEST_CHECK(stream.count() == 0u);
+    BOOST_TEST_CHECK((stream.peek(lexer::TokenStream::lookahead - 1) == tokens::Token{tags::identifier, "d"}));
+    BOOST_TEST_CHECK(stream.peek(lexer::TokenStream::lookahead).tag == tags::error);
+    BOOST_TEST_CHECK(stream.count() == lexer::TokenStream::lookahead);
+
+    // Peeked references stay valid until their tokens are removed
+    auto &front = stream.peek(0);
+    stream.peek(2);
+    BOOST_TEST_CHECK((front == tokens::Token{tags::identifier, "a"}));
+
+    // Consume up to the invalid character, which only throws when needed
+    for (char c : std::string("abcdef")) {
+        BOOST_TEST_CHECK(stream.get().content == std::string(1, c));
+    }
+    BOOST_CHECK_THROW(stream.peek(0), lexer::LexerException);
+}
+
+BOOST_AUTO_TEST_SUITE_END() // stream
+
 BOOST_AUTO_TEST_SUITE_END() // Lexer
@@ -0,0 +1,297 @@
+/** \file ParallelTest.cpp
+ * Parallel code generation test module
+ *
+ * \author Filip Smola
+ */
+#define BOOST_TEST_MODULE "Parallel"
+
+#include <basilisk/Parser.h>
+#include <basilisk/Tokens.h>
+#include <basilisk/Lexer.h>
+#include <basilisk/Codegen.h>
+#include <basilisk/JIT.h>
+#include <basilisk/Parallel.h>
+#include <basilisk/AST_util.h>
+#include <basilisk/Cache.h>
+#include <basilisk/Optimization.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include "Common.h"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace basilisk;
+
+/**
+ * \brief Generate a program on multiple threads and print the module
+ *
+ * \param src Basilisk source code
+ * \param jobs Number of threads
+ * \return Printed module
+ */
+std::string generate(const std::string &src, unsigned jobs) {
+    auto program = parse_program(src);
+    llvm::LLVMContext context;
+    llvm::Module module("test_source", context);
+    parallel::Settings settings;
+    settings.jobs = jobs;
+    settings.shard_size = 2;
+    parallel::generate(program, module, {}, settings);
+    BOOST_TEST_REQUIRE(!llvm::verifyModule(module, &llvm::errs()), "Linked module must be valid.");
+
+    std::string result;
+    llvm::raw_string_ostream stream(result);
+    module.print(stream, nullptr);
+    return stream.str();
+}
+
+//! Program used in the tests, with functions calling ones from earlier shards and reading globals defined between them
+const char *source = "a = 2.0;\n"
+                     "square(x) { return x * x; }\n"
+                     "scale(x) { return a * x; }\n"
+                     "b = square(3.0);\n"
+                     "sum(x, y) { return square(x) + scale(y) + b; }\n"
+                     "print(x) { println(x); return x; }\n"
+                     "main() { return sum(1.0, 2.0) + print(a); }";
+
+BOOST_AUTO_TEST_SUITE(ForEach)
+
+    BOOST_AUTO_TEST_CASE( all_indices ) {
+        std::vector<std::atomic<int>> runs(100);
+        parallel::for_each(runs.size(), 4, [&runs](std::size_t i){ runs[i]++; });
+        BOOST_TEST(std::all_of(runs.begin(), runs.end(), [](const std::atomic<int> &r){ return r == 1; }));
+    }
+
+    BOOST_AUTO_TEST_CASE( lowest_exception ) {
+        std::atomic<int> count{0};
+        try {
+            parallel::for_each(10, 3, [&count](std::size_t i){
+                count++;
+                if (i == 7 || i == 4) {
+                    throw std::runtime_error(std::to_string(i));
+                }
+            });
+            BOOST_FAIL("Exception must be rethrown.");
+        } catch (std::runtime_error &e) {
+            BOOST_TEST(std::string(e.what()) == "4");
+        }
+        BOOST_TEST(count == 10, "All tasks must run.");
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Parse)
+
+    BOOST_AUTO_TEST_CASE( same_program ) {
+        auto sequential = parse_program(source);
+        auto expected = ast::util::PrintVisitor::print(sequential);
+        auto tokens = lexer::lex(source);
+        for (unsigned jobs : {1u, 2u, 8u}) {
+            auto program = parallel::parse(tokens, jobs);
+            BOOST_TEST(program.definitions.size() == 7u);
+            BOOST_TEST(ast::util::PrintVisitor::print(program) == expected);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( empty ) {
+        BOOST_TEST(parallel::parse(lexer::lex(""), 4).definitions.empty());
+    }
+
+    BOOST_AUTO_TEST_CASE( errors ) {
+        // Missing semicolon, unclosed and unopened bodies
+        BOOST_CHECK_THROW(parallel::parse(lexer::lex("a = 1.0;\nb = 2.0\nc = 3.0;\nd = 4.0;"), 8),
+                          parser::ParserException);
+        BOOST_CHECK_THROW(parallel::parse(lexer::lex("a = 1.0;\nf() { return a;\nb = 2.0;"), 8),
+                          parser::ParserException);
+        BOOST_CHECK_THROW(parallel::parse(lexer::lex("a = 1.0;\n}\nb = 2.0;\nc = 3.0;"), 8),
+                          parser::ParserException);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Generate)
+
+    BOOST_AUTO_TEST_CASE( deterministic ) {
+        auto single = generate(source, 1);
+        BOOST_TEST(generate(source, 3) == single);
+        BOOST_TEST(generate(source, 8) == single);
+    }
+
+    BOOST_AUTO_TEST_CASE( run ) {
+        auto program = parse_program(source);
+        auto context = std::make_unique<llvm::LLVMContext>();
+        auto module = std::make_unique<llvm::Module>("test_source", *context);
+        parallel::Settings settings;
+        settings.jobs = 2;
+        settings.shard_size = 1;
+        settings.level = optimization::Level::O2;
+        parallel::generate(program, *module, {}, settings);
+
+        // sum(1, 2) + print(2) = 1 + 4 + 9 + 2
+        BOOST_TEST(jit::run(std::move(context), std::move(module)) == 16);
+    }
+
+    BOOST_AUTO_TEST_CASE( empty ) {
+        BOOST_TEST(!generate("a = 1.0;", 2).empty());
+    }
+
+    BOOST_AUTO_TEST_CASE( resolution ) {
+        // Functions defined later are not visible, as on one thread
+        BOOST_CHECK_THROW(generate("f() { return g(); }\n"
+                                   "g() { return 1.0; }", 2), codegen::CodegenException);
+        BOOST_CHECK_THROW(generate("f() { return g; }\n"
+                                   "g = 1.0;", 2), codegen::CodegenException);
+        BOOST_CHECK_THROW(generate("f() { return 1.0; }\n"
+                                   "f(x) { return x; }", 2), codegen::CodegenException);
+    }
+
+    BOOST_AUTO_TEST_CASE( declared ) {
+        // Functions declared beforehand are defined in other modules, and can be called from any shard
+        auto program = parse_program("f(x) { return square(x) + 1.0; }\n"
+                                     "g(x) { return f(x) * square(x); }");
+        llvm::LLVMContext context;
+        llvm::Module module("test_source", context);
+        auto double_ty = llvm::Type::getDoubleTy(context);
+        llvm::Function::Create(llvm::FunctionType::get(double_ty, {double_ty}, false),
+                llvm::Function::ExternalLinkage, "square", &module);
+        parallel::Settings settings;
+        settings.jobs = 2;
+        settings.shard_size = 1;
+        parallel::generate(program, module, {}, settings);
+
+        BOOST_TEST(!llvm::verifyModule(module, &llvm::errs()));
+        BOOST_TEST(module.getFunction("square")->isDeclaration());
+        BOOST_TEST(module.getFunction("square")->getNumUses() == 2u);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/** \class Directory
+ * \brief Unique temporary directory, removed with its contents on destruction
+ */
+class Directory {
+    public:
+        llvm::SmallString<128> path;
+
+        Directory() { llvm::sys::fs::createUniqueDirectory("basilisk-parallel-test", path); }
+        ~Directory() { llvm::sys::fs::remove_directories(path); }
+};
+
+/**
+ * \brief Generate a program one function per shard with a cache and print the module
+ *
+ * \param src Basilisk source code
+ * \param cache Cache of the shards
+ * \param reused Number of shards taken from the cache
+ * \param target_machine Target machine to configure and optimize the module for, or `nullptr` for none
+ * \return Printed module
+ */
+std::string generate_cached(const std::string &src, cache::ObjectCache &cache, std::size_t &reused,
+        const llvm::TargetMachine *target_machine = nullptr) {
+    auto program = parse_program(src);
+    llvm::LLVMContext context;
+    llvm::Module module("test_source", context);
+    if (target_machine) {
+        optimization::configure(module, *target_machine);
+    }
+    parallel::Settings settings;
+    settings.jobs = 2;
+    settings.shard_size = 1;
+    settings.level = optimization::Level::O2;
+    settings.cache = &cache;
+    settings.target_machine = target_machine;
+    reused = parallel::generate(program, module, {}, settings);
+    BOOST_TEST_REQUIRE(!llvm::verifyModule(module, &llvm::errs()), "Linked module must be valid.");
+
+    std::string result;
+    llvm::raw_string_ostream stream(result);
+    module.print(stream, nullptr);
+    return stream.str();
+}
+
+BOOST_AUTO_TEST_SUITE(Incremental)
+
+    BOOST_AUTO_TEST_CASE( reuse ) {
+        Directory directory;
+        cache::ObjectCache cache(directory.path.str().str());
+        std::size_t reused = 0;
+
+        // Nothing to reuse at first, everything when compiling again
+        auto first = generate_cached(source, cache, reused);
+        BOOST_TEST(reused == 0u);
+        BOOST_TEST(generate_cached(source, cache, reused) == first);
+        BOOST_TEST(reused == 5u);
+
+        // Adding a global variable no function refers to keeps every function
+        BOOST_TEST(!generate_cached(std::string("c = 1.0;\n") + source, cache, reused).empty());
+        BOOST_TEST(reused == 5u);
+    }
+
+    BOOST_AUTO_TEST_CASE( changes ) {
+        Directory directory;
+        cache::ObjectCache cache(directory.path.str().str());
+        std::size_t reused = 0;
+        generate_cached(source, cache, reused);
+
+        // Changing a body regenerates only that function, as the effects and signatures stay the same
+        std::string changed = "a = 2.0;\n"
+                              "square(x) { return x * x * 1.5; }\n"
+                              "scale(x) { return a * x; }\n"
+                              "b = square(3.0);\n"
+                              "sum(x, y) { return square(x) + scale(y) + b; }\n"
+                              "print(x) { println(x); return x; }\n"
+                              "main() { return sum(1.0, 2.0) + print(a); }";
+        std::size_t fresh_reused = 0;
+        Directory fresh_directory;
+        cache::ObjectCache fresh(fresh_directory.path.str().str());
+        BOOST_TEST(generate_cached(changed, cache, reused) == generate_cached(changed, fresh, fresh_reused));
+        BOOST_TEST(reused == 4u);
+
+        // Changing the effects of a function regenerates its callers as well
+        changed = "a = 2.0;\n"
+                  "square(x) { println(x); return x * x; }\n"
+                  "scale(x) { return a * x; }\n"
+                  "b = square(3.0);\n"
+                  "sum(x, y) { return square(x) + scale(y) + b; }\n"
+                  "print(x) { println(x); return x; }\n"
+                  "main() { return sum(1.0, 2.0) + print(a); }";
+        generate_cached(changed, cache, reused);
+        BOOST_TEST(reused == 3u);
+
+        // Removing callees makes their callers fail again
+        BOOST_CHECK_THROW(generate_cached("a = 2.0;\n"
+                                          "b = 9.0;\n"
+                                          "sum(x, y) { return square(x) + scale(y) + b; }", cache, reused),
+                          codegen::CodegenException);
+    }
+
+    BOOST_AUTO_TEST_CASE( target ) {
+        Directory directory;
+        cache::ObjectCache cache(directory.path.str().str());
+        std::size_t reused = 0;
+        generate_cached(source, cache, reused);
+
+        // The functions optimized without a target don't stand in for those optimized for one
+        jit::Engine engine;
+        auto targeted = generate_cached(source, cache, reused, &engine.host_machine());
+        BOOST_TEST(reused == 0u);
+        BOOST_TEST(targeted.find("\"target-cpu\"=\"" + engine.host_machine().getTargetCPU().str() + "\"")
+                   != std::string::npos);
+
+        // Those optimized for the same target do
+        BOOST_TEST(generate_cached(source, cache, reused, &engine.host_machine()) == targeted);
+        BOOST_TEST(reused == 5u);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -26,6 +26,8 @@ struct QueuesFixture {
     // Note: queue front is the vector back
     typedef std::vector<tokens::Token> token_queue_t;
 
+    //! Source the input tokens refer to
+    std::string source;
     //! Parser input queue in reverse order (back of this is front of queue)
     token_queue_t input;
     //! Parser compatible get function reference
@@ -41,39 +43,12 @@ struct QueuesFixture {
     /**
      * \brief Construct fixture by lexing a string (ignoring any exceptions raised)
      *
-     * /param src Source string to lex
+     * \param src Source string to lex
      */
-    explicit QueuesFixture(const std::string &src) {
-        // Prepare iterator
-        auto iterator = src.begin();
-        auto end = src.end();
-
-        // Prepare functions
-        basilisk::lexer::get_function_t lexer_get = [&iterator, &end](){
-            // Return null character when no more input
-            if (iterator >= end) {
-                return '\0';
-            }
-
-            // Pop and return character
-            auto buffer = *iterator;
-            iterator++;
-            return buffer;
-        };
-        basilisk::lexer::peek_function_t lexer_peek = [&iterator, &end](){
-            // Return null character when no more input
-            if (iterator >= end) {
-                return '\0';
-            }
-
-            // Return character
-            return *iterator;
-        };
-        basilisk::lexer::append_function_t lexer_append = [this](tokens::Token t){ this->input.push_back(t); };
-
+    explicit QueuesFixture(const std::string &src) : source(src) {
         // Lex
         try {
-            basilisk::lexer::lex(lexer_get, lexer_peek, lexer_append);
+            basilisk::lexer::lex(source, input);
         } catch (std::exception &/*e*/) {}
 
         // Reverse order to move top of the queue to the back of the vector
@@ -102,12 +77,11 @@ struct QueuesFixture {
      * \param offset Offset of the sought element from the front of the queue
      * \return Token \c offset elements from the front of the input queue, or the error token when not present
      */
-    tokens::Token peek(unsigned offset) {
+    const tokens::Token &peek(unsigned offset) {
         // Return error token if not valid
+        static const tokens::Token too_far{tags::error, "No token that far from the front of the input queue."};
         if (offset >= input.size()) {
-            std::ostringstream message;
-            message << "No token " << offset << " elements from the front of the input queue.";
-            return tokens::Token{tags::error, message.str()};
+            return too_far;
         }
 
         // Compute index
@@ -1309,6 +1283,24 @@ BOOST_AUTO_TEST_SUITE(Parser)
                 compare_ast(&result, &correct);
             }
 
+            // Check the program owns the arena its nodes are allocated from
+            BOOST_AUTO_TEST_CASE( arena ) {
+                // Construct fixture
+                QueuesFixture qf("x = 1.0;\nf(a) {\n    return a + x;\n}\n");
+
+                // Parse
+                auto result = parser::ProgramParser(qf.get_f, qf.peek_f).program();
+
+                // Check the arena holds the nodes
+                BOOST_TEST_REQUIRE((result.arena != nullptr), "Program does not own an arena.");
+                BOOST_TEST_CHECK(result.arena->size() > 0, "Program nodes not allocated in the arena.");
+
+                // Check moving the program keeps the nodes valid
+                ast::Program moved(std::vector<std::unique_ptr<ast::Definition>>{});
+                moved = std::move(result);
+                BOOST_TEST_CHECK(moved.definitions.size() == 2, "Moved program lost its definitions.");
+            }
+
             // Check end of input token gets consumed
             BOOST_AUTO_TEST_CASE( eoi_consumed ){
                 // Construct fixture
@@ -0,0 +1,93 @@
+/** \file RuntimeTest.cpp
+ * Runtime support test module
+ *
+ * \author Filip Smola
+ */
+#define BOOST_TEST_MODULE "Runtime"
+
+#include <basilisk/Parser.h>
+#include <basilisk/Tokens.h>
+#include <basilisk/Codegen.h>
+#include <basilisk/JIT.h>
+#include <basilisk/Runtime.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <llvm/IR/IRBuilder.h>
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <string>
+
+using namespace basilisk;
+
+/**
+ * \brief Format a value with the runtime
+ *
+ * \param x Value to format
+ * \return Formatted value
+ */
+std::string format(double x) {
+    char out[runtime::max_length];
+    return std::string(out, runtime::format(x, out));
+}
+
+/**
+ * \brief Format a value with `printf`
+ *
+ * \param x Value to format
+ * \return Formatted value
+ */
+std::string format_printf(double x) {
+    char out[runtime::max_length];
+    auto length = std::snprintf(out, sizeof(out), "%f\n", x);
+    return std::string(out, static_cast<std::size_t>(length));
+}
+
+BOOST_AUTO_TEST_SUITE(Format)
+
+    BOOST_AUTO_TEST_CASE( matches_printf ) {
+        // Including exactly halfway cases, which are rounded to even on the binary value
+        for (double x : {0.0, -0.0, 1.0, -2.5, 0.1, 1.0 / 3.0, 0.0000005, 0.0000015, 0.0000025, 2.0000005, 123456789.125,
+                         1e-7, -1e-300, 9007199254740993.0, 1e22, std::numeric_limits<double>::denorm_min()}) {
+            BOOST_TEST(format(x) == format_printf(x));
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE( special_values ) {
+        auto infinity = std::numeric_limits<double>::infinity();
+        BOOST_TEST(format(infinity) == format_printf(infinity));
+        BOOST_TEST(format(-infinity) == format_printf(-infinity));
+        BOOST_TEST(format(std::nan("")) == format_printf(std::nan("")));
+    }
+
+    BOOST_AUTO_TEST_CASE( longest ) {
+        auto max = std::numeric_limits<double>::max();
+        BOOST_TEST(format(-max) == format_printf(-max));
+        BOOST_TEST(format(-max).size() <= runtime::max_length);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Output)
+
+    BOOST_AUTO_TEST_CASE( jit_flush ) {
+        // The JIT resolves the runtime and runs its flush as a global destructor
+        auto program = parser::parse("main() { println(1.0); println(2.0); return 7.0; }");
+
+        auto context = std::make_unique<llvm::LLVMContext>();
+        auto module = std::make_unique<llvm::Module>("test_source", *context);
+        {
+            llvm::IRBuilder<> builder(*context);
+            codegen::NamedValuesHash variables;
+            codegen::Settings settings;
+            settings.buffered_output = true;
+            codegen::ProgramCodegen program_cg(*context, builder, module.get(), variables, settings);
+            program.accept(program_cg);
+        }
+        BOOST_TEST(jit::run(std::move(context), std::move(module)) == 7);
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
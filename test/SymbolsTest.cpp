@@ -0,0 +1,105 @@
+/** \file SymbolsTest.cpp
+ * Symbol pool test module
+ *
+ * \author Filip Smola
+ */
+#define BOOST_TEST_MODULE "Symbols"
+
+#include <basilisk/Symbols.h>
+#include <basilisk/Lexer.h>
+#include <basilisk/Tokens.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <unordered_set>
+
+namespace symbols = basilisk::symbols;
+namespace tokens = basilisk::tokens;
+namespace tags = basilisk::tokens::tags;
+namespace lexer = basilisk::lexer;
+
+BOOST_AUTO_TEST_SUITE(Symbols)
+
+    // Check the default symbol is the empty name
+    BOOST_AUTO_TEST_CASE( empty ) {
+        symbols::Symbol a;
+        symbols::Symbol b("");
+
+        BOOST_TEST_CHECK(a.empty(), "Default symbol is not empty.");
+        BOOST_TEST_CHECK((a == b), "Symbol of the empty name is not the default symbol.");
+        BOOST_TEST_CHECK(a.str().empty(), "Default symbol has a name.");
+    }
+
+    // Check equal names produce equal symbols regardless of source
+    BOOST_AUTO_TEST_CASE( equal_names ) {
+        std::string name = "some_name";
+        symbols::Symbol a(name);
+        symbols::Symbol b("some_name");
+        symbols::Symbol c{std::string_view(name)};
+
+        BOOST_TEST_CHECK((a == b), "Symbols of equal names are not equal.");
+        BOOST_TEST_CHECK((a == c), "Symbols of equal names are not equal.");
+        BOOST_TEST_CHECK(a.str() == name, "Symbol does not preserve the name.");
+        BOOST_TEST_CHECK(&a.str() == &b.str(), "Symbols of equal names do not share the interned name.");
+    }
+
+    // Check different names produce different symbols
+    BOOST_AUTO_TEST_CASE( different_names ) {
+        symbols::Symbol a("name_a");
+        symbols::Symbol b("name_b");
+
+        BOOST_TEST_CHECK((a != b), "Symbols of different names are equal.");
+        BOOST_TEST_CHECK((std::hash<symbols::Symbol>()(a) != std::hash<symbols::Symbol>()(b)),
+                "Symbols of different names have the same hash.");
+    }
+
+    // Check streaming writes the name
+    BOOST_AUTO_TEST_CASE( stream ) {
+        std::ostringstream out;
+        out << symbols::Symbol("streamed");
+
+        BOOST_TEST_CHECK(out.str() == "streamed", "Streaming a symbol does not write its name.");
+    }
+
+    // Check the lexer attaches symbols to identifier tokens only
+    BOOST_AUTO_TEST_CASE( lexer_tokens ) {
+        auto result = lexer::lex("x = 1.0; return x;");
+
+        BOOST_TEST_CHECK((result[0].symbol == symbols::Symbol("x")), "Identifier token does not carry its symbol.");
+        BOOST_TEST_CHECK((result[0].symbol == result[5].symbol), "Equal identifiers carry different symbols.");
+        BOOST_TEST_CHECK(result[2].symbol.empty(), "Literal token carries a symbol.");
+        BOOST_TEST_CHECK(result[4].symbol.empty(), "Keyword token carries a symbol.");
+    }
+
+    // Check concurrent interning agrees on the symbols
+    BOOST_AUTO_TEST_CASE( concurrent ) {
+        constexpr std::size_t thread_count = 4;
+        constexpr std::size_t name_count = 1000;
+
+        // Intern the same names from multiple threads at once
+        std::vector<std::vector<symbols::Symbol>> results(thread_count);
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < thread_count; t++) {
+            threads.emplace_back([&results, t]() {
+                for (std::size_t i = 0; i < name_count; i++) {
+                    results[t].emplace_back("concurrent_" + std::to_string(i));
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        // Check all threads got the same distinct symbols
+        std::unordered_set<symbols::Symbol> distinct(results[0].begin(), results[0].end());
+        BOOST_TEST_CHECK(distinct.size() == name_count, "Distinct names produced equal symbols.");
+        for (std::size_t t = 1; t < thread_count; t++) {
+            BOOST_TEST_CHECK((results[t] == results[0]), "Threads produced different symbols for the same names.");
+        }
+    }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,105 @@
+/** \file TimeReport.cpp
+ * Per-phase timing and memory report implementation
+ *
+ * \author Filip Smola
+ */
+
+#include "TimeReport.h"
+
+#include <iomanip>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+void TimeReport::begin(std::string name) {
+    if (!enabled) {
+        return;
+    }
+
+    end();
+    phases.push_back(Phase{std::move(name), clock_t::now() - origin, {}, 0, {}});
+    open = true;
+}
+
+void TimeReport::end() {
+    if (!enabled || !open) {
+        return;
+    }
+
+    auto &phase = phases.back();
+    phase.duration = clock_t::now() - origin - phase.start;
+    phase.peak_rss = peak_rss();
+    open = false;
+}
+
+void TimeReport::count(std::string name, std::uint64_t value) {
+    if (!enabled) {
+        return;
+    }
+
+    (open ? phases.back().counters : totals).emplace_back(std::move(name), value);
+}
+
+void TimeReport::print(std::ostream &stream) const {
+    auto milliseconds = [](clock_t::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    stream << "===-- basilisk time report --===\n"
+           << std::left << std::setw(12) << "phase" << std::right << std::setw(12) << "wall (ms)"
+           << std::setw(16) << "peak RSS (KiB)" << "  counters\n";
+
+    clock_t::duration total{};
+    for (auto &phase : phases) {
+        total += phase.duration;
+        stream << std::left << std::setw(12) << phase.name << std::right << std::setw(12) << std::fixed
+               << std::setprecision(3) << milliseconds(phase.duration) << std::setw(16) << phase.peak_rss << " ";
+        for (auto &counter : phase.counters) {
+            stream << ' ' << counter.first << '=' << counter.second;
+        }
+        stream << '\n';
+    }
+
+    stream << std::left << std::setw(12) << "total" << std::right << std::setw(12) << milliseconds(total)
+           << std::setw(16) << peak_rss() << " ";
+    for (auto &counter : totals) {
+        stream << ' ' << counter.first << '=' << counter.second;
+    }
+    stream << '\n';
+}
+
+void TimeReport::write_trace(std::ostream &stream) const {
+    auto microseconds = [](clock_t::duration d) { return std::chrono::duration<double, std::micro>(d).count(); };
+
+    // Complete events, one per phase, with the counters and peak RSS as arguments
+    stream << "{\"traceEvents\":[";
+    bool first = true;
+    for (auto &phase : phases) {
+        stream << (first ? "" : ",") << "\n{\"name\":\"" << phase.name << "\",\"cat\":\"basilisk\",\"ph\":\"X\""
+               << ",\"pid\":1,\"tid\":1,\"ts\":" << std::fixed << std::setprecision(3) << microseconds(phase.start)
+               << ",\"dur\":" << microseconds(phase.duration) << ",\"args\":{\"peak_rss_kib\":" << phase.peak_rss;
+        for (auto &counter : phase.counters) {
+            stream << ",\"" << counter.first << "\":" << counter.second;
+        }
+        stream << "}}";
+        first = false;
+    }
+    stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+std::uint64_t TimeReport::peak_rss() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    // Reported in bytes
+    return static_cast<std::uint64_t>(usage.ru_maxrss) / 1024;
+#else
+    // Reported in KiB
+    return static_cast<std::uint64_t>(usage.ru_maxrss);
+#endif
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,125 @@
+/** \file TimeReport.h
+ * Per-phase timing and memory report of the compiler executable
+ *
+ * \author Filip Smola
+ */
+#ifndef BASILISK_TIMEREPORT_H
+#define BASILISK_TIMEREPORT_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** \class TimeReport
+ * \brief Records wall time, peak memory and counters of the compilation phases
+ *
+ * Phases are recorded in order, each with its wall time, the peak resident set size at its end, and named counters
+ *  (for example the number of tokens).
+ * Counters that are not tied to a phase are recorded as totals.
+ * When disabled, nothing is recorded and the overhead is a branch per call.
+ */
+class TimeReport {
+    public:
+        //! Clock used for the wall time
+        typedef std::chrono::steady_clock clock_t;
+        //! Named counter
+        typedef std::pair<std::string, std::uint64_t> counter_t;
+
+        /** \struct Phase
+         * \brief Record of one phase
+         */
+        struct Phase {
+            //! Name of the phase
+            std::string name;
+            //! Start relative to the start of the report
+            clock_t::duration start;
+            //! Wall time of the phase
+            clock_t::duration duration;
+            //! Peak resident set size of the process at the end of the phase in KiB
+            std::uint64_t peak_rss;
+            //! Counters recorded during the phase
+            std::vector<counter_t> counters;
+        };
+
+        /** \class Scope
+         * \brief Records a phase for the lifetime of the scope
+         */
+        class Scope {
+            private:
+                //! Report to record into
+                TimeReport &report;
+            public:
+                //! Begin the phase
+                Scope(TimeReport &report, std::string name) : report(report) { report.begin(std::move(name)); }
+                //! End the phase
+                ~Scope() { report.end(); }
+
+                Scope(const Scope &) = delete;
+                Scope &operator=(const Scope &) = delete;
+        };
+    private:
+        //! Whether the report records anything
+        bool enabled;
+        //! Start of the report
+        clock_t::time_point origin = clock_t::now();
+        //! Recorded phases
+        std::vector<Phase> phases;
+        //! Counters not tied to a phase
+        std::vector<counter_t> totals;
+        //! Whether the last phase is still running
+        bool open = false;
+    public:
+        /**
+         * \brief Construct a time report
+         *
+         * \param enabled Whether to record anything
+         */
+        explicit TimeReport(bool enabled = false) : enabled(enabled) {}
+
+        //! Whether the report records anything
+        bool is_enabled() const { return enabled; }
+
+        /**
+         * \brief Begin a phase, ending the running one if any
+         *
+         * \param name Name of the phase
+         */
+        void begin(std::string name);
+        //! End the running phase
+        void end();
+        /**
+         * \brief Record a counter in the running phase, or in the totals when no phase is running
+         *
+         * \param name Name of the counter
+         * \param value Value of the counter
+         */
+        void count(std::string name, std::uint64_t value);
+
+        //! Recorded phases
+        const std::vector<Phase> &get() const { return phases; }
+
+        /**
+         * \brief Print the report as a table
+         *
+         * \param stream Output stream
+         */
+        void print(std::ostream &stream) const;
+        /**
+         * \brief Write the report as Chrome trace event JSON (viewable in `chrome://tracing` or Perfetto)
+         *
+         * \param stream Output stream
+         */
+        void write_trace(std::ostream &stream) const;
+
+        /**
+         * \brief Peak resident set size of the process
+         *
+         * \return Peak resident set size in KiB, or `0` where not supported
+         */
+        static std::uint64_t peak_rss();
+};
+
+#endif //BASILISK_TIMEREPORT_H
@@ -11,37 +11,100 @@
 #include <basilisk/AST.h>
 #include <basilisk/AST_util.h>
 #include <basilisk/Codegen.h>
+#include <basilisk/Optimization.h>
+#include <basilisk/JIT.h>
+#include <basilisk/Cache.h>
+#include <basilisk/Parallel.h>
+#include <basilisk/Interpreter.h>
 
+#include "TimeReport.h"
+
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/LegacyPassManager.h>
-#include <llvm/Transforms/InstCombine/InstCombine.h>
-#include <llvm/Transforms/Scalar.h>
-#include <llvm/Transforms/Scalar/GVN.h>
+#if LLVM_VERSION_MAJOR >= 11
+#include <llvm/IR/LLVMRemarkStreamer.h>
+#else
+#include <llvm/IR/RemarkStreamer.h>
+#endif
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/LTO/LTO.h>
+#include <llvm/Pass.h>
 #include <llvm/Support/TargetRegistry.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
 
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <math.h>
 #include <functional>
 #include <exception>
+#include <memory>
+#include <algorithm>
+#include <optional>
+#include <vector>
 
 //! Print usage into standard output
 // Note: inspired by output of `clang --help`
 void show_usage() {
     std::cout << "OVERVIEW: basilisk LLVM compiler\n\n"
-              << "USAGE: basilisk [options] file\n\n"
+              << "USAGE: basilisk [options] file...\n\n"
               << "OPTIONS:\n"
               << "\t-h, --help\n\t\tShow this screen.\n"
               << "\t-v, --version\n\t\tShow Basilisk version.\n"
-              << "\t-o, --output\n\t\tPath to output file. If not set, uses standard output stream.\n"
+              << "\t-o, --output\n\t\tPath to output file. If not set, uses standard output stream. With several input files, directory of the outputs (default: next to the inputs).\n"
               << "\t-l, --lex\n\t\tPerform only lexing, and output the tokens.\n"
               << "\t-p, --parse\n\t\tPerform only lexing and parsing, and output the AST.\n"
               << "\t-g, --codegen\n\t\tPerform only lexing, parsing and code generation, and output the LLVM IR.\n"
-              << "\t-G, --codegen-opt\n\t\tPerform only lexing, parsing, code generation and optimization, and output the optimized LLVM IR.\n";
+              << "\t-G, --codegen-opt\n\t\tPerform only lexing, parsing, code generation and optimization, and output the optimized LLVM IR.\n"
+              << "\t--emit-bc\n\t\tOutput LLVM bitcode instead of textual IR or object code, for example for link-time optimization.\n"
+              << "\t--thinlto\n\t\tOutput LLVM bitcode along with a ThinLTO module summary (implies --emit-bc).\n"
+              << "\t--cross-input-calls\n\t\tWith several input files, let each call the functions defined by the others, as if they were one program.\n"
+              << "\t--lto\n\t\tLink the bitcode input files with ThinLTO on -j threads, importing and inlining functions across them, into objects named `<output>.<i>.o`, and write their names into the output file.\n"
+              << "\t-r, --run\n\t\tCompile the program in memory and run it, exiting with the return value of main.\n"
+              << "\t--interpret\n\t\tRun the program in the bytecode interpreter, exiting with the return value of main.\n"
+              << "\t--tier-up=<n>\n\t\tWhen interpreting, compile pure functions in the JIT after n calls, 0 for never (default: 1000).\n"
+              << "\t--map-companions\n\t\tGenerate a vectorizable `<name>_map(const double *..., double *out, i64 n)` companion of each pure function.\n"
+              << "\t--memoize\n\t\tCache the results of pure functions that call other functions in a small per-function hash table.\n"
+              << "\t--buffered-output\n\t\tBuffer the output of println per thread and format it without printf. Objects then need to be linked with the basilisk_runtime library.\n"
+              << "\t--ffast-math\n\t\tAllow all fast-math transformations of floating-point arithmetic, including those below (default: strict IEEE 754 semantics).\n"
+              << "\t--fno-honor-nans, --fno-honor-infinities\n\t\tAssume floating-point arithmetic never has NaN or infinite arguments or results.\n"
+              << "\t--fno-signed-zeros\n\t\tIgnore the sign of floating-point zeros.\n"
+              << "\t--freciprocal-math\n\t\tAllow floating-point division to use the reciprocal of the divisor.\n"
+              << "\t--fassociative-math\n\t\tAllow floating-point arithmetic to be reassociated.\n"
+              << "\t--fp-contract=<off|on|fast>\n\t\tFuse floating-point multiplication and addition never, within one expression, or anywhere the optimizer finds them (default: off, fast with --ffast-math).\n"
+              << "\t-j <n>, -j<n>\n\t\tParse definitions and generate and optimize functions on n threads, 0 for one per hardware thread. The output doesn't depend on n. With several input files, compile the files on n threads instead.\n"
+              << "\t--split-codegen=<n>\n\t\tEmit the optimized module as n objects on n threads, named `<output>.<i>.o`, and write their names into the output file.\n"
+              << "\t-O0, -O1, -O2, -O3, -Os\n\t\tOptimization level of the LLVM pass pipeline and code generation (default: -O2).\n"
+              << "\t--target <triple>\n\t\tTarget triple to compile for (default: host triple).\n"
+              << "\t--cpu <name>\n\t\tTarget CPU to compile for, `native` for the host CPU (default: generic). Programs that are run are compiled for the host CPU and its features.\n"
+              << "\t--features <list>\n\t\tComma-separated target features such as `+avx2,+fma`, `native` for the host CPU features.\n"
+              << "\t-march=<name>\n\t\tShorthand for `--cpu <name>`, where `native` also selects the host CPU features.\n"
+              << "\t--cache-dir <dir>\n\t\tReuse object code compiled from the same source and options, kept in the directory.\n"
+              << "\t--incremental\n\t\tGenerate and optimize each function on its own, reusing the optimized IR of unchanged functions from the cache directory.\n"
+              << "\t--profile-gen[=<file>]\n\t\tInstrument the program to count the executions of its functions and branches into a raw profile (default: default.profraw). Objects then need to be linked with the profile runtime, e.g. `clang -fprofile-generate`.\n"
+              << "\t--profile-use=<file>\n\t\tOptimize with a profile merged from raw profiles by `llvm-profdata merge`, compiled with the same options.\n"
+              << "\t--remarks=<file>\n\t\tWrite the optimization remarks, such as missed inlining and vectorization, into the file as YAML.\n"
+              << "\t--report-recursion\n\t\tPrint which recursive functions are turned into loops into standard error stream.\n"
+              << "\t--time-report\n\t\tPrint wall time, peak memory and sizes of each phase into standard error stream.\n"
+              << "\t--time-trace <file>\n\t\tWrite the phases as Chrome trace event JSON to the file (implies --time-report).\n";
 }
 
 //! Print version into standard output
@@ -55,25 +118,18 @@ std::ostream& error() {
 }
 
 //----- Start Lexing Section
-//! Function to get a character from standard input
-char stdin_get() { return static_cast<char>(std::cin.get()); }
-//! Function to peek at a character from standard input
-char stdin_peek() { return static_cast<char>(std::cin.peek()); }
-
 /**
- * \brief Lex standard input stream
+ * \brief Lex a source buffer
  *
- * \param append_f Token append function
+ * \param source Source buffer
+ * \param output Output token buffer
  * \return `false` when there was a LexerException during lexing, `true` otherwise
  */
-bool lex_stdin(const basilisk::lexer::append_function_t &append_f) {
-    auto get_f = std::bind(&stdin_get);
-    auto peek_f = std::bind(&stdin_peek);
-
+bool lex_buffer(const llvm::MemoryBuffer &source, std::vector<basilisk::tokens::Token> &output) {
     // Try to lex
     try {
-        basilisk::lexer::lex(get_f, peek_f, append_f);
-    } catch (basilisk::lexer::LexerException e) {
+        basilisk::lexer::lex(std::string_view(source.getBufferStart(), source.getBufferSize()), output);
+    } catch (basilisk::lexer::LexerException &e) {
         // Print exception and return failure
         error() << "Lexer exception - " << e.what() << '\n';
         return false;
@@ -83,169 +139,1059 @@ bool lex_stdin(const basilisk::lexer::append_function_t &append_f) {
     return true;
 }
 
-//! Function to get a character from the provided stream
-char file_get(std::ifstream *stream) { return static_cast<char>(stream->get()); }
-//! Function to peek at a character from the provided stream
-char file_peek(std::ifstream *stream) { return static_cast<char>(stream->peek()); }
+/**
+ * \brief Read standard input stream
+ *
+ * \param source Buffer to hold the source
+ * \return `false` when the input could not be read, `true` otherwise
+ */
+bool read_stdin(std::unique_ptr<llvm::MemoryBuffer> &source) {
+    // Read the whole input
+    auto buffer = llvm::MemoryBuffer::getSTDIN();
+    if (!buffer) {
+        // Print error if not read
+        error() << "Failed to read standard input - " << buffer.getError().message() << '\n';
+        return false;
+    }
+    source = std::move(*buffer);
+
+    return true;
+}
 
 /**
- * \brief Lex file input stream
+ * \brief Read file input stream
+ *
+ * The file is memory-mapped when large enough for that to pay off.
  *
  * \param source_filename Name of the source file
- * \param append_f Token append function
- * \return `false` when there was a LexerException during lexing, `true` otherwise
+ * \param source Buffer to hold the source
+ * \return `false` when the file could not be opened, `true` otherwise
  */
-bool lex_file(const std::string &source_filename, const basilisk::lexer::append_function_t &append_f) {
-    // Open stream
-    std::ifstream stream(source_filename, std::ios::in);
-
-    if (!stream.is_open()) {
+bool read_file(const std::string &source_filename, std::unique_ptr<llvm::MemoryBuffer> &source) {
+    // Open (or map) the file
+    auto buffer = llvm::MemoryBuffer::getFile(source_filename);
+    if (!buffer) {
         // Print error if not open
         error() << "Failed to open file " << source_filename << '\n';
         return false;
+    }
+    source = std::move(*buffer);
+
+    return true;
+}
+
+/**
+ * \brief Print tokens into a stream separated with vertical bars
+ *
+ * \param stream Output stream
+ * \param tokens Tokens to print
+ */
+void print_tokens(std::ostream &stream, const std::vector<basilisk::tokens::Token> &tokens) {
+    for (std::size_t i = 0; i < tokens.size(); i++) {
+        if (i > 0) {
+            stream << '|';
+        }
+        stream << tokens[i];
+    }
+}
+//----- End Lexing Section
+
+//----- Start Options Section
+/** \struct Options
+ * \brief Options parsed from the command line
+ */
+struct Options {
+    //! Whether to output into a file (otherwise standard output)
+    bool file_out = false;
+    //! Name of the output file
+    std::string filename_out;
+    //! Whether to input from a file (otherwise standard input)
+    bool file_in = false;
+    //! Name of the input file
+    std::string filename_in;
+    //! Names of all of the input files, compiled on separate threads when there are several
+    std::vector<std::string> filenames_in;
+    //! Whether this input is compiled along with others, which excludes global state such as pass timings
+    bool batch = false;
+    //! Whether each input file can call the functions defined by the other input files
+    bool cross_input_calls = false;
+    //! Functions defined by the other input files, which this one can call
+    std::vector<basilisk::codegen::Prototype> imports;
+    //! Last stage to perform: 0 -> full, 1+ -> lex, 2+ -> parse, 3+ -> codegen, 4+ -> codegen-opt
+    unsigned ops = 0;
+    //! Whether to output LLVM bitcode instead of textual IR or object code
+    bool emit_bc = false;
+    //! Whether to include a ThinLTO module summary in the bitcode
+    bool summary = false;
+    //! Whether to link the bitcode input files with ThinLTO instead of compiling source input files
+    bool lto = false;
+    //! Whether to run the program instead of emitting it
+    bool run = false;
+    //! Whether to run the program in the bytecode interpreter instead of emitting it
+    bool interpret = false;
+    //! Number of calls after which the interpreter compiles a pure function in the JIT, `0` for never
+    std::size_t tier_up = basilisk::interpreter::Settings().tier_up;
+    //! Optional code generation features
+    basilisk::codegen::Settings codegen;
+    //! Extent to which code generation fuses floating-point multiplication and addition
+    llvm::FPOpFusion::FPOpFusionMode fusion = llvm::FPOpFusion::Strict;
+    //! Number of parsing and code generation threads (`0` for one per hardware thread), unset to work on one thread
+    std::optional<unsigned> jobs;
+    //! Number of objects to split object code emission into, `0` to emit one object
+    unsigned split = 0;
+    //! Optimization level
+    basilisk::optimization::Level level = basilisk::optimization::Level::O2;
+    //! Target triple, empty for the host triple
+    std::string triple;
+    //! Target CPU, `native` for the host CPU
+    std::string cpu = "generic";
+    //! Target features, `native` for the host CPU features
+    std::string features;
+    //! Directory of the compilation cache, empty for none
+    std::string cache_dir;
+    //! Whether to reuse the generated functions that didn't change from the compilation cache
+    bool incremental = false;
+    //! Profile to instrument the program for or to optimize it with
+    basilisk::optimization::Profile profile;
+    //! Name of the file to write the optimization remarks into, empty for none
+    std::string filename_remarks;
+    //! Whether to print which recursive functions are turned into loops
+    bool report_recursion = false;
+    //! Whether to print the time report
+    bool time_report = false;
+    //! Name of the file to write the Chrome trace into, empty for none
+    std::string filename_trace;
+};
+
+/**
+ * \brief Parse the command line arguments into options
+ *
+ * \param argc Number of arguments
+ * \param argv Arguments
+ * \param options Options to update
+ * \param exit_code Exit code to return when the execution should stop
+ * \return `true` if compilation should continue, `false` if execution should stop with `exit_code`
+ */
+bool parse_arguments(int argc, char *argv[], Options &options, int &exit_code) {
+    // Go through arguments
+    for (int i = 1; i < argc; i++) {
+        // Get the argument
+        std::string arg = argv[i];
+
+        // Check for options
+        if (arg == "-h" || arg == "--help") {
+            // Help -> show usage and stop execution
+            show_usage();
+            exit_code = 0;
+            return false;
+        } else if (arg == "-v" || arg == "--version") {
+            // Version -> show version and stop execution
+            show_version();
+            exit_code = 0;
+            return false;
+        } else if (arg == "-o" || arg == "--output") {
+            // Output -> update state, incrementing i to consume the following argument (filename)
+            if (i + 1 >= argc) {
+                error() << "Missing output filename.\n";
+                exit_code = 1;
+                return false;
+            }
+            options.file_out = true;
+            options.filename_out = argv[++i];
+        } else if (arg == "-l" || arg == "--lex") {
+            // Lex -> set ops to at least lex
+            options.ops = std::max(options.ops, 1u);
+        } else if (arg == "-p" || arg == "--parse") {
+            // Parse -> set ops to at least parse
+            options.ops = std::max(options.ops, 2u);
+        } else if (arg == "-g" || arg == "--codegen") {
+            // Codegen -> set ops to at least codegen
+            options.ops = std::max(options.ops, 3u);
+        } else if (arg == "-G" || arg == "--codegen-opt") {
+            // Codegen -> set ops to at least codegen
+            options.ops = std::max(options.ops, 4u);
+        } else if (arg == "--emit-bc") {
+            // Bitcode -> update state
+            options.emit_bc = true;
+        } else if (arg == "--thinlto") {
+            // Bitcode with summary -> update state
+            options.emit_bc = true;
+            options.summary = true;
+        } else if (arg == "--cross-input-calls") {
+            // Calls between inputs -> update state
+            options.cross_input_calls = true;
+        } else if (arg == "--lto") {
+            // Link-time optimization -> update state
+            options.lto = true;
+        } else if (arg == "-r" || arg == "--run") {
+            // Run -> update state
+            options.run = true;
+        } else if (arg == "--interpret") {
+            // Interpret -> update state
+            options.interpret = true;
+        } else if (arg.rfind("--tier-up=", 0) == 0) {
+            // Tier-up threshold -> update state
+            auto value = arg.substr(std::string_view("--tier-up=").size());
+            if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+                error() << "Invalid number of calls \"" << value << "\".\n";
+                exit_code = 1;
+                return false;
+            }
+            options.tier_up = std::stoul(value);
+        } else if (arg == "--map-companions") {
+            // Map companions -> enable them
+            options.codegen.map_companions = true;
+        } else if (arg == "--memoize") {
+            // Memoization -> enable it
+            options.codegen.memoize = true;
+        } else if (arg == "--buffered-output") {
+            // Buffered output -> enable it
+            options.codegen.buffered_output = true;
+        } else if (arg == "--ffast-math") {
+            // Fast math -> allow all of the transformations and fuse anywhere
+            options.codegen.fast_math.setFast();
+            options.fusion = llvm::FPOpFusion::Fast;
+        } else if (arg == "--fno-honor-nans") {
+            // No NaNs -> update state
+            options.codegen.fast_math.setNoNaNs();
+        } else if (arg == "--fno-honor-infinities") {
+            // No infinities -> update state
+            options.codegen.fast_math.setNoInfs();
+        } else if (arg == "--fno-signed-zeros") {
+            // No signed zeros -> update state
+            options.codegen.fast_math.setNoSignedZeros();
+        } else if (arg == "--freciprocal-math") {
+            // Reciprocal -> update state
+            options.codegen.fast_math.setAllowReciprocal();
+        } else if (arg == "--fassociative-math") {
+            // Reassociation -> update state
+            options.codegen.fast_math.setAllowReassoc();
+        } else if (arg.rfind("--fp-contract=", 0) == 0) {
+            // Contraction -> update state
+            // Note: `on` only fuses within an expression, so it is done by code generation rather than by the flags
+            auto value = arg.substr(std::string_view("--fp-contract=").size());
+            if (value == "off") {
+                options.fusion = llvm::FPOpFusion::Strict;
+                options.codegen.contract = false;
+                options.codegen.fast_math.setAllowContract(false);
+            } else if (value == "on") {
+                options.fusion = llvm::FPOpFusion::Standard;
+                options.codegen.contract = true;
+                options.codegen.fast_math.setAllowContract(false);
+            } else if (value == "fast") {
+                options.fusion = llvm::FPOpFusion::Fast;
+                options.codegen.contract = false;
+                options.codegen.fast_math.setAllowContract(true);
+            } else {
+                error() << "Invalid floating-point contraction \"" << value << "\".\n";
+                exit_code = 1;
+                return false;
+            }
+        } else if (arg.rfind("-j", 0) == 0) {
+            // Jobs -> update state, incrementing i to consume the following argument (count) unless attached
+            std::string value;
+            if (arg.size() > 2) {
+                value = arg.substr(2);
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            }
+            if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+                error() << "Invalid number of jobs \"" << value << "\".\n";
+                exit_code = 1;
+                return false;
+            }
+            options.jobs = static_cast<unsigned>(std::stoul(value));
+        } else if (arg.rfind("--split-codegen=", 0) == 0) {
+            // Split code generation -> update state
+            auto value = arg.substr(std::string_view("--split-codegen=").size());
+            if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos
+                || std::stoul(value) == 0) {
+                error() << "Invalid number of objects \"" << value << "\".\n";
+                exit_code = 1;
+                return false;
+            }
+            options.split = static_cast<unsigned>(std::stoul(value));
+        } else if (basilisk::optimization::parse_level(arg, options.level)) {
+            // Optimization level -> already set
+            continue;
+        } else if (arg == "--target" || arg == "--cpu" || arg == "--features") {
+            // Target option -> update state, incrementing i to consume the following argument (value)
+            if (i + 1 >= argc) {
+                error() << "Missing value of " << arg << ".\n";
+                exit_code = 1;
+                return false;
+            }
+            std::string &value = arg == "--target" ? options.triple : arg == "--cpu" ? options.cpu : options.features;
+            value = argv[++i];
+        } else if (arg.rfind("-march=", 0) == 0) {
+            // Architecture -> set CPU, and features when native
+            options.cpu = arg.substr(std::string_view("-march=").size());
+            if (options.cpu == "native") {
+                options.features = "native";
+            }
+        } else if (arg == "--cache-dir") {
+            // Cache directory -> update state, incrementing i to consume the following argument (directory)
+            if (i + 1 >= argc) {
+                error() << "Missing cache directory.\n";
+                exit_code = 1;
+                return false;
+            }
+            options.cache_dir = argv[++i];
+        } else if (arg == "--incremental") {
+            // Incremental compilation -> enable it
+            options.incremental = true;
+        } else if (arg == "--profile-gen" || arg.rfind("--profile-gen=", 0) == 0) {
+            // Profile instrumentation -> update state
+            options.profile.generate = true;
+            if (arg.size() > std::string_view("--profile-gen").size()) {
+                options.profile.generate_file = arg.substr(std::string_view("--profile-gen=").size());
+            }
+        } else if (arg.rfind("--profile-use=", 0) == 0) {
+            // Profile -> update state
+            options.profile.use_file = arg.substr(std::string_view("--profile-use=").size());
+            if (options.profile.use_file.empty()) {
+                error() << "Missing profile filename.\n";
+                exit_code = 1;
+                return false;
+            }
+        } else if (arg.rfind("--remarks=", 0) == 0) {
+            // Remarks -> update state
+            options.filename_remarks = arg.substr(std::string_view("--remarks=").size());
+            if (options.filename_remarks.empty()) {
+                error() << "Missing remarks filename.\n";
+                exit_code = 1;
+                return false;
+            }
+        } else if (arg == "--report-recursion") {
+            // Recursion report -> enable it
+            options.report_recursion = true;
+        } else if (arg == "--time-report") {
+            // Time report -> enable it
+            options.time_report = true;
+        } else if (arg == "--time-trace") {
+            // Time trace -> enable the report, incrementing i to consume the following argument (filename)
+            if (i + 1 >= argc) {
+                error() << "Missing trace filename.\n";
+                exit_code = 1;
+                return false;
+            }
+            options.time_report = true;
+            options.filename_trace = argv[++i];
+        } else if (arg == "-") {
+            // Standard input -> set file input to false and stop processing
+            options.file_in = false;
+            options.filenames_in.clear();
+            break;
+        } else {
+            // Input filename -> update state and continue, as more files can follow
+            options.file_in = true;
+            options.filename_in = arg;
+            options.filenames_in.push_back(arg);
+        }
+    }
+    if (!options.filenames_in.empty()) {
+        options.filename_in = options.filenames_in.front();
+    }
+
+    // Several input files are each written into their own output, unless they are linked
+    if (options.filenames_in.size() > 1 && !options.lto) {
+        if (options.run || options.interpret) {
+            error() << "Cannot run several input files.\n";
+            exit_code = 1;
+            return false;
+        }
+        if (!options.filename_trace.empty()) {
+            error() << "Cannot trace the compilation of several input files.\n";
+            exit_code = 1;
+            return false;
+        }
+        if (!options.filename_remarks.empty()) {
+            error() << "Cannot write the remarks of several input files into one file.\n";
+            exit_code = 1;
+            return false;
+        }
+    }
+
+    // Profiles are generated and used by the optimization pipeline of a compiled program
+    if (options.profile.generate || !options.profile.use_file.empty()) {
+        if (options.profile.generate && !options.profile.use_file.empty()) {
+            error() << "Cannot both generate and use a profile.\n";
+            exit_code = 1;
+            return false;
+        }
+        if (options.level == basilisk::optimization::Level::O0 || options.lto) {
+            error() << "Profile-guided optimization requires compiling with optimization.\n";
+            exit_code = 1;
+            return false;
+        }
+        if (options.profile.generate && (options.run || options.interpret)) {
+            // Note: the profile runtime is not linked into this process
+            error() << "Cannot run an instrumented program.\n";
+            exit_code = 1;
+            return false;
+        }
+        if (!options.profile.use_file.empty() && !llvm::sys::fs::exists(options.profile.use_file)) {
+            error() << "Profile \"" << options.profile.use_file << "\" not found.\n";
+            exit_code = 1;
+            return false;
+        }
+    }
+
+    // Shards are optimized on their own threads, without the profile and away from the remarks file
+    // Note: with several input files, the inputs are compiled on the threads instead
+    bool sharded = (options.jobs && options.filenames_in.size() <= 1) || options.incremental;
+    if (sharded && (options.profile.generate || !options.profile.use_file.empty()
+                    || !options.filename_remarks.empty())) {
+        error() << "Profiles and remarks cannot be combined with -j or --incremental.\n";
+        exit_code = 1;
+        return false;
+    }
+
+    // Linking only emits the objects of the bitcode input files
+    if (options.lto) {
+        if (options.run || options.interpret || options.ops != 0 || options.emit_bc || options.split > 0
+            || options.incremental) {
+            error() << "Link-time optimization can only emit object code.\n";
+            exit_code = 1;
+            return false;
+        }
+        if (options.filenames_in.empty() || !options.file_out) {
+            error() << "Link-time optimization requires input files and an output file.\n";
+            exit_code = 1;
+            return false;
+        }
+    }
+
+    // Bitcode is an alternative output
+    if (options.emit_bc && (options.run || options.interpret || options.split > 0 || options.ops == 1
+                            || options.ops == 2)) {
+        error() << "Bitcode can only be emitted instead of LLVM IR or object code.\n";
+        exit_code = 1;
+        return false;
+    }
+
+    // Only code for the host can be run
+    if ((options.run || options.interpret) && !options.triple.empty()) {
+        error() << "Cannot run a program compiled for another target.\n";
+        exit_code = 1;
+        return false;
+    }
+
+    // Split objects are named after the output file, which lists them
+    if (options.split > 0 && (options.run || options.interpret)) {
+        error() << "Cannot split code generation of a program that is run.\n";
+        exit_code = 1;
+        return false;
+    }
+    if (options.split > 0 && options.ops == 0 && !options.file_out) {
+        error() << "Splitting code generation requires an output file.\n";
+        exit_code = 1;
+        return false;
+    }
+
+    // Functions are reused from the cache, which nothing is generated for when interpreting
+    if (options.incremental && options.cache_dir.empty()) {
+        error() << "Incremental compilation requires a cache directory.\n";
+        exit_code = 1;
+        return false;
+    }
+    if (options.incremental && options.interpret) {
+        error() << "Cannot compile incrementally a program that is interpreted.\n";
+        exit_code = 1;
+        return false;
+    }
+
+    return true;
+}
+//----- End Options Section
+
+//----- Start Output Section
+/**
+ * \brief Write a string into the output file, or standard output if none
+ *
+ * \param options Options holding the output
+ * \param contents String to write
+ * \return `false` when the output file could not be opened, `true` otherwise
+ */
+bool write_output(const Options &options, const std::string &contents) {
+    if (options.file_out) {
+        // Open a stream to the output file
+        std::ofstream stream(options.filename_out, std::ios::out | std::ios::binary);
+
+        if (!stream.is_open()) {
+            // Print error if output not open
+            error() << "Failed to open file " << options.filename_out << '\n';
+            return false;
+        }
+
+        stream << contents;
     } else {
-        auto get_f = std::bind(&file_get, &stream);
-        auto peek_f = std::bind(&file_peek, &stream);
+        std::cout << contents;
+    }
 
-        // Try to lex
-        try {
-            basilisk::lexer::lex(get_f, peek_f, append_f);
-        } catch (basilisk::lexer::LexerException e) {
-            // Print exception and return failure
-            error() << "Lexer exception - " << e.what() << '\n';
+    return true;
+}
+
+/**
+ * \brief Write an LLVM module as textual IR or bitcode into the output file, or standard output if none
+ *
+ * \param options Options holding the output and whether to write bitcode with a summary
+ * \param module Module to write
+ * \return `false` when the output file could not be opened, `true` otherwise
+ */
+bool write_output(const Options &options, llvm::Module &module) {
+    auto write = [&options, &module](llvm::raw_ostream &stream){
+        if (options.emit_bc && options.summary) {
+            // Note: the module hash identifies the module in the link
+            llvm::ProfileSummaryInfo profile(module);
+            auto index = llvm::buildModuleSummaryIndex(module, nullptr, &profile);
+            llvm::WriteBitcodeToFile(module, stream, false, &index, true);
+        } else if (options.emit_bc) {
+            llvm::WriteBitcodeToFile(module, stream);
+        } else {
+            module.print(stream, nullptr);
+        }
+    };
+
+    if (options.file_out) {
+        // Open a stream to the output file and print the module into it
+        std::error_code ec;
+        llvm::raw_fd_ostream stream(options.filename_out, ec);
+        if (ec) {
+            // Error -> print message
+            error() << "Failed to open file " << options.filename_out << " - " << ec.message() <<'\n';
             return false;
         }
+        write(stream);
+    } else {
+        write(llvm::outs());
     }
 
-    // Return success
     return true;
 }
-//----- End Lexing Section
+//----- End Output Section
 
-//----- Start Parsing Section
+//----- Start Code Generation Section
 /**
- * \brief Pop a token from the front of the queue and return it
+ * \brief Count the instructions in a module
  *
- * \param queue Pointer to the input token queue
- * \return Popped token, or an error token when empty
+ * \param module Module to count in
+ * \return Number of instructions
  */
-basilisk::tokens::Token parser_get(std::vector<basilisk::tokens::Token> *queue) {
-    // Return error if no queue
-    if (!queue) {
-        std::ostringstream message;
-        message << "No input queue.";
-        return basilisk::tokens::Token{basilisk::tokens::tags::error, message.str()};
+std::size_t count_instructions(const llvm::Module &module) {
+    std::size_t count = 0;
+    for (auto &function : module) {
+        count += function.getInstructionCount();
     }
+    return count;
+}
 
-    // Return error token if empty
-    if (queue->empty()) {
-        return basilisk::tokens::Token{basilisk::tokens::tags::error, "No more input tokens."};
+/**
+ * \brief Generate LLVM IR of a program into a module
+ *
+ * \param program Program node
+ * \param module Module to generate into
+ * \param options Options, of which the imports, code generation features, jobs and optimization level are used
+ * \param target_machine Target machine that the module is configured for, to optimize the shards for
+ * \param cache Cache to reuse the functions from when compiling incrementally, or `nullptr` for none
+ * \param report Time report to count the reused functions in
+ * \return `false` when there was an exception during generation, `true` otherwise
+ */
+bool generate(basilisk::ast::Program &program, llvm::Module &module, const Options &options,
+        const llvm::TargetMachine &target_machine, basilisk::cache::ObjectCache *cache, TimeReport &report) {
+    // Generate LLVM IR
+    try {
+        basilisk::codegen::declare_prototypes(program, module, options.imports);
+        if (options.jobs || options.incremental) {
+            // Note: shards are optimized on their threads, so that the whole module is then quicker to optimize
+            basilisk::parallel::Settings settings;
+            settings.jobs = options.jobs.value_or(1);
+            if (options.ops != 3) {
+                settings.level = options.level;
+            }
+            settings.target_machine = &target_machine;
+            if (options.incremental) {
+                // Note: one function per shard, so that a change only invalidates the functions depending on it
+                settings.shard_size = 1;
+                settings.cache = cache;
+            }
+            auto reused = basilisk::parallel::generate(program, module, options.codegen, settings);
+            if (options.incremental) {
+                report.count("reused", reused);
+            }
+        } else {
+            llvm::IRBuilder<> builder(module.getContext());
+            basilisk::codegen::NamedValuesHash named_values;
+            basilisk::codegen::ProgramCodegen program_cg(module.getContext(), builder, &module, named_values,
+                    options.codegen);
+            program.accept(program_cg);
+        }
+    } catch (std::exception &e) {
+        // Print exception and note failure
+        error() << "LLVM IR generation exception - " << e.what() << '\n'
+                << "LLVM IR generation failed.\n";
+        return false;
     }
 
-    basilisk::tokens::Token t = queue->back();
-    queue->pop_back();
-    return t;
+    return true;
 }
 
 /**
- * \brief Peek at the token \c offset elements from the front of the input queue
+ * \brief Resolve the target CPU name, replacing `native` with the host CPU
  *
- * \param queue Pointer to the input token queue
- * \param offset Offset of the sought element from the front of the queue
- * \return Token \c offset elements from the front of the input queue, or the error token when not present
+ * \param cpu Requested CPU
+ * \return CPU name to create the target machine with
  */
-basilisk::tokens::Token parser_peek(std::vector<basilisk::tokens::Token> *queue, unsigned offset) {
-    // Return error if no queue
-    if (!queue) {
-        std::ostringstream message;
-        message << "No input queue.";
-        return basilisk::tokens::Token{basilisk::tokens::tags::error, message.str()};
+std::string resolve_cpu(const std::string &cpu) {
+    if (cpu == "native") {
+        return llvm::sys::getHostCPUName().str();
     }
+    return cpu;
+}
 
-    // Return error token if not valid
-    if (offset >= queue->size()) {
-        std::ostringstream message;
-        message << "No token " << offset << " elements from the front of the input queue.";
-        return basilisk::tokens::Token{basilisk::tokens::tags::error, message.str()};
+/**
+ * \brief Resolve the target features, replacing `native` with the features of the host CPU
+ *
+ * Host features that can't be detected resolve to an empty list, leaving the features implied by the CPU.
+ *
+ * \param features Requested features
+ * \return Feature string to create the target machine with
+ */
+std::string resolve_features(const std::string &features) {
+    if (features != "native") {
+        return features;
     }
 
-    // Compute index
-    auto index = static_cast<unsigned int>(queue->size() - 1 - offset);
+    llvm::SubtargetFeatures resolved;
+    llvm::StringMap<bool> host_features;
+    if (llvm::sys::getHostCPUFeatures(host_features)) {
+        for (auto &feature : host_features) {
+            resolved.AddFeature(feature.first(), feature.second);
+        }
+    }
+    return resolved.getString();
+}
 
-    return (*queue)[index];
+/**
+ * \brief Initialize all of the targets, along with their machine code layers and assembly parsers and printers
+ *
+ * Initializes the shared target registry, so is called once before any inputs are compiled.
+ */
+void initialize_targets() {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmParsers();
+    llvm::InitializeAllAsmPrinters();
 }
-//----- End Parsing Section
 
-int main(int argc, char *argv[]) {
-    // Compute actual argument number (without executable name)
-    int arg_n = argc - 1;
+/**
+ * \brief Get the options of code generation for the target, which hold the floating-point semantics
+ *
+ * \param options Options holding the fast-math flags and contraction
+ * \return Target options
+ */
+llvm::TargetOptions target_options(const Options &options) {
+    auto &fast_math = options.codegen.fast_math;
+    llvm::TargetOptions result;
+    result.UnsafeFPMath = options.codegen.unsafe_fp_math();
+    result.NoInfsFPMath = fast_math.noInfs();
+    result.NoNaNsFPMath = fast_math.noNaNs();
+    result.NoSignedZerosFPMath = fast_math.noSignedZeros();
+    result.AllowFPOpFusion = options.fusion;
+    return result;
+}
 
-    // Decide on actions to perform based on arguments
-    if (arg_n == 0) {
-        // No arguments -> print usage
-        show_usage();
-    } else {
-        // Some arguments -> process them (-h and -v stop execution)
-
-        // Prepare state
-        bool file_out = false;
-        std::string filename_out;
-        bool file_in = false;
-        std::string filename_in;
-        unsigned ops = 0; // 0 -> full, 1+ -> lex, 2+ -> parse, 3+ -> codegen, 4+ -> codegen-opt
-
-        // Go through arguments
-        for (int i = 1; i < argc; i++) {
-            // Get the argument
-            std::string arg = argv[i];
-
-            // Check for options
-            if (arg == "-h" || arg == "--help") {
-                // Help -> show usage, flag for exit and stop processing
-                show_usage();
-                return 0;
-            } else if (arg == "-v" || arg == "--version") {
-                // Version -> show version, flag for exit and stop processing
-                show_version();
-                return 0;
-            } else if (arg == "-o" || arg == "--output") {
-                // Output -> update state, incrementing i to consume the following argument (filename)
-                file_out = true;
-                filename_out = argv[++i];
-            } else if (arg == "-l" || arg == "--lex") {
-                // Lex -> set ops to at least lex
-                ops = std::max(ops, 1u);
-            } else if (arg == "-p" || arg == "--parse") {
-                // Parse -> set ops to at least parse
-                ops = std::max(ops, 2u);
-            } else if (arg == "-g" || arg == "--codegen") {
-                // Codegen -> set ops to at least codegen
-                ops = std::max(ops, 3u);
-            } else if (arg == "-G" || arg == "--codegen-opt") {
-                // Codegen -> set ops to at least codegen
-                ops = std::max(ops, 4u);
-            } else if (arg == "-") {
-                // Standard input -> set file input to false and stop processing
-                file_in = false;
-                break;
-            } else {
-                // Input filename -> update state and stop processing
-                file_in = true;
-                filename_in = arg;
-                break;
-            }
+/**
+ * \brief Write the optimization remarks of a context into the remarks file of the options as YAML
+ *
+ * Remarks are written with their hotness when optimizing with a profile.
+ *
+ * \param options Options holding the remarks file and profile
+ * \param context Context to write the remarks of
+ * \param file Remarks file to hold open while the context is used
+ * \return `false` when the file could not be opened, `true` otherwise
+ */
+bool setup_remarks(const Options &options, llvm::LLVMContext &context, std::unique_ptr<llvm::ToolOutputFile> &file) {
+    bool hotness = !options.profile.use_file.empty();
+#if LLVM_VERSION_MAJOR >= 11
+    auto opened = llvm::setupLLVMOptimizationRemarks(context, options.filename_remarks, "", "yaml", hotness);
+#else
+    auto opened = llvm::setupOptimizationRemarks(context, options.filename_remarks, "", "yaml", hotness);
+#endif
+    if (!opened) {
+        error() << "Failed to open remarks file - " << llvm::toString(opened.takeError()) << '\n';
+        return false;
+    }
+    file = std::move(*opened);
+    file->keep();
+    return true;
+}
+
+/**
+ * \brief Create the target machine to compile for
+ *
+ * \param options Options holding the target, optimization level and floating-point semantics
+ * \param host Host machine of the JIT to take the triple, CPU and features from, or `nullptr` to take them from the
+ *  options
+ * \return Target machine, or `nullptr` when the target could not be found
+ */
+std::unique_ptr<llvm::TargetMachine> create_target_machine(const Options &options,
+        const llvm::TargetMachine *host = nullptr) {
+    // Pick target
+    // Note: the targets are initialized once in main, so that inputs compiled on other threads share them
+    auto target_triple = host ? host->getTargetTriple().str()
+                              : options.triple.empty() ? llvm::sys::getDefaultTargetTriple() : options.triple;
+    auto cpu = host ? host->getTargetCPU().str() : resolve_cpu(options.cpu);
+    auto features = host ? host->getTargetFeatureString().str() : resolve_features(options.features);
+    std::string err;
+    auto target = llvm::TargetRegistry::lookupTarget(target_triple, err);
+
+    // Print error and terminate if target lookup failed
+    if (!target) {
+        error() << "Failed to look up target - " << err << '\n';
+        return nullptr;
+    }
+
+    // Get target machine
+    auto relocation_model = llvm::Optional<llvm::Reloc::Model>(llvm::Reloc::Model::PIC_);
+    return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(target_triple, cpu, features,
+            target_options(options), relocation_model, llvm::None, basilisk::optimization::codegen_level(options.level)));
+}
+
+/**
+ * \brief Emit a module as native object code
+ *
+ * \param module Module to emit
+ * \param target_machine Target machine to emit for
+ * \param code String to emit the object code into
+ * \return `false` when the target machine can't emit object code, `true` otherwise
+ */
+bool emit_object(llvm::Module &module, llvm::TargetMachine &target_machine, std::string &code) {
+    llvm::SmallString<0> small_string;
+    llvm::raw_svector_ostream stream(small_string);
+
+    // Create and run pass to emit object code
+    llvm::legacy::PassManager pass;
+    auto file_type = llvm::TargetMachine::CGFT_ObjectFile;
+    if (target_machine.addPassesToEmitFile(pass, stream, nullptr, file_type)) {
+        // Error -> print message
+        error() << "File emit pass error - TargetMachine can't emit a file of this type\n";
+        return false;
+    }
+    pass.run(module);
+
+    code = small_string.str().str();
+    return true;
+}
+
+/**
+ * \brief Emit a module as native object code split into several objects, on one thread per object
+ *
+ * The module is partitioned with `llvm::SplitModule`, and each partition is emitted in its own context by its own
+ *  target machine.
+ * Local symbols referred to from several partitions become hidden external symbols.
+ *
+ * \param module Module to emit, which is consumed by the split
+ * \param target_machine Target machine to emit for
+ * \param count Number of objects
+ * \param codes Strings to emit the object codes into
+ * \return `false` when a partition could not be emitted, `true` otherwise
+ */
+bool emit_split_objects(std::unique_ptr<llvm::Module> module, const llvm::TargetMachine &target_machine,
+        unsigned count, std::vector<std::string> &codes) {
+    // Split the module, keeping the partitions as bitcode to move them into other contexts
+    std::vector<std::string> partitions;
+    auto write_partition = [&partitions](std::unique_ptr<llvm::Module> partition){
+        llvm::raw_string_ostream stream(partitions.emplace_back());
+        llvm::WriteBitcodeToFile(*partition, stream);
+        stream.flush();
+    };
+#if LLVM_VERSION_MAJOR >= 12
+    llvm::SplitModule(*module, count, write_partition);
+#else
+    llvm::SplitModule(std::move(module), count, write_partition);
+#endif
+
+    // Emit the partitions
+    codes.assign(partitions.size(), std::string());
+    std::vector<char> success(partitions.size(), false);
+    basilisk::parallel::for_each(partitions.size(), count, [&](std::size_t i){
+        llvm::LLVMContext context;
+        auto partition = llvm::parseBitcodeFile(llvm::MemoryBufferRef(partitions[i], "partition"), context);
+        if (!partition) {
+            // Note: errors are printed once the threads are done
+            llvm::consumeError(partition.takeError());
+            return;
         }
+        auto machine = basilisk::optimization::copy_target_machine(target_machine);
+        success[i] = emit_object(**partition, *machine, codes[i]);
+    });
+
+    for (std::size_t i = 0; i < success.size(); i++) {
+        if (!success[i]) {
+            error() << "Failed to emit object " << i << " of the split module.\n";
+            return false;
+        }
+    }
+    return true;
+}
 
+/**
+ * \brief Write objects next to the output file and list them in it
+ *
+ * Object `i` is written into `<output>.<i>.o`, and the output file lists the object names, one per line.
+ *
+ * \param options Options holding the output
+ * \param codes Object codes to write
+ * \return `false` when the objects could not be written, `true` otherwise
+ */
+bool write_objects(const Options &options, const std::vector<std::string> &codes) {
+    std::string manifest;
+    for (std::size_t i = 0; i < codes.size(); i++) {
+        auto filename = options.filename_out + "." + std::to_string(i) + ".o";
+        std::ofstream stream(filename, std::ios::out | std::ios::binary);
+        if (!stream.is_open()) {
+            error() << "Failed to open file " << filename << '\n';
+            return false;
+        }
+        stream << codes[i];
+        manifest += filename + "\n";
+    }
+    return write_output(options, manifest);
+}
+
+/**
+ * \brief Emit a module as split native object code, write the objects next to the output file and list them in it
+ *
+ * \param options Options holding the output and number of objects
+ * \param module Module to emit
+ * \param target_machine Target machine to emit for
+ * \param report Time report to record the number of objects into
+ * \return `false` when the objects could not be emitted or written, `true` otherwise
+ */
+bool write_split_output(const Options &options, std::unique_ptr<llvm::Module> module,
+        const llvm::TargetMachine &target_machine, TimeReport &report) {
+    std::vector<std::string> codes;
+    if (!emit_split_objects(std::move(module), target_machine, options.split, codes)) {
+        return false;
+    }
+    report.count("objects", codes.size());
+    return write_objects(options, codes);
+}
+
+/**
+ * \brief Compute the cache key of the compiled program
+ *
+ * \param options Options holding the target, optimization level and mode
+ * \param source Source of the program
+ * \param host Host machine of the JIT that runs the program, or `nullptr` when compiling to object code
+ * \return Cache key
+ */
+std::string cache_key(const Options &options, const llvm::MemoryBuffer &source, const llvm::TargetMachine *host) {
+    // Note: the JIT compiles for the host, so its objects depend on the host triple, CPU and features
+    auto triple = host ? host->getTargetTriple().str()
+                       : options.triple.empty() ? llvm::sys::getDefaultTargetTriple() : options.triple;
+    auto cpu = host ? host->getTargetCPU().str() : resolve_cpu(options.cpu);
+    auto features = host ? host->getTargetFeatureString().str() : resolve_features(options.features);
+    auto kind = std::string(host ? "jit" : "object");
+
+    // Code generation settings change the output as well, as does the fusion of code generation for the target
+    kind += " " + options.codegen.describe() + " fusion " + std::to_string(options.fusion);
+    if (options.jobs) {
+        kind += " shards";
+    }
+    if (options.incremental) {
+        kind += " incremental";
+    }
+
+    // So do the functions of the other inputs that the program can call
+    for (auto &prototype : options.imports) {
+        kind += " import " + prototype.name + "/" + std::to_string(prototype.arity);
+    }
+
+    return basilisk::cache::ObjectCache::key(std::string_view(source.getBufferStart(), source.getBufferSize()),
+            triple, cpu, features, options.level, kind);
+}
+
+/**
+ * \brief Create the JIT engine to run a program in
+ *
+ * \param options Options holding the optimization level
+ * \return Engine, or `nullptr` when it could not be created
+ */
+std::unique_ptr<basilisk::jit::Engine> create_engine(const Options &options) {
+    try {
+        return std::make_unique<basilisk::jit::Engine>(basilisk::optimization::codegen_level(options.level));
+    } catch (basilisk::jit::JITException &e) {
+        // Print exception and note failure
+        error() << "JIT exception - " << e.what() << '\n'
+                << "Running failed.\n";
+        return nullptr;
+    }
+}
+
+/**
+ * \brief Run a program in the JIT
+ *
+ * \param engine Engine to run the program in
+ * \param add Function adding the program to the engine
+ * \return Return value of the program, or `1` on failure
+ */
+int run_jit(basilisk::jit::Engine &engine, const std::function<void()> &add) {
+    try {
+        add();
+        return engine.run();
+    } catch (basilisk::jit::JITException &e) {
+        // Print exception and note failure
+        error() << "JIT exception - " << e.what() << '\n'
+                << "Running failed.\n";
+        return 1;
+    }
+}
+
+/**
+ * \brief Run a program in the bytecode interpreter
+ *
+ * \param options Options holding the tier-up threshold and optimization level
+ * \param program Program node
+ * \param report Time report to record the number of functions compiled in the JIT into
+ * \return Return value of the program, or `1` on failure
+ */
+int interpret(const Options &options, basilisk::ast::Program program, TimeReport &report) {
+    try {
+        basilisk::interpreter::Settings settings;
+        settings.tier_up = options.tier_up;
+        settings.level = options.level;
+        basilisk::interpreter::Interpreter interpreter(std::move(program), settings);
+        auto result = interpreter.run();
+        report.count("tiered", interpreter.tiered());
+        return result;
+    } catch (basilisk::interpreter::InterpreterException &e) {
+        // Print exception and note failure
+        error() << "Interpreter exception - " << e.what() << '\n'
+                << "Interpreting failed.\n";
+        return 1;
+    }
+}
+
+/**
+ * \brief Print which recursive functions of a program are turned into loops into standard error stream
+ *
+ * Calls of a function to itself in tail position are turned into loops by tail recursion elimination when optimizing.
+ * The other recursive calls take a stack frame each, except for calls in tail position to functions with the same
+ *  prototype, which replace the frame of the caller.
+ *
+ * \param options Options holding the input and optimization level
+ * \param program Program to report on
+ */
+void report_recursion(const Options &options, basilisk::ast::Program &program) {
+    auto recursive = basilisk::codegen::Effects::analyze(program).recursive;
+    auto self_calls = basilisk::ast::util::SelfCallVisitor::analyze(program);
+    bool optimized = options.level != basilisk::optimization::Level::O0 && options.ops != 3;
+
+    // Note: functions are sorted, as they are collected into unordered containers
+    std::vector<std::string> functions;
+    for (auto &function : recursive) {
+        functions.push_back(function.str());
+    }
+    std::sort(functions.begin(), functions.end());
+
+    // Note: the report is written at once, as several inputs may be compiled on multiple threads
+    std::ostringstream report;
+    report << "Recursion in " << (options.file_in ? options.filename_in : "standard input") << ":"
+           << (functions.empty() ? " none\n" : "\n");
+    for (auto &function : functions) {
+        report << "    " << function << ": ";
+        auto found = self_calls.find(basilisk::ast::Identifier(function));
+        if (found == self_calls.end()) {
+            report << "not turned into a loop, only recursive through other functions\n";
+        } else if (found->second.tail == 0) {
+            report << "not turned into a loop, no call to itself is in tail position\n";
+        } else if (!optimized) {
+            report << "not turned into a loop without optimization\n";
+        } else if (found->second.other > 0) {
+            report << "partially turned into a loop, " << found->second.other << " of "
+                   << found->second.tail + found->second.other << " calls to itself not in tail position\n";
+        } else {
+            report << "turned into a loop\n";
+        }
+    }
+    std::cerr << report.str();
+}
+//----- End Code Generation Section
+
+/**
+ * \brief Run the compilation stages requested by the options
+ *
+ * \param options Options
+ * \param report Time report to record the phases into
+ * \return Exit code
+ */
+int compile(const Options &options, TimeReport &report) {
+    // Read the input
+    std::unique_ptr<llvm::MemoryBuffer> source;
+    {
+        TimeReport::Scope phase(report, "read");
+        bool read_success = options.file_in ? read_file(options.filename_in, source) : read_stdin(source);
+        if (!read_success) {
+            return 1;
+        }
+        report.count("bytes", source->getBufferSize());
+    }
+
+    // Create the engine first when running, as the program is compiled for its host machine
+    std::unique_ptr<basilisk::jit::Engine> engine;
+    if (options.run) {
+        TimeReport::Scope phase(report, "engine");
+        engine = create_engine(options);
+        if (!engine) {
+            return 1;
+        }
+    }
+    const llvm::TargetMachine *host = engine ? &engine->host_machine() : nullptr;
+
+    // Look up the compiled program in the cache when compiling to object code or running
+    std::unique_ptr<basilisk::cache::ObjectCache> cache;
+    std::string key;
+    std::optional<std::string> entry;
+    // Note: split objects and bitcode are not cached, the recursion report needs the parsed program, and profiles and
+    //  remarks need the optimization pipeline
+    if (!options.cache_dir.empty() && options.ops == 0 && options.split == 0 && !options.interpret
+        && !options.emit_bc && !options.report_recursion && !options.profile.generate
+        && options.profile.use_file.empty() && options.filename_remarks.empty()) {
+        TimeReport::Scope phase(report, "cache");
+        cache = std::make_unique<basilisk::cache::ObjectCache>(options.cache_dir);
+        key = cache_key(options, *source, host);
+        entry = cache->get(key);
+        report.count("hits", cache->hits());
+        report.count("misses", cache->misses());
+    }
+
+    // Use the cached program on a hit
+    if (entry) {
+        if (!options.run) {
+            TimeReport::Scope phase(report, "emit");
+            return write_output(options, *entry) ? 0 : 1;
+        }
+
+        basilisk::jit::Object object;
+        if (basilisk::jit::Object::deserialize(*entry, object)) {
+            TimeReport::Scope phase(report, "run");
+            return run_jit(*engine, [&](){ engine->add(std::move(object)); });
+        }
+        // Note: an invalid entry is recompiled and replaced
+    }
+
+    // Output tokens if only lexing requested
+    if (options.ops == 1) {
         // Lex the input
         std::vector<basilisk::tokens::Token> buffer;
-        auto append_f = [&buffer](basilisk::tokens::Token t){ buffer.push_back(t); };
         bool lex_success;
-        if (file_in) {
-            // File input
-            lex_success = lex_file(filename_in, append_f);
-        } else {
-            // Standard input
-            lex_success = lex_stdin(append_f);
+        {
+            TimeReport::Scope phase(report, "lex");
+            lex_success = lex_buffer(*source, buffer);
+            report.count("tokens", buffer.size());
         }
 
         // Print error and terminate on lexing failure
@@ -254,219 +1200,472 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
-        // Print error and terminate on no tokens
-        if (buffer.empty()) {
-            error() << "Lexing resulted in no tokens.\n";
+        std::ostringstream tokens;
+        print_tokens(tokens, buffer);
+        return write_output(options, tokens.str()) ? 0 : 1;
+    }
+
+    // Parse program, lexing the input as the parser consumes the tokens
+    basilisk::ast::Program program({});
+    {
+        TimeReport::Scope phase(report, "parse");
+        std::string_view input(source->getBufferStart(), source->getBufferSize());
+
+        try {
+            if (options.jobs) {
+                // Note: definitions are parsed on multiple threads, which needs all of the tokens up front
+                std::vector<basilisk::tokens::Token> buffer;
+                basilisk::lexer::lex(input, buffer);
+                report.count("tokens", buffer.size());
+                program = basilisk::parallel::parse(buffer, *options.jobs);
+            } else {
+                std::size_t count = 0;
+                program = basilisk::parser::parse(input, &count);
+                report.count("tokens", count);
+            }
+        } catch (basilisk::lexer::LexerException &e) {
+            // Print exception and note failure
+            error() << "Lexer exception - " << e.what() << '\n'
+                    << "Lexing failed.\n";
+            return 1;
+        } catch (basilisk::parser::ParserException &e) {
+            // Print exception and note failure
+            error() << "Parser exception - " << e.what() << '\n'
+                    << "Parsing failed.\n";
+            return 1;
+        }
+        if (report.is_enabled()) {
+            report.count("nodes", basilisk::ast::util::CountVisitor::count(program).nodes);
+        }
+    }
+
+    // Report the recursive functions if requested
+    if (options.report_recursion) {
+        report_recursion(options, program);
+    }
+
+    // Output AST if only parsing requested
+    if (options.ops == 2) {
+        return write_output(options, basilisk::ast::util::PrintVisitor::print(program)) ? 0 : 1;
+    }
+
+    // Interpret the program if requested, which needs none of the LLVM stages
+    if (options.interpret && options.ops == 0) {
+        TimeReport::Scope phase(report, "interpret");
+        return interpret(options, std::move(program), report);
+    }
+
+    // Generate LLVM IR, reusing the unchanged functions when compiling incrementally
+    // Note: the context and module are owned by pointers to allow handing them over to the JIT, and the remarks file
+    //  outlives the context that writes into it
+    std::unique_ptr<llvm::ToolOutputFile> remarks;
+    auto context = std::make_unique<llvm::LLVMContext>();
+    if (!options.filename_remarks.empty() && !setup_remarks(options, *context, remarks)) {
+        return 1;
+    }
+    auto module_ptr = std::make_unique<llvm::Module>(options.file_in ? options.filename_in : "standard input", *context);
+    llvm::Module &module = *module_ptr;
+
+    // Create the target machine first, which the optimization pipeline is tuned to, including that of the shards
+    // Note: programs that are run are compiled for the host machine of the engine rather than the target options
+    std::unique_ptr<llvm::TargetMachine> target_machine;
+    {
+        TimeReport::Scope phase(report, "target");
+        target_machine = create_target_machine(options, host);
+        if (!target_machine) {
             return 1;
         }
+        basilisk::optimization::configure(module, *target_machine);
+    }
 
-        // Output tokens if only lexing requested
-        if (ops == 1) {
-            // Only lexing requested -> output tokens
-            if (file_out) {
-                // Open a stream to the output file
-                std::ofstream stream(filename_out, std::ios::out);
+    {
+        TimeReport::Scope phase(report, "codegen");
+        std::unique_ptr<basilisk::cache::ObjectCache> function_cache;
+        if (options.incremental) {
+            function_cache = std::make_unique<basilisk::cache::ObjectCache>(options.cache_dir);
+        }
+        if (!generate(program, module, options, *target_machine, function_cache.get(), report)) {
+            return 1;
+        }
 
-                if (!stream.is_open()) {
-                    // Output not open -> print error and terminate
-                    error() << "Failed to open file " << filename_out << '\n';
-                    return 1;
-                } else {
-                    // Print tokens to the stream separated with vertical bars
-                    for (basilisk::tokens::Token t : buffer) {
-                        std::cout << t;
-                        if (t != *(buffer.end())) {
-                            std::cout << '|';
-                        }
-                    }
-                }
-            } else {
-                // Print tokens to the stream separated with vertical bars
-                for (basilisk::tokens::Token t : buffer) {
-                    std::cout << t;
-                    if (t != *(buffer.end())) {
-                        std::cout << '|';
-                    }
-                }
+        // Note: only the functions generated by now get the attributes of the target
+        basilisk::optimization::configure(module, *target_machine);
+        report.count("functions", module.getFunctionList().size());
+        report.count("instructions", count_instructions(module));
+    }
+
+    // Time the LLVM passes in detail along with the report
+    // Note: pass timings are global, so inputs compiled on multiple threads are not timed in detail
+    if (!options.batch) {
+        llvm::TimePassesIsEnabled = report.is_enabled();
+    }
+
+    // Optimize unless unoptimized code generation was requested
+    if (options.ops != 3) {
+        TimeReport::Scope phase(report, "optimize");
+        try {
+            basilisk::optimization::optimize(module, options.level, target_machine.get(), options.profile);
+        } catch (std::exception &e) {
+            // Print exception, note failure and terminate
+            error() << "LLVM optimization pass exception - " << e.what() << '\n'
+                    << "LLVM optimization failed.\n";
+            return 1;
+        }
+        report.count("instructions", count_instructions(module));
+    }
+
+    // Output LLVM IR if only (optimized or unoptimized) code generation was requested, or bitcode instead of objects
+    if (options.ops == 3 || options.ops == 4 || options.emit_bc) {
+        return write_output(options, module) ? 0 : 1;
+    }
+
+    // Run the program if requested, storing its object into the cache if any
+    if (options.run) {
+        TimeReport::Scope phase(report, "run");
+        if (cache) {
+            return run_jit(*engine, [&](){
+                auto object = engine->compile(module);
+                cache->put(key, object.serialize());
+                engine->add(std::move(object));
+            });
+        }
+        return run_jit(*engine, [&](){
+            engine->add(std::move(context), std::move(module_ptr));
+        });
+    }
+
+    // Otherwise -> output object code, storing it into the cache if any
+    TimeReport::Scope phase(report, "emit");
+    if (options.split > 0) {
+        return write_split_output(options, std::move(module_ptr), *target_machine, report) ? 0 : 1;
+    }
+    std::string code;
+    if (!emit_object(module, *target_machine, code)) {
+        return 1;
+    }
+    if (cache) {
+        cache->put(key, code);
+    }
+    return write_output(options, code) ? 0 : 1;
+}
+
+/**
+ * \brief Convert an optimization level into the numeric level of link-time optimization
+ *
+ * \param level Optimization level
+ * \return Numeric level, with size optimization at the default level
+ */
+unsigned lto_level(basilisk::optimization::Level level) {
+    switch (level) {
+        case basilisk::optimization::Level::O0:
+            return 0;
+        case basilisk::optimization::Level::O1:
+            return 1;
+        case basilisk::optimization::Level::O3:
+            return 3;
+        default:
+            return 2;
+    }
+}
+
+/**
+ * \brief Link bitcode input files with ThinLTO into native objects
+ *
+ * Inputs with a module summary (see `--thinlto`) import the functions they call from the other inputs, so that they
+ *  can be inlined, and are then optimized and emitted on multiple threads, each into its own object.
+ * Inputs without a summary are linked together and emitted as one object.
+ * The objects are written next to the output file, which lists them (see \ref write_objects).
+ * Definitions stay visible to other objects, so that the objects can still be linked with native code.
+ *
+ * \param options Options holding the inputs, output, target, optimization level and jobs
+ * \param report Time report to record the phases into
+ * \return Exit code
+ */
+int link_lto(const Options &options, TimeReport &report) {
+    // Read the inputs
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> buffers;
+    {
+        TimeReport::Scope phase(report, "read");
+        for (auto &filename : options.filenames_in) {
+            if (!read_file(filename, buffers.emplace_back())) {
+                return 1;
             }
-        } else {
-            // Otherwise -> parse
-
-            // Reverse tokens to prepare buffer
-            std::reverse(buffer.begin(), buffer.end());
-
-            // Bind functions
-            auto get_f = std::bind(&parser_get, &buffer);
-            auto peek_f = std::bind(&parser_peek, &buffer, std::placeholders::_1);
-
-            // Parse program
-            basilisk::ast::Program program({});
-            try {
-                program = basilisk::parser::ProgramParser(get_f, peek_f).program();
-            } catch (basilisk::parser::ParserException e) {
-                // Print exception and note failure
-                error() << "Parser exception - " << e.what() << '\n'
-                        << "Parsing failed.\n";
+        }
+        report.count("modules", buffers.size());
+    }
+
+    // Configure the link for the target
+    llvm::lto::Config config;
+    config.CPU = resolve_cpu(options.cpu);
+    auto features = resolve_features(options.features);
+    if (!features.empty()) {
+        config.MAttrs = llvm::SubtargetFeatures(features).getFeatures();
+    }
+    if (!options.triple.empty()) {
+        config.OverrideTriple = options.triple;
+    }
+    config.Options = target_options(options);
+    if (!options.filename_remarks.empty()) {
+        // Note: the remarks of each module after the first go into the file suffixed by its index
+        config.RemarksFilename = options.filename_remarks;
+        config.RemarksFormat = "yaml";
+    }
+    config.RelocModel = llvm::Reloc::Model::PIC_;
+    config.OptLevel = lto_level(options.level);
+    config.CGOptLevel = basilisk::optimization::codegen_level(options.level);
+    auto jobs = basilisk::parallel::resolve_jobs(options.jobs.value_or(0));
+#if LLVM_VERSION_MAJOR >= 11
+    llvm::lto::LTO lto(std::move(config),
+            llvm::lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency(jobs)));
+#else
+    llvm::lto::LTO lto(std::move(config), llvm::lto::createInProcessThinBackend(jobs));
+#endif
+
+    // Add the inputs, each symbol resolving to its only definition
+    {
+        TimeReport::Scope phase(report, "resolve");
+        llvm::StringMap<std::string> definitions;
+        for (std::size_t i = 0; i < buffers.size(); i++) {
+            auto &filename = options.filenames_in[i];
+            auto input = llvm::lto::InputFile::create(buffers[i]->getMemBufferRef());
+            if (!input) {
+                error() << "Failed to read bitcode from " << filename << " - " << llvm::toString(input.takeError())
+                        << '\n';
                 return 1;
             }
 
-            // Output AST if only parsing requested
-            if (ops == 2) {
-                // Only parsing requested -> output AST
-                if (file_out) {
-                    // Open a stream to the output file
-                    std::ofstream stream(filename_out, std::ios::out);
-
-                    if (!stream.is_open()) {
-                        // Print error if output not open
-                        error() << "Failed to open file " << filename_out << '\n';
-                        return 1;
-                    } else {
-                        // Print AST to the stream
-                        stream << basilisk::ast::util::PrintVisitor::print(program);
-                    }
-                } else {
-                    // Print AST to the stream
-                    std::cout << basilisk::ast::util::PrintVisitor::print(program);
+            std::vector<llvm::lto::SymbolResolution> resolutions;
+            for (auto &symbol : (*input)->symbols()) {
+                auto &resolution = resolutions.emplace_back();
+                if (symbol.isUndefined()) {
+                    continue;
                 }
-            } else {
-                // Otherwise -> generate LLVM IR
-
-                // Prepare state
-                llvm::LLVMContext context;
-                llvm::IRBuilder<> builder(context);
-                llvm::Module module(file_in ? filename_in : "standard input", context);
-                basilisk::codegen::NamedValuesStacks named_values;
-                basilisk::codegen::ProgramCodegen program_cg(context, builder, &module, named_values);
-
-                // Generate LLVM IR
-                try {
-                    program.accept(program_cg);
-                } catch (std::exception e) {
-                    // Print exception and note failure
-                    error() << "LLVM IR generation exception - " << e.what() << '\n'
-                            << "LLVM IR generation failed.\n";
+                auto inserted = definitions.try_emplace(symbol.getName(), filename);
+                if (!inserted.second) {
+                    error() << "Symbol " << symbol.getName().str() << " is defined in both "
+                            << inserted.first->second << " and " << filename << ".\n";
                     return 1;
                 }
+                resolution.Prevailing = true;
+                resolution.FinalDefinitionInLinkageUnit = true;
+                resolution.VisibleToRegularObj = true;
+            }
 
-                // Optimize unless unoptimized code generation was requested
-                if (ops != 3) {
-                    // Initialize optimization passes
-                    auto pass_manager = llvm::legacy::PassManager();
-
-                    // Add passes recommended in https://llvm.org/docs/tutorial/LangImpl04.html
-                    pass_manager.add(llvm::createInstructionCombiningPass());   // Merge instructions
-                    pass_manager.add(llvm::createReassociatePass());    // Use associativity to improve constant propagation
-                    pass_manager.add(llvm::createGVNPass());    // Most importantly promote stack to registers
-                    pass_manager.add(llvm::createCFGSimplificationPass());  // Simplify control flow graph
-
-                    // Run the passes
-                    try {
-                        pass_manager.run(module);
-                    } catch (std::exception e) {
-                        // Print exception, note failure and terminate
-                        error() << "LLVM optimization pass exception - " << e.what() << '\n'
-                                << "LLVM optimization failed.\n";
-                        return 1;
-                    }
-                }
+            if (auto err = lto.add(std::move(*input), resolutions)) {
+                error() << "Failed to add " << filename << " to the link - " << llvm::toString(std::move(err)) << '\n';
+                return 1;
+            }
+        }
+    }
 
-                // Output LLVM IR if only (optimized or unoptimized) code generation was requested
-                if (ops == 3 || ops == 4) {
-                    // Only codegen requested -> output LLVM IR
-                    if (file_out) {
-                        // Open a stream to the output file and print the module into it
-                        std::error_code ec;
-                        llvm::raw_fd_ostream stream = llvm::raw_fd_ostream(filename_out, ec);
-                        if (ec) {
-                            // Error -> print message
-                            error() << "Failed to open file " << filename_out << " - " << ec.message() <<'\n';
-                            return 1;
-                        } else {
-                            // Fine -> print module
-                            module.print(stream, nullptr);
-                        }
-                    } else {
-                        // Print AST to the stream
-                        module.print(llvm::outs(), nullptr);
-                    }
-                } else {
-                    // Otherwise -> output object code
-
-                    // Pick target
-                    auto target_triple = llvm::sys::getDefaultTargetTriple();
-                    llvm::InitializeAllTargetInfos();
-                    llvm::InitializeAllTargets();
-                    llvm::InitializeAllTargetMCs();
-                    llvm::InitializeAllAsmParsers();
-                    llvm::InitializeAllAsmPrinters();
-                    std::string err;
-                    auto target = llvm::TargetRegistry::lookupTarget(target_triple, err);
-
-                    // Print error and terminate if target lookup failed
-                    if (!target) {
-                        error() << "Failed to look up target - " << err;
-                        return 1;
-                    }
-
-                    // Get target machine
-                    auto cpu = "generic";
-                    auto features = "";
-                    llvm::TargetOptions options;
-                    auto relocation_model = llvm::Optional<llvm::Reloc::Model>(llvm::Reloc::Model::PIC_);
-                    auto target_machine = target->createTargetMachine(target_triple, cpu, features, options, relocation_model);
-
-                    // Configure module
-                    module.setDataLayout(target_machine->createDataLayout());
-                    module.setTargetTriple(target_triple);
-
-                    // Prepare output stream and emit the object code
-                    if (file_out) {
-                        // Open a stream to the output file and emit the code into it
-                        std::error_code ec;
-                        auto stream = llvm::raw_fd_ostream(filename_out, ec);
-
-                        // Print error and terminate on file open error
-                        if (ec) {
-                            error() << "Failed to open file " << filename_out << " - " << ec.message() <<'\n';
-                            return 1;
-                        }
-
-                        // Create and run pass to emit object code
-                        llvm::legacy::PassManager pass;
-                        auto file_type = llvm::TargetMachine::CGFT_ObjectFile;
-                        if (target_machine->addPassesToEmitFile(pass, stream, nullptr, file_type)) {
-                            // Error -> print message
-                            error() << "File emit pass error - TargetMachine can't emit a file of this type";
-                            return 1;
-                        } else {
-                            // Otherwise -> run the pass
-                            pass.run(module);
-                        }
-                    } else {
-                        // Prepare a stream to a small string
-                        llvm::SmallString<0> small_string;
-                        auto stream = llvm::raw_svector_ostream(small_string);
-
-                        // Create and run pass to emit object code
-                        llvm::legacy::PassManager pass;
-                        auto file_type = llvm::TargetMachine::CGFT_ObjectFile;
-                        if (target_machine->addPassesToEmitFile(pass, stream, nullptr, file_type)) {
-                            // Error -> print message
-                            error() << "File emit pass error - TargetMachine can't emit a file of this type";
-                            return 1;
-                        } else {
-                            // Otherwise -> run the pass
-                            pass.run(module);
-                        }
-
-                        // Print the small string into standard output
-                        std::cout << small_string.c_str();
-                    }
-                }
+    // Import, optimize and emit
+    // Note: tasks that emit nothing leave their objects empty
+    std::vector<llvm::SmallString<0>> objects(lto.getMaxTasks());
+#if LLVM_VERSION_MAJOR >= 14
+    auto add_stream = [&objects](unsigned task) -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+        return std::make_unique<llvm::CachedFileStream>(std::make_unique<llvm::raw_svector_ostream>(objects[task]));
+    };
+#else
+    auto add_stream = [&objects](unsigned task){
+        return std::make_unique<llvm::lto::NativeObjectStream>(
+                std::make_unique<llvm::raw_svector_ostream>(objects[task]));
+    };
+#endif
+    {
+        TimeReport::Scope phase(report, "link");
+        if (auto err = lto.run(add_stream)) {
+            error() << "Link-time optimization failed - " << llvm::toString(std::move(err)) << '\n';
+            return 1;
+        }
+    }
+
+    // Write the objects
+    TimeReport::Scope phase(report, "emit");
+    std::vector<std::string> codes;
+    for (auto &object : objects) {
+        if (!object.empty()) {
+            codes.push_back(object.str().str());
+        }
+    }
+    report.count("objects", codes.size());
+    return write_objects(options, codes) ? 0 : 1;
+}
+
+/**
+ * \brief Find the functions defined by each input file, parsing the files on multiple threads
+ *
+ * Only needed when the inputs can call each other's functions and code is generated, so nothing is found otherwise.
+ * Inputs that fail to read or parse define no functions, and their errors are reported when they are compiled.
+ *
+ * \param options Options holding the input files, stage, jobs and whether the inputs can call each other
+ * \return Functions defined by each input, in order
+ */
+std::vector<std::vector<basilisk::codegen::Prototype>> gather_prototypes(const Options &options) {
+    std::vector<std::vector<basilisk::codegen::Prototype>> prototypes(options.filenames_in.size());
+    if (!options.cross_input_calls || options.ops == 1 || options.ops == 2) {
+        return prototypes;
+    }
+
+    basilisk::parallel::for_each(prototypes.size(), options.jobs.value_or(0), [&](std::size_t i){
+        auto buffer = llvm::MemoryBuffer::getFile(options.filenames_in[i]);
+        if (!buffer) {
+            return;
+        }
+        try {
+            auto program = basilisk::parser::parse(std::string_view((*buffer)->getBufferStart(),
+                                                                    (*buffer)->getBufferSize()));
+            prototypes[i] = basilisk::codegen::prototypes(program);
+        } catch (std::exception &) {
+            prototypes[i].clear();
+        }
+    });
+    return prototypes;
+}
+
+/**
+ * \brief Compile several input files on multiple threads, each into its own output
+ *
+ * The outputs are written into the output directory, or next to their inputs if none, and are named after the inputs
+ *  with the extension of the output.
+ * With cross-input calls, each input can call the functions of all of the other inputs, as if they were one program,
+ *  so a function must not be defined by two inputs.
+ * Each input is compiled sequentially, with the jobs used for the inputs instead.
+ *
+ * \param options Options holding the input files
+ * \return Exit code, non-zero if any of the inputs failed
+ */
+int compile_batch(const Options &options) {
+    // Pick the extension of the outputs
+    std::string extension;
+    if (options.ops == 1) {
+        extension = ".tokens";
+    } else if (options.ops == 2) {
+        extension = ".ast";
+    } else if (options.emit_bc) {
+        extension = ".bc";
+    } else if (options.ops == 3 || options.ops == 4) {
+        extension = ".ll";
+    } else {
+        extension = ".o";
+    }
+
+    // Prepare the options of each input
+    // Note: an output written by two inputs would depend on the order they finish in, so it is an error
+    if (options.file_out) {
+        if (auto ec = llvm::sys::fs::create_directories(options.filename_out)) {
+            error() << "Failed to create directory " << options.filename_out << " - " << ec.message() << '\n';
+            return 1;
+        }
+    }
+    std::vector<Options> inputs;
+    llvm::StringMap<std::string> outputs;
+    auto prototypes = gather_prototypes(options);
+    // Note: redefinitions within one input are reported when it is compiled
+    llvm::StringMap<std::size_t> definers;
+    for (std::size_t i = 0; i < prototypes.size(); i++) {
+        for (auto &prototype : prototypes[i]) {
+            auto inserted = definers.try_emplace(prototype.name, i);
+            if (!inserted.second && inserted.first->second != i) {
+                error() << "Input files " << options.filenames_in[inserted.first->second] << " and "
+                        << options.filenames_in[i] << " both define function " << prototype.name << ".\n";
+                return 1;
+            }
+        }
+    }
+    for (auto &filename : options.filenames_in) {
+        llvm::SmallString<128> output(options.file_out ? options.filename_out
+                                                       : llvm::sys::path::parent_path(filename).str());
+        llvm::sys::path::append(output, llvm::sys::path::stem(filename) + extension);
+
+        auto inserted = outputs.try_emplace(output, filename);
+        if (!inserted.second) {
+            error() << "Input files " << inserted.first->second << " and " << filename << " would both be written to "
+                    << output.str().str() << ".\n";
+            return 1;
+        }
+
+        auto &input = inputs.emplace_back(options);
+        input.filename_in = filename;
+        input.filenames_in = {filename};
+        input.file_out = true;
+        input.filename_out = output.str().str();
+        input.jobs = std::nullopt;
+        input.batch = true;
+        for (std::size_t other = 0; other < prototypes.size(); other++) {
+            if (other + 1 != inputs.size()) {
+                input.imports.insert(input.imports.end(), prototypes[other].begin(), prototypes[other].end());
             }
         }
     }
 
-    return 0;
+    // Compile the inputs, each with its own report
+    std::vector<std::unique_ptr<TimeReport>> reports;
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+        reports.push_back(std::make_unique<TimeReport>(options.time_report));
+    }
+    std::vector<int> exit_codes(inputs.size(), 0);
+    basilisk::parallel::for_each(inputs.size(), options.jobs.value_or(0), [&](std::size_t i){
+        exit_codes[i] = compile(inputs[i], *reports[i]);
+        reports[i]->end();
+    });
+
+    // Print the reports and failures in the order of the inputs
+    int exit_code = 0;
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+        if (options.time_report) {
+            std::cerr << inputs[i].filename_in << ":\n";
+            reports[i]->print(std::cerr);
+        }
+        if (exit_codes[i] != 0) {
+            error() << "Compiling " << inputs[i].filename_in << " failed.\n";
+            exit_code = 1;
+        }
+    }
+    return exit_code;
+}
+
+int main(int argc, char *argv[]) {
+    // No arguments -> print usage
+    if (argc <= 1) {
+        show_usage();
+        return 0;
+    }
+
+    // Some arguments -> process them (-h and -v stop execution)
+    Options options;
+    int exit_code = 0;
+    if (!parse_arguments(argc, argv, options, exit_code)) {
+        return exit_code;
+    }
+
+    // Initialize the targets once for all of the inputs
+    initialize_targets();
+
+    // Several inputs -> compile them on multiple threads
+    if (options.filenames_in.size() > 1 && !options.lto) {
+        return compile_batch(options);
+    }
+
+    // Run the compilation or link
+    TimeReport report(options.time_report);
+    exit_code = options.lto ? link_lto(options, report) : compile(options, report);
+    report.end();
+
+    // Print the report, along with the detailed pass timings
+    if (options.time_report) {
+        report.print(std::cerr);
+        llvm::reportAndResetTimings();
+    }
+
+    // Write the trace
+    if (!options.filename_trace.empty()) {
+        std::ofstream stream(options.filename_trace, std::ios::out);
+        if (!stream.is_open()) {
+            error() << "Failed to open file " << options.filename_trace << '\n';
+            return 1;
+        }
+        report.write_trace(stream);
+    }
+
+    return exit_code;
 }